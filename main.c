@@ -1,9 +1,31 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include <time.h>
 #include <assert.h> 
 #include <math.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+#include <pthread.h>
+#include <signal.h>
+#include <sched.h>
+#include <stdatomic.h>
 
 #define ARRAY_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
 
@@ -66,13 +88,90 @@ _Static_assert(VEHICLE_TYPE_COUNT == ARRAY_COUNT(VehicleTypeNames),
 // ================================================
 
 // =====================CONSTANTS =================
-//Vehicle capacities
+//Vehicle capacities (used for the default lot when no lot config exists)
 const int MAX_MOTORCYCLES = 100;
 const int MAX_THREE_WHEELERS = 75;
 const int MAX_CARS = 100;
 const int MAX_VANS = 50;
 const int MAX_BUSES = 30;
-#define TOTAL_SLOTS 355
+
+// Default share of each vehicle type reserved per customer type, in percent
+const int DEFAULT_QUOTA_PERCENT[] = {
+    [DISABLED] = 15,
+    [VIP] = 10,
+    [STAFF] = 15,
+    [REGISTERED] = 25,
+    [GUEST] = 35
+};
+
+// Lots
+#define LOT_CONFIG_FILE "parking_lots.txt"
+#define DEFAULT_LOT_ID 1
+#define MAX_LOTS 1024
+#define MAX_LOT_VEHICLES 16000000         // per-lot capacity limit
+#define MAX_LOT_MEMORY ((size_t)1 << 30)  // per-lot arena limit in bytes
+
+// Plate lookup index (chained through the rows, power of two buckets,
+// load factor <= 1), locked in stripes of buckets
+#define PLATE_INDEX_EMPTY -1
+#define PLATE_LOCK_STRIPES 64
+
+// Plate encoding (see PLATES): six bits per character, ten characters in
+// PlateKey.hi and nine in PlateKey.lo
+#define PLATE_CODE_BITS 6
+#define PLATE_WORD_CHARS 10
+#define PLATE_SEPARATOR_CODE 1   // code 0 ends the plate
+#define PLATE_DIGIT_CODE 2       // '0'..'9' = 2..11
+#define PLATE_LETTER_CODE 12     // 'A'..'Z' = 12..37
+#define PLATE_SEPARATORS " -_./" // all read as one '-'
+
+// Persistence files and journal tuning. Per-lot files are named
+// parking_lot<id>_<suffix>; parking_data.txt is the pre-lot format.
+#define LEGACY_DATA_FILE "parking_data.txt"
+#define SNAPSHOT_SUFFIX "snapshot.bin"
+#define SNAPSHOT_TEMP_SUFFIX "snapshot.bin.tmp"
+#define SNAPSHOT_CORRUPT_SUFFIX ".corrupt"  // appended to a snapshot that failed a lazy check
+#define JOURNAL_SUFFIX "journal.bin"
+#define ARCHIVE_SUFFIX "archive_"     // + YYYYMMDD.bin: one file per UTC day of exit
+#define LOT_FILE_NAME_LENGTH 64
+
+// Gate workers (batch mode with --gates N)
+#define MAX_GATE_WORKERS 64
+#define GATE_QUEUE_LINES 4096
+#define BATCH_LINE_LENGTH 128
+#define JOURNAL_SYNC_BATCH 32        // fsync after this many records...
+#define JOURNAL_SYNC_INTERVAL 1      // ...or once this many seconds have passed
+#define JOURNAL_COMPACT_RECORDS 4096 // write a fresh snapshot after this many records
+
+// Shared lots (--shared <name>): one POSIX shared memory object per name,
+// mapped at the same address in every process that attaches
+#define SHARED_LOTS_ADDRESS 0x600000000000ull // asked for by the creator
+#define SHARED_NAME_LENGTH 30
+#define MAX_SHARED_PROCESSES 64
+#define SHARED_ATTACH_WAIT_MS 5000            // for the creator to finish loading
+
+// Replication (--leader / --follow <socket>): the leader queues its change
+// log in a ring and a sender thread streams it to one follower
+#define REPLICATION_RING_RECORDS 65536 // a follower this far behind is detached
+#define REPLICATION_SEND_RECORDS 512   // records per socket write
+#define REPLICATION_CHECKSUM_MS 1000   // between state checksums sent to the follower
+#define REPLICATION_CONNECT_WAIT_MS 5000 // for the leader's socket to appear
+#define REPLICATION_SEND_TIMEOUT_MS 1000 // a follower not reading this long is dropped
+
+// Service mode (./main --serve): request lines as in batch mode
+#define SERVE_SOCKET_PATH "parking.sock"
+#define MAX_SERVE_CLIENTS 256
+#define SERVE_INPUT_BUFFER 4096
+#define SERVE_OUTPUT_BUFFER 16384
+#define LOADTEST_CLIENTS 8
+#define LOADTEST_REQUESTS 100000     // per client
+#define LOADTEST_PIPELINE 16         // requests in flight per client
+#define MAX_LOADTEST_PIPELINE 256
+
+// Session archive: completed sessions are written in compressed blocks
+#define ARCHIVE_BLOCK_SESSIONS 4096
+#define ARCHIVE_DICTIONARY_SIZE 255  // distinct fees per block; others are escaped
+#define ARCHIVE_MAX_PAYLOAD (ARCHIVE_BLOCK_SESSIONS * 32 + ARCHIVE_DICTIONARY_SIZE * 10)
 
 // Fee structure
 const int FIRST_HOUR_FEE[] = {
@@ -91,46 +190,776 @@ const int ADDITIONAL_HOUR_FEE[] = {
     [BUS] = 100
 };
 
-const float DISCOUNTS[] = {
-    [DISABLED] = 0.6,
-    [VIP] = 0.5,
-    [STAFF] = 0.8,
-    [REGISTERED] = 0.3,
-    [GUEST] = 0.0
+// Maximum stay per vehicle type, in hours. A vehicle parked longer raises
+// an overstay alert.
+const int MAX_DWELL_HOURS[] = {
+    [MOTORCYCLE] = 24,
+    [THREE_WHEELER] = 24,
+    [CAR] = 24,
+    [VAN] = 48,
+    [BUS] = 12
+};
+#define OVERSTAY_BATCH_PLATES 6 // plates listed per OVERSTAY result line
+
+// Discounts in whole percent so bills stay exact in cents
+const int DISCOUNT_PERCENT[] = {
+    [DISABLED] = 60,
+    [VIP] = 50,
+    [STAFF] = 80,
+    [REGISTERED] = 30,
+    [GUEST] = 0
 };
+
+// Tariff (see TARIFF). An optional TARIFF_FILE replaces the fee and
+// discount tables above; SIGHUP re-reads it in batch and service mode.
+#define TARIFF_FILE "parking_tariff.txt"
+#define TARIFF_BLOCK_HOURS 24  // daily caps apply per 24 billed hours from arrival
+#define MAX_TARIFF_BANDS 24
+#define MAX_TARIFF_ZONE_SPANS 32  // UTC offset changes precomputed per compiled tariff
+#define TARIFF_ZONE_YEARS 5       // ... within this many years either side of compiling
+#define MAX_TARIFF_READERS 256    // threads billing at once that let retired tariffs be freed
+
+// Arrival forecasts (--policy forecast): arrival rates decay with time
+// constant FORECAST_TAU; every FORECAST_INTERVAL seconds of event time a
+// protected cell keeps free what its own tier is forecast to bring in
+// FORECAST_HORIZON.
+#define FORECAST_TAU 3600
+#define FORECAST_INTERVAL 900
+#define FORECAST_HORIZON 900
+
+// Advance reservations (see RESERVATIONS): holds are counted per cell in
+// 15-minute buckets, on a ring of RESERVATION_BUCKETS (42.7 days)
+#define RESERVATION_BUCKET_SECONDS 900
+#define RESERVATION_BUCKET_BITS 12
+#define RESERVATION_BUCKETS (1 << RESERVATION_BUCKET_BITS)
+#define RESERVATION_HORIZON_DAYS 30    // a booking must end within this
+#define RESERVATION_MAX_HOURS 24
+#define RESERVATION_GRACE_MINUTES 30   // a no-show's bay is released after this
+#define RESERVATION_LOOKAHEAD_BUCKETS 4 // walk-ins leave free what is held in the next hour
+#define RESERVABLE_PERCENT 50          // of a cell's bays
+#define RESERVATION_INITIAL_CAPACITY 256
+#define SHARED_RESERVATIONS_PER_BAY 4  // fixed book size of a shared lot
+
+// Default row counts for ./main --bench billing / scan
+#define BENCH_BILLING_ROWS 1000000
+#define BENCH_TARIFF_ROWS 1000000
+#define BENCH_TARIFF_SWAPS 2000 // tariff swaps while gate threads bill
+#define BENCH_SCAN_ROWS 2000000
+#define BENCH_PLATE_ROWS 1000000
+#define BENCH_RENDER_FRAMES 5000
+#define BENCH_BAYS 65536
+#define BENCH_BAY_OPERATIONS 200000
+#define BENCH_OPS_PAIRS 20000  // enter/exit pairs per occupancy level
+#define BENCH_OPS_BILLS 2000
+#define BENCH_OPS_RENDERS 200
+#define BENCH_OPS_FILE_ROUNDS 10 // saves and loads per occupancy level
+#define BENCH_REPORT_BAYS 10000
+#define BENCH_REPORT_PAIRS 100000  // enter/exit pairs per gate thread and mode
+#define BENCH_REPORT_GATES 2
+#define BENCH_REPORT_READERS 2
+#define BENCH_OVERSTAY_VEHICLES 1000000
+#define BENCH_ARCHIVE_DAYS 365
+#define BENCH_SHARED_BAYS 10000
+#define BENCH_SHARED_PAIRS 100000 // enter/exit pairs per gate and run
+#define BENCH_SHARED_GATES 4
+#define BENCH_ARCHIVE_SESSIONS_PER_DAY 2000
+#define BENCH_RESERVATIONS 1000000
+#define BENCH_RESERVATION_BAYS 200000
+#define BENCH_RESERVATION_QUERIES 100000 // per measured book size
+#define BENCH_REPLICATION_GATES 4
+#define BENCH_STALL_SECONDS 120    // gates held up by a stopped follower this long fail the bench
+#define BENCH_STARTUP_ROUNDS 5     // snapshot loads per lot size
+#define BENCH_EXIT_SAMPLES 100000  // timed exits per lot size
+#define BENCH_RECOVERY_ENTRIES 100000
+#define BENCH_REPLAY_EVENTS 10000000L
+#define BENCH_REPLAY_PARKED 150    // vehicles the replayed trace keeps in the lot
+#define BENCH_GATE_BAYS 100000
+#define BENCH_GATE_PAIRS 400000    // exit/enter pairs per run, split over its threads
+#define BENCH_GATE_THREADS 32
+#define BENCH_GATE_STRESS_BAYS 500     // small, so cells fill and lend
+#define BENCH_GATE_STRESS_PLATES 2048  // plates every stress thread works on
+#define BENCH_GATE_STRESS_OPS 400000   // enter/exit attempts, split over the threads
+#define BENCH_SLOT_THREADS 8
+#define BENCH_SLOT_BAYS 64
+#define BENCH_SLOT_FLOOR 16        // reservations keep at least this many free before taking
+#define BENCH_SLOT_BURST 8
+#define BENCH_SLOT_ROUNDS 200000   // bursts per thread
+#define BENCH_HISTORY_THREADS 4    // linearizability check of reserveSlot()
+#define BENCH_HISTORY_OPS 16       // per thread and round
+#define BENCH_HISTORY_ROUNDS 20000
+
+// Operation timing histograms: bucket b counts durations below 2^b ns
+#define TIMING_BUCKETS 40
+
+// Render buffer: initial size; grows (rarely) when a frame does not fit
+#define RENDER_BUFFER_INITIAL 16384
 // ================================================
 
 // ================== STRUCTS =====================
-// Parking slot structure
+// Parking slot structure. Allocated and free counts share one atomic word
+// (allocated in the high 32 bits, free in the low 32 bits) so a reservation
+// can check the priority rules and take the slot in a single CAS; the total
+// is always allocated + free.
 typedef struct {
-    int total;
-    int allocated;
-    int free;
+    _Atomic uint64_t counts;
 } ParkingSlot;
 
-// Vehicle structure
+#define SLOT_COUNTS(allocated, free) (((uint64_t)(allocated) << 32) | (uint32_t)(free))
+#define SLOT_ALLOCATED(counts) ((int)((counts) >> 32))
+#define SLOT_FREE(counts) ((int)((counts) & 0xffffffffu))
+
+// Slot allocation policy. A vehicle first takes a slot in its own
+// [vehicleType][customerType] cell. Failing that it may borrow from the
+// tiers in borrowFrom[its customer type], highest priority first, as long
+// as the donor keeps more than minFreePercent of its slots free. With
+// forecast set, a cell only keeps free what its own tier is forecast to
+// need (see FORECAST), never more than minFreePercent.
+#define TIER_BIT(customerType) (1u << (customerType))
+#define TIERS_ABOVE(customerType) (TIER_BIT(customerType) - 1)
+#define ALL_TIERS (TIER_BIT(CUSTOMER_TYPE_COUNT) - 1)
+
 typedef struct {
-    char vehicleNumber[20];
+    const char *name;
+    int minFreePercent[CUSTOMER_TYPE_COUNT];
+    unsigned int borrowFrom[CUSTOMER_TYPE_COUNT];
+    int forecast;
+} AllocationPolicy;
+
+static const AllocationPolicy ALLOCATION_POLICIES[] = {
+    // Borrow from higher tiers; disabled and VIP bays keep 60% / 50% free
+    {"priority", {[DISABLED] = 60, [VIP] = 50},
+     {TIERS_ABOVE(DISABLED), TIERS_ABOVE(VIP), TIERS_ABOVE(STAFF),
+      TIERS_ABOVE(REGISTERED), TIERS_ABOVE(GUEST)}, 0},
+    // Every tier only uses its own bays
+    {"strict", {0}, {0}, 0},
+    // Like priority, but staff and registered bays also keep a quarter free
+    {"guarded", {[DISABLED] = 60, [VIP] = 50, [STAFF] = 25, [REGISTERED] = 25},
+     {TIERS_ABOVE(DISABLED), TIERS_ABOVE(VIP), TIERS_ABOVE(STAFF),
+      TIERS_ABOVE(REGISTERED), TIERS_ABOVE(GUEST)}, 0},
+    // Any tier may borrow from any other, same floors as priority
+    {"shared", {[DISABLED] = 60, [VIP] = 50},
+     {ALL_TIERS & ~TIER_BIT(DISABLED), ALL_TIERS & ~TIER_BIT(VIP), ALL_TIERS & ~TIER_BIT(STAFF),
+      ALL_TIERS & ~TIER_BIT(REGISTERED), ALL_TIERS & ~TIER_BIT(GUEST)}, 0},
+    // Like priority, but disabled and VIP bays only keep free what their
+    // own tier is forecast to need, at most 60% / 50%
+    {"forecast", {[DISABLED] = 60, [VIP] = 50},
+     {TIERS_ABOVE(DISABLED), TIERS_ABOVE(VIP), TIERS_ABOVE(STAFF),
+      TIERS_ABOVE(REGISTERED), TIERS_ABOVE(GUEST)}, 1}
+};
+#define DEFAULT_ALLOCATION_POLICY (&ALLOCATION_POLICIES[0])
+
+// Vehicle structure. This is the row type passed around; lots store their
+// vehicles column-wise (see ParkingManagement).
+#define VEHICLE_NUMBER_LENGTH 20   // printed plate, with the terminating NUL
+#define PLATE_INPUT_LENGTH 64      // raw plate as typed, before encodePlate()
+
+// Plate number in canonical form (see PLATES): upper case, one '-' for each
+// run of separators, up to VEHICLE_NUMBER_LENGTH - 1 characters packed six
+// bits each with the first character on top, so two keys compare in two
+// words and order the same way as the plate text. All zero = no plate.
+typedef struct {
+    uint64_t hi;
+    uint64_t lo;
+} PlateKey;
+
+typedef struct {
+    PlateKey plate;
+    time_t arrivalTime;
+    int bayId;              // bay number, from 1; 0 while not parked
     enum VehicleType vehicleType;
     enum CustomerType customerType;
-    time_t arrivalTime;
 } Vehicle;
 
-// Parking management structure
+// Vehicle and customer type packed into one byte for the kind column
+#define VEHICLE_KIND(vehicleType, customerType) \
+    ((unsigned char)((vehicleType) << 4 | (customerType)))
+#define KIND_VEHICLE_TYPE(kind) ((enum VehicleType)((kind) >> 4))
+#define KIND_CUSTOMER_TYPE(kind) ((enum CustomerType)((kind) & 0x0f))
+#define VEHICLE_KIND_EMPTY 0xff  // a row whose bay is free
+
+// Bay occupancy bitmaps are arrays of 64-bit words
+#define BAY_WORD_BITS 64
+#define BAY_WORDS(bits) (((bits) + BAY_WORD_BITS - 1) / BAY_WORD_BITS)
+_Static_assert(VEHICLE_TYPE_COUNT <= 16 && CUSTOMER_TYPE_COUNT <= 16,
+               "vehicle kinds must fit in one byte");
+
+// Dwell time histogram buckets (upper bounds in hours, last one open-ended)
+static const int DWELL_BUCKET_HOURS[] = {1, 2, 4, 8, 12, 24, 48};
+#define DWELL_BUCKET_COUNT (ARRAY_COUNT(DWELL_BUCKET_HOURS) + 1)
+
+// Running aggregates, kept up to date on every entry/exit so that a stats
+// query only adds up each vehicle type's copy and never touches the
+// vehicle store.
+typedef struct {
+    int occupied;
+    int occupiedByType[VEHICLE_TYPE_COUNT];
+    long arrivals;
+    long exits;
+    long rejections;
+    long borrowed;                         // parked in another tier's slot
+    long overstays;                        // vehicles that passed their maximum stay
+    long long revenueCents;
+    long long revenueByTypeCents[VEHICLE_TYPE_COUNT];
+    long long totalDwellSeconds;
+    long arrivalsByHour[24];               // local hour of day of each arrival
+    long dwellHistogram[DWELL_BUCKET_COUNT];
+} ParkingStatistics;
+
+// One completed session waiting to be written to the archive
+typedef struct {
+    int64_t arrivalTime;
+    int64_t exitTime;
+    long long payableCents;
+    unsigned char kind;       // VEHICLE_KIND(vehicleType, customerType)
+} ArchiveSession;
+
+// Consistent copy of a lot's slot matrix and occupancy counts, as returned
+// by readOccupancy() for reports
 typedef struct {
-    ParkingSlot slots[5][5]; // [vehicleType][customerType]
-    Vehicle vehicles[TOTAL_SLOTS];
+    int allocated[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT];
+    int free[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT];
+    int occupied;
+    int occupiedByType[VEHICLE_TYPE_COUNT];
+} OccupancyView;
+
+// One advance booking (see RESERVATIONS)
+typedef struct {
+    PlateKey plate;
+    int64_t start;          // first second held
+    int64_t end;            // first second no longer held
+    unsigned char kind;     // VEHICLE_KIND(vehicleType, customerType)
+    int heapSlot;           // position in the book's deadline heap
+} Reservation;
+
+// A lot's bookings. heldMax/heldAdd form one segment tree per cell over the
+// bucket ring (root 1, leaves from RESERVATION_BUCKETS): heldMax[node] is
+// the most holds of any bucket under node, heldAdd[node] holds added to all
+// of them and not yet pushed down to the node's children.
+typedef struct {
+    int32_t heldMax[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT][2 * RESERVATION_BUCKETS];
+    int32_t heldAdd[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT][RESERVATION_BUCKETS];
+    Reservation *reservations;  // dense, in no particular order
+    int *index;                 // plate hash -> reservation, -1 empty (linear probing)
+    int *deadlines;             // min-heap of reservations on their deadline
+    int count;
+    int capacity;
+    unsigned int indexMask;
+    int fixed;                  // in a shared segment, so it cannot grow
+    int64_t now;                // latest event time seen
+    long heldBucket;            // bucket heldSoon was last computed for
+} ReservationBook;
+
+// One vehicle type's part of a lot (see parkVehicle). A vehicle's row is
+// its bay, so the type's rows are rowStart .. rowStart + rowCount - 1 of
+// the lot's columns. Gates parking different types never share a store, its
+// lock or its statistics.
+typedef struct {
+    _Alignas(64) pthread_rwlock_t lock;  // the type's rows, bays and overstays
+    int rowStart;
+    int rowCount;
     int vehicleCount;
+
+    // Overstay tracking (see OVERSTAY): a min-heap of rows on their
+    // deadline at the front of the type's part of overstayRows, rows past
+    // it at the back
+    int overstayHeapCount;
+    int overstayListCount;
+
+    // The type's share of the statistics and of the arrival forecasts, and
+    // the sequence counter of its row of the occupancy view
+    pthread_mutex_t statsLock;
+    ParkingStatistics stats;
+    time_t nextRebalance;
+    _Atomic unsigned long occupancySequence;  // odd while an update is in progress
+} VehicleStore;
+
+// Guards one stripe of plate index buckets: the buckets b with
+// b % PLATE_LOCK_STRIPES equal to its position
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+} PlateLock;
+
+// Parking management structure (one per lot)
+typedef struct {
+    int lotId;
+    int capacities[VEHICLE_TYPE_COUNT];
+    int quotaPercent[CUSTOMER_TYPE_COUNT];
+    ParkingSlot slots[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT];
+
+    // Allocation policy, resolved per cell: a cell lends a slot to another
+    // tier only while it has at least lendFloor free. lendingTiers[type] has
+    // bit c set while cell [type][c] can lend; it is refreshed on every
+    // reserve and release, so picking a donor is one mask and one ctz.
+    const AllocationPolicy *policy;
+    _Atomic int lendFloor[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT];
+    _Atomic unsigned int lendingTiers[VEHICLE_TYPE_COUNT];
+
+    // Arrival forecasts for the forecast policy (see FORECAST), kept under
+    // the type's statsLock: a decaying arrival rate per cell, by requested tier
+    double arrivalRate[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT];  // per second
+    time_t arrivalRateTime[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT];
+
+    // Vehicle storage, one column per field, carved out of one arena sized
+    // to the lot. Row i of every column is the vehicle in bay i + 1, so
+    // scans only pull in the columns they read and a vehicle never moves.
+    void *arena;
+    size_t arenaBytes;
+    void *arenaMap;               // version 6 snapshot the arena lives in, or NULL
+    size_t arenaMapBytes;         //   (see MAPPED SNAPSHOTS)
+    PlateKey *plateKeys;
+    time_t *arrivalTimes;
+    unsigned char *vehicleKinds;  // VEHICLE_KIND(vehicleType, customerType), or empty
+    int vehicleCapacity;
+    VehicleStore stores[VEHICLE_TYPE_COUNT];
+    int *plateBuckets;            // plate hash -> first row (see PLATE INDEX)
+    int *plateNext;               // row -> next row in its bucket
+    unsigned int plateBucketMask; // bucket count - 1
+    PlateLock plateLocks[PLATE_LOCK_STRIPES];
+    _Atomic long invalidRejections;  // entries refused as PARK_INVALID, in no store
+
+    int *overstayRows;            // per type, see VehicleStore
+    int *overstaySlots;           // row -> heap position, or listed (< 0)
+
+    // Bay map (see BAY MAP). Cell [type][tier] owns bays bayStart + 1 ..
+    // bayStart + bayCount; its bitmap starts at bayWords[bayWordStart] and
+    // its free-word bitmap at bayFreeWords[bayFreeWordStart].
+    int bayStart[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT];
+    int bayCount[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT];
+    int bayWordStart[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT];
+    int bayFreeWordStart[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT];
+    uint64_t *bayWords;
+    uint64_t *bayFreeWords;
+
+    // Occupancy view (see OCCUPANCY VIEW): the slot matrix and occupancy as
+    // of the last completed entry or exit, one row per type written under
+    // the type's statsLock and published through its occupancySequence, so
+    // reports never block gates.
+    _Atomic int viewAllocated[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT];
+    _Atomic int viewFree[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT];
+    _Atomic int viewOccupiedByType[VEHICLE_TYPE_COUNT];
+
+    // Advance bookings (see RESERVATIONS), created with the first one and
+    // kept under reservationLock. heldSoon[type][tier] is the most bays the
+    // cell's bookings hold within the lookahead; walk-ins leave them free.
+    ReservationBook *reservations;
+    _Atomic int bookingCount;     // lets gates skip the book while it is empty
+    _Atomic int heldSoon[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT];
+
+    // Locks, always taken in this order when nested:
+    //   plate lock -> store locks (by type) -> reservationLock -> journalLock
+    //   -> statsLocks (by type)
+    // Slots need no lock (see reserveSlot). A store's lock guards the rows,
+    // bays and overstays of its type; a gate holds only the plate's lock and
+    // its type's locks (see parkVehicle). Take store locks through
+    // lockStore()/lockVehicleStore() and the mutexes through lockLotMutex():
+    // a shared lot uses sharedStoreLock for every store and plate instead,
+    // and all its mutexes are robust (see SHARED LOTS).
+    pthread_mutex_t sharedStoreLock;
+    pthread_mutex_t reservationLock;
+    pthread_mutex_t journalLock;
+    int shared;                   // lives in a shared memory segment
+    _Atomic int storeDamaged;     // a process died mid-update; rebuild before use
+
+    // Journal state
+    char snapshotFile[LOT_FILE_NAME_LENGTH];
+    char snapshotTempFile[LOT_FILE_NAME_LENGTH];
+    char journalFileName[LOT_FILE_NAME_LENGTH];
+    FILE *journalFile;
+    int journalPending;     // records written since the last fsync
+    int journalRecords;     // records written since the last snapshot
+    time_t journalLastSync;
+    int journalCompacting;
+
+    // Session archive (see ARCHIVE). Exits are staged here and written to
+    // the day file of archiveDay as one block. archiveLock is never held
+    // while taking another lock.
+    char archivePrefix[LOT_FILE_NAME_LENGTH];
+    int archiving;                // off for simulations and benchmarks
+    pthread_mutex_t archiveLock;
+    ArchiveSession *archiveSessions;
+    int archiveCount;
+    long archiveDay;              // days since 1970-01-01 UTC
 } ParkingManagement;
+
+// Bill for one parking session
+typedef struct {
+    int displayHours;
+    int displayMinutes;
+    int billableHours;
+    int fee;                  // Rs, before discount
+    long long discountCents;
+    long long payableCents;
+} Bill;
+
+// Tariff definition. Amounts are whole rupees. A band scales the hourly
+// rates of the local hours of day [fromHour, toHour) by percent (rounded to
+// whole rupees); a session no longer than graceMinutes is free.
+typedef struct {
+    int fromHour;
+    int toHour;
+    int percent;
+} TariffBand;
+
+typedef struct {
+    int graceMinutes;
+    int firstHourFee[VEHICLE_TYPE_COUNT];
+    int additionalHourFee[VEHICLE_TYPE_COUNT];
+    int dailyCap[VEHICLE_TYPE_COUNT];        // per 24 billed hours, 0 = none
+    int discountPercent[CUSTOMER_TYPE_COUNT];
+    int bandCount;
+    TariffBand bands[MAX_TARIFF_BANDS];
+} Tariff;
+
+// A compiled tariff. Without bands a bill is plain arithmetic on the
+// rates; with bands it is a few reads from lookup tables. [startHour] is
+// the local hour of day the session started in; [hours] counts billed
+// hours within one 24-hour block. first* tables cover the block starting
+// at arrival, next* every later block. Compiled tariffs are never modified
+// once published.
+typedef struct {
+    int graceSeconds;
+    int banded;
+    int allocated;   // malloc'd by loadTariff(), freed once retired
+    int firstHourFee[VEHICLE_TYPE_COUNT];
+    int additionalHourFee[VEHICLE_TYPE_COUNT];
+    int dailyCap[VEHICLE_TYPE_COUNT];
+    int payablePercent[CUSTOMER_TYPE_COUNT];
+    // The hourly rates as payable cents, by [vehicleType *
+    // CUSTOMER_TYPE_COUNT + customerType], for calculateBills()
+    int64_t firstHourCents[VEHICLE_TYPE_COUNT * CUSTOMER_TYPE_COUNT];
+    int64_t additionalHourCents[VEHICLE_TYPE_COUNT * CUSTOMER_TYPE_COUNT];
+    // Local time - UTC from zoneStart[i] to the next span, for the start
+    // hour of banded bills; arrivals outside the spans ask the C library
+    int zoneSpans;
+    time_t zoneStart[MAX_TARIFF_ZONE_SPANS];
+    time_t zoneEnd;
+    long zoneOffset[MAX_TARIFF_ZONE_SPANS];
+    int firstFee[VEHICLE_TYPE_COUNT][24][TARIFF_BLOCK_HOURS + 1];  // Rs
+    int nextFee[VEHICLE_TYPE_COUNT][24][TARIFF_BLOCK_HOURS + 1];
+    int64_t firstPayableCents[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT][24][TARIFF_BLOCK_HOURS + 1];
+    int64_t nextPayableCents[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT][24][TARIFF_BLOCK_HOURS + 1];
+} CompiledTariff;
+
+// The tariff a billing thread is using, so installTariff() knows when a
+// retired one can be freed
+typedef struct {
+    _Alignas(64) _Atomic(const CompiledTariff *) inUse;
+    _Atomic int taken;
+} TariffReader;
+
+// One frame of view output, built in memory and written with a single
+// write(). The previous frame is kept so a diff redraw can re-emit only the
+// rows that changed. Buffers are reused across frames.
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    char *previous;
+    size_t previousLength;
+    size_t previousCapacity;
+    int hasPrevious;
+} RenderBuffer;
+
+// Outcome of parking a vehicle
+enum ParkResult {
+    PARK_OK = 0,
+    PARK_INVALID,
+    PARK_FULL,
+    PARK_DUPLICATE,
+    PARK_NO_SLOT
+};
+
+static const char* ParkResultNames[] = {
+    "OK",
+    "INVALID",
+    "FULL",
+    "DUPLICATE",
+    "NO_SLOT"
+};
+
+// Operations timed by the built-in counters (menu option 9, SIGUSR1 in
+// batch mode)
+enum TimedOperation {
+    TIMED_LOAD = 0,
+    TIMED_SAVE,
+    TIMED_ENTER,
+    TIMED_EXIT,
+    TIMED_BILL,
+    TIMED_RENDER,
+    TIMED_REPLICATE,     // follower: from the leader queuing a change to applying it
+    TIMED_OPERATION_COUNT
+};
+
+static const char* TimedOperationNames[] = {
+    "load",
+    "save",
+    "enter",
+    "exit",
+    "bill",
+    "render",
+    "replicate"
+};
+_Static_assert(ARRAY_COUNT(TimedOperationNames) == TIMED_OPERATION_COUNT,
+               "TimedOperationNames out of sync with enum TimedOperation!");
+
+// Relaxed atomic counters: gate threads add to them without locking
+typedef struct {
+    _Atomic long count;
+    _Atomic long long totalNanos;
+    _Atomic long buckets[TIMING_BUCKETS];
+} OperationTimer;
+
+// Journal operations
+enum JournalOp {
+    JOURNAL_ENTER = 1,
+    JOURNAL_EXIT = 2,
+    JOURNAL_RESERVE = 3,   // timestamp is the start; see appendReservationJournal
+    JOURNAL_CANCEL = 4
+};
+
+// How a journal record stores its plate
+enum JournalPlateFormat {
+    JOURNAL_PLATE_TEXT = 0, // NUL-terminated text (journals written before plate keys)
+    JOURNAL_PLATE_KEY = 1   // PlateKey in the first 16 bytes
+};
+
+// Fixed-size on-disk journal record (one per entry, exit or booking change)
+typedef struct {
+    uint8_t op;
+    uint8_t vehicleType;
+    uint8_t customerType;
+    uint8_t plateFormat;     // JournalPlateFormat
+    unsigned char plate[20];
+    int64_t timestamp;
+} JournalRecord;
+_Static_assert(sizeof(JournalRecord) == 32, "JournalRecord must stay 32 bytes!");
+
+// Fixed-size on-disk snapshot record (one per parked vehicle). The layout
+// is versioned through SnapshotHeader.version and must only ever change by
+// bumping SNAPSHOT_VERSION.
+typedef struct {
+    uint64_t plateHi;    // PlateKey
+    uint64_t plateLo;
+    uint8_t vehicleType;
+    uint8_t customerType;
+    uint8_t reserved[2];
+    uint32_t bayId;
+    int64_t arrivalTime;
+} SnapshotRecord;
+_Static_assert(sizeof(SnapshotRecord) == 32, "SnapshotRecord must stay 32 bytes!");
+
+// Record layout of version 2 and 3 snapshots, still accepted on load
+typedef struct {
+    char vehicleNumber[20];
+    uint32_t plateHash;
+    uint8_t vehicleType;
+    uint8_t customerType;
+    uint8_t reserved[2];
+    uint32_t bayId;      // 0 in version 2 files
+    int64_t arrivalTime;
+} SnapshotRecordV3;
+_Static_assert(sizeof(SnapshotRecordV3) == 40, "SnapshotRecordV3 must stay 40 bytes!");
+
+// Fixed-size on-disk booking record, after the vehicle records (version 5)
+typedef struct {
+    uint64_t plateHi;    // PlateKey
+    uint64_t plateLo;
+    uint8_t vehicleType;
+    uint8_t customerType;
+    uint8_t reserved[2];
+    uint32_t seconds;    // length of the booking
+    int64_t start;
+} SnapshotReservation;
+_Static_assert(sizeof(SnapshotReservation) == 32, "SnapshotReservation must stay 32 bytes!");
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t vehicleCount;
+    uint32_t reservationCount; // 0 before version 5
+    uint64_t checksum; // FNV-1a 64 over the record area (version 6: over the
+                       // SnapshotArena, chunk checksums and bookings)
+} SnapshotHeader;
+_Static_assert(sizeof(SnapshotHeader) == 32, "SnapshotHeader must stay 32 bytes!");
+
+// Archive block header. The payload that follows holds the block's
+// sessions column by column, in the order queries need them:
+//   kinds        one VEHICLE_KIND byte per session
+//   fees         dictionarySize zigzag varints, then one dictionary index
+//                byte per session (ARCHIVE_DICTIONARY_SIZE = escape,
+//                followed by the zigzag varint amount)
+//   exit times   zigzag varint deltas, the first one from firstExit
+//   dwell times  varint seconds (arrival = exit - dwell)
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t dictionarySize;
+    uint32_t sessionCount;
+    uint32_t payloadBytes;
+    int64_t firstExit;
+    int64_t minArrival;       // lets range queries skip whole blocks
+    int64_t maxExit;
+    uint64_t checksum;        // FNV-1a 64 over the payload
+} ArchiveBlockHeader;
+_Static_assert(sizeof(ArchiveBlockHeader) == 48, "ArchiveBlockHeader must stay 48 bytes!");
+
+static const char ARCHIVE_MAGIC[4] = "PKAR";
+#define ARCHIVE_VERSION 1
+
+static const char SNAPSHOT_MAGIC[8] = "PKSNAP";
+#define SNAPSHOT_VERSION 6
+#define SNAPSHOT_ARENA_VERSION 6   // first version holding the arena itself
+#define SNAPSHOT_RECORD_VERSION 5  // last version with SnapshotRecords, still written for sparse lots
+#define SNAPSHOT_BOOKING_VERSION 5 // first version with booking records
+#define SNAPSHOT_TEXT_VERSION 3 // last version with SnapshotRecordV3 (text plates)
+#define SNAPSHOT_MIN_VERSION 2  // as version 3, no bay numbers
+
+// Version 6 snapshots (see MAPPED SNAPSHOTS) keep the arena at a
+// SNAPSHOT_ARENA_ALIGN offset and check it in SNAPSHOT_CHUNK_BYTES chunks.
+// A lot is saved this way once its records would take at least
+// 1/SNAPSHOT_ARENA_SHARE of the arena, else as version 5 records.
+#define SNAPSHOT_ARENA_ALIGN 65536
+#define SNAPSHOT_CHUNK_BYTES (256 * 1024)
+#define SNAPSHOT_ARENA_SHARE 4
+
+// Lot layout and counts of a version 6 snapshot, right after its header.
+// Then come one checksumWords() per arena chunk, the bookings, and at
+// arenaOffset the arena as it was in memory.
+typedef struct {
+    uint64_t arenaBytes;
+    uint64_t arenaOffset;
+    int32_t capacities[VEHICLE_TYPE_COUNT];
+    int32_t quotaPercent[CUSTOMER_TYPE_COUNT];
+    int32_t vehicleCount[VEHICLE_TYPE_COUNT];
+    int32_t overstayHeapCount[VEHICLE_TYPE_COUNT];
+    int32_t overstayListCount[VEHICLE_TYPE_COUNT];
+    int32_t allocated[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT]; // occupied bays per cell
+} SnapshotArena;
+_Static_assert(sizeof(SnapshotArena) == 216, "SnapshotArena must stay 216 bytes!");
+
+// Check state of one chunk of a mapped arena
+enum ArenaChunkState {
+    ARENA_CHUNK_UNCHECKED = 0,
+    ARENA_CHUNK_CHECKING,      // a thread is verifying it, others wait
+    ARENA_CHUNK_CHECKED
+};
+
+// A lot arena mapped from a version 6 snapshot, as the fault handler sees
+// it. Entries are claimed and released under mappedArenaLock; the handler
+// only reads them.
+typedef struct {
+    _Atomic(char *) arena;        // NULL while the entry is free
+    size_t arenaBytes;
+    size_t guardedBytes;          // arenaBytes rounded up to whole pages
+    const uint64_t *checksums;    // per chunk, in the mapping
+    _Atomic unsigned char *chunkStates;
+    char snapshotFile[LOT_FILE_NAME_LENGTH];
+    char corruptFile[LOT_FILE_NAME_LENGTH + sizeof(SNAPSHOT_CORRUPT_SUFFIX)];
+    char message[256];            // written by the handler, which cannot format
+    size_t messageLength;
+} MappedArena;
+
+// Head of a shared lots segment (see SHARED LOTS). Written by the creator
+// before ready is set and only read afterwards, except for processes[].
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t lotCount;
+    uint64_t size;                 // bytes of the whole segment
+    uint64_t address;              // where every process maps it
+    uint64_t configChecksum;       // lot ids, capacities and quotas
+    pid_t creator;
+    int policyIndex;               // into ALLOCATION_POLICIES
+    AllocationPolicy policy;       // what the lots' policy pointers point at
+    _Atomic int ready;             // set once the creator has loaded the lots
+    pthread_mutex_t attachLock;    // robust, guards processes[]
+    pid_t processes[MAX_SHARED_PROCESSES]; // attached processes, 0 = free
+} SharedLotsHeader;
+
+static const char SHARED_LOTS_MAGIC[8] = "PKSHM";
+#define SHARED_LOTS_VERSION 2
+
+// Stream records other than journal changes (see REPLICATION)
+enum ReplicationOp {
+    REPLICATION_HELLO = 16,  // lotIndex holds the lot count, timestamp the config checksum
+    REPLICATION_SNAPSHOT,    // a snapshot image of timestamp bytes follows
+    REPLICATION_FLOORS,      // plate holds a uint16 lendFloor per tier of vehicleType
+    REPLICATION_CHECKSUM     // plate holds the lot's state checksum as of booking clock timestamp
+};
+
+// Change log record as streamed from a leader to its follower: a journal
+// record, or one of the above, for one lot
+typedef struct {
+    uint32_t lotIndex;
+    uint32_t sequence;       // of queued records, 0 for records sent directly
+    int64_t queuedNanos;     // leader's CLOCK_MONOTONIC when queued, for the lag
+    JournalRecord record;
+} ReplicationRecord;
+_Static_assert(sizeof(ReplicationRecord) == 48, "ReplicationRecord must stay 48 bytes!");
+
+// Leader side: the ring of records not yet sent, and the one follower
+typedef struct {
+    pthread_mutex_t lock;         // taken last, after any lot lock
+    pthread_cond_t queued;        // records queued, or stopping
+    pthread_cond_t space;         // records sent, or the follower dropped
+    ReplicationRecord *ring;
+    unsigned long head, tail;     // queued up to head, sent up to tail
+    uint32_t sequence;
+    _Atomic int streaming[MAX_LOTS]; // lot's changes go to the follower
+    char checksumDue[MAX_LOTS];   // sender only: the lot's periodic checksum is not queued yet
+    int listener, follower;       // sockets, -1 when none
+    int lagging;                  // the ring filled up: the sender drops the follower
+    int stopping;
+    pthread_t sender;
+    char socketPath[108];
+} ReplicationLeader;
+
+// What a follower saw before it took over
+typedef struct {
+    long records;
+    long bootstrapped;            // lots installed from a leader snapshot
+    long checksumsMatched, checksumsDiffered;
+    long gaps;                    // records missing from the stream
+    long rejoins;                 // times the leader detached it and it came back
+    double takeoverSeconds;       // from the leader's end of stream to ready
+} FollowerReport;
 // ================================================
 
 
-ParkingManagement parking;
+ParkingManagement *lots = NULL;
+int lotCount = 0;
+ParkingManagement *parking = NULL; // lot the menu currently operates on
+SharedLotsHeader *sharedLots = NULL; // set while lots points into a shared segment
+ReplicationLeader *replicationLeader = NULL; // set while changes are streamed (--leader)
+const AllocationPolicy *allocationPolicy = DEFAULT_ALLOCATION_POLICY; // for new lots (--policy)
+
+// Clock for arrival and exit times. The simulator swaps in its own so runs
+// are repeatable; journal group commit keeps using real time.
+time_t systemClock() {
+    return time(NULL);
+}
+time_t (*parkingClock)() = systemClock;
+
+OperationTimer operationTimers[TIMED_OPERATION_COUNT];
+
+// Tariff every bill is charged against. Swapped as a whole by
+// installTariff(); a bill loads it once, so it never mixes two tariffs.
+_Atomic(const CompiledTariff *) activeTariff = NULL;
 
 // Function prototypes
-void initializeParking();
-void loadParkingData();
-void saveParkingData();
+int initializeParking(ParkingManagement *lot, int lotId,
+                      const int capacities[VEHICLE_TYPE_COUNT],
+                      const int quotaPercent[CUSTOMER_TYPE_COUNT]);
+void resetParking(ParkingManagement *lot);
+void freeParking(ParkingManagement *lot);
+int loadLotConfig();
+void loadParkingData(ParkingManagement *lot);
+void applyJournalRecord(ParkingManagement *lot, const JournalRecord *record);
+void saveParkingData(ParkingManagement *lot);
+ParkingManagement *findLot(int lotId);
+void selectLot();
+void viewLotInformation();
 void displayMenu();
 void checkAvailability();
 void enterVehicle();
@@ -139,11 +968,298 @@ void viewParkingSpace();
 void viewStatistics();
 void viewStatisticsTableView();
 void viewStatisticsGraph();
-void generateBill(Vehicle vehicle, time_t exitTime);
+void viewStatisticsSummary();
+void renderReset(RenderBuffer *buffer);
+void renderText(RenderBuffer *buffer, const char *text);
+void renderFill(RenderBuffer *buffer, char symbol, int count);
+void renderFormat(RenderBuffer *buffer, const char *format, ...);
+long renderFlush(RenderBuffer *buffer, int fd);
+long renderFlushDiff(RenderBuffer *buffer, int fd);
+void renderParkingSpace(RenderBuffer *buffer, ParkingManagement *lot);
+void renderStatisticsGraph(RenderBuffer *buffer, ParkingManagement *lot);
+ParkingStatistics getParkingStatistics(ParkingManagement *lot);
+void resetOccupancyView(ParkingManagement *lot);
+void publishOccupancy(ParkingManagement *lot, int vehicleType, int customerType, int delta);
+void readOccupancy(ParkingManagement *lot, OccupancyView *view);
+void generateBill(const Vehicle *vehicle, time_t exitTime, const Bill *bill);
+Bill calculateBill(const Vehicle *vehicle, time_t exitTime);
+void defaultTariff(Tariff *tariff);
+int parseTariff(FILE *file, const char *fileName, Tariff *tariff);
+void compileTariff(const Tariff *tariff, CompiledTariff *compiled);
+void installTariff(const CompiledTariff *compiled);
+void installDefaultTariff();
+int loadTariff(const char *fileName);
+long long calculateBills(size_t count, const time_t *arrivalTimes, const time_t *exitTimes,
+                         const unsigned char *vehicleTypes, const unsigned char *customerTypes,
+                         long long *payableCents);
+int runBench(int argc, char *argv[]);
+int slotAllocated(const ParkingSlot *slot);
+int slotFree(const ParkingSlot *slot);
+int slotTotal(const ParkingSlot *slot);
+int reserveSlot(ParkingSlot *slot, int minFree);
+void releaseSlot(ParkingSlot *slot);
+int reserveCell(ParkingManagement *lot, int vehicleType, int customerType, int minFree);
+void releaseCell(ParkingManagement *lot, int vehicleType, int customerType);
+const AllocationPolicy *findAllocationPolicy(const char *name);
+void applyAllocationPolicy(ParkingManagement *lot, const AllocationPolicy *policy);
+void recordArrivalForecast(ParkingManagement *lot, int vehicleType, int customerType,
+                           time_t arrivalTime);
+void rebalanceQuotas(ParkingManagement *lot, int vehicleType, time_t now);
+int comparePolicies(FILE *input);
+int allocateSlot(ParkingManagement *lot, enum VehicleType vehicleType,
+                 enum CustomerType customerType);
+enum ParkResult parkVehicle(ParkingManagement *lot, Vehicle *vehicle, time_t arrivalTime);
+int unparkVehicle(ParkingManagement *lot, PlateKey plate, time_t exitTime,
+                  Vehicle *vehicle, Bill *bill);
+void recordExitStatistics(ParkingStatistics *stats, const Vehicle *vehicle,
+                          time_t exitTime, const Bill *bill);
+int runBatch(FILE *input, int gateWorkers);
+int processBatchLine(const char *line, char *output, size_t outputSize);
+void shutdownParking();
+void discardLots();
+int runSimulation(int argc, char *argv[]);
+int encodePlate(const char *text, PlateKey *plate);
+char *formatPlate(PlateKey plate, char *text);
+int isValidPlate(PlateKey plate);
+int comparePlates(PlateKey a, PlateKey b);
+unsigned int hashPlate(PlateKey plate);
+int readJournalPlate(const JournalRecord *record, PlateKey *plate);
+void resetPlateIndex(ParkingManagement *lot);
+void insertPlateIndex(ParkingManagement *lot, int vehicleIndex);
+void removePlateIndex(ParkingManagement *lot, int vehicleIndex);
+void lockPlate(ParkingManagement *lot, PlateKey plate);
+void unlockPlate(ParkingManagement *lot, PlateKey plate);
+int findVehicleIndex(ParkingManagement *lot, PlateKey plate);
+void getVehicleAt(const ParkingManagement *lot, int vehicleIndex, Vehicle *vehicle);
+void removeVehicleAt(ParkingManagement *lot, int vehicleIndex);
+int insertVehicle(ParkingManagement *lot, Vehicle *vehicle);
+int admitVehicle(ParkingManagement *lot, Vehicle *vehicle);
+int parkedVehicles(ParkingManagement *lot);
+void resetBayMap(ParkingManagement *lot);
+int takeBay(ParkingManagement *lot, int vehicleType, int customerType, int preferredBayId);
+void freeBay(ParkingManagement *lot, int vehicleType, int customerType, int bayId);
+int bayOccupied(const ParkingManagement *lot, int vehicleType, int customerType, int bayId);
+void releaseVehicleAt(ParkingManagement *lot, int vehicleIndex);
+int storedVehicles(const ParkingManagement *lot);
+void trackOverstay(ParkingManagement *lot, int vehicleIndex);
+void untrackOverstay(ParkingManagement *lot, int vehicleIndex);
+int advanceOverstays(ParkingManagement *lot, int vehicleType, time_t now);
+int listOverstays(ParkingManagement *lot, time_t now, Vehicle *vehicles, int maxVehicles);
+void viewOverstays();
+size_t reservationBookBytes(int capacity);
+ReservationBook *placeReservationBook(void *memory, int capacity);
+void rebuildReservationBook(ReservationBook *book);
+void advanceReservations(ParkingManagement *lot, time_t now);
+int windowAvailability(ParkingManagement *lot, int vehicleType, int customerType,
+                       time_t start, time_t end, time_t now);
+enum ParkResult reserveBay(ParkingManagement *lot, const Vehicle *vehicle, time_t start,
+                           time_t end, time_t now);
+int dropReservation(ParkingManagement *lot, PlateKey plate, time_t now);
+int cancelReservation(ParkingManagement *lot, PlateKey plate, time_t now);
+int findBooking(ParkingManagement *lot, PlateKey plate, int vehicleType, time_t arrivalTime,
+                int claim);
+void claimJournaledBooking(ParkingManagement *lot, PlateKey plate, int vehicleType,
+                           time_t arrivalTime);
+void restoreReservation(ParkingManagement *lot, const Reservation *reservation);
+void clearReservations(ParkingManagement *lot);
+int copyReservations(const ParkingManagement *lot, SnapshotReservation *records);
+void manageReservations();
+void openJournal(ParkingManagement *lot);
+void appendJournal(ParkingManagement *lot, enum JournalOp op, const Vehicle *vehicle, time_t timestamp);
+void writeJournalRecord(ParkingManagement *lot, const JournalRecord *record);
+void maintainJournal(ParkingManagement *lot);
+void syncJournal(ParkingManagement *lot);
+void closeJournal(ParkingManagement *lot);
+int writeSnapshot(ParkingManagement *lot);
+void *buildSnapshotImage(const ParkingManagement *lot, size_t *bytes);
+int storeSnapshotImage(const ParkingManagement *lot, const void *image, size_t bytes);
+void truncateJournal(ParkingManagement *lot);
+FILE **journalHandle(ParkingManagement *lot);
+void lockStore(ParkingManagement *lot, int exclusive);
+void unlockStore(ParkingManagement *lot);
+void lockVehicleStore(ParkingManagement *lot, int vehicleType, int exclusive);
+void unlockVehicleStore(ParkingManagement *lot, int vehicleType);
+void lockLotMutex(ParkingManagement *lot, pthread_mutex_t *mutex);
+int attachSharedLots(const char *name, int loadFiles);
+void detachSharedLots(int save);
+void lockLotState(ParkingManagement *lot);
+int tryLockLotState(ParkingManagement *lot);
+void unlockLotState(ParkingManagement *lot);
+uint64_t lotStateChecksum(const ParkingManagement *lot);
+void replicateRecord(ParkingManagement *lot, const JournalRecord *record);
+void replicateFloors(ParkingManagement *lot, int vehicleType);
+int startReplication(const char *socketPath);
+void stopReplication();
+int followLeader(const char *socketPath, FollowerReport *report);
+int loadSnapshot(ParkingManagement *lot);
+uint64_t checksumBytes(const void *data, size_t length);
+uint64_t checksumWords(const void *data, size_t length);
+void *buildRecordImage(const ParkingManagement *lot, size_t *bytes);
+void *buildArenaImage(const ParkingManagement *lot, size_t *bytes);
+int loadArenaSnapshot(ParkingManagement *lot, int fd, size_t size);
+void unmapArena(ParkingManagement *lot);
+void archiveSession(ParkingManagement *lot, const Vehicle *vehicle, time_t exitTime,
+                    const Bill *bill);
+int flushArchive(ParkingManagement *lot);
+int runQuery(int argc, char *argv[]);
+int runService(const char *socketPath);
+int runLoadTest(int argc, char *argv[]);
+void startTiming(struct timespec *start);
+void recordTiming(enum TimedOperation op, const struct timespec *start);
+void printOperationTimings(FILE *out);
+void resetOperationTimings();
+void viewOperationTimings();
+
+int main(int argc, char *argv[]) {
+    installDefaultTariff();
+
+    // Benchmarks run on synthetic data and never touch the lot files
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        return runBench(argc - 2, argv + 2);
+    }
+    // The load-test client only talks to a running --serve process
+    if (argc > 1 && strcmp(argv[1], "--loadtest") == 0) {
+        return runLoadTest(argc - 2, argv + 2);
+    }
+
+    // --policy <name> (anywhere on the command line) picks the slot
+    // allocation policy for every lot; --shared <name> shares the lots with
+    // other processes started with the same name (see SHARED LOTS);
+    // --leader <socket> streams every change to a follower started with
+    // --follow <socket>, which takes over when the leader is gone (see
+    // REPLICATION)
+    const char *sharedName = NULL;
+    const char *leaderPath = NULL;
+    const char *followPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        const char **value = strcmp(argv[i], "--shared") == 0 ? &sharedName :
+                             strcmp(argv[i], "--leader") == 0 ? &leaderPath :
+                             strcmp(argv[i], "--follow") == 0 ? &followPath : NULL;
+        if (value) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "%s needs a %s\n", argv[i],
+                        value == &sharedName ? "name" : "socket path");
+                return 1;
+            }
+            *value = argv[i + 1];
+            memmove(&argv[i], &argv[i + 2], (size_t)(argc - i - 1) * sizeof(*argv));
+            argc -= 2;
+            i--;
+            continue;
+        }
+        if (strcmp(argv[i], "--policy") != 0)
+            continue;
+        if (i + 1 >= argc || !(allocationPolicy = findAllocationPolicy(argv[i + 1]))) {
+            fprintf(stderr, "--policy must be one of:");
+            for (size_t p = 0; p < ARRAY_COUNT(ALLOCATION_POLICIES); p++)
+                fprintf(stderr, " %s", ALLOCATION_POLICIES[p].name);
+            fprintf(stderr, "\n");
+            return 1;
+        }
+        memmove(&argv[i], &argv[i + 2], (size_t)(argc - i - 1) * sizeof(*argv));
+        argc -= 2;
+        i--;
+    }
+
+    if (sharedName && (leaderPath || followPath)) {
+        fprintf(stderr, "--shared cannot be combined with --leader or --follow\n");
+        return 1;
+    }
+
+    if (loadLotConfig() != 0 || loadTariff(TARIFF_FILE) != 0) {
+        return 1;
+    }
+
+    // Policy comparison and simulation run on empty in-memory lots; saved
+    // lot data is neither loaded nor written.
+    if (argc > 1 && strcmp(argv[1], "--compare-policies") == 0) {
+        FILE *input = argc > 2 ? fopen(argv[2], "r") : stdin;
+        int status = 1;
+        if (input) {
+            status = comparePolicies(input);
+            if (input != stdin) fclose(input);
+        } else {
+            fprintf(stderr, "Cannot open %s\n", argv[2]);
+        }
+        discardLots();
+        return status;
+    }
+    if (argc > 1 && strcmp(argv[1], "--simulate") == 0) {
+        int status = runSimulation(argc - 2, argv + 2);
+        discardLots();
+        return status;
+    }
+    // Archive queries only read the day files
+    if (argc > 1 && strcmp(argv[1], "--query") == 0) {
+        int status = runQuery(argc - 2, argv + 2);
+        discardLots();
+        return status;
+    }
+
+    if (sharedName) {
+        if (attachSharedLots(sharedName, 1) != 0) {
+            discardLots();
+            return 1;
+        }
+    } else {
+        for (int i = 0; i < lotCount; i++) {
+            loadParkingData(&lots[i]);
+            lots[i].archiving = 1;
+        }
+    }
+    parking = &lots[0];
+
+    // A follower stands by until its leader is gone, then carries on in the
+    // mode it was started in; following one leader and leading the next
+    // follower both work
+    if (followPath) {
+        FollowerReport report;
+        if (followLeader(followPath, &report) != 0) {
+            shutdownParking();
+            return 1;
+        }
+    }
+    if (leaderPath && startReplication(leaderPath) != 0) {
+        shutdownParking();
+        return 1;
+    }
 
-int main() {
-    initializeParking();
-    loadParkingData();
+    // Non-interactive mode: ./main --batch [--gates N] [events file]
+    if (argc > 1 && strcmp(argv[1], "--batch") == 0) {
+        FILE *input = stdin;
+        int gateWorkers = 1;
+        int dumpTimings = 0;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--gates") == 0 && i + 1 < argc) {
+                gateWorkers = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--timings") == 0) {
+                dumpTimings = 1;
+            } else if (input == stdin && !(input = fopen(argv[i], "r"))) {
+                fprintf(stderr, "Cannot open %s\n", argv[i]);
+                shutdownParking();
+                return 1;
+            }
+        }
+        if (gateWorkers < 1 || gateWorkers > MAX_GATE_WORKERS) {
+            fprintf(stderr, "--gates must be between 1 and %d\n", MAX_GATE_WORKERS);
+            if (input != stdin) fclose(input);
+            shutdownParking();
+            return 1;
+        }
+        int status = runBatch(input, gateWorkers);
+        if (input != stdin) fclose(input);
+        shutdownParking();
+        if (dumpTimings)
+            printOperationTimings(stderr);
+        return status;
+    }
+
+    // Daemon mode: ./main --serve [socket path]
+    if (argc > 1 && strcmp(argv[1], "--serve") == 0) {
+        int status = runService(argc > 2 ? argv[2] : SERVE_SOCKET_PATH);
+        shutdownParking();
+        return status;
+    }
 
     int choice;
     do {
@@ -169,9 +1285,24 @@ int main() {
                 viewStatistics();
                 break;
             case 6:
-                saveParkingData();
+                shutdownParking();
                 printf("Exiting the system. Goodbye!\n");
                 break;
+            case 7:
+                selectLot();
+                break;
+            case 8:
+                viewLotInformation();
+                break;
+            case 9:
+                viewOperationTimings();
+                break;
+            case 10:
+                viewOverstays();
+                break;
+            case 11:
+                manageReservations();
+                break;
             default:
                 printf("Invalid choice. Please try again.\n");
         }
@@ -182,6 +1313,8 @@ int main() {
 
 void displayMenu() {
     printf("\n+============= Main Menu =============+\n");
+    printf("| %-6s %-28d |\n", "Lot", parking->lotId);
+    printf("+-------------------------------------+\n");
     printf("| %-2s | %-30s |\n", "No", "Option");
     printf("+-------------------------------------+\n");
     printf("| %-2d | %-30s |\n", 1, "Check Availability");
@@ -190,443 +1323,9940 @@ void displayMenu() {
     printf("| %-2d | %-30s |\n", 4, "View Parking Space");
     printf("| %-2d | %-30s |\n", 5, "View Statistics");
     printf("| %-2d | %-30s |\n", 6, "Exit");
+    printf("| %-2d | %-30s |\n", 7, "Switch Lot");
+    printf("| %-2d | %-30s |\n", 8, "Lot Information");
+    printf("| %-2d | %-30s |\n", 9, "Operation Timings");
+    printf("| %-2d | %-30s |\n", 10, "Overstay Alerts");
+    printf("| %-2d | %-30s |\n", 11, "Reservations");
     printf("+=====================================+\n");
 }
 
-void initializeParking() {
-    int capacities[] = {MAX_MOTORCYCLES, MAX_THREE_WHEELERS, MAX_CARS, MAX_VANS, MAX_BUSES};
-    float percentages[] = {0.15, 0.10, 0.15, 0.25, 0.35};
+static unsigned int nextPowerOfTwo(unsigned int value) {
+    unsigned int power = 1;
+    while (power < value) power <<= 1;
+    return power;
+}
 
-    for (int i = 0; i < 5; i++) {
-        for (int j = 0; j < 5; j++) {
-            parking.slots[i][j].total = (int)(capacities[i] * percentages[j]);
-            parking.slots[i][j].allocated = 0;
-            parking.slots[i][j].free = parking.slots[i][j].total;
+// Points a lot's columns into arena, laid out as initializeParking sized
+// it: widest element first, so each column stays aligned.
+static void placeArenaColumns(ParkingManagement *lot, char *arena) {
+    size_t rows = (size_t)lot->vehicleCapacity;
+    size_t bayWordCount = 0, bayFreeWordCount = 0;
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+            bayWordCount += BAY_WORDS(lot->bayCount[i][j]);
+            bayFreeWordCount += BAY_WORDS(BAY_WORDS(lot->bayCount[i][j]));
         }
     }
-    parking.vehicleCount = 0;
+
+    char *column = arena;
+    lot->arena = arena;
+    lot->plateKeys = (PlateKey *)column;
+    column += rows * sizeof(PlateKey);
+    lot->arrivalTimes = (time_t *)column;
+    column += rows * sizeof(time_t);
+    lot->bayWords = (uint64_t *)column;
+    column += bayWordCount * sizeof(uint64_t);
+    lot->bayFreeWords = (uint64_t *)column;
+    column += bayFreeWordCount * sizeof(uint64_t);
+    lot->plateNext = (int *)column;
+    column += rows * sizeof(int);
+    lot->overstayRows = (int *)column;
+    column += rows * sizeof(int);
+    lot->overstaySlots = (int *)column;
+    column += rows * sizeof(int);
+    lot->plateBuckets = (int *)column;
+    column += ((size_t)lot->plateBucketMask + 1) * sizeof(int);
+    lot->vehicleKinds = (unsigned char *)column;
 }
 
-void loadParkingData() {
-    FILE *file = fopen("parking_data.txt", "r");
-    if (!file) return;
+// Sets up a lot and allocates its vehicle arena: the vehicle columns, a
+// plate index of at least one bucket per bay and the bay map, split into
+// one store per vehicle type. Returns -1 if the lot would exceed
+// MAX_LOT_VEHICLES or MAX_LOT_MEMORY.
+int initializeParking(ParkingManagement *lot, int lotId,
+                      const int capacities[VEHICLE_TYPE_COUNT],
+                      const int quotaPercent[CUSTOMER_TYPE_COUNT]) {
+    memset(lot, 0, sizeof(*lot));
+    lot->lotId = lotId;
+    memcpy(lot->capacities, capacities, sizeof(lot->capacities));
+    memcpy(lot->quotaPercent, quotaPercent, sizeof(lot->quotaPercent));
 
-    fscanf(file, "%d\n", &parking.vehicleCount);
+    long vehicleCapacity = 0;
+    size_t bayWordCount = 0, bayFreeWordCount = 0;
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        lot->stores[i].rowStart = (int)vehicleCapacity;
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+            int total = capacities[i] * quotaPercent[j] / 100;
+            atomic_init(&lot->slots[i][j].counts, SLOT_COUNTS(0, total));
+            lot->bayStart[i][j] = (int)vehicleCapacity;
+            lot->bayCount[i][j] = total;
+            lot->bayWordStart[i][j] = (int)bayWordCount;
+            lot->bayFreeWordStart[i][j] = (int)bayFreeWordCount;
+            bayWordCount += BAY_WORDS(total);
+            bayFreeWordCount += BAY_WORDS(BAY_WORDS(total));
+            vehicleCapacity += total;
+        }
+        lot->stores[i].rowCount = (int)(vehicleCapacity - lot->stores[i].rowStart);
+    }
+    if (vehicleCapacity > MAX_LOT_VEHICLES) {
+        fprintf(stderr, "Lot %d: capacity %ld exceeds the limit of %d vehicles.\n",
+               lotId, vehicleCapacity, MAX_LOT_VEHICLES);
+        return -1;
+    }
 
-    for (int i = 0; i < parking.vehicleCount; i++) {
-        Vehicle v;
-        fscanf(file, "%s %d %d %ld\n",
-               v.vehicleNumber,
-               &v.vehicleType,
-               &v.customerType,
-               &v.arrivalTime);
+    lot->vehicleCapacity = (int)vehicleCapacity;
+    // Each stripe needs buckets of its own, or one bucket would span stripes
+    unsigned int bucketCount = nextPowerOfTwo((unsigned int)vehicleCapacity);
+    if (bucketCount < PLATE_LOCK_STRIPES)
+        bucketCount = PLATE_LOCK_STRIPES;
+    // Sized for placeArenaColumns
+    size_t rows = (size_t)lot->vehicleCapacity;
+    size_t plateBytes = rows * sizeof(PlateKey);
+    size_t arrivalBytes = rows * sizeof(time_t);
+    size_t bayWordBytes = bayWordCount * sizeof(uint64_t);
+    size_t bayFreeWordBytes = bayFreeWordCount * sizeof(uint64_t);
+    size_t rowIndexBytes = rows * sizeof(int);
+    size_t bucketBytes = bucketCount * sizeof(int);
+    lot->arenaBytes = plateBytes + arrivalBytes + bayWordBytes + bayFreeWordBytes +
+                      3 * rowIndexBytes + bucketBytes + rows;
+    if (lot->arenaBytes > MAX_LOT_MEMORY) {
+        fprintf(stderr, "Lot %d: needs %zu bytes, over the %zu byte limit per lot.\n",
+               lotId, lot->arenaBytes, MAX_LOT_MEMORY);
+        return -1;
+    }
 
-        parking.vehicles[i] = v;
-        parking.slots[v.vehicleType][v.customerType].allocated++;
-        parking.slots[v.vehicleType][v.customerType].free--;
+    // Zeroed, so a snapshot of the arena never carries stale heap bytes
+    char *arena = calloc(1, lot->arenaBytes);
+    if (!arena) {
+        fprintf(stderr, "Lot %d: out of memory.\n", lotId);
+        return -1;
     }
-    fclose(file);
-}
+    lot->plateBucketMask = bucketCount - 1;
+    placeArenaColumns(lot, arena);
 
-void saveParkingData() {
-    FILE *file = fopen("parking_data.txt", "w");
-    if (!file) return;
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        pthread_rwlock_init(&lot->stores[i].lock, NULL);
+        pthread_mutex_init(&lot->stores[i].statsLock, NULL);
+    }
+    for (int i = 0; i < PLATE_LOCK_STRIPES; i++)
+        pthread_mutex_init(&lot->plateLocks[i].lock, NULL);
+    pthread_mutex_init(&lot->reservationLock, NULL);
+    pthread_mutex_init(&lot->journalLock, NULL);
+    pthread_mutex_init(&lot->archiveLock, NULL);
 
-    fprintf(file, "%d\n", parking.vehicleCount);
+    snprintf(lot->snapshotFile, sizeof(lot->snapshotFile),
+             "parking_lot%d_%s", lotId, SNAPSHOT_SUFFIX);
+    snprintf(lot->snapshotTempFile, sizeof(lot->snapshotTempFile),
+             "parking_lot%d_%s", lotId, SNAPSHOT_TEMP_SUFFIX);
+    snprintf(lot->journalFileName, sizeof(lot->journalFileName),
+             "parking_lot%d_%s", lotId, JOURNAL_SUFFIX);
+    snprintf(lot->archivePrefix, sizeof(lot->archivePrefix),
+             "parking_lot%d_%s", lotId, ARCHIVE_SUFFIX);
+
+    lot->policy = allocationPolicy;
+    resetParking(lot);
+    return 0;
+}
 
-    for (int i = 0; i < parking.vehicleCount; i++) {
-        Vehicle v = parking.vehicles[i];
-        fprintf(file, "%s %d %d %ld\n",
-                v.vehicleNumber,
-                v.vehicleType,
-                v.customerType,
-                v.arrivalTime);
+// Empties a lot without touching its configuration or arena.
+void resetParking(ParkingManagement *lot) {
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+            ParkingSlot *slot = &lot->slots[i][j];
+            atomic_store(&slot->counts, SLOT_COUNTS(0, slotTotal(slot)));
+        }
+        VehicleStore *store = &lot->stores[i];
+        store->vehicleCount = 0;
+        store->overstayHeapCount = 0;
+        store->overstayListCount = 0;
+        memset(&store->stats, 0, sizeof(store->stats));
+        store->nextRebalance = 0;
     }
-    fclose(file);
+    applyAllocationPolicy(lot, lot->policy);
+    resetBayMap(lot);
+    memset(lot->vehicleKinds, VEHICLE_KIND_EMPTY, (size_t)lot->vehicleCapacity);
+    atomic_store(&lot->invalidRejections, 0);
+    memset(lot->arrivalRate, 0, sizeof(lot->arrivalRate));
+    memset(lot->arrivalRateTime, 0, sizeof(lot->arrivalRateTime));
+    resetOccupancyView(lot);
+    resetPlateIndex(lot);
 }
 
-// void enterVehicle() {
-//     if (parking.vehicleCount >= TOTAL_SLOTS) {
-//         printf("\n+==============================================+\n");
-//         printf("| Parking is full. Cannot accept more vehicles. |\n");
-//         printf("+==============================================+\n\n");
-//         return;
-//     }
+void freeParking(ParkingManagement *lot) {
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        pthread_rwlock_destroy(&lot->stores[i].lock);
+        pthread_mutex_destroy(&lot->stores[i].statsLock);
+        lot->stores[i].vehicleCount = 0;
+    }
+    for (int i = 0; i < PLATE_LOCK_STRIPES; i++)
+        pthread_mutex_destroy(&lot->plateLocks[i].lock);
+    pthread_mutex_destroy(&lot->reservationLock);
+    pthread_mutex_destroy(&lot->journalLock);
+    pthread_mutex_destroy(&lot->archiveLock);
 
-//     Vehicle vehicle;
+    free(lot->archiveSessions);
+    lot->archiveSessions = NULL;
+    lot->archiveCount = 0;
+    free(lot->reservations);
+    lot->reservations = NULL;
+    lot->bookingCount = 0;
+    if (lot->arenaMap)
+        unmapArena(lot);
+    else
+        free(lot->arena);
+    lot->arena = NULL;
+    lot->plateKeys = NULL;
+    lot->arrivalTimes = NULL;
+    lot->overstayRows = NULL;
+    lot->overstaySlots = NULL;
+    lot->bayWords = NULL;
+    lot->bayFreeWords = NULL;
+    lot->vehicleKinds = NULL;
+    lot->plateBuckets = NULL;
+    lot->plateNext = NULL;
+}
 
-//     printf("\n+=================== Enter Vehicle ===================+\n");
+// Zeroed room for count lots, aligned for their stores' locks. Free it
+// with free().
+static ParkingManagement *allocateLots(int count) {
+    size_t bytes = (size_t)count * sizeof(ParkingManagement);
+    ParkingManagement *allocated = aligned_alloc(_Alignof(ParkingManagement), bytes);
+    if (allocated)
+        memset(allocated, 0, bytes);
+    return allocated;
+}
 
-//     // Vehicle number input
-//     printf("| %-40s: ", "Vehicle Number");
-//     scanf("%s", vehicle.vehicleNumber);
+// Reads LOT_CONFIG_FILE. Each non-comment line describes one lot:
+//   <lotId> <motorcycles> <three wheelers> <cars> <vans> <buses>
+//           <disabled%> <vip%> <staff%> <registered%> <guest%>
+// Without a config file a single default lot is created.
+int loadLotConfig() {
+    lots = allocateLots(MAX_LOTS);
+    if (!lots) return -1;
+    lotCount = 0;
 
-//     // Vehicle type input
-//     printf("\n| %-40s: \n", "Vehicle Type");
-//     for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
-//         printf("|   (%d) %-33s |\n", i, VehicleTypeNames[i]);
-//     }
-//     printf("| %-40s: ", "Enter Choice");
-//     scanf("%d", &vehicle.vehicleType);
+    FILE *file = fopen(LOT_CONFIG_FILE, "r");
+    if (!file) {
+        int capacities[] = {MAX_MOTORCYCLES, MAX_THREE_WHEELERS, MAX_CARS, MAX_VANS, MAX_BUSES};
+        if (initializeParking(&lots[0], DEFAULT_LOT_ID, capacities, DEFAULT_QUOTA_PERCENT) != 0)
+            return -1;
+        lotCount = 1;
+        return 0;
+    }
 
-//     // Customer type input
-//     printf("\n| %-40s: \n", "Customer Type");
-//     for (int i = 0; i < CUSTOMER_TYPE_COUNT; i++) {
-//         printf("|   (%d) %-33s |\n", i, CustomerTypeNames[i]);
-//     }
-//     printf("| %-40s: ", "Enter Choice");
-//     scanf("%d", &vehicle.customerType);
+    char line[256];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
 
-//     ParkingSlot *slot = &parking.slots[vehicle.vehicleType][vehicle.customerType];
+        int lotId;
+        int c[VEHICLE_TYPE_COUNT];
+        int q[CUSTOMER_TYPE_COUNT];
+        if (sscanf(line, "%d %d %d %d %d %d %d %d %d %d %d",
+                   &lotId, &c[0], &c[1], &c[2], &c[3], &c[4],
+                   &q[0], &q[1], &q[2], &q[3], &q[4]) != 11) {
+            fprintf(stderr, "%s:%d: expected a lot id, 5 capacities and 5 quotas.\n",
+                   LOT_CONFIG_FILE, lineNumber);
+            continue;
+        }
 
-//     // Success / failure message
-//     if (slot->free > 0) {
-//         slot->allocated++;
-//         slot->free--;
-//         vehicle.arrivalTime = time(NULL);
-//         parking.vehicles[parking.vehicleCount++] = vehicle;
+        int valid = lotId > 0 && findLot(lotId) == NULL && lotCount < MAX_LOTS;
+        int quotaTotal = 0;
+        for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) valid &= c[i] >= 0;
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+            valid &= q[j] >= 0;
+            quotaTotal += q[j];
+        }
+        if (!valid || quotaTotal > 100) {
+            fprintf(stderr, "%s:%d: invalid or duplicate lot, skipped.\n", LOT_CONFIG_FILE, lineNumber);
+            continue;
+        }
 
-//         printf("+====================================================+\n");
-//         printf("| Vehicle parked successfully!                       |\n");
-//         printf("+====================================================+\n\n");
-//     } else {
-//         printf("+====================================================+\n");
-//         printf("| No free slots available for this vehicle and      |\n");
-//         printf("| customer type.                                     |\n");
-//         printf("+====================================================+\n\n");
-//     }
-// }
+        if (initializeParking(&lots[lotCount], lotId, c, q) == 0)
+            lotCount++;
+    }
+    fclose(file);
 
-void enterVehicle() {
-    if (parking.vehicleCount >= TOTAL_SLOTS) {
-        printf("\n+==============================================+\n");
-        printf("| Parking is full. Cannot accept more vehicles. |\n");
-        printf("+==============================================+\n\n");
+    if (lotCount == 0) {
+        fprintf(stderr, "%s does not define any usable lot.\n", LOT_CONFIG_FILE);
+        return -1;
+    }
+    return 0;
+}
+
+// Snapshots every lot and releases all lot memory. Shared lots are only
+// snapshotted by the last process to leave them. A follower is handed
+// everything first, so it takes over from the final state.
+void shutdownParking() {
+    stopReplication();
+    if (sharedLots) {
+        detachSharedLots(1);
         return;
     }
+    for (int i = 0; i < lotCount; i++) {
+        saveParkingData(&lots[i]);
+        closeJournal(&lots[i]);
+    }
+    discardLots();
+}
 
-    Vehicle vehicle;
+// Frees all lots without saving them.
+void discardLots() {
+    if (sharedLots) {
+        detachSharedLots(0);
+        return;
+    }
+    for (int i = 0; i < lotCount; i++) {
+        freeParking(&lots[i]);
+    }
+    free(lots);
+    lots = NULL;
+    lotCount = 0;
+    parking = NULL;
+}
 
-    printf("\n+=================== Enter Vehicle ===================+\n");
+ParkingManagement *findLot(int lotId) {
+    for (int i = 0; i < lotCount; i++) {
+        if (lots[i].lotId == lotId)
+            return &lots[i];
+    }
+    return NULL;
+}
+
+static int isValidVehicleKind(int vehicleType, int customerType) {
+    return vehicleType >= 0 && vehicleType < VEHICLE_TYPE_COUNT &&
+           customerType >= 0 && customerType < CUSTOMER_TYPE_COUNT;
+}
+
+// Legacy text format, only read when no binary snapshot exists yet.
+static void loadLegacyParkingData(ParkingManagement *lot) {
+    if (lot->lotId != DEFAULT_LOT_ID) return;
+
+    FILE *file = fopen(LEGACY_DATA_FILE, "r");
+    if (!file) return;
+
+    int count = 0;
+    if (fscanf(file, "%d\n", &count) != 1 || count < 0 || count > lot->vehicleCapacity) {
+        fprintf(stderr, "Warning: %s has an invalid vehicle count, ignoring it.\n", LEGACY_DATA_FILE);
+        fclose(file);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        Vehicle v;
+        int vehicleType, customerType;
+        long arrivalTime;
+        char vehicleNumber[VEHICLE_NUMBER_LENGTH];
+        if (fscanf(file, "%19s %d %d %ld\n",
+                   vehicleNumber,
+                   &vehicleType,
+                   &customerType,
+                   &arrivalTime) != 4 ||
+            !isValidVehicleKind(vehicleType, customerType))
+            break;
+        if (encodePlate(vehicleNumber, &v.plate) != 0 || findVehicleIndex(lot, v.plate) >= 0)
+            continue;
+
+        v.vehicleType = vehicleType;
+        v.customerType = customerType;
+        v.arrivalTime = (time_t)arrivalTime;
+        v.bayId = 0;
+        admitVehicle(lot, &v);
+    }
+    fclose(file);
+}
+
+// Restores the bookings of a snapshot. Caller holds the lot exclusively.
+static void restoreSnapshotBookings(ParkingManagement *lot, const SnapshotReservation *bookings,
+                                    size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const SnapshotReservation *record = &bookings[i];
+        Reservation reservation = {{record->plateHi, record->plateLo}, record->start,
+                                   record->start + record->seconds,
+                                   VEHICLE_KIND(record->vehicleType, record->customerType), 0};
+        if (record->vehicleType < VEHICLE_TYPE_COUNT && record->customerType < CUSTOMER_TYPE_COUNT)
+            restoreReservation(lot, &reservation);
+    }
+}
+
+// Loads the lot's snapshot. A version 6 snapshot is mapped and used in
+// place (see MAPPED SNAPSHOTS), so its load does not grow with the vehicle
+// count. Older ones are mapped read-only and their records admitted one by
+// one (plate index, bay map, overstay heap), which does.
+// Returns 0 on success, -1 if there is no snapshot or it fails validation.
+int loadSnapshot(ParkingManagement *lot) {
+    int fd = open(lot->snapshotFile, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat info;
+    SnapshotHeader head;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(SnapshotHeader) ||
+        pread(fd, &head, sizeof(head), 0) != (ssize_t)sizeof(head)) {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = (size_t)info.st_size;
+    if (memcmp(head.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0 &&
+        head.version == SNAPSHOT_ARENA_VERSION) {
+        int result = loadArenaSnapshot(lot, fd, size);
+        close(fd);
+        if (result != 0) {
+            fprintf(stderr, "Warning: %s is corrupt or from another version, ignoring it.\n",
+                   lot->snapshotFile);
+            resetParking(lot);
+            clearReservations(lot);
+        }
+        return result;
+    }
+
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const SnapshotHeader *header = map;
+    int textPlates = header->version <= SNAPSHOT_TEXT_VERSION;
+    size_t recordSize = textPlates ? sizeof(SnapshotRecordV3) : sizeof(SnapshotRecord);
+    size_t recordBytes = (size_t)header->vehicleCount * recordSize;
+    size_t reservationCount = header->version >= SNAPSHOT_BOOKING_VERSION ? header->reservationCount : 0;
+    const unsigned char *records = (const unsigned char *)(header + 1);
+    const SnapshotReservation *bookings = (const SnapshotReservation *)(records + recordBytes);
+    recordBytes += reservationCount * sizeof(SnapshotReservation);
+
+    int valid = memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0 &&
+                header->version >= SNAPSHOT_MIN_VERSION &&
+                header->version <= SNAPSHOT_RECORD_VERSION &&
+                header->recordSize == recordSize &&
+                header->vehicleCount <= (uint32_t)lot->vehicleCapacity &&
+                size - sizeof(SnapshotHeader) >= recordBytes;
+    if (valid) {
+        posix_madvise(map, size, POSIX_MADV_SEQUENTIAL);
+        valid = checksumBytes(records, recordBytes) == header->checksum;
+    }
+
+    for (uint32_t i = 0; valid && i < header->vehicleCount; i++) {
+        Vehicle v;
+        int vehicleType, customerType;
+        if (textPlates) {
+            // Older snapshot: re-encode the stored text
+            const SnapshotRecordV3 *record = (const SnapshotRecordV3 *)records + i;
+            if (memchr(record->vehicleNumber, '\0', sizeof(record->vehicleNumber)) == NULL ||
+                encodePlate(record->vehicleNumber, &v.plate) != 0) {
+                valid = 0;
+                break;
+            }
+            vehicleType = record->vehicleType;
+            customerType = record->customerType;
+            v.arrivalTime = (time_t)record->arrivalTime;
+            v.bayId = (int)record->bayId;
+        } else {
+            const SnapshotRecord *record = (const SnapshotRecord *)records + i;
+            v.plate = (PlateKey){record->plateHi, record->plateLo};
+            vehicleType = record->vehicleType;
+            customerType = record->customerType;
+            v.arrivalTime = (time_t)record->arrivalTime;
+            v.bayId = (int)record->bayId;
+        }
+        if (!isValidVehicleKind(vehicleType, customerType) ||
+            slotFree(&lot->slots[vehicleType][customerType]) <= 0 ||
+            !isValidPlate(v.plate) || findVehicleIndex(lot, v.plate) >= 0) {
+            valid = 0;
+            break;
+        }
+
+        v.vehicleType = vehicleType;
+        v.customerType = customerType;
+        admitVehicle(lot, &v);
+    }
+    if (valid)
+        restoreSnapshotBookings(lot, bookings, reservationCount);
+
+    munmap(map, size);
+    if (!valid) {
+        fprintf(stderr, "Warning: %s is corrupt or from another version, ignoring it.\n",
+               lot->snapshotFile);
+        resetParking(lot);
+        clearReservations(lot);
+        return -1;
+    }
+    return 0;
+}
+
+// Loads the last snapshot, then replays the journal written since it.
+void loadParkingData(ParkingManagement *lot) {
+    struct timespec start;
+    startTiming(&start);
+    clearReservations(lot);
+    if (loadSnapshot(lot) != 0) {
+        loadLegacyParkingData(lot);
+    }
+
+    // Replay the journal tail. A torn record at the end (crash mid-write)
+    // is simply ignored.
+    FILE *file = fopen(lot->journalFileName, "rb");
+    if (file) {
+        JournalRecord record;
+        while (fread(&record, sizeof(record), 1, file) == 1)
+            applyJournalRecord(lot, &record);
+        fclose(file);
+    }
+
+    openJournal(lot);
+    recordTiming(TIMED_LOAD, &start);
+}
+
+// Redoes one journaled change, as journal replay and a replication
+// follower do; the change is not journaled again. Invalid records are
+// skipped.
+void applyJournalRecord(ParkingManagement *lot, const JournalRecord *record) {
+    PlateKey plate;
+    if (!isValidVehicleKind(record->vehicleType, record->customerType) ||
+        readJournalPlate(record, &plate) != 0)
+        return;
+
+    if (record->op == JOURNAL_ENTER) {
+        Vehicle v;
+        v.plate = plate;
+        v.vehicleType = record->vehicleType;
+        v.customerType = record->customerType;
+        v.arrivalTime = (time_t)record->timestamp;
+        v.bayId = 0; // lowest free bay, as when it was first parked
+        if (findVehicleIndex(lot, v.plate) < 0 && admitVehicle(lot, &v) == 0 &&
+            lot->reservations)
+            claimJournaledBooking(lot, v.plate, v.vehicleType, v.arrivalTime);
+    } else if (record->op == JOURNAL_EXIT) {
+        int i = findVehicleIndex(lot, plate);
+        if (i >= 0)
+            releaseVehicleAt(lot, i);
+    } else if (record->op == JOURNAL_RESERVE) {
+        uint32_t seconds;
+        memcpy(&seconds, record->plate + sizeof(PlateKey), sizeof(seconds));
+        Reservation reservation = {plate, record->timestamp, record->timestamp + seconds,
+                                   VEHICLE_KIND(record->vehicleType, record->customerType), 0};
+        restoreReservation(lot, &reservation);
+    } else if (record->op == JOURNAL_CANCEL) {
+        lockLotMutex(lot, &lot->reservationLock);
+        dropReservation(lot, plate, (time_t)record->timestamp);
+        pthread_mutex_unlock(&lot->reservationLock);
+    }
+}
+
+// Compacts the journal into a fresh snapshot.
+void saveParkingData(ParkingManagement *lot) {
+    struct timespec start;
+    startTiming(&start);
+    if (writeSnapshot(lot) != 0) {
+        fprintf(stderr, "Warning: could not write %s, journal kept.\n", lot->snapshotFile);
+    }
+    recordTiming(TIMED_SAVE, &start);
+}
+
+// void enterVehicle() {
+//     if (lot->vehicleCount >= TOTAL_SLOTS) {
+//         printf("\n+==============================================+\n");
+//         printf("| Parking is full. Cannot accept more vehicles. |\n");
+//         printf("+==============================================+\n\n");
+//         return;
+//     }
+
+//     Vehicle vehicle;
+
+//     printf("\n+=================== Enter Vehicle ===================+\n");
+
+//     // Vehicle number input
+//     printf("| %-40s: ", "Vehicle Number");
+//     scanf("%s", vehicle.vehicleNumber);
+
+//     // Vehicle type input
+//     printf("\n| %-40s: \n", "Vehicle Type");
+//     for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+//         printf("|   (%d) %-33s |\n", i, VehicleTypeNames[i]);
+//     }
+//     printf("| %-40s: ", "Enter Choice");
+//     scanf("%d", &vehicle.vehicleType);
+
+//     // Customer type input
+//     printf("\n| %-40s: \n", "Customer Type");
+//     for (int i = 0; i < CUSTOMER_TYPE_COUNT; i++) {
+//         printf("|   (%d) %-33s |\n", i, CustomerTypeNames[i]);
+//     }
+//     printf("| %-40s: ", "Enter Choice");
+//     scanf("%d", &vehicle.customerType);
+
+//     ParkingSlot *slot = &lot->slots[vehicle.vehicleType][vehicle.customerType];
+
+//     // Success / failure message
+//     if (slot->free > 0) {
+//         slot->allocated++;
+//         slot->free--;
+//         vehicle.arrivalTime = time(NULL);
+//         lot->vehicles[lot->vehicleCount++] = vehicle;
 
-    // Vehicle number input
+//         printf("+====================================================+\n");
+//         printf("| Vehicle parked successfully!                       |\n");
+//         printf("+====================================================+\n\n");
+//     } else {
+//         printf("+====================================================+\n");
+//         printf("| No free slots available for this vehicle and      |\n");
+//         printf("| customer type.                                     |\n");
+//         printf("+====================================================+\n\n");
+//     }
+// }
+
+void enterVehicle() {
+    if (parkedVehicles(parking) >= parking->vehicleCapacity) {
+        printf("\n+==============================================+\n");
+        printf("| Parking is full. Cannot accept more vehicles. |\n");
+        printf("+==============================================+\n\n");
+        return;
+    }
+
+    Vehicle vehicle;
+    char plateText[PLATE_INPUT_LENGTH];
+    int vehicleType = -1, customerType = -1;
+
+    printf("\n+=================== Enter Vehicle ===================+\n");
+
+    // Vehicle number input; an unreadable plate is rejected by parkVehicle
     printf("| %-40s: ", "Vehicle Number");
-    scanf("%s", vehicle.vehicleNumber);
-    // fgets(vehicle.vehicleNumber, sizeof(vehicle.vehicleNumber), stdin);
+    if (scanf("%63s", plateText) != 1 || encodePlate(plateText, &vehicle.plate) != 0)
+        vehicle.plate = (PlateKey){0, 0};
 
     // Vehicle type input
     printf("\n| %-40s: \n", "Vehicle Type");
     for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
         printf("|   (%d) %-33s |\n", i, VehicleTypeNames[i]);
     }
-    printf("| %-40s: ", "Enter Choice");
-    scanf("%d", &vehicle.vehicleType);
+    printf("| %-40s: ", "Enter Choice");
+    scanf("%d", &vehicleType);
+
+    // Customer type input
+    printf("\n| %-40s: \n", "Customer Type");
+    for (int i = 0; i < CUSTOMER_TYPE_COUNT; i++) {
+        printf("|   (%d) %-33s |\n", i, CustomerTypeNames[i]);
+    }
+    printf("| %-40s: ", "Enter Choice");
+    scanf("%d", &customerType);
+
+    vehicle.vehicleType = vehicleType;
+    vehicle.customerType = customerType;
+
+    switch (parkVehicle(parking, &vehicle, parkingClock())) {
+        case PARK_OK:
+            printf("\n+====================================================+\n");
+            printf("| Vehicle parked successfully under %-12s slot |\n",
+                   CustomerTypeNames[vehicle.customerType]);
+            printf("| Bay number: %-38d |\n", vehicle.bayId);
+            printf("+====================================================+\n\n");
+            break;
+        case PARK_DUPLICATE:
+            printf("\n+====================================================+\n");
+            printf("| Vehicle is already inside the parking.             |\n");
+            printf("+====================================================+\n\n");
+            break;
+        case PARK_INVALID:
+            printf("\n+====================================================+\n");
+            printf("| Invalid vehicle number, vehicle or customer type.  |\n");
+            printf("+====================================================+\n\n");
+            break;
+        default:
+            printf("\n+====================================================+\n");
+            printf("| No suitable slot available based on priority rules |\n");
+            printf("+====================================================+\n\n");
+    }
+}
+
+int slotAllocated(const ParkingSlot *slot) {
+    return SLOT_ALLOCATED(atomic_load(&slot->counts));
+}
+
+int slotFree(const ParkingSlot *slot) {
+    return SLOT_FREE(atomic_load(&slot->counts));
+}
+
+int slotTotal(const ParkingSlot *slot) {
+    uint64_t counts = atomic_load(&slot->counts);
+    return SLOT_ALLOCATED(counts) + SLOT_FREE(counts);
+}
+
+// Takes one slot with a CAS loop, lock-free, but only while at least
+// minFree slots are free. The check and the decrement act on the same
+// snapshot of the counts, so concurrent gates can never push a reserved
+// tier below its floor. Returns 1 if taken.
+int reserveSlot(ParkingSlot *slot, int minFree) {
+    uint64_t counts = atomic_load(&slot->counts);
+    uint64_t next;
+
+    do {
+        int allocated = SLOT_ALLOCATED(counts);
+        int free = SLOT_FREE(counts);
+        if (free <= 0 || free < minFree)
+            return 0;
+
+        next = SLOT_COUNTS(allocated + 1, free - 1);
+    } while (!atomic_compare_exchange_weak(&slot->counts, &counts, next));
+
+    return 1;
+}
+
+// Gives one slot back: allocated - 1, free + 1 in a single atomic add.
+void releaseSlot(ParkingSlot *slot) {
+    atomic_fetch_add(&slot->counts, (uint64_t)1 - ((uint64_t)1 << 32));
+}
+
+// Brings cell [vehicleType][customerType]'s bit in lendingTiers in line with
+// its counts. Re-checks the counts afterwards: if another gate changed them
+// meanwhile, our update may be stale, so go again.
+static void refreshLendingTier(ParkingManagement *lot, int vehicleType, int customerType) {
+    ParkingSlot *slot = &lot->slots[vehicleType][customerType];
+    uint64_t counts = atomic_load(&slot->counts);
+    uint64_t seen;
+
+    do {
+        seen = counts;
+        if (SLOT_FREE(counts) >= lot->lendFloor[vehicleType][customerType])
+            atomic_fetch_or(&lot->lendingTiers[vehicleType], TIER_BIT(customerType));
+        else
+            atomic_fetch_and(&lot->lendingTiers[vehicleType], ~TIER_BIT(customerType));
+        counts = atomic_load(&slot->counts);
+    } while (counts != seen);
+}
+
+// reserveSlot/releaseSlot on one of a lot's cells, keeping lendingTiers current
+int reserveCell(ParkingManagement *lot, int vehicleType, int customerType, int minFree) {
+    if (!reserveSlot(&lot->slots[vehicleType][customerType], minFree))
+        return 0;
+    refreshLendingTier(lot, vehicleType, customerType);
+    return 1;
+}
+
+void releaseCell(ParkingManagement *lot, int vehicleType, int customerType) {
+    releaseSlot(&lot->slots[vehicleType][customerType]);
+    refreshLendingTier(lot, vehicleType, customerType);
+}
+
+// Reserves the slot for a vehicle: its own [vehicleType][customerType] cell,
+// otherwise the highest priority donor tier the lot's policy allows. Every
+// cell keeps the bays booked within the lookahead free (see RESERVATIONS).
+// Returns the customer type whose slot was taken, or -1 if none fits.
+int allocateSlot(ParkingManagement *lot, enum VehicleType vehicleType,
+                 enum CustomerType customerType) {
+    if (reserveCell(lot, vehicleType, customerType, 1 + lot->heldSoon[vehicleType][customerType]))
+        return customerType;
+
+    unsigned int donors = atomic_load(&lot->lendingTiers[vehicleType]) &
+                          lot->policy->borrowFrom[customerType];
+    while (donors) {
+        int c = __builtin_ctz(donors);
+        // The mask is a hint; the CAS re-checks the floor
+        if (reserveCell(lot, vehicleType, c,
+                        lot->lendFloor[vehicleType][c] + lot->heldSoon[vehicleType][c]))
+            return c;
+        donors &= donors - 1;
+    }
+    return -1;
+}
+
+const AllocationPolicy *findAllocationPolicy(const char *name) {
+    for (size_t i = 0; i < ARRAY_COUNT(ALLOCATION_POLICIES); i++) {
+        if (strcmp(ALLOCATION_POLICIES[i].name, name) == 0)
+            return &ALLOCATION_POLICIES[i];
+    }
+    return NULL;
+}
+
+// Switches a lot to policy: turns the percentages into per-cell floors and
+// rebuilds the lending masks. Not for use while gates are running.
+void applyAllocationPolicy(ParkingManagement *lot, const AllocationPolicy *policy) {
+    lot->policy = policy;
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        atomic_store(&lot->lendingTiers[i], 0);
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+            // free * 100 > minFreePercent * total  <=>  free >= floor + 1
+            lot->lendFloor[i][j] = policy->minFreePercent[j] * slotTotal(&lot->slots[i][j]) / 100 + 1;
+            refreshLendingTier(lot, i, j);
+        }
+    }
+}
+
+// ================== FORECAST ====================
+// The forecast policy keeps a decaying arrival rate per [type][tier] cell
+// (an exponentially weighted event rate, O(1) per request) and every
+// FORECAST_INTERVAL re-splits each vehicle type's bays: a protected cell
+// keeps enough free bays for the arrivals its own tier is forecast to bring
+// within FORECAST_HORIZON (mean plus two standard deviations), capped at the
+// policy's floor, and lends the rest.
+// Only the lending floors move; bay ranges, and so every parked vehicle and
+// its bay number, stay where they are.
+
+static double forecastRate(const ParkingManagement *lot, int vehicleType, int customerType,
+                           time_t now) {
+    double age = difftime(now, lot->arrivalRateTime[vehicleType][customerType]);
+    double rate = lot->arrivalRate[vehicleType][customerType];
+    return age > 0 ? rate * exp(-age / FORECAST_TAU) : rate;
+}
+
+// Caller holds the type's statsLock.
+void recordArrivalForecast(ParkingManagement *lot, int vehicleType, int customerType,
+                           time_t arrivalTime) {
+    VehicleStore *store = &lot->stores[vehicleType];
+    double rate = forecastRate(lot, vehicleType, customerType, arrivalTime);
+    lot->arrivalRate[vehicleType][customerType] = rate + 1.0 / FORECAST_TAU;
+    if (arrivalTime > lot->arrivalRateTime[vehicleType][customerType])
+        lot->arrivalRateTime[vehicleType][customerType] = arrivalTime;
+    // The first interval only warms the rates up; the policy's floors stand
+    if (store->nextRebalance == 0)
+        store->nextRebalance = arrivalTime + FORECAST_INTERVAL;
+}
+
+// Sets the lending floors of one vehicle type's cells from the forecasts.
+// Caller holds the type's statsLock; gates keep running, since floors and
+// lending masks are atomics.
+void rebalanceQuotas(ParkingManagement *lot, int vehicleType, time_t now) {
+    for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+        int total = slotTotal(&lot->slots[vehicleType][j]);
+        double expected = forecastRate(lot, vehicleType, j, now) * FORECAST_HORIZON;
+        int need = (int)ceil(expected + 2 * sqrt(expected));
+        int most = lot->policy->minFreePercent[j] * total / 100;
+        lot->lendFloor[vehicleType][j] = (need < most ? need : most) + 1;
+        refreshLendingTier(lot, vehicleType, j);
+    }
+    if (replicationLeader)
+        replicateFloors(lot, vehicleType);
+    lot->stores[vehicleType].nextRebalance = now + FORECAST_INTERVAL;
+}
+// ================================================
+
+// Parks a vehicle that arrived at arrivalTime. On success the vehicle's
+// customerType is updated to the tier whose slot it was given.
+// Safe to call from several gate threads at once. A gate holds the plate's
+// lock, then its vehicle type's store and statsLock, so gates parking other
+// plates of other types never wait for it.
+enum ParkResult parkVehicle(ParkingManagement *lot, Vehicle *vehicle, time_t arrivalTime) {
+    struct timespec start;
+    startTiming(&start);
+    if (!isValidVehicleKind(vehicle->vehicleType, vehicle->customerType) ||
+        !isValidPlate(vehicle->plate)) {
+        atomic_fetch_add(&lot->invalidRejections, 1);
+        recordTiming(TIMED_ENTER, &start);
+        return PARK_INVALID;
+    }
+
+    enum ParkResult result = PARK_OK;
+    enum CustomerType requestedCustomerType = vehicle->customerType;
+    int vehicleType = vehicle->vehicleType;
+    VehicleStore *store = &lot->stores[vehicleType];
+    // The plate's lock keeps every other gate off this plate, so the
+    // duplicate check holds until the vehicle is in. A shared lot makes
+    // the whole entry, slot and statistics included, under its one store
+    // lock instead, so its rows alone are enough to repair it if this
+    // process dies halfway (see SHARED LOTS)
+    int holdStore = lot->shared;
+    if (holdStore)
+        lockVehicleStore(lot, vehicleType, 1);
+    else
+        lockPlate(lot, vehicle->plate);
+    if (parkedVehicles(lot) >= lot->vehicleCapacity)
+        result = PARK_FULL;
+    else if (findVehicleIndex(lot, vehicle->plate) >= 0)
+        result = PARK_DUPLICATE;
+
+    // A vehicle with a booking for now takes a bay its booking kept free
+    int bookedCustomerType = -1;
+    if (result == PARK_OK && atomic_load(&lot->bookingCount) > 0)
+        bookedCustomerType = findBooking(lot, vehicle->plate, vehicleType, arrivalTime, 0);
+
+    int allocatedCustomerType = -1;
+    int overstays = 0;
+    if (result == PARK_OK) {
+        if (bookedCustomerType >= 0 && reserveCell(lot, vehicleType, bookedCustomerType, 1))
+            allocatedCustomerType = bookedCustomerType;
+        else
+            allocatedCustomerType = allocateSlot(lot, vehicleType, vehicle->customerType);
+        if (allocatedCustomerType < 0)
+            result = PARK_NO_SLOT;
+    }
+
+    if (result == PARK_OK) {
+        vehicle->customerType = allocatedCustomerType;
+        vehicle->arrivalTime = arrivalTime;
+        vehicle->bayId = 0;
+
+        if (!holdStore)
+            lockVehicleStore(lot, vehicleType, 1);
+        if (insertVehicle(lot, vehicle) != 0) {
+            result = PARK_NO_SLOT;
+        } else {
+            if (bookedCustomerType >= 0)
+                findBooking(lot, vehicle->plate, vehicleType, arrivalTime, 1);
+            appendJournal(lot, JOURNAL_ENTER, vehicle, arrivalTime);
+            overstays = advanceOverstays(lot, vehicleType, arrivalTime);
+        }
+        if (!holdStore)
+            unlockVehicleStore(lot, vehicleType);
+
+        if (result != PARK_OK)
+            releaseCell(lot, vehicleType, allocatedCustomerType);
+    }
+    if (!holdStore)
+        unlockPlate(lot, vehicle->plate);
+
+    lockLotMutex(lot, &store->statsLock);
+    if (result == PARK_OK) {
+        struct tm local;
+        store->stats.occupied++;
+        store->stats.occupiedByType[vehicleType]++;
+        publishOccupancy(lot, vehicleType, allocatedCustomerType, 1);
+        store->stats.arrivals++;
+        if (allocatedCustomerType != (int)requestedCustomerType)
+            store->stats.borrowed++;
+        store->stats.overstays += overstays;
+        if (localtime_r(&arrivalTime, &local))
+            store->stats.arrivalsByHour[local.tm_hour]++;
+    } else {
+        store->stats.rejections++;
+    }
+    // Forecasts count every request, so rejected demand shows up too
+    if (lot->policy->forecast) {
+        recordArrivalForecast(lot, vehicleType, requestedCustomerType, arrivalTime);
+        if (arrivalTime >= store->nextRebalance)
+            rebalanceQuotas(lot, vehicleType, arrivalTime);
+    }
+    pthread_mutex_unlock(&store->statsLock);
+    if (holdStore)
+        unlockVehicleStore(lot, vehicleType);
+
+    if (result == PARK_OK)
+        maintainJournal(lot);
+    recordTiming(TIMED_ENTER, &start);
+    return result;
+}
+
+// Removes a parked vehicle at exitTime and bills it. Returns 0 and fills
+// *vehicle and *bill if found, -1 otherwise. Safe to call from several
+// gate threads at once; like parkVehicle it holds the plate's lock and
+// then only its vehicle type's locks.
+int unparkVehicle(ParkingManagement *lot, PlateKey plate, time_t exitTime,
+                  Vehicle *vehicle, Bill *bill) {
+    struct timespec start;
+    startTiming(&start);
+    // A shared lot has one store lock for every type, and keeps it until
+    // the statistics are done, as in parkVehicle
+    int holdStore = lot->shared;
+    if (holdStore)
+        lockStore(lot, 1);
+    else
+        lockPlate(lot, plate);
+    int i = findVehicleIndex(lot, plate);
+    if (i < 0) {
+        if (holdStore)
+            unlockStore(lot);
+        else
+            unlockPlate(lot, plate);
+        recordTiming(TIMED_EXIT, &start);
+        return -1;
+    }
+    // The row cannot change while the plate is locked
+    int vehicleType = KIND_VEHICLE_TYPE(lot->vehicleKinds[i]);
+    VehicleStore *store = &lot->stores[vehicleType];
+    if (!holdStore)
+        lockVehicleStore(lot, vehicleType, 1);
+    getVehicleAt(lot, i, vehicle);
+    removeVehicleAt(lot, i);
+    appendJournal(lot, JOURNAL_EXIT, vehicle, exitTime);
+    int overstays = advanceOverstays(lot, vehicleType, exitTime);
+    if (!holdStore) {
+        unlockVehicleStore(lot, vehicleType);
+        unlockPlate(lot, plate);
+    }
+
+    releaseCell(lot, vehicleType, vehicle->customerType);
+
+    struct timespec billStart;
+    startTiming(&billStart);
+    *bill = calculateBill(vehicle, exitTime);
+    recordTiming(TIMED_BILL, &billStart);
+
+    lockLotMutex(lot, &store->statsLock);
+    store->stats.occupied--;
+    store->stats.occupiedByType[vehicleType]--;
+    publishOccupancy(lot, vehicleType, vehicle->customerType, -1);
+    store->stats.overstays += overstays;
+    recordExitStatistics(&store->stats, vehicle, exitTime, bill);
+    pthread_mutex_unlock(&store->statsLock);
+    if (holdStore)
+        unlockStore(lot);
+
+    archiveSession(lot, vehicle, exitTime, bill);
+    maintainJournal(lot);
+    recordTiming(TIMED_EXIT, &start);
+    return 0;
+}
+
+void recordExitStatistics(ParkingStatistics *stats, const Vehicle *vehicle,
+                          time_t exitTime, const Bill *bill) {
+    long long dwellSeconds = (long long)difftime(exitTime, vehicle->arrivalTime);
+    if (dwellSeconds < 0)
+        dwellSeconds = 0;
+
+    size_t bucket = 0;
+    while (bucket < ARRAY_COUNT(DWELL_BUCKET_HOURS) &&
+           dwellSeconds >= DWELL_BUCKET_HOURS[bucket] * 3600LL)
+        bucket++;
+
+    stats->exits++;
+    stats->totalDwellSeconds += dwellSeconds;
+    stats->dwellHistogram[bucket]++;
+    stats->revenueCents += bill->payableCents;
+    stats->revenueByTypeCents[vehicle->vehicleType] += bill->payableCents;
+}
+
+static void addStatistics(ParkingStatistics *total, const ParkingStatistics *part) {
+    total->occupied += part->occupied;
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        total->occupiedByType[i] += part->occupiedByType[i];
+        total->revenueByTypeCents[i] += part->revenueByTypeCents[i];
+    }
+    total->arrivals += part->arrivals;
+    total->exits += part->exits;
+    total->rejections += part->rejections;
+    total->borrowed += part->borrowed;
+    total->overstays += part->overstays;
+    total->revenueCents += part->revenueCents;
+    total->totalDwellSeconds += part->totalDwellSeconds;
+    for (int hour = 0; hour < 24; hour++)
+        total->arrivalsByHour[hour] += part->arrivalsByHour[hour];
+    for (size_t i = 0; i < DWELL_BUCKET_COUNT; i++)
+        total->dwellHistogram[i] += part->dwellHistogram[i];
+}
+
+// The lot's statistics: every vehicle type's, each copied under its own
+// statsLock, added up.
+ParkingStatistics getParkingStatistics(ParkingManagement *lot) {
+    ParkingStatistics stats;
+    memset(&stats, 0, sizeof(stats));
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        VehicleStore *store = &lot->stores[i];
+        lockLotMutex(lot, &store->statsLock);
+        ParkingStatistics part = store->stats;
+        pthread_mutex_unlock(&store->statsLock);
+        addStatistics(&stats, &part);
+    }
+    stats.rejections += atomic_load(&lot->invalidRejections);
+    return stats;
+}
+
+// ================== OCCUPANCY VIEW ==============
+// Reports read the slot matrix through a seqlock instead of the live slot
+// counts: those change cell by cell under concurrent gates, so a long report
+// could show a vehicle in no cell or in two. A gate only moves vehicles
+// within its vehicle type's row of cells, so each row has its own sequence
+// counter, written under that type's statsLock (or before any gate starts):
+// writers never wait for a reader or for gates of other types, and a reader
+// that overlaps an update of a row simply copies that row again.
+
+// Rebuilds the view from the slot counts. Not for use while gates are
+// running, but reports in other processes may read a shared lot meanwhile.
+void resetOccupancyView(ParkingManagement *lot) {
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        _Atomic unsigned long *sequence = &lot->stores[i].occupancySequence;
+        unsigned long before = atomic_load_explicit(sequence, memory_order_relaxed);
+        atomic_store_explicit(sequence, before | 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+
+        int occupiedByType = 0;
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+            uint64_t counts = atomic_load(&lot->slots[i][j].counts);
+            atomic_store_explicit(&lot->viewAllocated[i][j], SLOT_ALLOCATED(counts),
+                                  memory_order_relaxed);
+            atomic_store_explicit(&lot->viewFree[i][j], SLOT_FREE(counts), memory_order_relaxed);
+            occupiedByType += SLOT_ALLOCATED(counts);
+        }
+        atomic_store_explicit(&lot->viewOccupiedByType[i], occupiedByType, memory_order_relaxed);
+        atomic_store_explicit(sequence, (before | 1) + 1, memory_order_release);
+    }
+}
+
+// Moves delta vehicles into cell [vehicleType][customerType] of the view.
+// Caller holds the type's statsLock (or no gate is running).
+void publishOccupancy(ParkingManagement *lot, int vehicleType, int customerType, int delta) {
+    _Atomic unsigned long *sequence = &lot->stores[vehicleType].occupancySequence;
+    unsigned long before = atomic_load_explicit(sequence, memory_order_relaxed);
+    atomic_store_explicit(sequence, before + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    _Atomic int *allocated = &lot->viewAllocated[vehicleType][customerType];
+    _Atomic int *free = &lot->viewFree[vehicleType][customerType];
+    atomic_store_explicit(allocated, atomic_load_explicit(allocated, memory_order_relaxed) + delta,
+                          memory_order_relaxed);
+    atomic_store_explicit(free, atomic_load_explicit(free, memory_order_relaxed) - delta,
+                          memory_order_relaxed);
+    _Atomic int *byType = &lot->viewOccupiedByType[vehicleType];
+    atomic_store_explicit(byType, atomic_load_explicit(byType, memory_order_relaxed) + delta,
+                          memory_order_relaxed);
+
+    atomic_store_explicit(sequence, before + 2, memory_order_release);
+}
+
+// Vehicles parked in the lot as of the view; no lock taken.
+int parkedVehicles(ParkingManagement *lot) {
+    int parked = 0;
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        parked += atomic_load_explicit(&lot->viewOccupiedByType[i], memory_order_relaxed);
+    return parked;
+}
+
+// Copies the view a vehicle type's row at a time; retries a row while an
+// update overlaps its copy.
+void readOccupancy(ParkingManagement *lot, OccupancyView *view) {
+    view->occupied = 0;
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        _Atomic unsigned long *sequence = &lot->stores[i].occupancySequence;
+        unsigned long before, after;
+        do {
+            before = atomic_load_explicit(sequence, memory_order_acquire);
+            if (before & 1)
+                continue;
+            for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+                view->allocated[i][j] = atomic_load_explicit(&lot->viewAllocated[i][j],
+                                                             memory_order_relaxed);
+                view->free[i][j] = atomic_load_explicit(&lot->viewFree[i][j],
+                                                        memory_order_relaxed);
+            }
+            view->occupiedByType[i] = atomic_load_explicit(&lot->viewOccupiedByType[i],
+                                                           memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            after = atomic_load_explicit(sequence, memory_order_relaxed);
+        } while ((before & 1) || before != after);
+        view->occupied += view->occupiedByType[i];
+    }
+}
+// ================================================
+
+void checkAvailability() {
+    int backChoice;
+
+    do {
+        OccupancyView view;
+        readOccupancy(parking, &view);
+        printf("\n================ Availability ================\n");
+
+        printf("%-15s | %-15s | %5s\n", "Vehicle Type", "Customer Type", "Free");
+        printf("--------------------------------------------\n");
+
+        for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+            for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+                printf("%-15s | %-15s | %5d\n",
+                       VehicleTypeNames[i],        // Vehicle Type
+                       CustomerTypeNames[j],       // Customer Type
+                       view.free[i][j]             // Free count
+                );
+            }
+            printf("\n");
+        }
+
+        printf("============================================\n");
+
+        printf("\nEnter 0 to go back to the Main Menu: ");
+        scanf("%d", &backChoice);
+        getchar();
+    } while (backChoice != 0);
+}
+
+void exitVehicle() {
+    char plateText[PLATE_INPUT_LENGTH];
+    PlateKey plate;
+
+    printf("\n==================== Exit Vehicle ===================\n");
+    printf("| %-30s: ", "Enter vehicle number");
+    int readable = scanf("%63s", plateText) == 1 && encodePlate(plateText, &plate) == 0;
+
+    Vehicle vehicle;
+    Bill bill;
+    time_t exitTime = parkingClock();
+    if (readable && unparkVehicle(parking, plate, exitTime, &vehicle, &bill) == 0) {
+        generateBill(&vehicle, exitTime, &bill);
+
+        printf("\n+--------------------------------------------+\n");
+        printf("| Vehicle successfully exited the parking!  |\n");
+        printf("+--------------------------------------------+\n\n");
+
+        return;
+    }
+
+    printf("\n+--------------------------------------------+\n");
+    printf("| Vehicle not found in the parking system.   |\n");
+    printf("+--------------------------------------------+\n\n");
+}
+
+// ================== PLATES ======================
+// Plates are encoded once, where they enter the system (gate, menu, files),
+// into a PlateKey. Everything after that compares, hashes and stores two
+// words instead of a 20 byte string.
+static const char PLATE_ALPHABET[] = "?-0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+#define PLATE_CODE_COUNT ((int)sizeof(PLATE_ALPHABET) - 1)
+_Static_assert(PLATE_CODE_COUNT <= 1 << PLATE_CODE_BITS, "plate codes must fit in six bits");
+_Static_assert(2 * PLATE_WORD_CHARS - 1 >= VEHICLE_NUMBER_LENGTH - 1,
+               "PlateKey must hold the longest plate");
+
+static int appendPlateCode(uint64_t words[2], int *length, int code) {
+    if (*length >= VEHICLE_NUMBER_LENGTH - 1) return -1;
+    int shift = 64 - PLATE_CODE_BITS * (*length % PLATE_WORD_CHARS + 1);
+    words[*length / PLATE_WORD_CHARS] |= (uint64_t)code << shift;
+    (*length)++;
+    return 0;
+}
+
+// Encodes plate text as typed: letters in either case, digits and
+// separators, so "wp cab-1234" and "WP-CAB-1234" are the same plate.
+// Returns 0, or -1 for an empty plate, another character, or more than
+// VEHICLE_NUMBER_LENGTH - 1 characters once canonical.
+int encodePlate(const char *text, PlateKey *plate) {
+    uint64_t words[2] = {0, 0};
+    int length = 0;
+    int separator = 0;
+
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        int code;
+        if (*p >= '0' && *p <= '9') {
+            code = PLATE_DIGIT_CODE + (*p - '0');
+        } else if ((*p | 0x20) >= 'a' && (*p | 0x20) <= 'z') {
+            code = PLATE_LETTER_CODE + ((*p | 0x20) - 'a');
+        } else if (strchr(PLATE_SEPARATORS, *p)) {
+            separator = length > 0; // leading separators are dropped
+            continue;
+        } else {
+            return -1;
+        }
+        // A run of separators is written once, and only between characters
+        if (separator && appendPlateCode(words, &length, PLATE_SEPARATOR_CODE) != 0)
+            return -1;
+        separator = 0;
+        if (appendPlateCode(words, &length, code) != 0)
+            return -1;
+    }
+    if (length == 0) return -1;
+
+    plate->hi = words[0];
+    plate->lo = words[1];
+    return 0;
+}
+
+// Writes the canonical plate text into text (VEHICLE_NUMBER_LENGTH bytes)
+// and returns it.
+char *formatPlate(PlateKey plate, char *text) {
+    int length = 0;
+    for (; length < VEHICLE_NUMBER_LENGTH - 1; length++) {
+        uint64_t word = length < PLATE_WORD_CHARS ? plate.hi : plate.lo;
+        int shift = 64 - PLATE_CODE_BITS * (length % PLATE_WORD_CHARS + 1);
+        int code = (int)(word >> shift) & ((1 << PLATE_CODE_BITS) - 1);
+        if (code == 0 || code >= PLATE_CODE_COUNT) break;
+        text[length] = PLATE_ALPHABET[code];
+    }
+    text[length] = '\0';
+    return text;
+}
+
+// Cheap check that a key holds a plate at all; keys from encodePlate()
+// always pass.
+int isValidPlate(PlateKey plate) {
+    return plate.hi >> (64 - PLATE_CODE_BITS) != 0;
+}
+
+// Full check for keys read from files: the key must be exactly what
+// encodePlate() makes of its own text.
+static int isCanonicalPlate(PlateKey plate) {
+    char text[VEHICLE_NUMBER_LENGTH];
+    PlateKey encoded;
+    return encodePlate(formatPlate(plate, text), &encoded) == 0 &&
+           encoded.hi == plate.hi && encoded.lo == plate.lo;
+}
+
+static inline int samePlate(PlateKey a, PlateKey b) {
+    return ((a.hi ^ b.hi) | (a.lo ^ b.lo)) == 0;
+}
+
+// Orders keys like strcmp() orders their canonical text
+int comparePlates(PlateKey a, PlateKey b) {
+    if (a.hi != b.hi) return a.hi < b.hi ? -1 : 1;
+    if (a.lo != b.lo) return a.lo < b.lo ? -1 : 1;
+    return 0;
+}
+
+// Multiplicative mix of both words; the index takes the low bits
+unsigned int hashPlate(PlateKey plate) {
+    uint64_t hash = plate.hi ^ (plate.lo * 0x9e3779b97f4a7c15ull);
+    hash *= 0xff51afd7ed558ccdull;
+    return (unsigned int)(hash >> 32);
+}
+// ================================================
+
+// ================== PLATE INDEX =================
+// Plate -> row, chained through the rows: plateBuckets[bucket] is the
+// bucket's first row and plateNext[row] the next, so the index never fills
+// up and never needs rebuilding. A bucket's chain is guarded by the plate
+// lock of its stripe, which every lookup holds (see lockPlate); changes
+// hold the store of the row's type as well, so a thread holding every
+// store sees the whole index stand still.
+
+static inline unsigned int plateBucket(const ParkingManagement *lot, PlateKey plate) {
+    return hashPlate(plate) & lot->plateBucketMask;
+}
+
+void resetPlateIndex(ParkingManagement *lot) {
+    for (unsigned int i = 0; i <= lot->plateBucketMask; i++)
+        lot->plateBuckets[i] = PLATE_INDEX_EMPTY;
+}
+
+// Locks the stripe of the plate's bucket: no other gate can park, find or
+// remove that plate meanwhile. Shared lots use their store lock instead.
+void lockPlate(ParkingManagement *lot, PlateKey plate) {
+    pthread_mutex_lock(&lot->plateLocks[plateBucket(lot, plate) % PLATE_LOCK_STRIPES].lock);
+}
+
+void unlockPlate(ParkingManagement *lot, PlateKey plate) {
+    pthread_mutex_unlock(&lot->plateLocks[plateBucket(lot, plate) % PLATE_LOCK_STRIPES].lock);
+}
+
+void insertPlateIndex(ParkingManagement *lot, int vehicleIndex) {
+    unsigned int bucket = plateBucket(lot, lot->plateKeys[vehicleIndex]);
+    lot->plateNext[vehicleIndex] = lot->plateBuckets[bucket];
+    lot->plateBuckets[bucket] = vehicleIndex;
+}
+
+void removePlateIndex(ParkingManagement *lot, int vehicleIndex) {
+    int *link = &lot->plateBuckets[plateBucket(lot, lot->plateKeys[vehicleIndex])];
+    while (*link != vehicleIndex) {
+        assert(*link >= 0);
+        link = &lot->plateNext[*link];
+    }
+    *link = lot->plateNext[vehicleIndex];
+}
+
+// Returns the plate's row, or -1 if it is not parked. Caller holds the
+// plate (lockPlate), every store, or is the only thread.
+int findVehicleIndex(ParkingManagement *lot, PlateKey plate) {
+    int row = lot->plateBuckets[plateBucket(lot, plate)];
+    while (row >= 0 && !samePlate(lot->plateKeys[row], plate))
+        row = lot->plateNext[row];
+    return row;
+}
+
+// Copies row vehicleIndex of the vehicle columns into *vehicle.
+void getVehicleAt(const ParkingManagement *lot, int vehicleIndex, Vehicle *vehicle) {
+    vehicle->plate = lot->plateKeys[vehicleIndex];
+    vehicle->vehicleType = KIND_VEHICLE_TYPE(lot->vehicleKinds[vehicleIndex]);
+    vehicle->customerType = KIND_CUSTOMER_TYPE(lot->vehicleKinds[vehicleIndex]);
+    vehicle->arrivalTime = lot->arrivalTimes[vehicleIndex];
+    vehicle->bayId = vehicleIndex + 1;
+}
+
+static void setVehicleAt(ParkingManagement *lot, int vehicleIndex, const Vehicle *vehicle) {
+    lot->plateKeys[vehicleIndex] = vehicle->plate;
+    lot->arrivalTimes[vehicleIndex] = vehicle->arrivalTime;
+    lot->vehicleKinds[vehicleIndex] = VEHICLE_KIND(vehicle->vehicleType, vehicle->customerType);
+}
+
+// Removes the vehicle in row vehicleIndex and frees its bay. No other row
+// moves, so exit cost does not depend on how many vehicles are parked.
+// The caller holds the plate and the type's store for writing.
+void removeVehicleAt(ParkingManagement *lot, int vehicleIndex) {
+    unsigned char kind = lot->vehicleKinds[vehicleIndex];
+    untrackOverstay(lot, vehicleIndex);
+    removePlateIndex(lot, vehicleIndex);
+    lot->vehicleKinds[vehicleIndex] = VEHICLE_KIND_EMPTY;
+    freeBay(lot, KIND_VEHICLE_TYPE(kind), KIND_CUSTOMER_TYPE(kind), vehicleIndex + 1);
+    lot->stores[KIND_VEHICLE_TYPE(kind)].vehicleCount--;
+}
+
+// Gives a vehicle a bay, vehicle->bayId if that bay is free and in its
+// cell, else the cell's lowest free bay, and stores it in that bay's row
+// and the plate index. The caller holds the plate and the type's store for
+// writing (or is the only thread, during load) and has already reserved
+// the slot.
+int insertVehicle(ParkingManagement *lot, Vehicle *vehicle) {
+    int bayId = takeBay(lot, vehicle->vehicleType, vehicle->customerType, vehicle->bayId);
+    if (bayId == 0)
+        return -1;
+    vehicle->bayId = bayId;
+
+    int i = bayId - 1;
+    setVehicleAt(lot, i, vehicle);
+    insertPlateIndex(lot, i);
+    trackOverstay(lot, i);
+    lot->stores[vehicle->vehicleType].vehicleCount++;
+    return 0;
+}
+
+// Takes a slot in the vehicle's (already decided) [vehicleType][customerType]
+// cell and records the vehicle. Used by load and journal replay, which run
+// before any gate thread starts.
+// vehicle->bayId is the bay to restore, or 0. Returns -1 if the lot or the vehicle's cell is full.
+int admitVehicle(ParkingManagement *lot, Vehicle *vehicle) {
+    if (!reserveCell(lot, vehicle->vehicleType, vehicle->customerType, 1))
+        return -1;
+    if (insertVehicle(lot, vehicle) != 0) {
+        releaseCell(lot, vehicle->vehicleType, vehicle->customerType);
+        return -1;
+    }
+
+    ParkingStatistics *stats = &lot->stores[vehicle->vehicleType].stats;
+    stats->occupied++;
+    stats->occupiedByType[vehicle->vehicleType]++;
+    publishOccupancy(lot, vehicle->vehicleType, vehicle->customerType, 1);
+    return 0;
+}
+
+void releaseVehicleAt(ParkingManagement *lot, int vehicleIndex) {
+    unsigned char kind = lot->vehicleKinds[vehicleIndex];
+    ParkingStatistics *stats = &lot->stores[KIND_VEHICLE_TYPE(kind)].stats;
+    releaseCell(lot, KIND_VEHICLE_TYPE(kind), KIND_CUSTOMER_TYPE(kind));
+    stats->occupied--;
+    stats->occupiedByType[KIND_VEHICLE_TYPE(kind)]--;
+    publishOccupancy(lot, KIND_VEHICLE_TYPE(kind), KIND_CUSTOMER_TYPE(kind), -1);
+    removeVehicleAt(lot, vehicleIndex);
+}
+
+// Vehicles in the lot's rows. Caller holds every store (lockStore) or is
+// the only thread.
+int storedVehicles(const ParkingManagement *lot) {
+    int stored = 0;
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        stored += lot->stores[i].vehicleCount;
+    return stored;
+}
+// ================================================
+
+// ================== BAY MAP =====================
+// Every slot is a physical bay with a number for guidance signage. Each
+// [type][tier] cell has an occupancy bitmap (bit set = occupied) and a
+// second bitmap with one bit per bitmap word, set while that word still
+// has a free bay, so the lowest free bay is two ctz scans. A type's bays
+// only change under its store lock (or during load), which keeps the choice
+// deterministic: journal replay puts every vehicle back in the bay it was
+// given.
+void resetBayMap(ParkingManagement *lot) {
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+            int bays = lot->bayCount[i][j];
+            int words = BAY_WORDS(bays);
+            uint64_t *bitmap = lot->bayWords + lot->bayWordStart[i][j];
+            uint64_t *freeWords = lot->bayFreeWords + lot->bayFreeWordStart[i][j];
+
+            memset(bitmap, 0, (size_t)words * sizeof(uint64_t));
+            memset(freeWords, 0, (size_t)BAY_WORDS(words) * sizeof(uint64_t));
+            // Bits past the last bay count as occupied so they are never handed out
+            if (bays % BAY_WORD_BITS)
+                bitmap[words - 1] = ~0ULL << (bays % BAY_WORD_BITS);
+            for (int w = 0; w < words; w++)
+                freeWords[w / BAY_WORD_BITS] |= 1ULL << (w % BAY_WORD_BITS);
+        }
+    }
+}
+
+// Takes preferredBayId if it belongs to the cell and is free, otherwise the
+// cell's lowest free bay. Returns the bay number, or 0 if the cell is full.
+int takeBay(ParkingManagement *lot, int vehicleType, int customerType, int preferredBayId) {
+    int start = lot->bayStart[vehicleType][customerType];
+    int bays = lot->bayCount[vehicleType][customerType];
+    uint64_t *bitmap = lot->bayWords + lot->bayWordStart[vehicleType][customerType];
+    uint64_t *freeWords = lot->bayFreeWords + lot->bayFreeWordStart[vehicleType][customerType];
+    int index = -1;
+
+    if (preferredBayId > start && preferredBayId <= start + bays) {
+        int preferred = preferredBayId - start - 1;
+        if (!(bitmap[preferred / BAY_WORD_BITS] >> (preferred % BAY_WORD_BITS) & 1))
+            index = preferred;
+    }
+    for (int f = 0; index < 0 && f < BAY_WORDS(BAY_WORDS(bays)); f++) {
+        if (freeWords[f]) {
+            int word = f * BAY_WORD_BITS + __builtin_ctzll(freeWords[f]);
+            index = word * BAY_WORD_BITS + __builtin_ctzll(~bitmap[word]);
+        }
+    }
+    if (index < 0)
+        return 0;
+
+    int word = index / BAY_WORD_BITS;
+    bitmap[word] |= 1ULL << (index % BAY_WORD_BITS);
+    if (bitmap[word] == ~0ULL)
+        freeWords[word / BAY_WORD_BITS] &= ~(1ULL << (word % BAY_WORD_BITS));
+    return start + index + 1;
+}
+
+void freeBay(ParkingManagement *lot, int vehicleType, int customerType, int bayId) {
+    int index = bayId - lot->bayStart[vehicleType][customerType] - 1;
+    if (index < 0 || index >= lot->bayCount[vehicleType][customerType])
+        return;
+
+    int word = index / BAY_WORD_BITS;
+    lot->bayWords[lot->bayWordStart[vehicleType][customerType] + word] &=
+        ~(1ULL << (index % BAY_WORD_BITS));
+    lot->bayFreeWords[lot->bayFreeWordStart[vehicleType][customerType] + word / BAY_WORD_BITS] |=
+        1ULL << (word % BAY_WORD_BITS);
+}
+
+int bayOccupied(const ParkingManagement *lot, int vehicleType, int customerType, int bayId) {
+    int index = bayId - lot->bayStart[vehicleType][customerType] - 1;
+    if (index < 0 || index >= lot->bayCount[vehicleType][customerType])
+        return 0;
+    uint64_t word = lot->bayWords[lot->bayWordStart[vehicleType][customerType] + index / BAY_WORD_BITS];
+    return (int)(word >> (index % BAY_WORD_BITS) & 1);
+}
+
+// Length of the run of equally occupied bays starting at bitmap index
+// index, found a word at a time.
+static int bayRunLength(const uint64_t *bitmap, int index, int bays) {
+    int occupied = (int)(bitmap[index / BAY_WORD_BITS] >> (index % BAY_WORD_BITS) & 1);
+    int run = 0;
+
+    while (index + run < bays) {
+        int bit = (index + run) % BAY_WORD_BITS;
+        uint64_t word = bitmap[(index + run) / BAY_WORD_BITS] >> bit;
+        if (occupied)
+            word = ~word;
+        int length = word ? __builtin_ctzll(word) : BAY_WORD_BITS - bit;
+        run += length;
+        if (length < BAY_WORD_BITS - bit)
+            break;
+    }
+    return run < bays - index ? run : bays - index;
+}
+// ================================================
+
+// ================== OVERSTAY ====================
+// A vehicle's deadline is its arrival time plus MAX_DWELL_HOURS of its
+// type. Each vehicle type tracks its own vehicles: those before their
+// deadline sit in a min-heap on it, so a tick with nothing due only looks
+// at the root. advanceOverstays moves the due ones to the type's overstay
+// list, which is what listOverstays returns: no scan of the parked
+// vehicles. The heap fills the type's part of overstayRows from the front
+// and the list from the back; together they never hold more than the
+// type's rows. overstaySlots[row] is the row's heap position, or -1 - its
+// list position once listed. Callers hold the type's store for writing.
+#define OVERSTAY_HEAP(lot, store) ((lot)->overstayRows + (store)->rowStart)
+#define OVERSTAY_LIST_ROW(lot, store, k) (OVERSTAY_HEAP(lot, store)[(store)->rowCount - 1 - (k)])
+
+static time_t overstayDeadline(const ParkingManagement *lot, int row) {
+    return lot->arrivalTimes[row] +
+           (time_t)MAX_DWELL_HOURS[KIND_VEHICLE_TYPE(lot->vehicleKinds[row])] * 3600;
+}
+
+static void placeOverstay(ParkingManagement *lot, int *heap, int position, int row) {
+    heap[position] = row;
+    lot->overstaySlots[row] = position;
+}
+
+static void siftOverstayUp(ParkingManagement *lot, VehicleStore *store, int position) {
+    int *heap = OVERSTAY_HEAP(lot, store);
+    int row = heap[position];
+    time_t deadline = overstayDeadline(lot, row);
+    while (position > 0) {
+        int parent = (position - 1) / 2;
+        if (overstayDeadline(lot, heap[parent]) <= deadline)
+            break;
+        placeOverstay(lot, heap, position, heap[parent]);
+        position = parent;
+    }
+    placeOverstay(lot, heap, position, row);
+}
+
+static void siftOverstayDown(ParkingManagement *lot, VehicleStore *store, int position) {
+    int *heap = OVERSTAY_HEAP(lot, store);
+    int row = heap[position];
+    time_t deadline = overstayDeadline(lot, row);
+    for (;;) {
+        int child = 2 * position + 1;
+        if (child >= store->overstayHeapCount)
+            break;
+        if (child + 1 < store->overstayHeapCount &&
+            overstayDeadline(lot, heap[child + 1]) < overstayDeadline(lot, heap[child]))
+            child++;
+        if (overstayDeadline(lot, heap[child]) >= deadline)
+            break;
+        placeOverstay(lot, heap, position, heap[child]);
+        position = child;
+    }
+    placeOverstay(lot, heap, position, row);
+}
+
+// Starts tracking a newly stored row. Arrivals come in roughly time order,
+// so the sift usually stops at once.
+void trackOverstay(ParkingManagement *lot, int vehicleIndex) {
+    VehicleStore *store = &lot->stores[KIND_VEHICLE_TYPE(lot->vehicleKinds[vehicleIndex])];
+    placeOverstay(lot, OVERSTAY_HEAP(lot, store), store->overstayHeapCount++, vehicleIndex);
+    siftOverstayUp(lot, store, store->overstayHeapCount - 1);
+}
+
+void untrackOverstay(ParkingManagement *lot, int vehicleIndex) {
+    VehicleStore *store = &lot->stores[KIND_VEHICLE_TYPE(lot->vehicleKinds[vehicleIndex])];
+    int *heap = OVERSTAY_HEAP(lot, store);
+    int slot = lot->overstaySlots[vehicleIndex];
+    if (slot >= 0) {
+        int last = heap[--store->overstayHeapCount];
+        if (slot < store->overstayHeapCount) {
+            placeOverstay(lot, heap, slot, last);
+            siftOverstayUp(lot, store, slot);
+            siftOverstayDown(lot, store, lot->overstaySlots[last]);
+        }
+    } else {
+        int k = -1 - slot;
+        int last = OVERSTAY_LIST_ROW(lot, store, --store->overstayListCount);
+        OVERSTAY_LIST_ROW(lot, store, k) = last;
+        lot->overstaySlots[last] = -1 - k;
+    }
+}
+
+// Lists every vehicle of the type whose deadline is before now. Returns how
+// many were newly listed; each vehicle is counted once.
+int advanceOverstays(ParkingManagement *lot, int vehicleType, time_t now) {
+    VehicleStore *store = &lot->stores[vehicleType];
+    int *heap = OVERSTAY_HEAP(lot, store);
+    int listed = 0;
+    while (store->overstayHeapCount > 0 && overstayDeadline(lot, heap[0]) < now) {
+        int row = heap[0];
+        int last = heap[--store->overstayHeapCount];
+        if (store->overstayHeapCount > 0) {
+            placeOverstay(lot, heap, 0, last);
+            siftOverstayDown(lot, store, 0);
+        }
+        int k = store->overstayListCount++;
+        OVERSTAY_LIST_ROW(lot, store, k) = row;
+        lot->overstaySlots[row] = -1 - k;
+        listed++;
+    }
+    return listed;
+}
+
+static int compareOverstayDeadlines(const void *a, const void *b) {
+    const Vehicle *x = a, *y = b;
+    time_t dx = x->arrivalTime + (time_t)MAX_DWELL_HOURS[x->vehicleType] * 3600;
+    time_t dy = y->arrivalTime + (time_t)MAX_DWELL_HOURS[y->vehicleType] * 3600;
+    if (dx != dy)
+        return (dx > dy) - (dx < dy);
+    return comparePlates(x->plate, y->plate);
+}
+
+// Brings the lot up to now and copies the maxVehicles overstaying vehicles
+// with the earliest deadlines into vehicles[], earliest first. Returns how
+// many vehicles are overstaying in total. Safe to call from any thread.
+int listOverstays(ParkingManagement *lot, time_t now, Vehicle *vehicles, int maxVehicles) {
+    int listed[VEHICLE_TYPE_COUNT];
+    int count = 0;
+    int copied = 0;
+    lockStore(lot, 1);
+    for (int t = 0; t < VEHICLE_TYPE_COUNT; t++) {
+        listed[t] = advanceOverstays(lot, t, now);
+        count += lot->stores[t].overstayListCount;
+    }
+    for (int t = 0; t < VEHICLE_TYPE_COUNT; t++) {
+        VehicleStore *store = &lot->stores[t];
+        for (int k = 0; k < store->overstayListCount; k++) {
+            if (count <= maxVehicles) {
+                getVehicleAt(lot, OVERSTAY_LIST_ROW(lot, store, k), &vehicles[copied++]);
+                continue;
+            }
+            if (maxVehicles <= 0)
+                break;
+            // Keep the earliest maxVehicles by insertion; meant for short lists
+            Vehicle v;
+            getVehicleAt(lot, OVERSTAY_LIST_ROW(lot, store, k), &v);
+            if (copied == maxVehicles &&
+                compareOverstayDeadlines(&v, &vehicles[copied - 1]) >= 0)
+                continue;
+            int i = copied < maxVehicles ? copied++ : copied - 1;
+            while (i > 0 && compareOverstayDeadlines(&v, &vehicles[i - 1]) < 0) {
+                vehicles[i] = vehicles[i - 1];
+                i--;
+            }
+            vehicles[i] = v;
+        }
+    }
+    unlockStore(lot);
+
+    for (int t = 0; t < VEHICLE_TYPE_COUNT; t++) {
+        if (!listed[t])
+            continue;
+        VehicleStore *store = &lot->stores[t];
+        lockLotMutex(lot, &store->statsLock);
+        store->stats.overstays += listed[t];
+        pthread_mutex_unlock(&store->statsLock);
+    }
+    if (count <= maxVehicles && copied > 1)
+        qsort(vehicles, (size_t)copied, sizeof(*vehicles), compareOverstayDeadlines);
+    return count;
+}
+
+void viewOverstays() {
+    time_t now = parkingClock();
+    // The list can grow between sizing it and copying it (gate threads,
+    // a later now); size it again until every vehicle fits
+    Vehicle *vehicles = NULL;
+    int allocated = 0;
+    int count = listOverstays(parking, now, NULL, 0);
+    while (count > allocated) {
+        Vehicle *grown = realloc(vehicles, count * sizeof(*vehicles));
+        if (!grown) {
+            printf("Out of memory.\n");
+            free(vehicles);
+            return;
+        }
+        vehicles = grown;
+        allocated = count;
+        count = listOverstays(parking, now, vehicles, allocated);
+    }
+
+    printf("\n+===================== Overstay Alerts =======================+\n");
+    printf("| %-14s | %-13s | %-7s | %-16s |\n",
+           "Vehicle Number", "Vehicle Type", "Bay", "Over Limit By");
+    printf("+-------------------------------------------------------------+\n");
+    for (int i = 0; i < count; i++) {
+        char plateText[VEHICLE_NUMBER_LENGTH];
+        long long over = (long long)difftime(now, vehicles[i].arrivalTime) -
+                         MAX_DWELL_HOURS[vehicles[i].vehicleType] * 3600LL;
+        printf("| %-14s | %-13s | %-7d | %5lld h %2lld min  |\n",
+               formatPlate(vehicles[i].plate, plateText), VehicleTypeNames[vehicles[i].vehicleType],
+               vehicles[i].bayId, over / 3600, over % 3600 / 60);
+    }
+    if (count == 0)
+        printf("| %-59s |\n", "No vehicle is over its maximum stay.");
+    printf("+=============================================================+\n");
+    free(vehicles);
+}
+// ================================================
+
+// ================== RESERVATIONS ================
+// Advance bookings. A booking holds one bay of its [type][tier] cell from
+// start to end. Holds are counted per cell in a segment tree over a ring of
+// RESERVATION_BUCKETS 15-minute buckets: a booking adds 1 to the buckets it
+// covers, and the most holds of any bucket in a window is a range maximum,
+// both O(log buckets) however many bookings there are. Bookings end within
+// RESERVATION_HORIZON_DAYS and live at most RESERVATION_GRACE_MINUTES past
+// their start, so the ring never holds two bookings in one bucket slot at
+// different times.
+// A window takes another booking while the cell's bookable share
+// (RESERVABLE_PERCENT of its bays) exceeds the holds of each of its
+// buckets; one starting within the lookahead must also fit in the bays free
+// now. Walk-ins leave free the most bays held within the lookahead
+// (heldSoon, see allocateSlot), so a holder arriving from one bucket before
+// its start until the grace period after it finds a bay and claims, that is
+// removes, its booking. A no-show's booking is released at that deadline.
+_Static_assert(RESERVATION_HORIZON_DAYS * 86400L + RESERVATION_GRACE_MINUTES * 60L +
+               2L * RESERVATION_BUCKET_SECONDS <= (long)RESERVATION_BUCKETS * RESERVATION_BUCKET_SECONDS,
+               "the bucket ring must span the booking horizon");
+
+static long reservationBucket(int64_t time) {
+    return (long)(time >= 0 ? time / RESERVATION_BUCKET_SECONDS
+                            : (time - RESERVATION_BUCKET_SECONDS + 1) / RESERVATION_BUCKET_SECONDS);
+}
+
+static int64_t reservationDeadline(const Reservation *reservation) {
+    int64_t grace = reservation->start + RESERVATION_GRACE_MINUTES * 60;
+    return grace < reservation->end ? grace : reservation->end;
+}
+
+static void applyHolds(ReservationBook *book, int vehicleType, int customerType, int node,
+                       int delta) {
+    book->heldMax[vehicleType][customerType][node] += delta;
+    if (node < RESERVATION_BUCKETS)
+        book->heldAdd[vehicleType][customerType][node] += delta;
+}
+
+// Recomputes the ancestors of node after a change below them
+static void pullHolds(ReservationBook *book, int vehicleType, int customerType, int node) {
+    int32_t *heldMax = book->heldMax[vehicleType][customerType];
+    const int32_t *heldAdd = book->heldAdd[vehicleType][customerType];
+    for (node >>= 1; node >= 1; node >>= 1) {
+        int32_t most = heldMax[2 * node] > heldMax[2 * node + 1] ? heldMax[2 * node]
+                                                                  : heldMax[2 * node + 1];
+        heldMax[node] = most + heldAdd[node];
+    }
+}
+
+// Pushes pending adds down the path to node, so node's heldMax is exact
+static void pushHolds(ReservationBook *book, int vehicleType, int customerType, int node) {
+    int32_t *heldAdd = book->heldAdd[vehicleType][customerType];
+    for (int shift = RESERVATION_BUCKET_BITS; shift > 0; shift--) {
+        int parent = node >> shift;
+        if (heldAdd[parent] != 0) {
+            applyHolds(book, vehicleType, customerType, 2 * parent, heldAdd[parent]);
+            applyHolds(book, vehicleType, customerType, 2 * parent + 1, heldAdd[parent]);
+            heldAdd[parent] = 0;
+        }
+    }
+}
+
+// Adds delta to ring positions [from, to)
+static void addHoldRange(ReservationBook *book, int vehicleType, int customerType,
+                         int from, int to, int delta) {
+    int left = from + RESERVATION_BUCKETS, right = to + RESERVATION_BUCKETS;
+    for (int l = left, r = right; l < r; l >>= 1, r >>= 1) {
+        if (l & 1) applyHolds(book, vehicleType, customerType, l++, delta);
+        if (r & 1) applyHolds(book, vehicleType, customerType, --r, delta);
+    }
+    pullHolds(book, vehicleType, customerType, left);
+    pullHolds(book, vehicleType, customerType, right - 1);
+}
+
+// Most holds of ring positions [from, to)
+static int maxHoldRange(ReservationBook *book, int vehicleType, int customerType,
+                        int from, int to) {
+    const int32_t *heldMax = book->heldMax[vehicleType][customerType];
+    int left = from + RESERVATION_BUCKETS, right = to + RESERVATION_BUCKETS;
+    pushHolds(book, vehicleType, customerType, left);
+    pushHolds(book, vehicleType, customerType, right - 1);
+    int most = 0;
+    for (int l = left, r = right; l < r; l >>= 1, r >>= 1) {
+        if (l & 1) {
+            if (heldMax[l] > most) most = heldMax[l];
+            l++;
+        }
+        if (r & 1) {
+            r--;
+            if (heldMax[r] > most) most = heldMax[r];
+        }
+    }
+    return most;
+}
+
+// The same over buckets first..last (absolute, at most a ring apart)
+static void addHolds(ReservationBook *book, int vehicleType, int customerType,
+                     long first, long last, int delta) {
+    int from = (int)(first & (RESERVATION_BUCKETS - 1)), to = (int)(last & (RESERVATION_BUCKETS - 1));
+    if (from <= to) {
+        addHoldRange(book, vehicleType, customerType, from, to + 1, delta);
+    } else {
+        addHoldRange(book, vehicleType, customerType, from, RESERVATION_BUCKETS, delta);
+        addHoldRange(book, vehicleType, customerType, 0, to + 1, delta);
+    }
+}
+
+static int maxHolds(ReservationBook *book, int vehicleType, int customerType,
+                    long first, long last) {
+    int from = (int)(first & (RESERVATION_BUCKETS - 1)), to = (int)(last & (RESERVATION_BUCKETS - 1));
+    if (from <= to)
+        return maxHoldRange(book, vehicleType, customerType, from, to + 1);
+    int head = maxHoldRange(book, vehicleType, customerType, from, RESERVATION_BUCKETS);
+    int tail = maxHoldRange(book, vehicleType, customerType, 0, to + 1);
+    return head > tail ? head : tail;
+}
+
+static void holdReservation(ReservationBook *book, const Reservation *reservation, int delta) {
+    addHolds(book, KIND_VEHICLE_TYPE(reservation->kind), KIND_CUSTOMER_TYPE(reservation->kind),
+             reservationBucket(reservation->start), reservationBucket(reservation->end - 1), delta);
+}
+
+// Index slot of plate's booking, or -1
+static int findReservationSlot(const ReservationBook *book, PlateKey plate) {
+    for (unsigned int pos = hashPlate(plate) & book->indexMask; ;
+         pos = (pos + 1) & book->indexMask) {
+        int number = book->index[pos];
+        if (number < 0)
+            return -1;
+        if (samePlate(book->reservations[number].plate, plate))
+            return (int)pos;
+    }
+}
+
+static void indexReservation(ReservationBook *book, int number) {
+    unsigned int pos = hashPlate(book->reservations[number].plate) & book->indexMask;
+    while (book->index[pos] >= 0)
+        pos = (pos + 1) & book->indexMask;
+    book->index[pos] = number;
+}
+
+// Empties index slot pos, moving later entries of its run back so that no
+// lookup stops early (no tombstones needed)
+static void unindexReservation(ReservationBook *book, unsigned int pos) {
+    for (unsigned int next = (pos + 1) & book->indexMask; book->index[next] >= 0;
+         next = (next + 1) & book->indexMask) {
+        unsigned int home = hashPlate(book->reservations[book->index[next]].plate) & book->indexMask;
+        // Move it back unless its home lies cyclically in (pos, next]
+        if (((next - home) & book->indexMask) >= ((next - pos) & book->indexMask)) {
+            book->index[pos] = book->index[next];
+            pos = next;
+        }
+    }
+    book->index[pos] = -1;
+}
+
+static int earlierDeadline(const ReservationBook *book, int a, int b) {
+    return reservationDeadline(&book->reservations[book->deadlines[a]]) <
+           reservationDeadline(&book->reservations[book->deadlines[b]]);
+}
+
+static void swapDeadlines(ReservationBook *book, int a, int b) {
+    int number = book->deadlines[a];
+    book->deadlines[a] = book->deadlines[b];
+    book->deadlines[b] = number;
+    book->reservations[book->deadlines[a]].heapSlot = a;
+    book->reservations[book->deadlines[b]].heapSlot = b;
+}
+
+static void siftDeadline(ReservationBook *book, int slot) {
+    while (slot > 0 && earlierDeadline(book, slot, (slot - 1) / 2)) {
+        swapDeadlines(book, slot, (slot - 1) / 2);
+        slot = (slot - 1) / 2;
+    }
+    for (;;) {
+        int child = 2 * slot + 1;
+        if (child >= book->count)
+            break;
+        if (child + 1 < book->count && earlierDeadline(book, child + 1, child))
+            child++;
+        if (!earlierDeadline(book, child, slot))
+            break;
+        swapDeadlines(book, slot, child);
+        slot = child;
+    }
+}
+
+// Empties the book (trees, index and heap) without freeing it
+static void clearReservationBook(ReservationBook *book) {
+    memset(book->heldMax, 0, sizeof(book->heldMax));
+    memset(book->heldAdd, 0, sizeof(book->heldAdd));
+    memset(book->index, 0xff, ((size_t)book->indexMask + 1) * sizeof(*book->index));
+    book->count = 0;
+    book->now = 0;
+    book->heldBucket = LONG_MIN;
+}
+
+// Carves a book for capacity bookings out of memory (see reservationBookBytes)
+ReservationBook *placeReservationBook(void *memory, int capacity) {
+    ReservationBook *book = memory;
+    unsigned int indexSize = nextPowerOfTwo(2 * (unsigned int)capacity);
+    book->reservations = (Reservation *)(book + 1);
+    book->deadlines = (int *)(book->reservations + capacity);
+    book->index = book->deadlines + capacity;
+    book->capacity = capacity;
+    book->indexMask = indexSize - 1;
+    book->fixed = 0;
+    clearReservationBook(book);
+    return book;
+}
+
+size_t reservationBookBytes(int capacity) {
+    return sizeof(ReservationBook) + (size_t)capacity * (sizeof(Reservation) + sizeof(int)) +
+           nextPowerOfTwo(2 * (unsigned int)capacity) * sizeof(int);
+}
+
+// Doubles a local book in place of the old one. Returns 0 or -1.
+static int growReservationBook(ParkingManagement *lot) {
+    ReservationBook *old = lot->reservations;
+    int capacity = old ? 2 * old->capacity : RESERVATION_INITIAL_CAPACITY;
+    if ((old && old->fixed) || capacity > INT_MAX / 4)
+        return -1;
+    ReservationBook *book = malloc(reservationBookBytes(capacity));
+    if (!book)
+        return -1;
+    placeReservationBook(book, capacity);
+    if (old) {
+        memcpy(book->heldMax, old->heldMax, sizeof(book->heldMax));
+        memcpy(book->heldAdd, old->heldAdd, sizeof(book->heldAdd));
+        memcpy(book->reservations, old->reservations, (size_t)old->count * sizeof(Reservation));
+        memcpy(book->deadlines, old->deadlines, (size_t)old->count * sizeof(int));
+        book->count = old->count;
+        book->now = old->now;
+        book->heldBucket = old->heldBucket;
+        for (int i = 0; i < book->count; i++)
+            indexReservation(book, i);
+        free(old);
+    }
+    lot->reservations = book;
+    return 0;
+}
+
+// Rebuilds trees, index and heap from the booking records, after a process
+// died holding reservationLock of a shared lot
+void rebuildReservationBook(ReservationBook *book) {
+    int count = book->count < 0 || book->count > book->capacity ? 0 : book->count;
+    int64_t now = book->now;
+    clearReservationBook(book);
+    book->now = now;
+    for (int i = 0; i < count; i++) {
+        Reservation *reservation = &book->reservations[i];
+        if (findReservationSlot(book, reservation->plate) >= 0 ||
+            reservation->end <= reservation->start ||
+            reservation->end - reservation->start > RESERVATION_MAX_HOURS * 3600)
+            continue;
+        book->reservations[book->count] = *reservation;
+        holdReservation(book, reservation, 1);
+        indexReservation(book, book->count);
+        book->deadlines[book->count] = book->count;
+        book->reservations[book->count].heapSlot = book->count;
+        book->count++;
+    }
+    for (int slot = book->count / 2 - 1; slot >= 0; slot--)
+        siftDeadline(book, slot);
+}
+
+static void refreshHeldSoon(ParkingManagement *lot, int vehicleType, int customerType) {
+    ReservationBook *book = lot->reservations;
+    long bucket = reservationBucket(book->now);
+    atomic_store(&lot->heldSoon[vehicleType][customerType],
+                 maxHolds(book, vehicleType, customerType, bucket,
+                          bucket + RESERVATION_LOOKAHEAD_BUCKETS - 1));
+}
+
+// Drops booking number, moving the last one into its place
+static void removeReservation(ParkingManagement *lot, int number) {
+    ReservationBook *book = lot->reservations;
+    Reservation *reservation = &book->reservations[number];
+    holdReservation(book, reservation, -1);
+    unindexReservation(book, (unsigned int)findReservationSlot(book, reservation->plate));
+
+    // The last heap entry takes its heap slot, the last record its row
+    int slot = reservation->heapSlot, last = book->count - 1;
+    swapDeadlines(book, slot, last);
+    if (number != last) {
+        int pos = findReservationSlot(book, book->reservations[last].plate);
+        book->index[pos] = number;
+        *reservation = book->reservations[last];
+        book->deadlines[reservation->heapSlot] = number;
+    }
+    book->count--;
+    atomic_store(&lot->bookingCount, book->count);
+    if (slot < book->count)
+        siftDeadline(book, slot);
+}
+
+// Moves the book's clock up to now: releases bookings past their deadline
+// and, in a new bucket, recomputes heldSoon. Caller holds reservationLock.
+void advanceReservations(ParkingManagement *lot, time_t now) {
+    ReservationBook *book = lot->reservations;
+    if ((int64_t)now > book->now)
+        book->now = (int64_t)now;
+    while (book->count > 0 &&
+           reservationDeadline(&book->reservations[book->deadlines[0]]) <= book->now) {
+        Reservation expired = book->reservations[book->deadlines[0]];
+        removeReservation(lot, book->deadlines[0]);
+        refreshHeldSoon(lot, KIND_VEHICLE_TYPE(expired.kind), KIND_CUSTOMER_TYPE(expired.kind));
+    }
+    if (reservationBucket(book->now) != book->heldBucket) {
+        book->heldBucket = reservationBucket(book->now);
+        for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+            for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++)
+                refreshHeldSoon(lot, i, j);
+    }
+}
+
+// Bays of cell [vehicleType][customerType] still bookable for all of
+// [start, end). Caller holds reservationLock and has advanced the book.
+static int bookableBays(ParkingManagement *lot, int vehicleType, int customerType,
+                        int64_t start, int64_t end) {
+    ReservationBook *book = lot->reservations;
+    const ParkingSlot *slot = &lot->slots[vehicleType][customerType];
+    long first = reservationBucket(start);
+    int bays = slotTotal(slot) * RESERVABLE_PERCENT / 100 -
+               maxHolds(book, vehicleType, customerType, first, reservationBucket(end - 1));
+    if (first < reservationBucket(book->now) + RESERVATION_LOOKAHEAD_BUCKETS) {
+        int freeNow = slotFree(slot) - atomic_load(&lot->heldSoon[vehicleType][customerType]);
+        if (freeNow < bays)
+            bays = freeNow;
+    }
+    return bays > 0 ? bays : 0;
+}
+
+static int validBookingWindow(const ReservationBook *book, int64_t start, int64_t end) {
+    return start < end && end - start <= RESERVATION_MAX_HOURS * 3600 &&
+           reservationBucket(start) >= reservationBucket(book->now) &&
+           end <= book->now + RESERVATION_HORIZON_DAYS * 86400LL;
+}
+
+// Creates the book on first use. Caller holds reservationLock.
+static int ensureReservationBook(ParkingManagement *lot) {
+    return lot->reservations || growReservationBook(lot) == 0 ? 0 : -1;
+}
+
+// Bays of the cell bookable for [start, end) as of now, or -1 if the window
+// cannot be booked at all (in the past, too long or too far ahead)
+int windowAvailability(ParkingManagement *lot, int vehicleType, int customerType,
+                       time_t start, time_t end, time_t now) {
+    if (!isValidVehicleKind(vehicleType, customerType))
+        return -1;
+    lockLotMutex(lot, &lot->reservationLock);
+    int bays = -1;
+    if (ensureReservationBook(lot) == 0) {
+        advanceReservations(lot, now);
+        if (validBookingWindow(lot->reservations, start, end))
+            bays = bookableBays(lot, vehicleType, customerType, start, end);
+    }
+    pthread_mutex_unlock(&lot->reservationLock);
+    return bays;
+}
+
+// Journals a booking: the timestamp is its start, and the four plate bytes
+// after the key hold its length in seconds.
+static void appendReservationJournal(ParkingManagement *lot, const Reservation *reservation) {
+    JournalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.op = JOURNAL_RESERVE;
+    record.vehicleType = KIND_VEHICLE_TYPE(reservation->kind);
+    record.customerType = KIND_CUSTOMER_TYPE(reservation->kind);
+    record.plateFormat = JOURNAL_PLATE_KEY;
+    memcpy(record.plate, &reservation->plate, sizeof(reservation->plate));
+    uint32_t seconds = (uint32_t)(reservation->end - reservation->start);
+    memcpy(record.plate + sizeof(PlateKey), &seconds, sizeof(seconds));
+    record.timestamp = reservation->start;
+    writeJournalRecord(lot, &record);
+}
+
+// Adds a booking without any checks but the book's capacity. Caller holds
+// reservationLock. Returns 0 or -1.
+static int insertReservation(ParkingManagement *lot, const Reservation *reservation) {
+    if (lot->reservations->count == lot->reservations->capacity && growReservationBook(lot) != 0)
+        return -1;
+    ReservationBook *book = lot->reservations;
+    int number = book->count++;
+    book->reservations[number] = *reservation;
+    book->reservations[number].heapSlot = number;
+    book->deadlines[number] = number;
+    indexReservation(book, number);
+    holdReservation(book, reservation, 1);
+    siftDeadline(book, number);
+    atomic_store(&lot->bookingCount, book->count);
+    refreshHeldSoon(lot, KIND_VEHICLE_TYPE(reservation->kind), KIND_CUSTOMER_TYPE(reservation->kind));
+    return 0;
+}
+
+// Books a bay of the vehicle's [vehicleType][customerType] cell for
+// [start, end), as requested at now. Returns PARK_OK, PARK_INVALID for a
+// bad kind, plate or window, PARK_DUPLICATE if the plate already has a
+// booking, PARK_NO_SLOT if the window is fully booked and PARK_FULL if the
+// book cannot grow.
+enum ParkResult reserveBay(ParkingManagement *lot, const Vehicle *vehicle, time_t start,
+                           time_t end, time_t now) {
+    if (!isValidVehicleKind(vehicle->vehicleType, vehicle->customerType) ||
+        !isValidPlate(vehicle->plate))
+        return PARK_INVALID;
+    Reservation reservation = {vehicle->plate, (int64_t)start, (int64_t)end,
+                               VEHICLE_KIND(vehicle->vehicleType, vehicle->customerType), 0};
+
+    enum ParkResult result = PARK_OK;
+    lockLotMutex(lot, &lot->reservationLock);
+    if (ensureReservationBook(lot) != 0) {
+        result = PARK_FULL;
+    } else {
+        advanceReservations(lot, now);
+        if (!validBookingWindow(lot->reservations, start, end))
+            result = PARK_INVALID;
+        else if (findReservationSlot(lot->reservations, vehicle->plate) >= 0)
+            result = PARK_DUPLICATE;
+        else if (bookableBays(lot, vehicle->vehicleType, vehicle->customerType, start, end) < 1)
+            result = PARK_NO_SLOT;
+        else if (insertReservation(lot, &reservation) != 0)
+            result = PARK_FULL;
+        else
+            appendReservationJournal(lot, &reservation);
+    }
+    pthread_mutex_unlock(&lot->reservationLock);
+    return result;
+}
+
+static void appendCancelJournal(ParkingManagement *lot, PlateKey plate, time_t now) {
+    JournalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.op = JOURNAL_CANCEL;
+    record.plateFormat = JOURNAL_PLATE_KEY;
+    memcpy(record.plate, &plate, sizeof(plate));
+    record.timestamp = (int64_t)now;
+    writeJournalRecord(lot, &record);
+}
+
+// Drops plate's booking without journaling it. Caller holds reservationLock.
+// Returns 0, or -1 if it has none (any more).
+int dropReservation(ParkingManagement *lot, PlateKey plate, time_t now) {
+    if (!lot->reservations)
+        return -1;
+    advanceReservations(lot, now);
+    int pos = findReservationSlot(lot->reservations, plate);
+    if (pos < 0)
+        return -1;
+    Reservation cancelled = lot->reservations->reservations[lot->reservations->index[pos]];
+    removeReservation(lot, lot->reservations->index[pos]);
+    refreshHeldSoon(lot, KIND_VEHICLE_TYPE(cancelled.kind), KIND_CUSTOMER_TYPE(cancelled.kind));
+    return 0;
+}
+
+// Cancels plate's booking. Returns 0, or -1 if it has none (any more).
+int cancelReservation(ParkingManagement *lot, PlateKey plate, time_t now) {
+    lockLotMutex(lot, &lot->reservationLock);
+    int result = dropReservation(lot, plate, now);
+    if (result == 0)
+        appendCancelJournal(lot, plate, now);
+    pthread_mutex_unlock(&lot->reservationLock);
+    return result;
+}
+
+// As findBooking, without moving the booking clock. Caller holds
+// reservationLock.
+static int matchBooking(ParkingManagement *lot, PlateKey plate, int vehicleType,
+                        time_t arrivalTime, int claim) {
+    int pos = findReservationSlot(lot->reservations, plate);
+    if (pos < 0)
+        return -1;
+    int number = lot->reservations->index[pos];
+    Reservation booking = lot->reservations->reservations[number];
+    if ((int)KIND_VEHICLE_TYPE(booking.kind) != vehicleType ||
+        reservationBucket(arrivalTime) < reservationBucket(booking.start) - 1)
+        return -1;
+    int customerType = KIND_CUSTOMER_TYPE(booking.kind);
+    if (claim) {
+        removeReservation(lot, number);
+        refreshHeldSoon(lot, vehicleType, customerType);
+    }
+    return customerType;
+}
+
+// The customer type of plate's booking if a vehicleType arriving at
+// arrivalTime may use it, else -1. With claim set the booking is used up.
+int findBooking(ParkingManagement *lot, PlateKey plate, int vehicleType, time_t arrivalTime,
+                int claim) {
+    int customerType = -1;
+    lockLotMutex(lot, &lot->reservationLock);
+    if (lot->reservations) {
+        advanceReservations(lot, arrivalTime);
+        customerType = matchBooking(lot, plate, vehicleType, arrivalTime, claim);
+    }
+    pthread_mutex_unlock(&lot->reservationLock);
+    return customerType;
+}
+
+// Claims the booking of a journaled entry. The booking clock is left where
+// it is: a gate only moves it when it had bookings to look at, and a
+// follower that ran ahead of its leader's clock would expire bookings the
+// leader still holds (the leader's checksums carry its clock).
+void claimJournaledBooking(ParkingManagement *lot, PlateKey plate, int vehicleType,
+                           time_t arrivalTime) {
+    lockLotMutex(lot, &lot->reservationLock);
+    matchBooking(lot, plate, vehicleType, arrivalTime, 1);
+    pthread_mutex_unlock(&lot->reservationLock);
+}
+
+// Re-adds a journaled or snapshotted booking unless it has expired. A
+// plate's earlier booking is replaced: its gates had dropped it by then,
+// though this book's clock may not have caught up yet. Used while loading,
+// with no gate running, and by a follower (see REPLICATION).
+void restoreReservation(ParkingManagement *lot, const Reservation *reservation) {
+    if (reservation->end <= reservation->start ||
+        reservation->end - reservation->start > RESERVATION_MAX_HOURS * 3600 ||
+        !isValidVehicleKind(KIND_VEHICLE_TYPE(reservation->kind), KIND_CUSTOMER_TYPE(reservation->kind)) ||
+        !isValidPlate(reservation->plate) || ensureReservationBook(lot) != 0 ||
+        reservationDeadline(reservation) <= lot->reservations->now)
+        return;
+    int pos = findReservationSlot(lot->reservations, reservation->plate);
+    if (pos >= 0) {
+        Reservation earlier = lot->reservations->reservations[lot->reservations->index[pos]];
+        removeReservation(lot, lot->reservations->index[pos]);
+        refreshHeldSoon(lot, KIND_VEHICLE_TYPE(earlier.kind), KIND_CUSTOMER_TYPE(earlier.kind));
+    }
+    insertReservation(lot, reservation);
+}
+
+// Drops every booking (before the lot is loaded again)
+void clearReservations(ParkingManagement *lot) {
+    if (!lot->reservations)
+        return;
+    clearReservationBook(lot->reservations);
+    atomic_store(&lot->bookingCount, 0);
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++)
+            atomic_store(&lot->heldSoon[i][j], 0);
+}
+
+// Copies out every booking, for the snapshot. Caller holds reservationLock.
+int copyReservations(const ParkingManagement *lot, SnapshotReservation *records) {
+    const ReservationBook *book = lot->reservations;
+    for (int i = 0; book && i < book->count; i++) {
+        const Reservation *reservation = &book->reservations[i];
+        records[i] = (SnapshotReservation){reservation->plate.hi, reservation->plate.lo,
+                                           KIND_VEHICLE_TYPE(reservation->kind),
+                                           KIND_CUSTOMER_TYPE(reservation->kind), {0, 0},
+                                           (uint32_t)(reservation->end - reservation->start),
+                                           reservation->start};
+    }
+    return book ? book->count : 0;
+}
+
+// Reads a local start time and a length in hours. Returns 0, or -1 if
+// either does not parse.
+static int readBookingWindow(time_t *start, time_t *end) {
+    char text[64];
+    struct tm local;
+    int hours;
+    memset(&local, 0, sizeof(local));
+    printf("| %-40s: ", "Start (YYYY-MM-DD HH:MM)");
+    if (!fgets(text, sizeof(text), stdin) ||
+        sscanf(text, "%d-%d-%d %d:%d", &local.tm_year, &local.tm_mon, &local.tm_mday,
+               &local.tm_hour, &local.tm_min) != 5)
+        return -1;
+    local.tm_year -= 1900;
+    local.tm_mon -= 1;
+    local.tm_isdst = -1;
+    printf("| %-40s: ", "Length (hours)");
+    if (!fgets(text, sizeof(text), stdin) || sscanf(text, "%d", &hours) != 1 || hours < 1)
+        return -1;
+    *start = mktime(&local);
+    *end = *start + hours * 3600;
+    return *start == (time_t)-1 ? -1 : 0;
+}
+
+static void readVehicleKind(int *vehicleType, int *customerType) {
+    char text[32];
+    *vehicleType = *customerType = -1;
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        printf("|   (%d) %-33s |\n", i, VehicleTypeNames[i]);
+    printf("| %-40s: ", "Vehicle Type");
+    if (fgets(text, sizeof(text), stdin)) sscanf(text, "%d", vehicleType);
+    for (int i = 0; i < CUSTOMER_TYPE_COUNT; i++)
+        printf("|   (%d) %-33s |\n", i, CustomerTypeNames[i]);
+    printf("| %-40s: ", "Customer Type");
+    if (fgets(text, sizeof(text), stdin)) sscanf(text, "%d", customerType);
+}
+
+void manageReservations() {
+    char text[PLATE_INPUT_LENGTH], plateText[PLATE_INPUT_LENGTH];
+    int choice = -1;
+
+    do {
+        printf("\n+=================== Reservations ====================+\n");
+        printf("| Bookings outstanding: %-29d |\n", atomic_load(&parking->bookingCount));
+        printf("|   (1) %-45s |\n", "Check a window");
+        printf("|   (2) %-45s |\n", "Book a bay");
+        printf("|   (3) %-45s |\n", "Cancel a booking");
+        printf("|   (0) %-45s |\n", "Back to the Main Menu");
+        printf("| %-40s: ", "Enter Choice");
+        if (!fgets(text, sizeof(text), stdin) || sscanf(text, "%d", &choice) != 1)
+            continue;
+
+        Vehicle vehicle;
+        time_t start, end;
+        int vehicleType, customerType, bays;
+        switch (choice) {
+            case 1:
+                readVehicleKind(&vehicleType, &customerType);
+                if (readBookingWindow(&start, &end) != 0) {
+                    printf("| %-51s |\n", "Invalid start time or length.");
+                    break;
+                }
+                bays = windowAvailability(parking, vehicleType, customerType, start, end,
+                                              parkingClock());
+                if (bays < 0)
+                    printf("| %-51s |\n", "That window cannot be booked.");
+                else
+                    printf("| %-40s: %-10d |\n", "Bays bookable for the window", bays);
+                break;
+            case 2:
+                printf("| %-40s: ", "Vehicle Number");
+                if (!fgets(text, sizeof(text), stdin) || sscanf(text, "%63s", plateText) != 1 ||
+                    encodePlate(plateText, &vehicle.plate) != 0)
+                    vehicle.plate = (PlateKey){0, 0};
+                readVehicleKind(&vehicleType, &customerType);
+                if (readBookingWindow(&start, &end) != 0) {
+                    printf("| %-51s |\n", "Invalid start time or length.");
+                    break;
+                }
+                vehicle.vehicleType = vehicleType;
+                vehicle.customerType = customerType;
+                switch (reserveBay(parking, &vehicle, start, end, parkingClock())) {
+                    case PARK_OK:
+                        printf("| %-51s |\n", "Bay booked.");
+                        break;
+                    case PARK_DUPLICATE:
+                        printf("| %-51s |\n", "That vehicle already has a booking.");
+                        break;
+                    case PARK_INVALID:
+                        printf("| %-51s |\n", "Invalid vehicle, customer type or window.");
+                        break;
+                    default:
+                        printf("| %-51s |\n", "No bay can be booked for that window.");
+                }
+                break;
+            case 3:
+                printf("| %-40s: ", "Vehicle Number");
+                if (fgets(text, sizeof(text), stdin) && sscanf(text, "%63s", plateText) == 1 &&
+                    encodePlate(plateText, &vehicle.plate) == 0 &&
+                    cancelReservation(parking, vehicle.plate, parkingClock()) == 0)
+                    printf("| %-51s |\n", "Booking cancelled.");
+                else
+                    printf("| %-51s |\n", "No booking found for that vehicle.");
+                break;
+            case 0:
+                break;
+            default:
+                printf("| %-51s |\n", "Invalid choice. Please try again.");
+        }
+    } while (choice != 0);
+    printf("+=====================================================+\n");
+}
+// ================================================
+
+// ================== JOURNAL =====================
+// Every entry and exit is appended to the journal as one fixed-size record.
+// Records are written through to the OS immediately and fsync'ed in groups,
+// so a process crash loses nothing and a power loss at most one batch.
+void openJournal(ParkingManagement *lot) {
+    FILE **journal = journalHandle(lot);
+    *journal = fopen(lot->journalFileName, "ab");
+    if (!*journal) {
+        fprintf(stderr, "Warning: could not open %s, changes will not be journaled.\n",
+               lot->journalFileName);
+    }
+    lot->journalPending = 0;
+    lot->journalLastSync = time(NULL);
+}
+
+// Caller holds journalLock (or is the only thread).
+void syncJournal(ParkingManagement *lot) {
+    FILE *journal = *journalHandle(lot);
+    if (!journal || lot->journalPending == 0) return;
+
+    fflush(journal);
+    fsync(fileno(journal));
+    lot->journalPending = 0;
+    lot->journalLastSync = time(NULL);
+}
+
+// Called with the vehicle's plate and its type's store held, so the journal
+// keeps the order in which each store and each plate changed; replay needs
+// no more, as a type's bays only depend on that type's history.
+void appendJournal(ParkingManagement *lot, enum JournalOp op, const Vehicle *vehicle, time_t timestamp) {
+    JournalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.op = (uint8_t)op;
+    record.vehicleType = (uint8_t)vehicle->vehicleType;
+    record.customerType = (uint8_t)vehicle->customerType;
+    record.plateFormat = JOURNAL_PLATE_KEY;
+    memcpy(record.plate, &vehicle->plate, sizeof(vehicle->plate));
+    record.timestamp = (int64_t)timestamp;
+    writeJournalRecord(lot, &record);
+}
+
+void writeJournalRecord(ParkingManagement *lot, const JournalRecord *record) {
+    FILE *journal = *journalHandle(lot);
+    lockLotMutex(lot, &lot->journalLock);
+    if (journal) {
+        fwrite(record, sizeof(*record), 1, journal);
+        fflush(journal);
+        lot->journalPending++;
+        lot->journalRecords++;
+    }
+    if (replicationLeader)
+        replicateRecord(lot, record);
+    pthread_mutex_unlock(&lot->journalLock);
+}
+
+// Reads the plate of a journal record in either format. Returns 0, or -1
+// if the record holds no valid plate.
+int readJournalPlate(const JournalRecord *record, PlateKey *plate) {
+    _Static_assert(sizeof(record->plate) >= sizeof(PlateKey), "journal plate field too small");
+    if (record->plateFormat == JOURNAL_PLATE_KEY) {
+        memcpy(plate, record->plate, sizeof(*plate));
+        return isCanonicalPlate(*plate) ? 0 : -1;
+    }
+    if (record->plateFormat != JOURNAL_PLATE_TEXT) return -1;
+
+    char text[sizeof(record->plate) + 1];
+    memcpy(text, record->plate, sizeof(record->plate));
+    text[sizeof(record->plate) - 1] = '\0';
+    return encodePlate(text, plate);
+}
+
+// Group commit and compaction, run after the store lock has been released so a
+// slow fsync or snapshot does not happen inside the store's critical section.
+void maintainJournal(ParkingManagement *lot) {
+    int compact = 0;
+
+    lockLotMutex(lot, &lot->journalLock);
+    if (lot->journalPending >= JOURNAL_SYNC_BATCH ||
+        time(NULL) - lot->journalLastSync >= JOURNAL_SYNC_INTERVAL) {
+        syncJournal(lot);
+    }
+    if (lot->journalRecords >= JOURNAL_COMPACT_RECORDS && !lot->journalCompacting) {
+        lot->journalCompacting = 1;
+        compact = 1;
+    }
+    pthread_mutex_unlock(&lot->journalLock);
+
+    if (compact) {
+        writeSnapshot(lot);
+        lockLotMutex(lot, &lot->journalLock);
+        lot->journalCompacting = 0;
+        pthread_mutex_unlock(&lot->journalLock);
+    }
+}
+
+void closeJournal(ParkingManagement *lot) {
+    FILE **journal = journalHandle(lot);
+    if (!*journal) return;
+
+    syncJournal(lot);
+    fclose(*journal);
+    *journal = NULL;
+}
+
+// FNV-1a 64 checksum used to validate snapshot contents
+uint64_t checksumBytes(const void *data, size_t length) {
+    const unsigned char *bytes = data;
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Writes all parked vehicles to a temporary file, fsyncs it and renames it
+// over the previous snapshot, then truncates the journal it supersedes.
+static int writeSnapshotLocked(ParkingManagement *lot);
+
+// Holds every store for reading and reservationLock throughout, so no entry,
+// exit or booking can slip in between the snapshot and the journal truncation.
+int writeSnapshot(ParkingManagement *lot) {
+    lockStore(lot, 0);
+    lockLotMutex(lot, &lot->reservationLock);
+    int result = writeSnapshotLocked(lot);
+    pthread_mutex_unlock(&lot->reservationLock);
+    unlockStore(lot);
+
+    // Exits dropped from the journal are kept only by the archive
+    if (flushArchive(lot) != 0)
+        fprintf(stderr, "Warning: could not write the session archive of lot %d.\n", lot->lotId);
+    return result;
+}
+
+static int writeSnapshotLocked(ParkingManagement *lot) {
+    size_t bytes;
+    void *image = buildSnapshotImage(lot, &bytes);
+    int failed = !image || storeSnapshotImage(lot, image, bytes) != 0;
+    free(image);
+    if (failed)
+        return -1;
+    truncateJournal(lot);
+    return 0;
+}
+
+// Builds a lot's snapshot file image in one allocation: its arena as it is
+// (version 6, see MAPPED SNAPSHOTS) once its records would take at least
+// 1/SNAPSHOT_ARENA_SHARE of the arena, else its records. Caller holds every
+// store and reservationLock. Returns NULL when out of memory.
+void *buildSnapshotImage(const ParkingManagement *lot, size_t *bytes) {
+    size_t recordBytes = (size_t)storedVehicles(lot) * sizeof(SnapshotRecord);
+    if (recordBytes * SNAPSHOT_ARENA_SHARE >= lot->arenaBytes)
+        return buildArenaImage(lot, bytes);
+    return buildRecordImage(lot, bytes);
+}
+
+// Version 5 image: the header, the vehicles, then the bookings. Caller holds
+// every store and reservationLock. Returns NULL when out of memory.
+void *buildRecordImage(const ParkingManagement *lot, size_t *bytes) {
+    int reservationCount = lot->reservations ? lot->reservations->count : 0;
+    int vehicleCount = storedVehicles(lot);
+    size_t recordBytes = (size_t)vehicleCount * sizeof(SnapshotRecord) +
+                         (size_t)reservationCount * sizeof(SnapshotReservation);
+    SnapshotHeader *header = calloc(1, sizeof(SnapshotHeader) + recordBytes);
+    if (!header)
+        return NULL;
+
+    SnapshotRecord *records = (SnapshotRecord *)(header + 1);
+    SnapshotRecord *record = records;
+    for (int i = 0; i < lot->vehicleCapacity; i++) {
+        if (lot->vehicleKinds[i] == VEHICLE_KIND_EMPTY)
+            continue;
+        record->plateHi = lot->plateKeys[i].hi;
+        record->plateLo = lot->plateKeys[i].lo;
+        record->vehicleType = KIND_VEHICLE_TYPE(lot->vehicleKinds[i]);
+        record->customerType = KIND_CUSTOMER_TYPE(lot->vehicleKinds[i]);
+        record->arrivalTime = (int64_t)lot->arrivalTimes[i];
+        record->bayId = (uint32_t)(i + 1);
+        record++;
+    }
+    copyReservations(lot, (SnapshotReservation *)(records + vehicleCount));
+
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header->version = SNAPSHOT_RECORD_VERSION;
+    header->recordSize = sizeof(SnapshotRecord);
+    header->vehicleCount = (uint32_t)vehicleCount;
+    header->reservationCount = (uint32_t)reservationCount;
+    header->checksum = checksumBytes(records, recordBytes);
+    *bytes = sizeof(SnapshotHeader) + recordBytes;
+    return header;
+}
+
+// Writes a snapshot image to a temporary file, fsyncs it and renames it
+// over the lot's snapshot. Returns 0 or -1.
+int storeSnapshotImage(const ParkingManagement *lot, const void *image, size_t bytes) {
+    FILE *file = fopen(lot->snapshotTempFile, "wb");
+    if (!file) return -1;
+
+    int failed = fwrite(image, 1, bytes, file) != bytes;
+    failed |= fflush(file) != 0 || fsync(fileno(file)) != 0;
+    failed |= fclose(file) != 0;
+    if (failed || rename(lot->snapshotTempFile, lot->snapshotFile) != 0) {
+        remove(lot->snapshotTempFile);
+        return -1;
+    }
+    return 0;
+}
+
+// Empties the journal once a new snapshot covers everything journaled so
+// far. Other processes sharing the lot keep appending to their own
+// handles, which follow the truncated file since they were opened for append.
+void truncateJournal(ParkingManagement *lot) {
+    FILE **journal = journalHandle(lot);
+    lockLotMutex(lot, &lot->journalLock);
+    int reopen = *journal != NULL;
+    if (reopen) {
+        syncJournal(lot);
+        fclose(*journal);
+        *journal = NULL;
+    }
+    FILE *truncated = fopen(lot->journalFileName, "wb");
+    if (truncated) fclose(truncated);
+    lot->journalRecords = 0;
+    if (reopen) openJournal(lot);
+    pthread_mutex_unlock(&lot->journalLock);
+}
+// ================================================
+
+// ================== MAPPED SNAPSHOTS ============
+// A version 6 snapshot holds a lot's arena byte for byte (vehicle columns,
+// plate index, bay map, overstay heaps) with the counts that go with it, so
+// loading one maps the file copy-on-write and points the columns into it:
+// nothing is parsed or admitted, and only the header, the chunk checksums
+// and the bookings are read up front. The arena pages start inaccessible;
+// the first touch of each SNAPSHOT_CHUNK_BYTES chunk faults into
+// arenaFaultHandler, which checks the chunk against its checksum and opens
+// it. A chunk that fails ends the process, as the lot is already in use:
+// the snapshot is moved aside to <file>.corrupt, so a restart ignores it as
+// it would a snapshot found corrupt at load. Mapped arena memory must not
+// be handed to system calls, which fail on an unchecked page instead of
+// faulting; whatever saves or sends the arena copies it first. Shared lots
+// copy the arena into their segment instead, checking every chunk on the way.
+
+static MappedArena mappedArenas[MAX_LOTS];
+static pthread_mutex_t mappedArenaLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t arenaFaultHandlerOnce = PTHREAD_ONCE_INIT;
+static struct sigaction previousSegvAction, previousBusAction;
+
+static size_t arenaChunkCount(size_t arenaBytes) {
+    return (arenaBytes + SNAPSHOT_CHUNK_BYTES - 1) / SNAPSHOT_CHUNK_BYTES;
+}
+
+// Bytes of chunk in an arena of arenaBytes (the last one may be short)
+static size_t arenaChunkLength(size_t arenaBytes, size_t chunk) {
+    size_t rest = arenaBytes - chunk * SNAPSHOT_CHUNK_BYTES;
+    return rest < SNAPSHOT_CHUNK_BYTES ? rest : SNAPSHOT_CHUNK_BYTES;
+}
+
+// Where the arena starts in a version 6 image whose SnapshotArena, chunk
+// checksums and bookings take metaBytes
+static size_t arenaImageOffset(size_t metaBytes) {
+    size_t end = sizeof(SnapshotHeader) + metaBytes;
+    return (end + SNAPSHOT_ARENA_ALIGN - 1) / SNAPSHOT_ARENA_ALIGN * SNAPSHOT_ARENA_ALIGN;
+}
+
+// FNV-1a 64 over 64-bit words (a tail shorter than a word bytewise), for
+// arena chunks. Async-signal-safe.
+uint64_t checksumWords(const void *data, size_t length) {
+    const unsigned char *bytes = data;
+    uint64_t hash = 14695981039346656037ull;
+    size_t words = length / sizeof(uint64_t);
+    for (size_t i = 0; i < words; i++) {
+        uint64_t word;
+        memcpy(&word, bytes + i * sizeof(word), sizeof(word));
+        hash ^= word;
+        hash *= 1099511628211ull;
+    }
+    for (size_t i = words * sizeof(uint64_t); i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Checks one chunk of a mapped arena and opens it for writing, or waits
+// while another thread does. Async-signal-safe.
+static void checkArenaChunk(MappedArena *mapped, char *arena, size_t chunk) {
+    _Atomic unsigned char *state = &mapped->chunkStates[chunk];
+    unsigned char expected = ARENA_CHUNK_UNCHECKED;
+    if (!atomic_compare_exchange_strong(state, &expected, ARENA_CHUNK_CHECKING)) {
+        // Checked by now, or being checked: retrying the access is enough
+        struct timespec pause = {0, 100000};
+        while (atomic_load(state) != ARENA_CHUNK_CHECKED)
+            nanosleep(&pause, NULL);
+        return;
+    }
+
+    char *start = arena + chunk * SNAPSHOT_CHUNK_BYTES;
+    size_t guarded = mapped->guardedBytes - chunk * SNAPSHOT_CHUNK_BYTES;
+    if (guarded > SNAPSHOT_CHUNK_BYTES)
+        guarded = SNAPSHOT_CHUNK_BYTES;
+    // Read-only while it is checked, so a writer waits for the verdict
+    if (mprotect(start, guarded, PROT_READ) != 0) {
+        static const char failure[] = "Cannot open a mapped snapshot page.\n";
+        ssize_t ignored = write(STDERR_FILENO, failure, sizeof(failure) - 1);
+        (void)ignored;
+        _exit(EXIT_FAILURE);
+    }
+    if (checksumWords(start, arenaChunkLength(mapped->arenaBytes, chunk)) !=
+        mapped->checksums[chunk]) {
+        rename(mapped->snapshotFile, mapped->corruptFile);
+        ssize_t ignored = write(STDERR_FILENO, mapped->message, mapped->messageLength);
+        (void)ignored;
+        _exit(EXIT_FAILURE);
+    }
+    mprotect(start, guarded, PROT_READ | PROT_WRITE);
+    atomic_store(state, ARENA_CHUNK_CHECKED);
+}
+
+// SIGSEGV/SIGBUS handler: a fault in a mapped arena checks the chunk and
+// returns, which retries the access. Any other fault goes to the previous
+// action, by default ending the process as it would have anyway.
+static void arenaFaultHandler(int signal, siginfo_t *info, void *context) {
+    (void)context;
+    char *address = info->si_addr;
+    for (int i = 0; i < MAX_LOTS; i++) {
+        MappedArena *mapped = &mappedArenas[i];
+        char *arena = atomic_load(&mapped->arena);
+        if (arena && address >= arena && address < arena + mapped->guardedBytes) {
+            checkArenaChunk(mapped, arena, (size_t)(address - arena) / SNAPSHOT_CHUNK_BYTES);
+            return;
+        }
+    }
+    sigaction(signal, signal == SIGBUS ? &previousBusAction : &previousSegvAction, NULL);
+}
+
+static void installArenaFaultHandler() {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = arenaFaultHandler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, &previousSegvAction);
+    sigaction(SIGBUS, &action, &previousBusAction); // macOS reports protection faults as SIGBUS
+}
+
+// Registers a lot's arena, mapped at arena, with the fault handler and
+// makes its pages inaccessible until checked. Returns 0, or -1 if every
+// entry is taken or the pages cannot be protected.
+static int guardMappedArena(const ParkingManagement *lot, char *arena, const uint64_t *checksums) {
+    pthread_once(&arenaFaultHandlerOnce, installArenaFaultHandler);
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    _Atomic unsigned char *states = calloc(arenaChunkCount(lot->arenaBytes), sizeof(*states));
+    if (!states) return -1;
+
+    int result = -1;
+    pthread_mutex_lock(&mappedArenaLock);
+    for (int i = 0; i < MAX_LOTS; i++) {
+        MappedArena *mapped = &mappedArenas[i];
+        if (atomic_load(&mapped->arena))
+            continue;
+        mapped->arenaBytes = lot->arenaBytes;
+        mapped->guardedBytes = (lot->arenaBytes + page - 1) / page * page;
+        if (mprotect(arena, mapped->guardedBytes, PROT_NONE) != 0)
+            break;
+        mapped->checksums = checksums;
+        mapped->chunkStates = states;
+        snprintf(mapped->snapshotFile, sizeof(mapped->snapshotFile), "%s", lot->snapshotFile);
+        snprintf(mapped->corruptFile, sizeof(mapped->corruptFile), "%s%s",
+                 lot->snapshotFile, SNAPSHOT_CORRUPT_SUFFIX);
+        int length = snprintf(mapped->message, sizeof(mapped->message),
+                              "Lot %d: %s failed a checksum on first use; moved it to %s%s "
+                              "and stopped. A restart loads the lot without it.\n",
+                              lot->lotId, lot->snapshotFile, lot->snapshotFile,
+                              SNAPSHOT_CORRUPT_SUFFIX);
+        mapped->messageLength = length < 0 ? 0 : (size_t)length < sizeof(mapped->message) ?
+                                (size_t)length : sizeof(mapped->message) - 1;
+        atomic_store(&mapped->arena, arena);
+        result = 0;
+        break;
+    }
+    pthread_mutex_unlock(&mappedArenaLock);
+    if (result != 0)
+        free(states);
+    return result;
+}
+
+// Drops a lot's mapped arena and the snapshot mapping it lives in. Caller
+// holds the lot exclusively.
+void unmapArena(ParkingManagement *lot) {
+    pthread_mutex_lock(&mappedArenaLock);
+    for (int i = 0; i < MAX_LOTS; i++) {
+        MappedArena *mapped = &mappedArenas[i];
+        if (atomic_load(&mapped->arena) == (char *)lot->arena) {
+            atomic_store(&mapped->arena, NULL);
+            free(mapped->chunkStates);
+            mapped->chunkStates = NULL;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mappedArenaLock);
+    munmap(lot->arenaMap, lot->arenaMapBytes);
+    lot->arenaMap = NULL;
+    lot->arenaMapBytes = 0;
+}
+
+// Version 6 image: the header, the SnapshotArena, a checksum per arena
+// chunk, the bookings and, SNAPSHOT_ARENA_ALIGN-aligned, a copy of the
+// arena. Caller holds every store and reservationLock. Returns NULL when
+// out of memory.
+void *buildArenaImage(const ParkingManagement *lot, size_t *bytes) {
+    int reservationCount = lot->reservations ? lot->reservations->count : 0;
+    size_t chunks = arenaChunkCount(lot->arenaBytes);
+    size_t metaBytes = sizeof(SnapshotArena) + chunks * sizeof(uint64_t) +
+                       (size_t)reservationCount * sizeof(SnapshotReservation);
+    size_t arenaOffset = arenaImageOffset(metaBytes);
+    SnapshotHeader *header = calloc(1, arenaOffset + lot->arenaBytes);
+    if (!header)
+        return NULL;
+
+    SnapshotArena *layout = (SnapshotArena *)(header + 1);
+    uint64_t *checksums = (uint64_t *)(layout + 1);
+    char *arena = (char *)header + arenaOffset;
+    memcpy(arena, lot->arena, lot->arenaBytes);
+    for (size_t c = 0; c < chunks; c++)
+        checksums[c] = checksumWords(arena + c * SNAPSHOT_CHUNK_BYTES,
+                                     arenaChunkLength(lot->arenaBytes, c));
+    copyReservations(lot, (SnapshotReservation *)(checksums + chunks));
+
+    layout->arenaBytes = lot->arenaBytes;
+    layout->arenaOffset = arenaOffset;
+    for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++)
+        layout->quotaPercent[j] = lot->quotaPercent[j];
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        const VehicleStore *store = &lot->stores[i];
+        layout->capacities[i] = lot->capacities[i];
+        layout->vehicleCount[i] = store->vehicleCount;
+        layout->overstayHeapCount[i] = store->overstayHeapCount;
+        layout->overstayListCount[i] = store->overstayListCount;
+        // From the rows, not the slots: a gate may hold a slot it has not used yet
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+            const unsigned char *kinds = lot->vehicleKinds + lot->bayStart[i][j];
+            for (int k = 0; k < lot->bayCount[i][j]; k++)
+                layout->allocated[i][j] += kinds[k] != VEHICLE_KIND_EMPTY;
+        }
+    }
+
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header->version = SNAPSHOT_ARENA_VERSION;
+    header->recordSize = sizeof(SnapshotArena);
+    header->vehicleCount = (uint32_t)storedVehicles(lot);
+    header->reservationCount = (uint32_t)reservationCount;
+    header->checksum = checksumBytes(layout, metaBytes);
+    *bytes = arenaOffset + lot->arenaBytes;
+    return header;
+}
+
+// Whether a version 6 snapshot was taken of a lot laid out as this one and
+// its counts add up
+static int arenaSnapshotFits(const ParkingManagement *lot, const SnapshotArena *layout,
+                             uint32_t vehicleCount) {
+    for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+        if (layout->quotaPercent[j] != lot->quotaPercent[j])
+            return 0;
+    }
+    long total = 0;
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        int count = layout->vehicleCount[i];
+        int listed = layout->overstayListCount[i];
+        if (layout->capacities[i] != lot->capacities[i] ||
+            count < 0 || count > lot->stores[i].rowCount || listed < 0 || listed > count ||
+            layout->overstayHeapCount[i] != count - listed)
+            return 0;
+        long allocated = 0;
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+            if (layout->allocated[i][j] < 0 || layout->allocated[i][j] > lot->bayCount[i][j])
+                return 0;
+            allocated += layout->allocated[i][j];
+        }
+        if (allocated != count)
+            return 0;
+        total += count;
+    }
+    return total == (long)vehicleCount;
+}
+
+// Sets a lot's stores, slots, statistics and occupancy view from a version
+// 6 snapshot whose arena it now has
+static void applyArenaCounts(ParkingManagement *lot, const SnapshotArena *layout) {
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        VehicleStore *store = &lot->stores[i];
+        store->vehicleCount = layout->vehicleCount[i];
+        store->overstayHeapCount = layout->overstayHeapCount[i];
+        store->overstayListCount = layout->overstayListCount[i];
+        store->stats.occupied = store->vehicleCount;
+        store->stats.occupiedByType[i] = store->vehicleCount;
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+            ParkingSlot *slot = &lot->slots[i][j];
+            int allocated = layout->allocated[i][j];
+            atomic_store(&slot->counts, SLOT_COUNTS(allocated, slotTotal(slot) - allocated));
+            refreshLendingTier(lot, i, j);
+        }
+    }
+    resetOccupancyView(lot);
+}
+
+// Loads a version 6 snapshot from fd, size bytes long: validates the header,
+// layout, counts and the checksum over them, then takes the arena pages as
+// the lot's arena, unchecked. A shared lot (or one for which no mapped
+// arena entry is left) copies the arena into its own, checking every chunk
+// first. Caller holds the lot exclusively. Returns 0, or -1 if the snapshot
+// fails validation.
+int loadArenaSnapshot(ParkingManagement *lot, int fd, size_t size) {
+    if (size < sizeof(SnapshotHeader) + sizeof(SnapshotArena))
+        return -1;
+    char *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) return -1;
+
+    const SnapshotHeader *header = (const SnapshotHeader *)map;
+    const SnapshotArena *layout = (const SnapshotArena *)(header + 1);
+    size_t chunks = arenaChunkCount(lot->arenaBytes);
+    const uint64_t *checksums = (const uint64_t *)(layout + 1);
+    const SnapshotReservation *bookings = (const SnapshotReservation *)(checksums + chunks);
+    size_t metaBytes = sizeof(SnapshotArena) + chunks * sizeof(uint64_t) +
+                       (size_t)header->reservationCount * sizeof(SnapshotReservation);
+    size_t arenaOffset = arenaImageOffset(metaBytes);
+    int valid = header->recordSize == sizeof(SnapshotArena) &&
+                layout->arenaBytes == lot->arenaBytes &&
+                layout->arenaOffset == arenaOffset &&
+                size >= arenaOffset + lot->arenaBytes &&
+                checksumBytes(layout, metaBytes) == header->checksum &&
+                arenaSnapshotFits(lot, layout, header->vehicleCount);
+    if (!valid) {
+        munmap(map, size);
+        return -1;
+    }
+
+    char *arena = map + arenaOffset;
+    int mapped = !lot->shared && guardMappedArena(lot, arena, checksums) == 0;
+    if (mapped) {
+        if (lot->arenaMap)
+            unmapArena(lot);
+        else
+            free(lot->arena);
+        lot->arenaMap = map;
+        lot->arenaMapBytes = size;
+        placeArenaColumns(lot, arena);
+    } else {
+        for (size_t c = 0; c < chunks; c++) {
+            const char *chunk = arena + c * SNAPSHOT_CHUNK_BYTES;
+            size_t length = arenaChunkLength(lot->arenaBytes, c);
+            if (checksumWords(chunk, length) != checksums[c]) {
+                munmap(map, size);
+                return -1;
+            }
+            memcpy((char *)lot->arena + c * SNAPSHOT_CHUNK_BYTES, chunk, length);
+        }
+    }
+
+    applyArenaCounts(lot, layout);
+    restoreSnapshotBookings(lot, bookings, header->reservationCount);
+    if (!mapped)
+        munmap(map, size);
+    return 0;
+}
+// ================================================
+
+// ================== SHARED LOTS =================
+// With --shared <name> the lots live in the POSIX shared memory segment
+// /<name>, so several processes (batch runs, services) can work on the same
+// lots at once. The first process creates the segment from its own lot
+// configuration and loads the lot files into it; later ones check that their
+// configuration matches and map it. The segment is mapped at the same
+// address in every process, so the column pointers inside the lots are
+// valid everywhere as they are. All processes must run in the same directory,
+// as they share the lot files too.
+//
+// Every lock of a shared lot is a process-shared robust mutex. POSIX has no
+// robust rwlock, so every store and plate lookup serialises on
+// sharedStoreLock instead of the store and plate locks. Entries and
+// exits hold it until their statistics are updated, and rows are only
+// written under it, so when a process dies holding a lock the next process
+// to take the store rebuilds slots, bays, plate index, overstays and
+// occupancy from the vehicle rows (see recoverSharedStore).
+static char sharedLotsName[SHARED_NAME_LENGTH + 2];
+static FILE *sharedJournalFiles[MAX_LOTS]; // a FILE is only valid in its own process
+
+FILE **journalHandle(ParkingManagement *lot) {
+    return lot->shared ? &sharedJournalFiles[lot - lots] : &lot->journalFile;
+}
+
+// Called when a lock's previous owner died holding it: makes what the lock
+// guards usable again, or marks the store for a rebuild.
+static void repairAfterOwnerDied(ParkingManagement *lot, pthread_mutex_t *mutex) {
+    fprintf(stderr, "Warning: a process died holding a lock of lot %d, recovering.\n",
+            lot->lotId);
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        VehicleStore *store = &lot->stores[i];
+        if (mutex != &store->statsLock)
+            continue;
+        // The view may be half updated; the rebuild republishes it
+        unsigned long sequence = atomic_load(&store->occupancySequence);
+        if (sequence & 1)
+            atomic_store(&store->occupancySequence, sequence + 1);
+        atomic_store(&lot->storeDamaged, 1);
+        return;
+    }
+    if (mutex == &lot->journalLock) {
+        lot->journalCompacting = 0;
+    } else if (mutex == &lot->archiveLock) {
+        if (lot->archiveCount < 0 || lot->archiveCount > ARCHIVE_BLOCK_SESSIONS)
+            lot->archiveCount = 0;
+    } else if (mutex == &lot->reservationLock) {
+        // The next advance recomputes heldSoon from the rebuilt trees
+        rebuildReservationBook(lot->reservations);
+        atomic_store(&lot->bookingCount, lot->reservations->count);
+    } else {
+        atomic_store(&lot->storeDamaged, 1);
+    }
+}
+
+void lockLotMutex(ParkingManagement *lot, pthread_mutex_t *mutex) {
+    int error = pthread_mutex_lock(mutex);
+#ifdef __linux__
+    if (error == EOWNERDEAD) {
+        repairAfterOwnerDied(lot, mutex);
+        pthread_mutex_consistent(mutex);
+    }
+#else
+    (void)lot;
+    (void)error;
+#endif
+}
+
+// Rebuilds a shared lot from its vehicle rows, keeping every valid row whose
+// plate is not already in, and the statistics other than occupancy. A row
+// that was being inserted when its process died is lost, as the entry was
+// neither counted nor journaled. Caller holds sharedStoreLock.
+static void recoverSharedStore(ParkingManagement *lot) {
+    int count = 0;
+    for (int i = 0; i < lot->vehicleCapacity; i++)
+        count += lot->vehicleKinds[i] != VEHICLE_KIND_EMPTY;
+    Vehicle *rows = malloc((count ? count : 1) * sizeof(*rows));
+    if (!rows) {
+        fprintf(stderr, "Lot %d: out of memory, cannot rebuild it yet.\n", lot->lotId);
+        return;
+    }
+    count = 0;
+    for (int i = 0; i < lot->vehicleCapacity; i++) {
+        if (lot->vehicleKinds[i] != VEHICLE_KIND_EMPTY)
+            getVehicleAt(lot, i, &rows[count++]);
+    }
+
+    ParkingStatistics stats[VEHICLE_TYPE_COUNT];
+    time_t nextRebalance[VEHICLE_TYPE_COUNT];
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        lockLotMutex(lot, &lot->stores[i].statsLock);
+        stats[i] = lot->stores[i].stats;
+        stats[i].occupied = 0;
+        memset(stats[i].occupiedByType, 0, sizeof(stats[i].occupiedByType));
+        nextRebalance[i] = lot->stores[i].nextRebalance;
+    }
+    double arrivalRate[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT];
+    time_t arrivalRateTime[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT];
+    long invalidRejections = atomic_load(&lot->invalidRejections);
+    memcpy(arrivalRate, lot->arrivalRate, sizeof(arrivalRate));
+    memcpy(arrivalRateTime, lot->arrivalRateTime, sizeof(arrivalRateTime));
+    resetParking(lot);
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        lot->stores[i].stats = stats[i];
+        lot->stores[i].nextRebalance = nextRebalance[i];
+    }
+    memcpy(lot->arrivalRate, arrivalRate, sizeof(arrivalRate));
+    memcpy(lot->arrivalRateTime, arrivalRateTime, sizeof(arrivalRateTime));
+    atomic_store(&lot->invalidRejections, invalidRejections);
+
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (isValidVehicleKind(rows[i].vehicleType, rows[i].customerType) &&
+            isCanonicalPlate(rows[i].plate) && findVehicleIndex(lot, rows[i].plate) < 0 &&
+            admitVehicle(lot, &rows[i]) == 0)
+            kept++;
+    }
+    for (int i = VEHICLE_TYPE_COUNT - 1; i >= 0; i--)
+        pthread_mutex_unlock(&lot->stores[i].statsLock);
+    free(rows);
+
+    // A compaction the dead process had started is abandoned
+    lockLotMutex(lot, &lot->journalLock);
+    lot->journalCompacting = 0;
+    pthread_mutex_unlock(&lot->journalLock);
+
+    atomic_store(&lot->storeDamaged, 0);
+    fprintf(stderr, "Lot %d: rebuilt from its vehicle rows, %d of %d kept.\n",
+            lot->lotId, kept, count);
+}
+
+// Locks every vehicle type's store, in type order.
+void lockStore(ParkingManagement *lot, int exclusive) {
+    if (!lot->shared) {
+        for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+            if (exclusive)
+                pthread_rwlock_wrlock(&lot->stores[i].lock);
+            else
+                pthread_rwlock_rdlock(&lot->stores[i].lock);
+        }
+        return;
+    }
+    lockLotMutex(lot, &lot->sharedStoreLock);
+    if (atomic_load(&lot->storeDamaged))
+        recoverSharedStore(lot);
+}
+
+void unlockStore(ParkingManagement *lot) {
+    if (lot->shared) {
+        pthread_mutex_unlock(&lot->sharedStoreLock);
+        return;
+    }
+    for (int i = VEHICLE_TYPE_COUNT - 1; i >= 0; i--)
+        pthread_rwlock_unlock(&lot->stores[i].lock);
+}
+
+// Locks one vehicle type's store; on a shared lot, the lot's one store lock.
+void lockVehicleStore(ParkingManagement *lot, int vehicleType, int exclusive) {
+    if (lot->shared) {
+        lockStore(lot, exclusive);
+    } else if (exclusive) {
+        pthread_rwlock_wrlock(&lot->stores[vehicleType].lock);
+    } else {
+        pthread_rwlock_rdlock(&lot->stores[vehicleType].lock);
+    }
+}
+
+void unlockVehicleStore(ParkingManagement *lot, int vehicleType) {
+    if (lot->shared)
+        pthread_mutex_unlock(&lot->sharedStoreLock);
+    else
+        pthread_rwlock_unlock(&lot->stores[vehicleType].lock);
+}
+
+// Process-shared, and robust where the platform has robust mutexes (Linux).
+static int initSharedMutex(pthread_mutex_t *mutex) {
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    int error = pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+#ifdef __linux__
+    if (!error)
+        error = pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+#endif
+    if (!error)
+        error = pthread_mutex_init(mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+    return error;
+}
+
+static size_t sharedAlign(size_t bytes) {
+    return (bytes + 63) & ~(size_t)63;
+}
+
+// Identifies the lot configuration, so a process never maps lots that are
+// laid out differently from its own
+static uint64_t lotConfigChecksum() {
+    int config[MAX_LOTS][1 + VEHICLE_TYPE_COUNT + CUSTOMER_TYPE_COUNT];
+    for (int i = 0; i < lotCount; i++) {
+        config[i][0] = lots[i].lotId;
+        memcpy(&config[i][1], lots[i].capacities, sizeof(lots[i].capacities));
+        memcpy(&config[i][1 + VEHICLE_TYPE_COUNT], lots[i].quotaPercent,
+               sizeof(lots[i].quotaPercent));
+    }
+    return checksumBytes(config, (size_t)lotCount * sizeof(config[0]));
+}
+
+static void lockAttach(SharedLotsHeader *header) {
+    int error = pthread_mutex_lock(&header->attachLock);
+#ifdef __linux__
+    if (error == EOWNERDEAD)
+        pthread_mutex_consistent(&header->attachLock);
+#else
+    (void)error;
+#endif
+}
+
+// Adds pid to (or, with remove set, removes it from) the attached processes
+// and forgets processes that died. Returns how many remain, or -1 if there
+// is no room for pid.
+static int updateSharedProcesses(SharedLotsHeader *header, pid_t pid, int remove) {
+    int remaining = 0, added = remove;
+    for (int i = 0; i < MAX_SHARED_PROCESSES; i++) {
+        pid_t process = header->processes[i];
+        if (process == pid && remove) {
+            header->processes[i] = 0;
+        } else if (process != 0 && kill(process, 0) != 0 && errno == ESRCH) {
+            header->processes[i] = 0;
+        }
+        if (header->processes[i] == 0 && !added) {
+            header->processes[i] = pid;
+            added = 1;
+        }
+        remaining += header->processes[i] != 0;
+    }
+    return added ? remaining : -1;
+}
+
+// Moves the local lots into a new segment (fd, just created). Returns 0 or -1.
+static int sharedBookCapacity(const ParkingManagement *lot) {
+    return lot->vehicleCapacity * SHARED_RESERVATIONS_PER_BAY;
+}
+
+static int createSharedLots(int fd, int loadFiles) {
+    size_t size = sharedAlign(sizeof(SharedLotsHeader)) +
+                  sharedAlign((size_t)lotCount * sizeof(ParkingManagement));
+    for (int i = 0; i < lotCount; i++)
+        size += sharedAlign(lots[i].arenaBytes) +
+                sharedAlign(ARCHIVE_BLOCK_SESSIONS * sizeof(ArchiveSession)) +
+                sharedAlign(reservationBookBytes(sharedBookCapacity(&lots[i])));
+    void *base = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0)
+        base = mmap((void *)(uintptr_t)SHARED_LOTS_ADDRESS, size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Cannot map shared lots %s: %s\n", sharedLotsName, strerror(errno));
+        shm_unlink(sharedLotsName);
+        return -1;
+    }
+
+    SharedLotsHeader *header = base;
+    memcpy(header->magic, SHARED_LOTS_MAGIC, sizeof(SHARED_LOTS_MAGIC));
+    header->version = SHARED_LOTS_VERSION;
+    header->lotCount = (uint32_t)lotCount;
+    header->size = size;
+    header->address = (uint64_t)(uintptr_t)base;
+    header->configChecksum = lotConfigChecksum();
+    header->creator = getpid();
+    header->policyIndex = (int)(allocationPolicy - ALLOCATION_POLICIES);
+    header->policy = *allocationPolicy;
+    header->policy.name = NULL; // points into this process's image
+    initSharedMutex(&header->attachLock);
+
+    // Each lot keeps its layout; only the columns move
+    char *cursor = (char *)base + sharedAlign(sizeof(*header));
+    ParkingManagement *sharedLotArray = (ParkingManagement *)cursor;
+    cursor += sharedAlign((size_t)lotCount * sizeof(ParkingManagement));
+    for (int i = 0; i < lotCount; i++) {
+        ParkingManagement *local = &lots[i], *lot = &sharedLotArray[i];
+        *lot = *local;
+        memcpy(cursor, local->arena, local->arenaBytes);
+        placeArenaColumns(lot, cursor);
+        lot->arenaMap = NULL;
+        lot->arenaMapBytes = 0;
+        cursor += sharedAlign(local->arenaBytes);
+        lot->archiveSessions = (ArchiveSession *)cursor;
+        lot->archiveCount = 0;
+        cursor += sharedAlign(ARCHIVE_BLOCK_SESSIONS * sizeof(ArchiveSession));
+        // Bookings cannot grow into a new allocation here, so the book is fixed
+        lot->reservations = placeReservationBook(cursor, sharedBookCapacity(local));
+        lot->reservations->fixed = 1;
+        atomic_store(&lot->bookingCount, 0);
+        cursor += sharedAlign(reservationBookBytes(sharedBookCapacity(local)));
+        lot->policy = &header->policy;
+        lot->journalFile = NULL;
+        lot->shared = 1;
+        atomic_store(&lot->storeDamaged, 0);
+        initSharedMutex(&lot->sharedStoreLock);
+        initSharedMutex(&lot->journalLock);
+        for (int t = 0; t < VEHICLE_TYPE_COUNT; t++)
+            initSharedMutex(&lot->stores[t].statsLock);
+        initSharedMutex(&lot->archiveLock);
+        initSharedMutex(&lot->reservationLock);
+        freeParking(local);
+    }
+    free(lots);
+    lots = sharedLotArray;
+    sharedLots = header;
+
+    // No other process uses the lots before ready is set
+    for (int i = 0; loadFiles && i < lotCount; i++) {
+        loadParkingData(&lots[i]);
+        lots[i].archiving = 1;
+    }
+    updateSharedProcesses(header, getpid(), 0);
+    atomic_store_explicit(&header->ready, 1, memory_order_release);
+    return 0;
+}
+
+// Maps an existing segment over the local lots. Returns 0, -1, or 1 if the
+// segment is stale (its creator died before finishing it).
+static int openSharedLots(int fd, int loadFiles) {
+    SharedLotsHeader *header = MAP_FAILED;
+    struct stat status;
+    for (int waited = 0; ; waited++) {
+        if (header == MAP_FAILED && fstat(fd, &status) == 0 &&
+            (size_t)status.st_size >= sizeof(*header))
+            header = mmap(NULL, sizeof(*header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (header != MAP_FAILED && atomic_load_explicit(&header->ready, memory_order_acquire))
+            break;
+        int creatorDead = header != MAP_FAILED && header->creator > 0 &&
+                          kill(header->creator, 0) != 0 && errno == ESRCH;
+        if (creatorDead || (header == MAP_FAILED && waited >= SHARED_ATTACH_WAIT_MS)) {
+            if (header != MAP_FAILED) munmap(header, sizeof(*header));
+            close(fd);
+            return 1;
+        }
+        if (waited >= SHARED_ATTACH_WAIT_MS) {
+            fprintf(stderr, "Shared lots %s are still being loaded, giving up.\n", sharedLotsName);
+            munmap(header, sizeof(*header));
+            close(fd);
+            return -1;
+        }
+        struct timespec pause = {0, 1000000};
+        nanosleep(&pause, NULL);
+    }
+
+    void *address = (void *)(uintptr_t)header->address;
+    size_t size = (size_t)header->size;
+    const char *mismatch = NULL;
+    if (memcmp(header->magic, SHARED_LOTS_MAGIC, sizeof(SHARED_LOTS_MAGIC)) != 0 ||
+        header->version != SHARED_LOTS_VERSION || size != (size_t)status.st_size)
+        mismatch = "it is not a parking lots segment of this version";
+    else if (header->lotCount != (uint32_t)lotCount ||
+             header->configChecksum != lotConfigChecksum())
+        mismatch = "its lots are configured differently";
+    const AllocationPolicy *policy = &ALLOCATION_POLICIES[0];
+    if (!mismatch && header->policyIndex >= 0 &&
+        (size_t)header->policyIndex < ARRAY_COUNT(ALLOCATION_POLICIES))
+        policy = &ALLOCATION_POLICIES[header->policyIndex];
+    munmap(header, sizeof(*header));
+
+    void *base = MAP_FAILED;
+    if (!mismatch) {
+        base = mmap(address, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base != MAP_FAILED && base != address) {
+            munmap(base, size);
+            base = MAP_FAILED;
+            mismatch = "its address is taken in this process";
+        } else if (base == MAP_FAILED) {
+            mismatch = strerror(errno);
+        }
+    }
+    close(fd);
+    if (mismatch) {
+        fprintf(stderr, "Cannot use shared lots %s: %s.\n", sharedLotsName, mismatch);
+        return -1;
+    }
+
+    header = base;
+    lockAttach(header);
+    int attached = updateSharedProcesses(header, getpid(), 0);
+    pthread_mutex_unlock(&header->attachLock);
+    if (attached < 0) {
+        fprintf(stderr, "Shared lots %s already have %d processes.\n", sharedLotsName,
+                MAX_SHARED_PROCESSES);
+        munmap(base, size);
+        return -1;
+    }
+    if (policy != allocationPolicy)
+        fprintf(stderr, "Shared lots %s use the %s policy.\n", sharedLotsName, policy->name);
+    allocationPolicy = policy;
+
+    discardLots();
+    lotCount = (int)header->lotCount;
+    lots = (ParkingManagement *)((char *)base + sharedAlign(sizeof(*header)));
+    sharedLots = header;
+    for (int i = 0; loadFiles && i < lotCount; i++)
+        openJournal(&lots[i]);
+    return 0;
+}
+
+// Puts the lots into the shared memory segment /name, creating it from the
+// local lots (and, with loadFiles, the lot files) if it does not exist yet,
+// else mapping it in their place. Returns 0, or -1 with the local lots kept.
+int attachSharedLots(const char *name, int loadFiles) {
+    size_t length = strlen(name);
+    int valid = length > 0 && length <= SHARED_NAME_LENGTH;
+    for (size_t i = 0; i < length; i++)
+        valid &= (name[i] >= 'a' && name[i] <= 'z') || (name[i] >= 'A' && name[i] <= 'Z') ||
+                 (name[i] >= '0' && name[i] <= '9') || name[i] == '-' || name[i] == '_';
+    if (!valid) {
+        fprintf(stderr, "--shared needs a name of up to %d letters, digits, '-' and '_'.\n",
+                SHARED_NAME_LENGTH);
+        return -1;
+    }
+    snprintf(sharedLotsName, sizeof(sharedLotsName), "/%s", name);
+
+    for (int attempt = 0; attempt < 3; attempt++) {
+        int fd = shm_open(sharedLotsName, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd >= 0)
+            return createSharedLots(fd, loadFiles);
+        if (errno != EEXIST)
+            break;
+        fd = shm_open(sharedLotsName, O_RDWR, 0600);
+        if (fd < 0) {
+            if (errno == ENOENT)
+                continue; // its last process detached meanwhile
+            break;
+        }
+        int result = openSharedLots(fd, loadFiles);
+        if (result <= 0)
+            return result;
+        fprintf(stderr, "Removing stale shared lots %s.\n", sharedLotsName);
+        shm_unlink(sharedLotsName);
+    }
+    fprintf(stderr, "Cannot open shared lots %s: %s\n", sharedLotsName, strerror(errno));
+    return -1;
+}
+
+// Unmaps the shared lots. The last process to leave removes the segment,
+// snapshotting every lot first if save is set; the journals already hold
+// everything either way.
+void detachSharedLots(int save) {
+    if (!sharedLots)
+        return;
+    SharedLotsHeader *header = sharedLots;
+    for (int i = 0; i < lotCount; i++)
+        closeJournal(&lots[i]);
+
+    lockAttach(header);
+    if (updateSharedProcesses(header, getpid(), 1) == 0) {
+        for (int i = 0; save && i < lotCount; i++)
+            saveParkingData(&lots[i]);
+        shm_unlink(sharedLotsName);
+    }
+    pthread_mutex_unlock(&header->attachLock);
+
+    sharedLots = NULL;
+    lots = NULL;
+    lotCount = 0;
+    parking = NULL;
+    munmap(header, (size_t)header->size);
+}
+// ================================================
+
+// ================== REPLICATION =================
+// Hot standby. A leader (--leader <socket>) streams its change log to one
+// follower process (--follow <socket>) over a Unix domain socket: every
+// journal record (entries, exits, bookings) and every change of a lending
+// floor, as 48-byte ReplicationRecords. A new follower first gets a
+// snapshot image of each lot, then applies the stream as it arrives and
+// journals it to its own lot files, so it holds a durable copy a few
+// records behind the leader. Run it from another directory with the same
+// lot configuration. When the stream ends, because the leader exited or
+// died, the follower syncs its journals and carries on in the mode it was
+// started in. Every REPLICATION_CHECKSUM_MS, and when it stops, the leader
+// sends a checksum of each lot's state, which the follower checks against
+// its own at the same point of the stream.
+// Records are queued under the lot lock that orders them (journalLock, or
+// the type's statsLock for floors), so the stream keeps the journal's order. Gates
+// never wait for the follower: one a whole ring behind, or not reading for
+// REPLICATION_SEND_TIMEOUT_MS, is detached, and rejoins from fresh images
+// (see followLeader). The sender still never waits for a streaming lot's
+// locks: it only tries them for the periodic checksums, and comes back to
+// a busy lot on its next pass.
+
+static int64_t monotonicNanos() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Everything a lot's checksum covers stands still while these are held
+void lockLotState(ParkingManagement *lot) {
+    lockStore(lot, 0);
+    lockLotMutex(lot, &lot->reservationLock);
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        lockLotMutex(lot, &lot->stores[i].statsLock);
+}
+
+// lockLotState() if no lock is held elsewhere: 0, or -1 with nothing held.
+// Lots are never shared while leading.
+int tryLockLotState(ParkingManagement *lot) {
+    int stores = 0, statsLocks = 0, reserved = 0;
+    if (lot->shared)
+        return -1;
+    while (stores < VEHICLE_TYPE_COUNT &&
+           pthread_rwlock_tryrdlock(&lot->stores[stores].lock) == 0)
+        stores++;
+    if (stores == VEHICLE_TYPE_COUNT)
+        reserved = pthread_mutex_trylock(&lot->reservationLock) == 0;
+    while (reserved && statsLocks < VEHICLE_TYPE_COUNT &&
+           pthread_mutex_trylock(&lot->stores[statsLocks].statsLock) == 0)
+        statsLocks++;
+    if (statsLocks == VEHICLE_TYPE_COUNT)
+        return 0;
+
+    while (statsLocks > 0)
+        pthread_mutex_unlock(&lot->stores[--statsLocks].statsLock);
+    if (reserved)
+        pthread_mutex_unlock(&lot->reservationLock);
+    while (stores > 0)
+        pthread_rwlock_unlock(&lot->stores[--stores].lock);
+    return -1;
+}
+
+void unlockLotState(ParkingManagement *lot) {
+    for (int i = VEHICLE_TYPE_COUNT - 1; i >= 0; i--)
+        pthread_mutex_unlock(&lot->stores[i].statsLock);
+    pthread_mutex_unlock(&lot->reservationLock);
+    unlockStore(lot);
+}
+
+static uint64_t mixChecksum(uint64_t hash, uint64_t value) {
+    hash = (hash ^ value) * 0x9e3779b97f4a7c15ull;
+    return hash ^ (hash >> 29);
+}
+
+// The state a follower must reproduce: lending floors, parked vehicles with
+// their cells and bays, and bookings. Slot counts are left out, as a gate
+// takes its slot before it holds the store. Rows and bookings are summed,
+// so their order does not matter. Caller holds the lot state (lockLotState).
+uint64_t lotStateChecksum(const ParkingManagement *lot) {
+    uint64_t floors = 14695981039346656037ull, rows = 0, bookings = 0;
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++)
+            floors = mixChecksum(floors, (uint64_t)lot->lendFloor[i][j]);
+    }
+    for (int i = 0; i < lot->vehicleCapacity; i++) {
+        if (lot->vehicleKinds[i] == VEHICLE_KIND_EMPTY)
+            continue;
+        uint64_t row = mixChecksum(lot->plateKeys[i].hi, lot->plateKeys[i].lo);
+        row = mixChecksum(row, (uint64_t)lot->arrivalTimes[i]);
+        rows += mixChecksum(row, (uint64_t)lot->vehicleKinds[i] << 32 | (uint32_t)(i + 1));
+    }
+    const ReservationBook *book = lot->reservations;
+    for (int i = 0; book && i < book->count; i++) {
+        const Reservation *reservation = &book->reservations[i];
+        uint64_t booking = mixChecksum(reservation->plate.hi, reservation->plate.lo);
+        booking = mixChecksum(booking, (uint64_t)reservation->start);
+        bookings += mixChecksum(booking, (uint64_t)reservation->end << 8 | reservation->kind);
+    }
+    return mixChecksum(mixChecksum(floors, rows), bookings);
+}
+
+// Caller holds the lot state. The booking clock goes along, so the follower
+// expires the same bookings before comparing.
+static void checksumRecord(const ParkingManagement *lot, JournalRecord *record) {
+    memset(record, 0, sizeof(*record));
+    record->op = REPLICATION_CHECKSUM;
+    record->timestamp = lot->reservations ? lot->reservations->now : 0;
+    uint64_t checksum = lotStateChecksum(lot);
+    memcpy(record->plate, &checksum, sizeof(checksum));
+}
+
+static void floorsRecord(const ParkingManagement *lot, int vehicleType, JournalRecord *record) {
+    _Static_assert(CUSTOMER_TYPE_COUNT * sizeof(uint16_t) <= sizeof(record->plate),
+                   "lending floors must fit in a record");
+    uint16_t floors[CUSTOMER_TYPE_COUNT];
+    for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++)
+        floors[j] = (uint16_t)lot->lendFloor[vehicleType][j];
+    memset(record, 0, sizeof(*record));
+    record->op = REPLICATION_FLOORS;
+    record->vehicleType = (uint8_t)vehicleType;
+    memcpy(record->plate, floors, sizeof(floors));
+}
+
+// Caller holds leader->lock. The follower is a whole ring behind: stop
+// streaming to it instead of making gates wait. The sender closes its
+// socket and the follower comes back for fresh images.
+static void detachFollower(ReplicationLeader *leader) {
+    for (int i = 0; i < lotCount; i++)
+        atomic_store(&leader->streaming[i], 0);
+    if (!leader->lagging)
+        fprintf(stderr, "replication: follower %lu records behind, detached\n",
+                leader->head - leader->tail);
+    leader->lagging = 1;
+    pthread_cond_broadcast(&leader->space);
+    pthread_cond_signal(&leader->queued);
+}
+
+// Queues a record of lot lotIndex if that lot is streaming. With wait set
+// (only once gates have stopped) it waits for room in the ring; otherwise a
+// full ring detaches the follower.
+static void queueReplication(ReplicationLeader *leader, int lotIndex, const JournalRecord *record,
+                             int wait) {
+    int64_t now = monotonicNanos();
+    pthread_mutex_lock(&leader->lock);
+    while (wait && leader->head - leader->tail >= REPLICATION_RING_RECORDS &&
+           atomic_load(&leader->streaming[lotIndex]))
+        pthread_cond_wait(&leader->space, &leader->lock);
+    if (leader->head - leader->tail >= REPLICATION_RING_RECORDS &&
+        atomic_load(&leader->streaming[lotIndex])) {
+        detachFollower(leader);
+    } else if (atomic_load(&leader->streaming[lotIndex])) {
+        ReplicationRecord *queued = &leader->ring[leader->head++ % REPLICATION_RING_RECORDS];
+        queued->lotIndex = (uint32_t)lotIndex;
+        queued->sequence = ++leader->sequence;
+        queued->queuedNanos = now;
+        queued->record = *record;
+        if (leader->head - leader->tail == 1)
+            pthread_cond_signal(&leader->queued);
+    }
+    pthread_mutex_unlock(&leader->lock);
+}
+
+// Called with the lot's journalLock held, after the record is journaled
+void replicateRecord(ParkingManagement *lot, const JournalRecord *record) {
+    ReplicationLeader *leader = replicationLeader;
+    int lotIndex = (int)(lot - lots);
+    if (lotIndex >= 0 && lotIndex < lotCount &&
+        atomic_load_explicit(&leader->streaming[lotIndex], memory_order_relaxed))
+        queueReplication(leader, lotIndex, record, 0);
+}
+
+// Called with the type's statsLock held, after the floors were changed
+void replicateFloors(ParkingManagement *lot, int vehicleType) {
+    JournalRecord record;
+    floorsRecord(lot, vehicleType, &record);
+    replicateRecord(lot, &record);
+}
+
+// Queues a checksum of every streaming lot, taken with the lot state held
+// so it sits at the right place in the stream. Gates must have stopped.
+static void queueChecksums(ReplicationLeader *leader) {
+    for (int i = 0; i < lotCount; i++) {
+        if (!atomic_load(&leader->streaming[i]))
+            continue;
+        JournalRecord record;
+        lockLotState(&lots[i]);
+        checksumRecord(&lots[i], &record);
+        queueReplication(leader, i, &record, 1);
+        unlockLotState(&lots[i]);
+    }
+}
+
+// The sender's periodic checksums: queues those of the due lots whose state
+// it can take without waiting, as gates hold a lot's locks for a whole
+// entry or exit. Never waits for room either.
+static void queueDueChecksums(ReplicationLeader *leader) {
+    for (int i = 0; i < lotCount; i++) {
+        if (!leader->checksumDue[i] || !atomic_load(&leader->streaming[i]) ||
+            tryLockLotState(&lots[i]) != 0)
+            continue;
+        JournalRecord record;
+        checksumRecord(&lots[i], &record);
+        queueReplication(leader, i, &record, 0);
+        unlockLotState(&lots[i]);
+        leader->checksumDue[i] = 0;
+    }
+}
+
+// Fails with EAGAIN once the follower has not read for
+// REPLICATION_SEND_TIMEOUT_MS (SO_SNDTIMEO)
+static int sendAll(int fd, const void *data, size_t bytes) {
+    const char *cursor = data;
+    while (bytes > 0) {
+        ssize_t sent = write(fd, cursor, bytes);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        cursor += sent;
+        bytes -= (size_t)sent;
+    }
+    return 0;
+}
+
+// Sends a new follower the lot configuration, then each lot as a snapshot
+// image followed by its floors and a checksum. A lot starts streaming while
+// its state is held for the image, so the ring gets exactly the changes
+// made after it. Waiting for that state is safe: gates never wait for the
+// sender.
+static int bootstrapFollower(ReplicationLeader *leader, int fd) {
+    ReplicationRecord hello;
+    memset(&hello, 0, sizeof(hello));
+    hello.lotIndex = (uint32_t)lotCount;
+    hello.record.op = REPLICATION_HELLO;
+    hello.record.timestamp = (int64_t)lotConfigChecksum();
+    if (sendAll(fd, &hello, sizeof(hello)) != 0)
+        return -1;
+
+    for (int i = 0; i < lotCount; i++) {
+        ParkingManagement *lot = &lots[i];
+        ReplicationRecord records[2 + VEHICLE_TYPE_COUNT]; // image, floors, checksum
+        memset(records, 0, sizeof(records));
+        size_t bytes = 0;
+        lockLotState(lot);
+        void *image = buildSnapshotImage(lot, &bytes);
+        for (int t = 0; t < VEHICLE_TYPE_COUNT; t++)
+            floorsRecord(lot, t, &records[1 + t].record);
+        checksumRecord(lot, &records[1 + VEHICLE_TYPE_COUNT].record);
+        if (image)
+            atomic_store(&leader->streaming[i], 1);
+        unlockLotState(lot);
+        if (!image)
+            return -1;
+
+        for (size_t r = 0; r < ARRAY_COUNT(records); r++)
+            records[r].lotIndex = (uint32_t)i;
+        records[0].record.op = REPLICATION_SNAPSHOT;
+        records[0].record.timestamp = (int64_t)bytes;
+        int failed = sendAll(fd, &records[0], sizeof(records[0])) != 0 ||
+                     sendAll(fd, image, bytes) != 0 ||
+                     sendAll(fd, &records[1], sizeof(records) - sizeof(records[0])) != 0;
+        free(image);
+        if (failed)
+            return -1;
+    }
+    return 0;
+}
+
+// Stops streaming and forgets what was queued; a waiting stop goes on
+static void dropFollower(ReplicationLeader *leader) {
+    pthread_mutex_lock(&leader->lock);
+    for (int i = 0; i < lotCount; i++)
+        atomic_store(&leader->streaming[i], 0);
+    leader->tail = leader->head;
+    leader->lagging = 0;
+    pthread_cond_broadcast(&leader->space);
+    pthread_mutex_unlock(&leader->lock);
+    close(leader->follower);
+    leader->follower = -1;
+}
+
+// Accepts one follower at a time and sends it the ring, in batches, until
+// it goes away or the leader stops
+static void *runReplicationSender(void *arg) {
+    ReplicationLeader *leader = arg;
+    ReplicationRecord *batch = malloc(REPLICATION_SEND_RECORDS * sizeof(*batch));
+    int64_t lastChecksum = monotonicNanos();
+    while (batch) {
+        pthread_mutex_lock(&leader->lock);
+        int stopping = leader->stopping;
+        pthread_mutex_unlock(&leader->lock);
+
+        if (leader->follower < 0) {
+            if (stopping)
+                break;
+            struct pollfd waiting = {leader->listener, POLLIN, 0};
+            if (poll(&waiting, 1, 100) <= 0)
+                continue;
+            leader->follower = accept(leader->listener, NULL, NULL);
+            if (leader->follower < 0)
+                continue;
+            struct timeval timeout = {REPLICATION_SEND_TIMEOUT_MS / 1000,
+                                      REPLICATION_SEND_TIMEOUT_MS % 1000 * 1000};
+            setsockopt(leader->follower, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            if (bootstrapFollower(leader, leader->follower) != 0) {
+                fprintf(stderr, "replication: could not bring the follower up to date\n");
+                dropFollower(leader);
+                continue;
+            }
+            fprintf(stderr, "replication: follower attached\n");
+            lastChecksum = monotonicNanos();
+            continue;
+        }
+
+        pthread_mutex_lock(&leader->lock);
+        if (leader->lagging) {
+            pthread_mutex_unlock(&leader->lock);
+            dropFollower(leader);
+            continue;
+        }
+        if (leader->head == leader->tail && !leader->stopping) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += 100000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&leader->queued, &leader->lock, &deadline);
+        }
+        stopping = leader->stopping;
+        size_t count = 0;
+        while (count < REPLICATION_SEND_RECORDS && leader->tail + count < leader->head) {
+            batch[count] = leader->ring[(leader->tail + count) % REPLICATION_RING_RECORDS];
+            count++;
+        }
+        pthread_mutex_unlock(&leader->lock);
+
+        if (count > 0) {
+            if (sendAll(leader->follower, batch, count * sizeof(*batch)) != 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    fprintf(stderr, "replication: follower stopped reading, dropped\n");
+                else
+                    fprintf(stderr, "replication: follower gone\n");
+                dropFollower(leader);
+                continue;
+            }
+            pthread_mutex_lock(&leader->lock);
+            leader->tail += count;
+            pthread_cond_broadcast(&leader->space);
+            pthread_mutex_unlock(&leader->lock);
+        } else if (stopping) {
+            break; // everything sent, the final checksums included
+        }
+        if (!stopping && monotonicNanos() - lastChecksum >= REPLICATION_CHECKSUM_MS * 1000000LL) {
+            memset(leader->checksumDue, 1, (size_t)lotCount);
+            lastChecksum = monotonicNanos();
+        }
+        if (!stopping)
+            queueDueChecksums(leader);
+    }
+    free(batch);
+    return NULL;
+}
+
+// Starts leading on socketPath. Returns 0 or -1.
+int startReplication(const char *socketPath) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "replication: socket path too long\n");
+        return -1;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    ReplicationLeader *leader = calloc(1, sizeof(*leader));
+    if (leader)
+        leader->ring = malloc(REPLICATION_RING_RECORDS * sizeof(*leader->ring));
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath);
+    if (!leader || !leader->ring || listener < 0 ||
+        bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(listener, 1) != 0) {
+        fprintf(stderr, "replication: cannot listen on %s: %s\n", socketPath, strerror(errno));
+        if (listener >= 0) close(listener);
+        if (leader) free(leader->ring);
+        free(leader);
+        return -1;
+    }
+    pthread_mutex_init(&leader->lock, NULL);
+    pthread_cond_init(&leader->queued, NULL);
+    pthread_cond_init(&leader->space, NULL);
+    leader->listener = listener;
+    leader->follower = -1;
+    snprintf(leader->socketPath, sizeof(leader->socketPath), "%s", socketPath);
+    fprintf(stderr, "replication: leading on %s\n", socketPath);
+    signal(SIGPIPE, SIG_IGN); // a vanished follower must not kill the leader
+
+    replicationLeader = leader;
+    if (pthread_create(&leader->sender, NULL, runReplicationSender, leader) != 0) {
+        fprintf(stderr, "replication: cannot start the sender thread\n");
+        replicationLeader = NULL;
+        close(listener);
+        unlink(socketPath);
+        free(leader->ring);
+        free(leader);
+        return -1;
+    }
+    return 0;
+}
+
+// Sends the follower everything queued and a final checksum of every lot,
+// then ends the stream, upon which it takes over. Gates must have stopped.
+void stopReplication() {
+    ReplicationLeader *leader = replicationLeader;
+    if (!leader)
+        return;
+    queueChecksums(leader);
+    pthread_mutex_lock(&leader->lock);
+    leader->stopping = 1;
+    pthread_cond_signal(&leader->queued);
+    pthread_mutex_unlock(&leader->lock);
+    pthread_join(leader->sender, NULL);
+
+    // Listener first: a follower that finds it gone once the stream ends
+    // takes over instead of rejoining
+    replicationLeader = NULL;
+    close(leader->listener);
+    unlink(leader->socketPath);
+    if (leader->follower >= 0)
+        close(leader->follower);
+    pthread_cond_destroy(&leader->queued);
+    pthread_cond_destroy(&leader->space);
+    pthread_mutex_destroy(&leader->lock);
+    free(leader->ring);
+    free(leader);
+}
+
+// Tries for up to waitMs for the leader's socket to accept
+static int connectToLeader(const char *socketPath, int waitMs) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", socketPath);
+    for (int waited = 0; ; waited += 10) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0)
+            return fd;
+        if (fd >= 0) close(fd);
+        if (fd < 0 || waited >= waitMs)
+            return -1;
+        struct timespec pause = {0, 10000000};
+        nanosleep(&pause, NULL);
+    }
+}
+
+// Connects and reads the leader's hello. Returns the stream, or NULL if
+// there is no leader (reported when waitMs is not 0) or it has other lots.
+static FILE *openLeaderStream(const char *socketPath, int waitMs) {
+    int fd = connectToLeader(socketPath, waitMs);
+    FILE *stream = fd >= 0 ? fdopen(fd, "rb") : NULL;
+    if (!stream) {
+        if (waitMs)
+            fprintf(stderr, "follow: cannot connect to %s: %s\n", socketPath, strerror(errno));
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    ReplicationRecord hello;
+    if (fread(&hello, sizeof(hello), 1, stream) != 1 || hello.record.op != REPLICATION_HELLO ||
+        hello.lotIndex != (uint32_t)lotCount ||
+        (uint64_t)hello.record.timestamp != lotConfigChecksum()) {
+        fprintf(stderr, "follow: the leader on %s has other lots\n", socketPath);
+        fclose(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+// The leader's image becomes the lot's snapshot file, its journal is
+// emptied and the lot reloaded from it. Returns 0 or -1.
+static int installSnapshotImage(ParkingManagement *lot, const void *image, size_t bytes) {
+    if (storeSnapshotImage(lot, image, bytes) != 0)
+        return -1;
+    truncateJournal(lot);
+    resetParking(lot);
+    clearReservations(lot);
+    return loadSnapshot(lot);
+}
+
+static void applyFloors(ParkingManagement *lot, const JournalRecord *record) {
+    uint16_t floors[CUSTOMER_TYPE_COUNT];
+    if (record->vehicleType >= VEHICLE_TYPE_COUNT)
+        return;
+    memcpy(floors, record->plate, sizeof(floors));
+    VehicleStore *store = &lot->stores[record->vehicleType];
+    lockLotMutex(lot, &store->statsLock);
+    for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+        lot->lendFloor[record->vehicleType][j] = floors[j];
+        refreshLendingTier(lot, record->vehicleType, j);
+    }
+    pthread_mutex_unlock(&store->statsLock);
+}
+
+// Checks the leader's checksum against this copy, after expiring the
+// bookings the leader had expired. Returns 1 if they agree.
+static int checkReplica(ParkingManagement *lot, const JournalRecord *record) {
+    uint64_t expected;
+    memcpy(&expected, record->plate, sizeof(expected));
+    lockLotState(lot);
+    if (lot->reservations)
+        advanceReservations(lot, (time_t)record->timestamp);
+    uint64_t actual = lotStateChecksum(lot);
+    unlockLotState(lot);
+    return actual == expected;
+}
+
+// Applies the leader's stream until it ends
+static void applyLeaderStream(FILE *stream, FollowerReport *report) {
+    ReplicationRecord change;
+    uint32_t lastSequence = 0;
+    while (fread(&change, sizeof(change), 1, stream) == 1 && change.lotIndex < (uint32_t)lotCount) {
+        ParkingManagement *lot = &lots[change.lotIndex];
+        const JournalRecord *record = &change.record;
+        report->records++;
+        if (change.sequence) {
+            report->gaps += lastSequence && change.sequence != lastSequence + 1;
+            lastSequence = change.sequence;
+        }
+
+        if (record->op == REPLICATION_SNAPSHOT) {
+            size_t bytes = (size_t)record->timestamp;
+            void *image = malloc(bytes ? bytes : 1);
+            int received = image && fread(image, 1, bytes, stream) == bytes;
+            if (received && installSnapshotImage(lot, image, bytes) == 0)
+                report->bootstrapped++;
+            free(image);
+            if (!received)
+                break;
+        } else if (record->op == REPLICATION_FLOORS) {
+            applyFloors(lot, record);
+        } else if (record->op == REPLICATION_CHECKSUM) {
+            if (checkReplica(lot, record)) {
+                report->checksumsMatched++;
+            } else {
+                report->checksumsDiffered++;
+                fprintf(stderr, "Warning: lot %d differs from the leader's.\n", lot->lotId);
+            }
+        } else {
+            applyJournalRecord(lot, record);
+            writeJournalRecord(lot, record);
+            maintainJournal(lot);
+        }
+
+        if (change.sequence) {
+            struct timespec queued = {(time_t)(change.queuedNanos / 1000000000LL),
+                                      (long)(change.queuedNanos % 1000000000LL)};
+            recordTiming(TIMED_REPLICATE, &queued);
+        }
+    }
+}
+
+// Follows the leader on socketPath until its stream ends, then takes over.
+// A stream also ends when the leader detaches this follower for falling
+// behind; the leader still listens then, so the follower rejoins and gets
+// fresh images instead of taking over. A stopping leader closes its
+// listener before the stream. Returns 0 once taken over, or -1 if there
+// was no leader to follow.
+int followLeader(const char *socketPath, FollowerReport *report) {
+    memset(report, 0, sizeof(*report));
+    FILE *stream = openLeaderStream(socketPath, REPLICATION_CONNECT_WAIT_MS);
+    if (!stream)
+        return -1;
+    fprintf(stderr, "follow: following %s\n", socketPath);
+
+    struct timespec start;
+    for (;;) {
+        applyLeaderStream(stream, report);
+        startTiming(&start);
+        fclose(stream);
+        if (!(stream = openLeaderStream(socketPath, 0)))
+            break;
+        fprintf(stderr, "follow: detached by the leader, rejoining\n");
+        report->rejoins++;
+        report->bootstrapped = 0;
+    }
+
+    // The stream ended: make everything applied durable and take over
+    for (int i = 0; i < lotCount; i++) {
+        lockLotMutex(&lots[i], &lots[i].journalLock);
+        syncJournal(&lots[i]);
+        pthread_mutex_unlock(&lots[i].journalLock);
+    }
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    report->takeoverSeconds = (double)(end.tv_sec - start.tv_sec) +
+                              (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "follow: leader gone after %ld records; took over in %.2f ms "
+            "(%ld checksums matched, %ld differed, %ld records missing, %ld rejoins)\n",
+            report->records, report->takeoverSeconds * 1e3, report->checksumsMatched,
+            report->checksumsDiffered, report->gaps, report->rejoins);
+    if (report->bootstrapped < lotCount)
+        fprintf(stderr, "Warning: only %ld of %d lots were copied from the leader.\n",
+                report->bootstrapped, lotCount);
+    return 0;
+}
+// ================================================
+
+// ================== ARCHIVE =====================
+// Completed sessions, one file per UTC day of exit, each a sequence of
+// compressed column blocks (see ArchiveBlockHeader). A block holds at most
+// ARCHIVE_BLOCK_SESSIONS sessions of one day and is written whole, so a
+// torn block can only be the last one of a file and is ignored. Sessions
+// staged but not yet written are lost on a crash.
+static long dayOfTime(int64_t time) {
+    return (long)(time >= 0 ? time / 86400 : (time - 86399) / 86400);
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+static long daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long yearOfEra = year - era * 400;
+    long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+static void archiveFileName(const char *prefix, long day, char *name, size_t size) {
+    time_t time = (time_t)day * 86400;
+    struct tm utc;
+    char date[9];
+    gmtime_r(&time, &utc);
+    if (strftime(date, sizeof(date), "%Y%m%d", &utc) == 0)
+        date[0] = '\0';
+    snprintf(name, size, "%s%s.bin", prefix, date);
+}
+
+static size_t putVarint(uint8_t *out, uint64_t value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+static const uint8_t *getVarint(const uint8_t *in, const uint8_t *end, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && in < end; shift += 7) {
+        uint8_t byte = *in++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return in;
+        }
+    }
+    return NULL;
+}
+
+static uint64_t zigzagEncode(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t zigzagDecode(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// Encodes the staged sessions as one block and appends it to the day file.
+// Caller holds archiveLock.
+static int writeArchiveBlock(ParkingManagement *lot) {
+    const ArchiveSession *sessions = lot->archiveSessions;
+    int count = lot->archiveCount;
+    uint8_t *payload = malloc(ARCHIVE_MAX_PAYLOAD);
+    if (!payload) return -1;
+
+    ArchiveBlockHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+    header.version = ARCHIVE_VERSION;
+    header.sessionCount = (uint32_t)count;
+    header.firstExit = sessions[0].exitTime;
+    header.minArrival = sessions[0].arrivalTime;
+    header.maxExit = sessions[0].exitTime;
+
+    size_t length = 0;
+    for (int i = 0; i < count; i++) {
+        payload[length++] = sessions[i].kind;
+        if (sessions[i].arrivalTime < header.minArrival) header.minArrival = sessions[i].arrivalTime;
+        if (sessions[i].exitTime > header.maxExit) header.maxExit = sessions[i].exitTime;
+    }
+
+    // Fees repeat a lot (type x tier x hours), so most fit the dictionary
+    long long dictionary[ARCHIVE_DICTIONARY_SIZE];
+    uint8_t *indexes = payload + length + ARCHIVE_DICTIONARY_SIZE * 10;
+    size_t indexLength = 0;
+    int dictionarySize = 0;
+    for (int i = 0; i < count; i++) {
+        long long fee = sessions[i].payableCents;
+        int entry = 0;
+        while (entry < dictionarySize && dictionary[entry] != fee)
+            entry++;
+        if (entry == dictionarySize && dictionarySize < ARCHIVE_DICTIONARY_SIZE)
+            dictionary[dictionarySize++] = fee;
+        if (entry < dictionarySize) {
+            indexes[indexLength++] = (uint8_t)entry;
+        } else {
+            indexes[indexLength++] = ARCHIVE_DICTIONARY_SIZE;
+            indexLength += putVarint(indexes + indexLength, zigzagEncode(fee));
+        }
+    }
+    header.dictionarySize = (uint16_t)dictionarySize;
+    for (int entry = 0; entry < dictionarySize; entry++)
+        length += putVarint(payload + length, zigzagEncode(dictionary[entry]));
+    memmove(payload + length, indexes, indexLength);
+    length += indexLength;
+
+    int64_t previous = header.firstExit;
+    for (int i = 0; i < count; i++) {
+        length += putVarint(payload + length, zigzagEncode(sessions[i].exitTime - previous));
+        previous = sessions[i].exitTime;
+    }
+    for (int i = 0; i < count; i++) {
+        int64_t dwell = sessions[i].exitTime - sessions[i].arrivalTime;
+        length += putVarint(payload + length, (uint64_t)(dwell > 0 ? dwell : 0));
+    }
+    header.payloadBytes = (uint32_t)length;
+    header.checksum = checksumBytes(payload, length);
+
+    char name[LOT_FILE_NAME_LENGTH + 16];
+    archiveFileName(lot->archivePrefix, lot->archiveDay, name, sizeof(name));
+    FILE *file = fopen(name, "ab");
+    int failed = !file;
+    if (file) {
+        failed |= fwrite(&header, sizeof(header), 1, file) != 1;
+        failed |= fwrite(payload, 1, length, file) != length;
+        failed |= fflush(file) != 0 || fsync(fileno(file)) != 0;
+        failed |= fclose(file) != 0;
+    }
+    free(payload);
+    return failed ? -1 : 0;
+}
+
+static int flushArchiveLocked(ParkingManagement *lot) {
+    if (lot->archiveCount == 0)
+        return 0;
+    int result = writeArchiveBlock(lot);
+    lot->archiveCount = 0;
+    return result;
+}
+
+int flushArchive(ParkingManagement *lot) {
+    lockLotMutex(lot, &lot->archiveLock);
+    int result = flushArchiveLocked(lot);
+    pthread_mutex_unlock(&lot->archiveLock);
+    return result;
+}
+
+// Stages a completed session. The block is written when it is full or the
+// next session exits on another day, and on every snapshot.
+void archiveSession(ParkingManagement *lot, const Vehicle *vehicle, time_t exitTime,
+                    const Bill *bill) {
+    if (!lot->archiving)
+        return;
+    long day = dayOfTime(exitTime);
+
+    lockLotMutex(lot, &lot->archiveLock);
+    if (!lot->archiveSessions) {
+        lot->archiveSessions = malloc(ARCHIVE_BLOCK_SESSIONS * sizeof(ArchiveSession));
+        if (!lot->archiveSessions) {
+            pthread_mutex_unlock(&lot->archiveLock);
+            return;
+        }
+    }
+    if (lot->archiveCount == ARCHIVE_BLOCK_SESSIONS ||
+        (lot->archiveCount > 0 && day != lot->archiveDay)) {
+        if (flushArchiveLocked(lot) != 0)
+            fprintf(stderr, "Warning: could not write the session archive of lot %d.\n",
+                    lot->lotId);
+    }
+    lot->archiveDay = day;
+    ArchiveSession *session = &lot->archiveSessions[lot->archiveCount++];
+    session->arrivalTime = (int64_t)vehicle->arrivalTime;
+    session->exitTime = (int64_t)exitTime;
+    session->payableCents = bill->payableCents;
+    session->kind = (unsigned char)VEHICLE_KIND(vehicle->vehicleType, vehicle->customerType);
+    pthread_mutex_unlock(&lot->archiveLock);
+}
+
+// One decoded block. Queries reuse a single one, so memory stays bounded
+// whatever the size of the archive.
+typedef struct {
+    ArchiveBlockHeader header;
+    uint8_t payload[ARCHIVE_MAX_PAYLOAD];
+    unsigned char kinds[ARCHIVE_BLOCK_SESSIONS];
+    long long payableCents[ARCHIVE_BLOCK_SESSIONS];
+    int64_t exitTimes[ARCHIVE_BLOCK_SESSIONS];
+    int64_t arrivalTimes[ARCHIVE_BLOCK_SESSIONS];
+} ArchiveBlock;
+
+// Reads the next block header. Returns 0 at the end of the file or at a
+// torn or foreign block.
+static int readArchiveHeader(FILE *file, ArchiveBlockHeader *header) {
+    return fread(header, sizeof(*header), 1, file) == 1 &&
+           memcmp(header->magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) == 0 &&
+           header->version == ARCHIVE_VERSION &&
+           header->sessionCount <= ARCHIVE_BLOCK_SESSIONS &&
+           header->dictionarySize <= ARCHIVE_DICTIONARY_SIZE &&
+           header->payloadBytes <= ARCHIVE_MAX_PAYLOAD;
+}
+
+// Reads and decodes the payload after block->header: kinds and fees
+// always, exit and arrival times only if withTimes. Returns -1 if the
+// block is torn or corrupt.
+static int readArchivePayload(FILE *file, ArchiveBlock *block, int withTimes) {
+    const ArchiveBlockHeader *header = &block->header;
+    int count = (int)header->sessionCount;
+    if (fread(block->payload, 1, header->payloadBytes, file) != header->payloadBytes ||
+        checksumBytes(block->payload, header->payloadBytes) != header->checksum)
+        return -1;
+
+    const uint8_t *in = block->payload, *end = block->payload + header->payloadBytes;
+    if (end - in < count)
+        return -1;
+    memcpy(block->kinds, in, (size_t)count);
+    in += count;
+
+    long long dictionary[ARCHIVE_DICTIONARY_SIZE];
+    uint64_t value;
+    for (int entry = 0; entry < header->dictionarySize; entry++) {
+        if (!(in = getVarint(in, end, &value))) return -1;
+        dictionary[entry] = zigzagDecode(value);
+    }
+    for (int i = 0; i < count; i++) {
+        if (in >= end) return -1;
+        int entry = *in++;
+        if (entry < header->dictionarySize) {
+            block->payableCents[i] = dictionary[entry];
+        } else {
+            if (!(in = getVarint(in, end, &value))) return -1;
+            block->payableCents[i] = zigzagDecode(value);
+        }
+    }
+    if (!withTimes)
+        return 0;
+
+    int64_t exitTime = header->firstExit;
+    for (int i = 0; i < count; i++) {
+        if (!(in = getVarint(in, end, &value))) return -1;
+        exitTime += zigzagDecode(value);
+        block->exitTimes[i] = exitTime;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!(in = getVarint(in, end, &value))) return -1;
+        block->arrivalTimes[i] = block->exitTimes[i] - (int64_t)value;
+    }
+    return 0;
+}
+
+static int compareDays(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+// Finds the day files of prefix between firstDay and lastDay, sorted.
+// Returns the number found (*days is malloc'd) or -1.
+static int listArchiveDays(const char *prefix, long firstDay, long lastDay, long **days) {
+    char directory[LOT_FILE_NAME_LENGTH] = ".";
+    const char *base = strrchr(prefix, '/');
+    if (base) {
+        snprintf(directory, sizeof(directory), "%.*s", (int)(base - prefix), prefix);
+        base++;
+    } else {
+        base = prefix;
+    }
+    size_t baseLength = strlen(base);
+
+    DIR *dir = opendir(directory);
+    if (!dir) return -1;
+    int count = 0, capacity = 64;
+    *days = malloc(capacity * sizeof(long));
+    struct dirent *entry;
+    while (*days && (entry = readdir(dir))) {
+        int year, month, day;
+        char tail[8];
+        if (strncmp(entry->d_name, base, baseLength) != 0 ||
+            sscanf(entry->d_name + baseLength, "%4d%2d%2d%7s", &year, &month, &day, tail) != 4 ||
+            strcmp(tail, ".bin") != 0)
+            continue;
+        long number = daysFromCivil(year, month, day);
+        if (number < firstDay || number > lastDay)
+            continue;
+        if (count == capacity) {
+            long *grown = realloc(*days, 2 * capacity * sizeof(long));
+            if (!grown) {
+                free(*days);
+                *days = NULL;
+                break;
+            }
+            *days = grown;
+            capacity *= 2;
+        }
+        (*days)[count++] = number;
+    }
+    closedir(dir);
+    if (!*days) return -1;
+    qsort(*days, (size_t)count, sizeof(long), compareDays);
+    return count;
+}
+
+typedef struct {
+    long sessions[VEHICLE_TYPE_COUNT];
+    long long revenueCents[VEHICLE_TYPE_COUNT];
+} ArchiveRevenue;
+
+// Adds the sessions that exited between firstDay and lastDay (inclusive)
+// to *revenue. Only the kind and fee columns are decoded. Returns the
+// number of corrupt blocks skipped, or -1 if the archive cannot be read.
+int queryArchiveRevenue(const char *prefix, long firstDay, long lastDay, ArchiveRevenue *revenue) {
+    long *days;
+    int dayCount = listArchiveDays(prefix, firstDay, lastDay, &days);
+    ArchiveBlock *block = malloc(sizeof(ArchiveBlock));
+    if (dayCount < 0 || !block) {
+        if (dayCount >= 0) free(days);
+        free(block);
+        return -1;
+    }
+
+    int corrupt = 0;
+    for (int d = 0; d < dayCount; d++) {
+        char name[LOT_FILE_NAME_LENGTH + 16];
+        archiveFileName(prefix, days[d], name, sizeof(name));
+        FILE *file = fopen(name, "rb");
+        if (!file) continue;
+        while (readArchiveHeader(file, &block->header)) {
+            if (readArchivePayload(file, block, 0) != 0) {
+                corrupt++;
+                break;
+            }
+            for (uint32_t i = 0; i < block->header.sessionCount; i++) {
+                int type = KIND_VEHICLE_TYPE(block->kinds[i]);
+                if (type >= VEHICLE_TYPE_COUNT) continue;
+                revenue->sessions[type]++;
+                revenue->revenueCents[type] += block->payableCents[i];
+            }
+        }
+        fclose(file);
+    }
+    free(days);
+    free(block);
+    return corrupt;
+}
+
+// Adds the number of archived vehicles parked during each hour (UTC) from
+// firstDay to lastDay to parkedByHour[0 .. 24 * days). A vehicle counts
+// for every hour its stay overlaps. Sessions are filed by exit day, so
+// every later file is read too; blocks that start after the range are
+// skipped from their header. Memory grows with the range, not the archive.
+// Returns the number of corrupt blocks skipped, or -1.
+int queryArchiveOccupancy(const char *prefix, long firstDay, long lastDay, long *parkedByHour) {
+    long hours = (lastDay - firstDay + 1) * 24;
+    long *days;
+    int dayCount = listArchiveDays(prefix, firstDay, LONG_MAX, &days);
+    long *delta = calloc((size_t)hours + 1, sizeof(long));
+    ArchiveBlock *block = malloc(sizeof(ArchiveBlock));
+    if (dayCount < 0 || !delta || !block) {
+        if (dayCount >= 0) free(days);
+        free(delta);
+        free(block);
+        return -1;
+    }
+
+    int64_t rangeStart = (int64_t)firstDay * 86400;
+    int64_t rangeEnd = rangeStart + (int64_t)hours * 3600;
+    int corrupt = 0;
+    for (int d = 0; d < dayCount; d++) {
+        char name[LOT_FILE_NAME_LENGTH + 16];
+        archiveFileName(prefix, days[d], name, sizeof(name));
+        FILE *file = fopen(name, "rb");
+        if (!file) continue;
+        while (readArchiveHeader(file, &block->header)) {
+            if (block->header.minArrival >= rangeEnd || block->header.maxExit <= rangeStart) {
+                if (fseek(file, block->header.payloadBytes, SEEK_CUR) != 0) break;
+                continue;
+            }
+            if (readArchivePayload(file, block, 1) != 0) {
+                corrupt++;
+                break;
+            }
+            for (uint32_t i = 0; i < block->header.sessionCount; i++) {
+                int64_t from = block->arrivalTimes[i], to = block->exitTimes[i];
+                if (from < rangeStart) from = rangeStart;
+                if (to > rangeEnd) to = rangeEnd;
+                if (from >= to) continue;
+                delta[(from - rangeStart) / 3600]++;
+                delta[(to - rangeStart + 3599) / 3600]--;
+            }
+        }
+        fclose(file);
+    }
+
+    long parked = 0;
+    for (long h = 0; h < hours; h++) {
+        parked += delta[h];
+        parkedByHour[h] += parked;
+    }
+    free(days);
+    free(delta);
+    free(block);
+    return corrupt;
+}
+
+static int parseArchiveDate(const char *text, long *day) {
+    int year, month, date;
+    char extra;
+    if (sscanf(text, "%4d-%2d-%2d%c", &year, &month, &date, &extra) != 3 ||
+        month < 1 || month > 12 || date < 1 || date > 31)
+        return -1;
+    *day = daysFromCivil(year, month, date);
+    return 0;
+}
+
+static void formatArchiveDay(long day, char *text, size_t size) {
+    time_t time = (time_t)day * 86400;
+    struct tm utc;
+    gmtime_r(&time, &utc);
+    strftime(text, size, "%Y-%m-%d", &utc);
+}
+
+// ./main --query revenue|occupancy <from YYYY-MM-DD> <to YYYY-MM-DD> [lotId]
+// Without a lot id every configured lot is included.
+int runQuery(int argc, char *argv[]) {
+    long firstDay, lastDay;
+    int lotId = argc >= 4 ? atoi(argv[3]) : -1;
+    if (argc < 3 || (strcmp(argv[0], "revenue") != 0 && strcmp(argv[0], "occupancy") != 0) ||
+        parseArchiveDate(argv[1], &firstDay) != 0 || parseArchiveDate(argv[2], &lastDay) != 0 ||
+        lastDay < firstDay) {
+        fprintf(stderr, "usage: ./main --query revenue|occupancy <from YYYY-MM-DD> "
+                        "<to YYYY-MM-DD> [lotId]\n");
+        return 1;
+    }
+    if (lotId >= 0 && !findLot(lotId)) {
+        fprintf(stderr, "No lot %d\n", lotId);
+        return 1;
+    }
+
+    int revenueQuery = strcmp(argv[0], "revenue") == 0;
+    long hours = (lastDay - firstDay + 1) * 24;
+    ArchiveRevenue revenue;
+    memset(&revenue, 0, sizeof(revenue));
+    long *parkedByHour = revenueQuery ? NULL : calloc((size_t)hours, sizeof(long));
+    if (!revenueQuery && !parkedByHour)
+        return 1;
+    int corrupt = 0;
+    for (int i = 0; i < lotCount; i++) {
+        if (lotId >= 0 && lots[i].lotId != lotId)
+            continue;
+        int result = revenueQuery
+            ? queryArchiveRevenue(lots[i].archivePrefix, firstDay, lastDay, &revenue)
+            : queryArchiveOccupancy(lots[i].archivePrefix, firstDay, lastDay, parkedByHour);
+        if (result < 0) {
+            fprintf(stderr, "Cannot read the archive of lot %d\n", lots[i].lotId);
+            free(parkedByHour);
+            return 1;
+        }
+        corrupt += result;
+    }
+
+    if (revenueQuery) {
+        long sessions = 0;
+        long long total = 0;
+        printf("%-15s %10s %16s\n", "Vehicle Type", "Sessions", "Revenue (Rs)");
+        for (int t = 0; t < VEHICLE_TYPE_COUNT; t++) {
+            printf("%-15s %10ld %13lld.%02lld\n", VehicleTypeNames[t], revenue.sessions[t],
+                   revenue.revenueCents[t] / 100, revenue.revenueCents[t] % 100);
+            sessions += revenue.sessions[t];
+            total += revenue.revenueCents[t];
+        }
+        printf("%-15s %10ld %13lld.%02lld\n", "Total", sessions, total / 100, total % 100);
+    } else {
+        long peak[24] = {0}, peakDay[24] = {0};
+        for (long h = 0; h < hours; h++) {
+            if (parkedByHour[h] > peak[h % 24]) {
+                peak[h % 24] = parkedByHour[h];
+                peakDay[h % 24] = firstDay + h / 24;
+            }
+        }
+        printf("%-10s %12s  %s\n", "Hour (UTC)", "Peak parked", "First reached");
+        for (int h = 0; h < 24; h++) {
+            char date[16] = "-";
+            if (peak[h] > 0)
+                formatArchiveDay(peakDay[h], date, sizeof(date));
+            printf("%02d:00      %12ld  %s\n", h, peak[h], date);
+        }
+        free(parkedByHour);
+    }
+    if (corrupt)
+        fprintf(stderr, "%d damaged block(s) skipped\n", corrupt);
+    return 0;
+}
+// ================================================
+
+// ================== TIMINGS =====================
+void resetOperationTimings() {
+    for (int op = 0; op < TIMED_OPERATION_COUNT; op++) {
+        atomic_store(&operationTimers[op].count, 0);
+        atomic_store(&operationTimers[op].totalNanos, 0);
+        for (int b = 0; b < TIMING_BUCKETS; b++)
+            atomic_store(&operationTimers[op].buckets[b], 0);
+    }
+}
+
+void startTiming(struct timespec *start) {
+    clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+// Adds the time since *start to the operation's counters. Costs one clock
+// read and three uncontended atomic adds.
+void recordTiming(enum TimedOperation op, const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long long nanos = (end.tv_sec - start->tv_sec) * 1000000000LL + (end.tv_nsec - start->tv_nsec);
+    if (nanos < 0)
+        nanos = 0;
+    int bucket = nanos ? 64 - __builtin_clzll((unsigned long long)nanos) : 0;
+    if (bucket >= TIMING_BUCKETS)
+        bucket = TIMING_BUCKETS - 1;
+
+    OperationTimer *timer = &operationTimers[op];
+    atomic_fetch_add_explicit(&timer->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&timer->totalNanos, nanos, memory_order_relaxed);
+    atomic_fetch_add_explicit(&timer->buckets[bucket], 1, memory_order_relaxed);
+}
+
+static void formatNanos(char *text, size_t size, double nanos) {
+    if (nanos < 1e3)
+        snprintf(text, size, "%.0f ns", nanos);
+    else if (nanos < 1e6)
+        snprintf(text, size, "%.1f us", nanos / 1e3);
+    else if (nanos < 1e9)
+        snprintf(text, size, "%.1f ms", nanos / 1e6);
+    else
+        snprintf(text, size, "%.1f s", nanos / 1e9);
+}
+
+// Upper bound of the bucket holding the given percentile
+static double timingPercentile(const long buckets[TIMING_BUCKETS], long count, int percent) {
+    long rank = (count * percent + 99) / 100;
+    long seen = 0;
+    for (int b = 0; b < TIMING_BUCKETS; b++) {
+        seen += buckets[b];
+        if (seen >= rank)
+            return ldexp(1.0, b);
+    }
+    return ldexp(1.0, TIMING_BUCKETS - 1);
+}
+
+// Prints a summary row per operation, then the histogram of every
+// operation that has run. Percentiles are bucket upper bounds.
+void printOperationTimings(FILE *out) {
+    long buckets[TIMED_OPERATION_COUNT][TIMING_BUCKETS];
+    long counts[TIMED_OPERATION_COUNT];
+    long long totals[TIMED_OPERATION_COUNT];
+    for (int op = 0; op < TIMED_OPERATION_COUNT; op++) {
+        counts[op] = atomic_load_explicit(&operationTimers[op].count, memory_order_relaxed);
+        totals[op] = atomic_load_explicit(&operationTimers[op].totalNanos, memory_order_relaxed);
+        for (int b = 0; b < TIMING_BUCKETS; b++)
+            buckets[op][b] = atomic_load_explicit(&operationTimers[op].buckets[b],
+                                                  memory_order_relaxed);
+    }
+
+    fprintf(out, "\n+===================== Operation Timings =====================+\n");
+    fprintf(out, "| %-9s | %-9s | %-9s | %-9s | %-9s |\n",
+            "Operation", "Count", "Mean", "p50 <=", "p99 <=");
+    fprintf(out, "+-------------------------------------------------------------+\n");
+    for (int op = 0; op < TIMED_OPERATION_COUNT; op++) {
+        char mean[16] = "-", p50[16] = "-", p99[16] = "-";
+        if (counts[op] > 0) {
+            formatNanos(mean, sizeof(mean), (double)totals[op] / counts[op]);
+            formatNanos(p50, sizeof(p50), timingPercentile(buckets[op], counts[op], 50));
+            formatNanos(p99, sizeof(p99), timingPercentile(buckets[op], counts[op], 99));
+        }
+        fprintf(out, "| %-9s | %9ld | %9s | %9s | %9s |\n",
+                TimedOperationNames[op], counts[op], mean, p50, p99);
+    }
+
+    for (int op = 0; op < TIMED_OPERATION_COUNT; op++) {
+        if (counts[op] == 0)
+            continue;
+        long largest = 0;
+        int first = TIMING_BUCKETS, last = 0;
+        for (int b = 0; b < TIMING_BUCKETS; b++) {
+            if (buckets[op][b] == 0)
+                continue;
+            if (buckets[op][b] > largest) largest = buckets[op][b];
+            if (b < first) first = b;
+            last = b;
+        }
+        fprintf(out, "+-------------------------------------------------------------+\n");
+        fprintf(out, "| %-59s |\n", TimedOperationNames[op]);
+        for (int b = first; b <= last; b++) {
+            char bound[16];
+            formatNanos(bound, sizeof(bound), ldexp(1.0, b));
+            int width = (int)(buckets[op][b] * 36 / largest);
+            fprintf(out, "|   < %-9s %-36.*s %9ld |\n", bound, width,
+                    "####################################", buckets[op][b]);
+        }
+    }
+    fprintf(out, "+=============================================================+\n");
+}
+
+void viewOperationTimings() {
+    printOperationTimings(stdout);
+}
+// ================================================
+
+// void generateBill(Vehicle vehicle, time_t exitTime) {
+//     // Calculate parking duration
+//     double duration = difftime(exitTime, vehicle.arrivalTime) / 3600.0; // in hours
+//     int hours = (int)duration;
+//     int minutes = (int)((duration - hours) * 60);
+
+//     // Calculate fees
+//     int fee = FIRST_HOUR_FEE[vehicle.vehicleType];
+//     if (hours > 1) {
+//         fee += (hours - 1) * ADDITIONAL_HOUR_FEE[vehicle.vehicleType];
+//     }
+
+//     float discount = fee * DISCOUNTS[vehicle.customerType];
+//     float totalPayable = fee - discount;
+
+//     // Print the parking bill
+//     printf("\n+=================== Parking Bill ===================+\n");
+//     printf("| %-20s : %s\n", "Vehicle Number", vehicle.vehicleNumber);
+//     printf("| %-20s : %s\n", "Vehicle Type", VehicleTypeNames[vehicle.vehicleType]);
+//     printf("| %-20s : %s\n", "Customer Type", CustomerTypeNames[vehicle.customerType]);
+//     printf("| %-20s : %s", "Entered Time", ctime(&vehicle.arrivalTime));
+//     printf("| %-20s : %s", "Exit Time", ctime(&exitTime));
+//     printf("| %-20s : %d hours %d minutes\n", "Parking Duration", hours, minutes);
+//     printf("| %-20s : Rs %d.00\n", "Total Charge", fee);
+//     printf("| %-20s : Rs %.2f\n", "Discount", discount);
+//     printf("| %-20s : Rs %.2f\n", "Total Payable", totalPayable);
+//     printf("+====================================================+\n\n");
+// }
+
+// ================== TARIFF ======================
+// A tariff is read from TARIFF_FILE (defaults: the fee and discount tables
+// above) and compiled into per-hour lookup tables. Lines:
+//   grace <minutes>                                    sessions up to this long are free
+//   rate <vehicleType> <firstHour> <additionalHour> [dailyCap]     rupees
+//   band <fromHour> <toHour> <percent>                 local hours [from, to)
+//   discount <customerType> <percent>
+// installTariff() publishes a compiled tariff with one atomic exchange, so
+// a reload never leaves a bill looking at half-updated tables. Each billing
+// thread claims a TariffReader slot and announces the tariff it bills
+// against there; a retired tariff is freed once no slot announces it.
+static CompiledTariff builtinTariff;
+static TariffReader tariffReaders[MAX_TARIFF_READERS];
+static _Thread_local TariffReader *tariffReader = NULL;
+static pthread_key_t tariffReaderKey;
+static pthread_once_t tariffReaderOnce = PTHREAD_ONCE_INIT;
+static _Atomic int tariffReadersExhausted = 0;  // some thread reads unannounced: free nothing
+static pthread_mutex_t tariffInstallLock = PTHREAD_MUTEX_INITIALIZER;
+static CompiledTariff **retiredTariffs = NULL;
+static size_t retiredTariffCount = 0;
+static size_t retiredTariffCapacity = 0;
+static long freedTariffCount = 0;
+
+void defaultTariff(Tariff *tariff) {
+    memset(tariff, 0, sizeof(*tariff));
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        tariff->firstHourFee[i] = FIRST_HOUR_FEE[i];
+        tariff->additionalHourFee[i] = ADDITIONAL_HOUR_FEE[i];
+    }
+    for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++)
+        tariff->discountPercent[j] = DISCOUNT_PERCENT[j];
+}
+
+// Fills tariff from file on top of the defaults. Returns 0, or -1 after
+// reporting the first bad line (the caller keeps its current tariff).
+int parseTariff(FILE *file, const char *fileName, Tariff *tariff) {
+    defaultTariff(tariff);
+
+    char line[256];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        char key[16];
+        if (line[0] == '#' || sscanf(line, "%15s", key) != 1)
+            continue;
+
+        int a, b, c, d = 0;
+        int fields = 0;
+        int valid = 0;
+        if (strcmp(key, "grace") == 0) {
+            valid = sscanf(line, "%*s %d", &a) == 1 && a >= 0 && a < 24 * 60;
+            if (valid) tariff->graceMinutes = a;
+        } else if (strcmp(key, "rate") == 0) {
+            fields = sscanf(line, "%*s %d %d %d %d", &a, &b, &c, &d);
+            valid = fields >= 3 && a >= 0 && a < VEHICLE_TYPE_COUNT &&
+                    b >= 0 && c >= 0 && d >= 0 && b <= 100000 && c <= 100000;
+            if (valid) {
+                tariff->firstHourFee[a] = b;
+                tariff->additionalHourFee[a] = c;
+                tariff->dailyCap[a] = fields == 4 ? d : 0;
+            }
+        } else if (strcmp(key, "band") == 0) {
+            valid = sscanf(line, "%*s %d %d %d", &a, &b, &c) == 3 &&
+                    a >= 0 && a < 24 && b > a && b <= 24 && c >= 0 && c <= 1000 &&
+                    tariff->bandCount < MAX_TARIFF_BANDS;
+            if (valid)
+                tariff->bands[tariff->bandCount++] = (TariffBand){a, b, c};
+        } else if (strcmp(key, "discount") == 0) {
+            valid = sscanf(line, "%*s %d %d", &a, &b) == 2 &&
+                    a >= 0 && a < CUSTOMER_TYPE_COUNT && b >= 0 && b <= 100;
+            if (valid) tariff->discountPercent[a] = b;
+        }
+        if (!valid) {
+            fprintf(stderr, "%s:%d: invalid tariff line.\n", fileName, lineNumber);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Local time - UTC at when, in seconds
+static long utcOffsetAt(time_t when) {
+    struct tm local, utc;
+    localtime_r(&when, &local);
+    gmtime_r(&when, &utc);
+    long dayDelta = (local.tm_year - utc.tm_year) ? local.tm_year - utc.tm_year
+                                                  : local.tm_yday - utc.tm_yday;
+    return dayDelta * 86400L + (local.tm_hour - utc.tm_hour) * 3600L +
+           (local.tm_min - utc.tm_min) * 60L;
+}
+
+// Records the UTC offset changes within TARIFF_ZONE_YEARS of now: a daily
+// walk finds each change, a binary search its exact second. Stops early
+// (zoneEnd) if the zone changes more often than MAX_TARIFF_ZONE_SPANS.
+static void compileZoneSpans(CompiledTariff *compiled, time_t now) {
+    time_t from = now - TARIFF_ZONE_YEARS * 366L * 86400;
+    time_t until = now + TARIFF_ZONE_YEARS * 366L * 86400;
+    long offset = utcOffsetAt(from);
+    compiled->zoneStart[0] = from;
+    compiled->zoneOffset[0] = offset;
+    compiled->zoneSpans = 1;
+    compiled->zoneEnd = until;
+    for (time_t day = from; day < until; day += 86400) {
+        time_t next = day + 86400 < until ? day + 86400 : until;
+        long nextOffset = utcOffsetAt(next);
+        if (nextOffset == offset)
+            continue;
+        time_t low = day, high = next;  // offset at low, nextOffset at high
+        while (high - low > 1) {
+            time_t middle = low + (high - low) / 2;
+            if (utcOffsetAt(middle) == offset)
+                low = middle;
+            else
+                high = middle;
+        }
+        if (compiled->zoneSpans == MAX_TARIFF_ZONE_SPANS) {
+            compiled->zoneEnd = high;
+            return;
+        }
+        compiled->zoneStart[compiled->zoneSpans] = high;
+        compiled->zoneOffset[compiled->zoneSpans++] = utcOffsetAt(high);
+        offset = utcOffsetAt(high);
+        if (offset != nextOffset)
+            day = high - 86400 + 1;  // a second change the same day: walk on from high
+    }
+}
+
+// Local hour of day at arrivalTime under the tariff's zone spans
+static inline int localStartHour(const CompiledTariff *tariff, time_t arrivalTime) {
+    long offset;
+    if (arrivalTime < tariff->zoneStart[0] || arrivalTime >= tariff->zoneEnd) {
+        offset = utcOffsetAt(arrivalTime);
+    } else {
+        int low = 0, high = tariff->zoneSpans;  // last span starting at or before arrival
+        while (high - low > 1) {
+            int middle = (low + high) / 2;
+            if (tariff->zoneStart[middle] <= arrivalTime)
+                low = middle;
+            else
+                high = middle;
+        }
+        offset = tariff->zoneOffset[low];
+    }
+    long long local = ((long long)arrivalTime + offset) % 86400;
+    return (int)((local < 0 ? local + 86400 : local) / 3600);
+}
+
+void compileTariff(const Tariff *tariff, CompiledTariff *compiled) {
+    memset(compiled, 0, sizeof(*compiled));
+    compiled->graceSeconds = tariff->graceMinutes * 60;
+    compiled->banded = tariff->bandCount > 0;
+
+    // Later bands override earlier ones for the hours they share
+    int hourPercent[24];
+    for (int h = 0; h < 24; h++)
+        hourPercent[h] = 100;
+    for (int b = 0; b < tariff->bandCount; b++)
+        for (int h = tariff->bands[b].fromHour; h < tariff->bands[b].toHour; h++)
+            hourPercent[h] = tariff->bands[b].percent;
+
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        compiled->firstHourFee[i] = tariff->firstHourFee[i];
+        compiled->additionalHourFee[i] = tariff->additionalHourFee[i];
+        compiled->dailyCap[i] = tariff->dailyCap[i];
+    }
+    for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++)
+        compiled->payablePercent[j] = 100 - tariff->discountPercent[j];
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+            int cell = i * CUSTOMER_TYPE_COUNT + j;
+            compiled->firstHourCents[cell] =
+                (int64_t)tariff->firstHourFee[i] * compiled->payablePercent[j];
+            compiled->additionalHourCents[cell] =
+                (int64_t)tariff->additionalHourFee[i] * compiled->payablePercent[j];
+        }
+    }
+    if (!compiled->banded)
+        return;
+    compileZoneSpans(compiled, time(NULL));
+
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        for (int startHour = 0; startHour < 24; startHour++) {
+            int first = 0, next = 0;
+            for (int k = 0; k < TARIFF_BLOCK_HOURS; k++) {
+                int percent = hourPercent[(startHour + k) % 24];
+                int additional = (tariff->additionalHourFee[i] * percent + 50) / 100;
+                first += k == 0 ? (tariff->firstHourFee[i] * percent + 50) / 100 : additional;
+                next += additional;
+                int cap = tariff->dailyCap[i];
+                compiled->firstFee[i][startHour][k + 1] = cap && first > cap ? cap : first;
+                compiled->nextFee[i][startHour][k + 1] = cap && next > cap ? cap : next;
+            }
+            for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+                int64_t payablePercent = compiled->payablePercent[j];
+                for (int k = 0; k <= TARIFF_BLOCK_HOURS; k++) {
+                    compiled->firstPayableCents[i][j][startHour][k] =
+                        compiled->firstFee[i][startHour][k] * payablePercent;
+                    compiled->nextPayableCents[i][j][startHour][k] =
+                        compiled->nextFee[i][startHour][k] * payablePercent;
+                }
+            }
+        }
+    }
+}
+
+static void releaseTariffReader(void *slot) {
+    TariffReader *reader = slot;
+    atomic_store(&reader->inUse, NULL);
+    atomic_store(&reader->taken, 0);
+}
+
+static void createTariffReaderKey() {
+    pthread_key_create(&tariffReaderKey, releaseTariffReader);
+}
+
+// Claims a reader slot for this thread, released when the thread exits.
+// NULL once all are taken.
+static TariffReader *claimTariffReader() {
+    pthread_once(&tariffReaderOnce, createTariffReaderKey);
+    for (int i = 0; i < MAX_TARIFF_READERS; i++) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&tariffReaders[i].taken, &expected, 1)) {
+            pthread_setspecific(tariffReaderKey, &tariffReaders[i]);
+            return &tariffReaders[i];
+        }
+    }
+    return NULL;
+}
+
+// Frees the retired tariffs no reader announces. Caller holds tariffInstallLock.
+static void freeRetiredTariffs() {
+    if (atomic_load(&tariffReadersExhausted))
+        return;
+    size_t kept = 0;
+    for (size_t r = 0; r < retiredTariffCount; r++) {
+        int inUse = 0;
+        for (int i = 0; i < MAX_TARIFF_READERS && !inUse; i++)
+            inUse = atomic_load(&tariffReaders[i].inUse) == retiredTariffs[r];
+        if (inUse) {
+            retiredTariffs[kept++] = retiredTariffs[r];
+        } else {
+            free(retiredTariffs[r]);
+            freedTariffCount++;
+        }
+    }
+    retiredTariffCount = kept;
+}
+
+void installTariff(const CompiledTariff *compiled) {
+    pthread_mutex_lock(&tariffInstallLock);
+    const CompiledTariff *retired = atomic_exchange(&activeTariff, compiled);
+    if (retired && retired != compiled && retired->allocated) {
+        if (retiredTariffCount == retiredTariffCapacity) {
+            size_t capacity = retiredTariffCapacity ? retiredTariffCapacity * 2 : 8;
+            CompiledTariff **grown = realloc(retiredTariffs, capacity * sizeof(*grown));
+            if (grown) {
+                retiredTariffs = grown;
+                retiredTariffCapacity = capacity;
+            }
+        }
+        // Without room it is kept forever, as before reclamation
+        if (retiredTariffCount < retiredTariffCapacity)
+            retiredTariffs[retiredTariffCount++] = (CompiledTariff *)retired;
+    }
+    freeRetiredTariffs();
+    pthread_mutex_unlock(&tariffInstallLock);
+}
+
+// Compiles TARIFF_FILE (or fileName) and installs it. Without the file the
+// built-in tariff stays. Returns -1 if the file is invalid.
+int loadTariff(const char *fileName) {
+    FILE *file = fopen(fileName, "r");
+    if (!file)
+        return 0;
+    Tariff tariff;
+    int status = parseTariff(file, fileName, &tariff);
+    fclose(file);
+    if (status != 0)
+        return -1;
+
+    CompiledTariff *compiled = malloc(sizeof(*compiled));
+    if (!compiled)
+        return -1;
+    compileTariff(&tariff, compiled);
+    compiled->allocated = 1;
+    installTariff(compiled);
+    return 0;
+}
+
+// Compiles the built-in tariff and makes it current; main() does this
+// before anything can bill.
+void installDefaultTariff() {
+    Tariff defaults;
+    defaultTariff(&defaults);
+    compileTariff(&defaults, &builtinTariff);
+    installTariff(&builtinTariff);
+}
+
+// The current tariff, announced in this thread's reader slot: it stays
+// allocated until this thread's next call, or its exit. The announcement
+// is re-checked against activeTariff so installTariff() cannot miss it.
+static inline const CompiledTariff *currentTariff() {
+    const CompiledTariff *tariff = atomic_load(&activeTariff);
+    TariffReader *reader = tariffReader;
+    if (reader && atomic_load_explicit(&reader->inUse, memory_order_relaxed) == tariff)
+        return tariff;
+    if (!reader && !(reader = tariffReader = claimTariffReader())) {
+        atomic_store(&tariffReadersExhausted, 1);
+        return atomic_load(&activeTariff);
+    }
+    for (;;) {
+        atomic_store(&reader->inUse, tariff);
+        const CompiledTariff *current = atomic_load(&activeTariff);
+        if (current == tariff)
+            return tariff;
+        tariff = current;
+    }
+}
+// ================================================
+
+// Billing hours for a session: rounded up, at least one; none within the
+// grace period
+static inline long long billableHoursFor(const CompiledTariff *tariff,
+                                         long long durationSeconds) {
+    if (durationSeconds <= tariff->graceSeconds && tariff->graceSeconds > 0)
+        return 0;
+    long long hours = (durationSeconds + 3599) / 3600;
+    return hours < 1 ? 1 : hours;
+}
+
+static inline long long cappedFee(long long fee, int cap) {
+    return cap && fee > cap ? cap : fee;
+}
+
+// Fee (whole Rs) and payable cents for a session: the first 24-hour block,
+// whole later blocks, then the remainder. An unbanded tariff is the rates
+// themselves; a banded one is read from the compiled tables. Integer only,
+// so the single and bulk billing paths produce identical amounts.
+static inline long long sessionPayableCents(const CompiledTariff *tariff,
+                                            long long durationSeconds, time_t arrivalTime,
+                                            int vehicleType, int customerType,
+                                            long long *hoursOut, long long *feeOut) {
+    long long hours = billableHoursFor(tariff, durationSeconds);
+    long long fee, payable;
+    int cap = tariff->dailyCap[vehicleType];
+    if (!tariff->banded && !cap) {
+        long long first = hours ? tariff->firstHourFee[vehicleType] : 0;
+        fee = first + (hours - (hours > 0)) * tariff->additionalHourFee[vehicleType];
+        payable = fee * tariff->payablePercent[customerType];
+        *hoursOut = hours;
+        *feeOut = fee;
+        return payable;
+    }
+
+    long long firstHours = hours < TARIFF_BLOCK_HOURS ? hours : TARIFF_BLOCK_HOURS;
+    long long laterHours = hours - firstHours;
+    long long blocks = laterHours / TARIFF_BLOCK_HOURS;
+    long long rest = laterHours % TARIFF_BLOCK_HOURS;
+    if (!tariff->banded) {
+        long long additional = tariff->additionalHourFee[vehicleType];
+        fee = hours ? cappedFee(tariff->firstHourFee[vehicleType] + (firstHours - 1) * additional,
+                                cap) : 0;
+        fee += blocks * cappedFee(TARIFF_BLOCK_HOURS * additional, cap) +
+               cappedFee(rest * additional, cap);
+        payable = fee * tariff->payablePercent[customerType];
+    } else {
+        // Entry 0 of every table is zero, so no branch on the session length
+        int startHour = localStartHour(tariff, arrivalTime);
+        const int *firstFee = tariff->firstFee[vehicleType][startHour];
+        const int *nextFee = tariff->nextFee[vehicleType][startHour];
+        const int64_t *firstPayable = tariff->firstPayableCents[vehicleType][customerType][startHour];
+        const int64_t *nextPayable = tariff->nextPayableCents[vehicleType][customerType][startHour];
+        fee = firstFee[firstHours] + blocks * nextFee[TARIFF_BLOCK_HOURS] + nextFee[rest];
+        payable = firstPayable[firstHours] + blocks * nextPayable[TARIFF_BLOCK_HOURS] +
+                  nextPayable[rest];
+    }
+    *hoursOut = hours;
+    *feeOut = fee;
+    return payable;
+}
+
+Bill calculateBill(const Vehicle *vehicle, time_t exitTime) {
+    Bill bill;
+    const CompiledTariff *tariff = currentTariff();
+
+    // Exact duration in seconds
+    long long durationSeconds = (long long)exitTime - (long long)vehicle->arrivalTime;
+
+    // Display duration
+    int totalMinutes = (int)(durationSeconds / 60);
+    bill.displayHours = totalMinutes / 60;
+    bill.displayMinutes = totalMinutes % 60;
+
+    // Calculate fees and discount
+    long long hours, fee;
+    bill.payableCents = sessionPayableCents(tariff, durationSeconds, vehicle->arrivalTime,
+                                            vehicle->vehicleType, vehicle->customerType,
+                                            &hours, &fee);
+    bill.billableHours = (int)hours;
+    bill.fee = (int)fee;
+    bill.discountCents = fee * 100 - bill.payableCents;
+    return bill;
+}
+
+// Bulk billing for settlement. Inputs are parallel columns; payableCents[i]
+// receives what calculateBill() would charge for row i. Returns the sum, or
+// -1 (with nothing written) if a row's vehicle or customer type is out of
+// range, since the types index the tariff tables.
+long long calculateBills(size_t count, const time_t *arrivalTimes, const time_t *exitTimes,
+                         const unsigned char *vehicleTypes, const unsigned char *customerTypes,
+                         long long *payableCents) {
+    // Stays of up to 68 years also let the fast path below work in 32 bits
+    int shortStays = 1;
+    for (size_t i = 0; i < count; i++) {
+        if (vehicleTypes[i] >= VEHICLE_TYPE_COUNT || customerTypes[i] >= CUSTOMER_TYPE_COUNT)
+            return -1;
+        long long durationSeconds = (long long)exitTimes[i] - (long long)arrivalTimes[i];
+        shortStays &= durationSeconds > INT32_MIN && durationSeconds <= INT32_MAX - 3599;
+    }
+
+    const CompiledTariff *tariff = currentTariff();
+    int capped = 0;
+    for (int v = 0; v < VEHICLE_TYPE_COUNT; v++)
+        capped |= tariff->dailyCap[v] != 0;
+
+    long long total = 0;
+    if (tariff->banded || capped || !shortStays) {
+        // Blocks, bands or huge stays: the per-row work of the single path
+        for (size_t i = 0; i < count; i++) {
+            long long hours, fee;
+            payableCents[i] = sessionPayableCents(tariff,
+                                                  (long long)exitTimes[i] - (long long)arrivalTimes[i],
+                                                  arrivalTimes[i], vehicleTypes[i], customerTypes[i],
+                                                  &hours, &fee);
+            total += payableCents[i];
+        }
+        return total;
+    }
+
+    // Unbanded and uncapped, the common case: payable is the first hour plus
+    // the rest at the additional rate, each already scaled by the customer's
+    // percent (fee * percent distributes, so the cents are identical).
+    // Straight-line over the columns with a 32-bit divide, which gcc -O3
+    // vectorizes where the target has 32-bit multiply-high and gathers (AVX2).
+    const int64_t *firstCents = tariff->firstHourCents;
+    const int64_t *additionalCents = tariff->additionalHourCents;
+    // Sessions up to graceLimit bill nothing; no grace means no limit
+    int32_t graceLimit = tariff->graceSeconds > 0 ? tariff->graceSeconds : INT32_MIN;
+    for (size_t i = 0; i < count; i++) {
+        int32_t durationSeconds = (int32_t)(exitTimes[i] - arrivalTimes[i]);
+        int32_t billed = (durationSeconds + 3599) / 3600;
+        billed = billed < 1 ? 1 : billed;
+        billed = durationSeconds <= graceLimit ? 0 : billed;
+        int64_t hours = billed;
+        int64_t started = hours > 0;
+        int cell = vehicleTypes[i] * CUSTOMER_TYPE_COUNT + customerTypes[i];
+        payableCents[i] = started * firstCents[cell] + (hours - started) * additionalCents[cell];
+        total += payableCents[i];
+    }
+    return total;
+}
+
+// Prints the bill unparkVehicle() charged for vehicle
+void generateBill(const Vehicle *vehicle, time_t exitTime, const Bill *bill) {
+    char plateText[VEHICLE_NUMBER_LENGTH];
+
+    // Print the parking bill
+    printf("\n+=================== Parking Bill ===================+\n");
+    printf("| %-20s : %s\n", "Vehicle Number", formatPlate(vehicle->plate, plateText));
+    printf("| %-20s : %s\n", "Vehicle Type", VehicleTypeNames[vehicle->vehicleType]);
+    printf("| %-20s : %s\n", "Customer Type", CustomerTypeNames[vehicle->customerType]);
+    printf("| %-20s : %s", "Entered Time", ctime(&vehicle->arrivalTime));
+    printf("| %-20s : %s", "Exit Time", ctime(&exitTime));
+    printf("| %-20s : %d hours %d minutes\n",
+           "Parking Duration", bill->displayHours, bill->displayMinutes);
+    printf("| %-20s : Rs %d.00\n", "Total Charge", bill->fee);
+    printf("| %-20s : Rs %lld.%02lld\n", "Discount",
+           bill->discountCents / 100, bill->discountCents % 100);
+    printf("| %-20s : Rs %lld.%02lld\n", "Total Payable",
+           bill->payableCents / 100, bill->payableCents % 100);
+    printf("+====================================================+\n\n");
+}
+
+// ================== RENDER ======================
+// Views are rendered into a RenderBuffer and flushed in one write() instead
+// of one printf per symbol. renderFlushDiff() redraws in place (ANSI cursor
+// moves), touching only rows that differ from the last frame, for displays
+// that refresh continuously.
+static RenderBuffer screen;
+
+static int renderReserve(RenderBuffer *buffer, size_t extra) {
+    if (buffer->length + extra <= buffer->capacity)
+        return 0;
+    size_t capacity = buffer->capacity ? buffer->capacity : RENDER_BUFFER_INITIAL;
+    while (capacity < buffer->length + extra) capacity *= 2;
+    char *data = realloc(buffer->data, capacity);
+    if (!data) return -1;
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+void renderReset(RenderBuffer *buffer) {
+    buffer->length = 0;
+}
+
+void renderText(RenderBuffer *buffer, const char *text) {
+    size_t length = strlen(text);
+    if (renderReserve(buffer, length) != 0) return;
+    memcpy(buffer->data + buffer->length, text, length);
+    buffer->length += length;
+}
+
+// Appends count copies of symbol (a run of equal cells in one memset)
+void renderFill(RenderBuffer *buffer, char symbol, int count) {
+    if (count <= 0 || renderReserve(buffer, (size_t)count) != 0) return;
+    memset(buffer->data + buffer->length, symbol, (size_t)count);
+    buffer->length += (size_t)count;
+}
+
+void renderFormat(RenderBuffer *buffer, const char *format, ...) {
+    if (renderReserve(buffer, 1) != 0) return;
+
+    va_list args;
+    va_start(args, format);
+    int needed = vsnprintf(buffer->data + buffer->length, buffer->capacity - buffer->length,
+                           format, args);
+    va_end(args);
+    if (needed < 0) return;
+
+    if ((size_t)needed >= buffer->capacity - buffer->length) {
+        if (renderReserve(buffer, (size_t)needed + 1) != 0) return;
+        va_start(args, format);
+        vsnprintf(buffer->data + buffer->length, (size_t)needed + 1, format, args);
+        va_end(args);
+    }
+    buffer->length += (size_t)needed;
+}
+
+static int writeAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) return -1;
+        data += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+// Writes the whole frame with one write() (more only on a short write).
+// Returns the bytes written, or -1.
+long renderFlush(RenderBuffer *buffer, int fd) {
+    fflush(stdout); // keep order with printf output around the view
+    buffer->hasPrevious = 0;
+    if (writeAll(fd, buffer->data, buffer->length) != 0)
+        return -1;
+    return (long)buffer->length;
+}
+
+// Returns the length of the line starting at text (without its newline).
+static size_t lineLength(const char *text, size_t remaining) {
+    const char *end = memchr(text, '\n', remaining);
+    return end ? (size_t)(end - text) : remaining;
+}
+
+static size_t countLines(const char *text, size_t length) {
+    size_t lines = 0;
+    for (size_t pos = 0; pos < length; lines++)
+        pos += lineLength(text + pos, length - pos) + 1;
+    return lines;
+}
+
+// Redraws the frame in place. The first frame (or one whose row count
+// changed) clears the screen; later frames rewrite only changed rows.
+// Returns the bytes written, or -1.
+long renderFlushDiff(RenderBuffer *buffer, int fd) {
+    const char *frame = buffer->data;
+    size_t frameLength = buffer->length;
+    int full = !buffer->hasPrevious ||
+               countLines(frame, frameLength) != countLines(buffer->previous, buffer->previousLength);
+
+    // The escape sequences go after the frame in the same buffer, so there
+    // is still a single write()
+    size_t output = buffer->length;
+    if (full) {
+        renderText(buffer, "\033[H\033[2J");
+        if (renderReserve(buffer, frameLength) != 0) return -1;
+        memcpy(buffer->data + buffer->length, buffer->data, frameLength);
+        buffer->length += frameLength;
+    } else {
+        size_t pos = 0, previousPos = 0;
+        for (int row = 1; pos < frameLength; row++) {
+            size_t length = lineLength(buffer->data + pos, frameLength - pos);
+            size_t previousLength = lineLength(buffer->previous + previousPos,
+                                               buffer->previousLength - previousPos);
+            if (length != previousLength ||
+                memcmp(buffer->data + pos, buffer->previous + previousPos, length) != 0) {
+                renderFormat(buffer, "\033[%d;1H", row);
+                if (renderReserve(buffer, length) != 0) return -1;
+                memcpy(buffer->data + buffer->length, buffer->data + pos, length);
+                buffer->length += length;
+                renderText(buffer, "\033[K");
+            }
+            pos += length + 1;
+            previousPos += previousLength + 1;
+        }
+        renderFormat(buffer, "\033[%zu;1H", countLines(buffer->data, frameLength) + 1);
+    }
+
+    fflush(stdout);
+    long result = (long)(buffer->length - output);
+    if (writeAll(fd, buffer->data + output, buffer->length - output) != 0)
+        result = -1;
+
+    // Keep this frame for the next comparison
+    if (buffer->previousCapacity < frameLength) {
+        char *previous = realloc(buffer->previous, frameLength);
+        if (!previous) {
+            buffer->hasPrevious = 0;
+            buffer->length = frameLength;
+            return result;
+        }
+        buffer->previous = previous;
+        buffer->previousCapacity = frameLength;
+    }
+    memcpy(buffer->previous, buffer->data, frameLength);
+    buffer->previousLength = frameLength;
+    buffer->hasPrevious = 1;
+    buffer->length = frameLength;
+    return result;
+}
+
+void renderParkingSpace(RenderBuffer *buffer, ParkingManagement *lot) {
+    renderText(buffer, "\n+======================================================= Parking Space ============================================================\n\n");
+
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        renderFormat(buffer, "%-15s: { ", VehicleTypeNames[i]);
+
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+            // Bays in number order, one run of occupied or free bays per fill
+            const uint64_t *bitmap = lot->bayWords + lot->bayWordStart[i][j];
+            int bays = lot->bayCount[i][j];
+            for (int k = 0; k < bays;) {
+                int occupied = (int)(bitmap[k / BAY_WORD_BITS] >> (k % BAY_WORD_BITS) & 1);
+                int run = bayRunLength(bitmap, k, bays);
+                renderFill(buffer, occupied ? CustomerTypeSymbols[j][0] : 'F', run);
+                k += run;
+            }
+
+            if (j < CUSTOMER_TYPE_COUNT - 1) {
+                renderText(buffer, " | ");
+            }
+        }
+
+        renderText(buffer, " }\n");
+    }
+
+    renderText(buffer, "\n+================================================================================================================================+\n\n");
+}
+
+void renderStatisticsGraph(RenderBuffer *buffer, ParkingManagement *lot) {
+    int vehicleColWidth = 15;
+    int customerColWidth = 25;
+    int barWidth = 20;
+    OccupancyView view;
+    readOccupancy(lot, &view);
+
+    renderText(buffer, "\n+==================================================================== Parking Graph ===================================================================+\n");
+
+    renderFormat(buffer, "| %-*s|", vehicleColWidth, "Vehicle Type");
+    for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+        renderFormat(buffer, " %-*s ", customerColWidth, CustomerTypeNames[j]);
+    }
+    renderText(buffer, "\n");
+
+    renderFill(buffer, '=', vehicleColWidth + 2);
+    for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+        renderFill(buffer, '=', customerColWidth + 2);
+    }
+    renderText(buffer, "\n");
+
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        renderFormat(buffer, "|%-*s |", vehicleColWidth, VehicleTypeNames[i]);
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+            int allocated = view.allocated[i][j];
+            int free = view.free[i][j];
+            int totalSlots = allocated + free;
+
+            int scale = totalSlots > barWidth ? totalSlots / barWidth + 1 : 1;
+            int allocBars = allocated / scale;
+            int freeBars = free / scale;
+
+            renderFill(buffer, '#', allocBars);
+            renderFill(buffer, '*', freeBars);
+            renderFill(buffer, ' ', customerColWidth - (allocBars + freeBars));
+        }
+        renderText(buffer, "\n");
+    }
+
+    renderText(buffer, "+===================================================================================================================================================+\n");
+}
+// ================================================
+
+void viewParkingSpace() {
+    struct timespec start;
+    startTiming(&start);
+    renderReset(&screen);
+    renderParkingSpace(&screen, parking);
+    renderFlush(&screen, STDOUT_FILENO);
+    recordTiming(TIMED_RENDER, &start);
+}
+
+void viewStatistics() {
+    int choice = 1; 
+
+    do {
+        if (choice == 1) {
+            viewStatisticsTableView();
+        } else if (choice == 2) {
+            viewStatisticsGraph();
+        } else if (choice == 3) {
+            viewStatisticsSummary();
+        }
+
+        printf("\n| %-18s | %-18s | %-18s | %-18s \n",
+               "1: Table View", "2: Graph View", "3: Summary View", "0: Go Back");
+        printf("\n");
+        printf("+=============================================================+\n");
+        printf("Enter your choice: ");
+        scanf("%d", &choice);
+        getchar(); 
+
+        if (choice < 0 || choice > 3) {
+            printf("Invalid choice. Please try again.\n");
+            choice = 1;
+        }
+
+    } while (choice != 0);
+}
+
+void viewStatisticsTableView() {
+    struct timespec start;
+    startTiming(&start);
+    OccupancyView view;
+    readOccupancy(parking, &view);
+    printf("\n+=================== Parking Statistics ======================+\n");
+
+    printf("| %-15s | %-15s | %-10s | %-10s |\n", 
+           "Vehicle Type", "Customer Type", "Allocated", "Free");
+    printf("+-------------------------------------------------------------+\n");
+
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+            printf("| %-15s | %-15s | %-10d | %-10d |\n",
+                   VehicleTypeNames[i],
+                   CustomerTypeNames[j],
+                   view.allocated[i][j],
+                   view.free[i][j]);
+        }
+        printf("+-------------------------------------------------------------+\n"); 
+    }
+
+    printf("+=============================================================+\n");
+    recordTiming(TIMED_RENDER, &start);
+}
+
+void viewStatisticsGraph() {
+    struct timespec start;
+    startTiming(&start);
+    renderReset(&screen);
+    renderStatisticsGraph(&screen, parking);
+    renderFlush(&screen, STDOUT_FILENO);
+    recordTiming(TIMED_RENDER, &start);
+}
+
+void selectLot() {
+    int lotId;
+
+    printf("\n==================== Switch Lot ====================\n");
+    for (int i = 0; i < lotCount; i++) {
+        printf("|   Lot %-6d %6d / %-6d vehicles parked       |\n",
+               lots[i].lotId, parkedVehicles(&lots[i]), lots[i].vehicleCapacity);
+    }
+    printf("| %-30s: ", "Enter lot id");
+    scanf("%d", &lotId);
+    getchar();
+
+    ParkingManagement *lot = findLot(lotId);
+    if (lot) {
+        parking = lot;
+        printf("\n+--------------------------------------------+\n");
+        printf("| Now operating on lot %-21d |\n", lotId);
+        printf("+--------------------------------------------+\n\n");
+    } else {
+        printf("\n+--------------------------------------------+\n");
+        printf("| No lot with that id.                       |\n");
+        printf("+--------------------------------------------+\n\n");
+    }
+}
+
+void viewLotInformation() {
+    size_t totalBytes = 0;
+
+    printf("\n+===================== Lot Information ======================+\n");
+    printf("| %-8s | %-10s | %-10s | %-22s |\n", "Lot", "Parked", "Capacity", "Memory (bytes)");
+    printf("+------------------------------------------------------------+\n");
+
+    for (int i = 0; i < lotCount; i++) {
+        printf("| %-8d | %-10d | %-10d | %-22zu |\n",
+               lots[i].lotId,
+               parkedVehicles(&lots[i]),
+               lots[i].vehicleCapacity,
+               lots[i].arenaBytes);
+        totalBytes += lots[i].arenaBytes;
+    }
+
+    printf("+------------------------------------------------------------+\n");
+    printf("| %-8s | %-10d | %-10s | %-22zu |\n", "Lots", lotCount, "", totalBytes);
+    printf("| Limit per lot: %-10d vehicles, %-10zu bytes       |\n",
+           MAX_LOT_VEHICLES, MAX_LOT_MEMORY);
+    printf("+============================================================+\n");
+}
+
+// ================== BATCH MODE ==================
+// Streams gate events, one per line, and applies them through the same
+// allocation and billing code as the menu:
+//   ENTER <lotId> <vehicleNumber> <vehicleType> <customerType> [unixTime]
+//   EXIT  <lotId> <vehicleNumber> [unixTime]
+//   STATS <lotId>
+//   OVERSTAY <lotId> [unixTime]
+//   AVAILABILITY <lotId>
+//   RESERVE <lotId> <vehicleNumber> <vehicleType> <customerType> <from> <to> [unixTime]
+//   CANCEL <lotId> <vehicleNumber> [unixTime]
+//   AVAILABILITY <lotId> <vehicleType> <customerType> <from> <to> [unixTime]
+//   CHECKSUM <lotId>
+// (from and to are unix times; see RESERVATIONS)
+// Each event produces exactly one result line on stdout:
+//   OK ENTER <lotId> <vehicleNumber> <allocatedCustomerType> <bay>
+//   OK EXIT <lotId> <vehicleNumber> <billableHours> <fee> <totalPayable>
+//   OK STATS <lotId> <occupied> <capacity> <arrivals> <exits> <rejections>
+//            <revenue> <averageDwellSeconds>
+//   OK OVERSTAY <lotId> <count> [vehicleNumber ...] (earliest deadline
+//            first, at most OVERSTAY_BATCH_PLATES, "..." when there are more)
+//   OK AVAILABILITY <lotId> <free bays per vehicle type, all tiers>
+//   OK RESERVE <lotId> <vehicleNumber> <customerType>
+//   OK CANCEL <lotId> <vehicleNumber>
+//   OK AVAILABILITY <lotId> <vehicleType> <customerType> <bookable bays>
+//   OK CHECKSUM <lotId> <hex> (the lot's state, as compared by REPLICATION)
+//   ERR <ENTER|EXIT|STATS|OVERSTAY|AVAILABILITY|RESERVE|CANCEL|CHECKSUM|PARSE> <lotId>
+//       <vehicleNumber> <reason>
+// Vehicle numbers are echoed in canonical form (see encodePlate), so
+// "wp.cab_1" and "WP-CAB-1" are the same vehicle; a plate that does not
+// encode is answered with reason INVALID. Fields are split on whitespace,
+// so a plate with spaces ("wp cab-1") is only accepted by the menu.
+// With --gates N, events are spread over N gate worker threads. Events for
+// the same vehicle number always go to the same worker, so each vehicle's
+// ENTER/EXIT order is kept; result lines from different workers interleave.
+// A throughput summary is written to stderr at the end.
+
+// Applies one event line and writes its result line (with newline) to
+// output. Returns 1 for an error result, 0 for OK, -1 for a skipped line.
+int processBatchLine(const char *line, char *output, size_t outputSize) {
+    char op[16];
+    char vehicleNumber[PLATE_INPUT_LENGTH];
+    PlateKey plate;
+    int lotId, vehicleType, customerType;
+    long long timestamp, from, to;
+    int fields;
+
+    if (line[0] == '#' || line[0] == '\n' || line[0] == '\0')
+        return -1;
+
+    if (sscanf(line, "%15s", op) != 1) {
+        snprintf(output, outputSize, "ERR PARSE - - EMPTY\n");
+        return 1;
+    }
+
+    if (strcmp(op, "ENTER") == 0 &&
+        (fields = sscanf(line, "%*s %d %63s %d %d %lld",
+                         &lotId, vehicleNumber, &vehicleType, &customerType,
+                         &timestamp)) >= 4) {
+        ParkingManagement *lot = findLot(lotId);
+        if (!lot) {
+            snprintf(output, outputSize, "ERR ENTER %d %s NO_LOT\n", lotId, vehicleNumber);
+            return 1;
+        }
+        if (encodePlate(vehicleNumber, &plate) != 0) {
+            snprintf(output, outputSize, "ERR ENTER %d %s %s\n",
+                     lotId, vehicleNumber, ParkResultNames[PARK_INVALID]);
+            return 1;
+        }
+        formatPlate(plate, vehicleNumber);
+
+        Vehicle vehicle;
+        vehicle.plate = plate;
+        vehicle.vehicleType = vehicleType;
+        vehicle.customerType = customerType;
+
+        enum ParkResult result = parkVehicle(lot, &vehicle,
+                                             fields == 5 ? (time_t)timestamp : parkingClock());
+        if (result != PARK_OK) {
+            snprintf(output, outputSize, "ERR ENTER %d %s %s\n",
+                     lotId, vehicleNumber, ParkResultNames[result]);
+            return 1;
+        }
+        snprintf(output, outputSize, "OK ENTER %d %s %d %d\n",
+                 lotId, vehicleNumber, vehicle.customerType, vehicle.bayId);
+        return 0;
+    }
+
+    if (strcmp(op, "EXIT") == 0 &&
+        (fields = sscanf(line, "%*s %d %63s %lld",
+                         &lotId, vehicleNumber, &timestamp)) >= 2) {
+        ParkingManagement *lot = findLot(lotId);
+        Vehicle vehicle;
+        Bill bill;
+        time_t exitTime = fields == 3 ? (time_t)timestamp : parkingClock();
+
+        if (!lot) {
+            snprintf(output, outputSize, "ERR EXIT %d %s NO_LOT\n", lotId, vehicleNumber);
+            return 1;
+        }
+        if (encodePlate(vehicleNumber, &plate) != 0) {
+            snprintf(output, outputSize, "ERR EXIT %d %s %s\n",
+                     lotId, vehicleNumber, ParkResultNames[PARK_INVALID]);
+            return 1;
+        }
+        formatPlate(plate, vehicleNumber);
+        if (unparkVehicle(lot, plate, exitTime, &vehicle, &bill) != 0) {
+            snprintf(output, outputSize, "ERR EXIT %d %s NOT_FOUND\n", lotId, vehicleNumber);
+            return 1;
+        }
+        snprintf(output, outputSize, "OK EXIT %d %s %d %d %lld.%02lld\n", lotId, vehicleNumber,
+                 bill.billableHours, bill.fee, bill.payableCents / 100, bill.payableCents % 100);
+        return 0;
+    }
+
+    if (strcmp(op, "STATS") == 0 && sscanf(line, "%*s %d", &lotId) == 1) {
+        ParkingManagement *lot = findLot(lotId);
+        if (!lot) {
+            snprintf(output, outputSize, "ERR STATS %d - NO_LOT\n", lotId);
+            return 1;
+        }
+
+        ParkingStatistics stats = getParkingStatistics(lot);
+        snprintf(output, outputSize, "OK STATS %d %d %d %ld %ld %ld %lld.%02lld %lld\n", lotId,
+                 stats.occupied, lot->vehicleCapacity, stats.arrivals, stats.exits,
+                 stats.rejections, stats.revenueCents / 100, stats.revenueCents % 100,
+                 stats.exits ? stats.totalDwellSeconds / stats.exits : 0);
+        return 0;
+    }
+
+    if (strcmp(op, "CHECKSUM") == 0 && sscanf(line, "%*s %d", &lotId) == 1) {
+        ParkingManagement *lot = findLot(lotId);
+        if (!lot) {
+            snprintf(output, outputSize, "ERR CHECKSUM %d - NO_LOT\n", lotId);
+            return 1;
+        }
+
+        lockLotState(lot);
+        uint64_t checksum = lotStateChecksum(lot);
+        unlockLotState(lot);
+        snprintf(output, outputSize, "OK CHECKSUM %d %016llx\n",
+                 lotId, (unsigned long long)checksum);
+        return 0;
+    }
+
+    if (strcmp(op, "RESERVE") == 0 &&
+        (fields = sscanf(line, "%*s %d %63s %d %d %lld %lld %lld", &lotId, vehicleNumber,
+                         &vehicleType, &customerType, &from, &to, &timestamp)) >= 6) {
+        ParkingManagement *lot = findLot(lotId);
+        if (!lot) {
+            snprintf(output, outputSize, "ERR RESERVE %d %s NO_LOT\n", lotId, vehicleNumber);
+            return 1;
+        }
+        if (encodePlate(vehicleNumber, &plate) != 0) {
+            snprintf(output, outputSize, "ERR RESERVE %d %s %s\n",
+                     lotId, vehicleNumber, ParkResultNames[PARK_INVALID]);
+            return 1;
+        }
+        formatPlate(plate, vehicleNumber);
+
+        Vehicle vehicle;
+        vehicle.plate = plate;
+        vehicle.vehicleType = vehicleType;
+        vehicle.customerType = customerType;
+        enum ParkResult result = reserveBay(lot, &vehicle, (time_t)from, (time_t)to,
+                                            fields == 7 ? (time_t)timestamp : parkingClock());
+        if (result != PARK_OK) {
+            snprintf(output, outputSize, "ERR RESERVE %d %s %s\n",
+                     lotId, vehicleNumber, ParkResultNames[result]);
+            return 1;
+        }
+        snprintf(output, outputSize, "OK RESERVE %d %s %d\n", lotId, vehicleNumber, customerType);
+        return 0;
+    }
+
+    if (strcmp(op, "CANCEL") == 0 &&
+        (fields = sscanf(line, "%*s %d %63s %lld", &lotId, vehicleNumber, &timestamp)) >= 2) {
+        ParkingManagement *lot = findLot(lotId);
+        if (!lot) {
+            snprintf(output, outputSize, "ERR CANCEL %d %s NO_LOT\n", lotId, vehicleNumber);
+            return 1;
+        }
+        if (encodePlate(vehicleNumber, &plate) != 0) {
+            snprintf(output, outputSize, "ERR CANCEL %d %s %s\n",
+                     lotId, vehicleNumber, ParkResultNames[PARK_INVALID]);
+            return 1;
+        }
+        formatPlate(plate, vehicleNumber);
+        if (cancelReservation(lot, plate, fields == 3 ? (time_t)timestamp : parkingClock()) != 0) {
+            snprintf(output, outputSize, "ERR CANCEL %d %s NOT_FOUND\n", lotId, vehicleNumber);
+            return 1;
+        }
+        snprintf(output, outputSize, "OK CANCEL %d %s\n", lotId, vehicleNumber);
+        return 0;
+    }
+
+    // The window form asks how many bays of one cell can still be booked
+    if (strcmp(op, "AVAILABILITY") == 0 &&
+        (fields = sscanf(line, "%*s %d %d %d %lld %lld %lld", &lotId, &vehicleType,
+                         &customerType, &from, &to, &timestamp)) >= 5) {
+        ParkingManagement *lot = findLot(lotId);
+        if (!lot) {
+            snprintf(output, outputSize, "ERR AVAILABILITY %d - NO_LOT\n", lotId);
+            return 1;
+        }
+        int bays = windowAvailability(lot, vehicleType, customerType, (time_t)from, (time_t)to,
+                                      fields == 6 ? (time_t)timestamp : parkingClock());
+        if (bays < 0) {
+            snprintf(output, outputSize, "ERR AVAILABILITY %d - %s\n",
+                     lotId, ParkResultNames[PARK_INVALID]);
+            return 1;
+        }
+        snprintf(output, outputSize, "OK AVAILABILITY %d %d %d %d\n",
+                 lotId, vehicleType, customerType, bays);
+        return 0;
+    }
+
+    if (strcmp(op, "AVAILABILITY") == 0 && sscanf(line, "%*s %d", &lotId) == 1) {
+        ParkingManagement *lot = findLot(lotId);
+        if (!lot) {
+            snprintf(output, outputSize, "ERR AVAILABILITY %d - NO_LOT\n", lotId);
+            return 1;
+        }
+
+        OccupancyView view;
+        readOccupancy(lot, &view);
+        int length = snprintf(output, outputSize, "OK AVAILABILITY %d", lotId);
+        for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+            int free = 0;
+            for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++)
+                free += view.free[i][j];
+            length += snprintf(output + length, outputSize - length, " %d", free);
+        }
+        snprintf(output + length, outputSize - length, "\n");
+        return 0;
+    }
+
+    if (strcmp(op, "OVERSTAY") == 0 &&
+        (fields = sscanf(line, "%*s %d %lld", &lotId, &timestamp)) >= 1) {
+        ParkingManagement *lot = findLot(lotId);
+        if (!lot) {
+            snprintf(output, outputSize, "ERR OVERSTAY %d - NO_LOT\n", lotId);
+            return 1;
+        }
+
+        Vehicle vehicles[OVERSTAY_BATCH_PLATES];
+        int count = listOverstays(lot, fields == 2 ? (time_t)timestamp : parkingClock(),
+                                  vehicles, OVERSTAY_BATCH_PLATES);
+        int length = snprintf(output, outputSize, "OK OVERSTAY %d %d", lotId, count);
+        for (int i = 0; i < count && i < OVERSTAY_BATCH_PLATES; i++)
+            length += snprintf(output + length, outputSize - length, " %s",
+                               formatPlate(vehicles[i].plate, vehicleNumber));
+        snprintf(output + length, outputSize - length, "%s\n",
+                 count > OVERSTAY_BATCH_PLATES ? " ..." : "");
+        return 0;
+    }
+
+    snprintf(output, outputSize, "ERR PARSE - - %s\n", op);
+    return 1;
+}
+
+// One gate worker: a bounded queue of event lines fed by the reader thread
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+    char (*lines)[BATCH_LINE_LENGTH];
+    int head;
+    int count;
+    int done;
+    long events;
+    long errors;
+} GateWorker;
+
+static void *runGateWorker(void *arg) {
+    GateWorker *worker = arg;
+    char line[BATCH_LINE_LENGTH];
+    char result[BATCH_LINE_LENGTH + 64];
+    char output[1 << 14];
+    size_t outputLength = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&worker->lock);
+        while (worker->count == 0 && !worker->done)
+            pthread_cond_wait(&worker->notEmpty, &worker->lock);
+        if (worker->count == 0) {
+            pthread_mutex_unlock(&worker->lock);
+            break;
+        }
+        memcpy(line, worker->lines[worker->head], sizeof(line));
+        worker->head = (worker->head + 1) % GATE_QUEUE_LINES;
+        worker->count--;
+        pthread_cond_signal(&worker->notFull);
+        pthread_mutex_unlock(&worker->lock);
+
+        int status = processBatchLine(line, result, sizeof(result));
+        if (status < 0)
+            continue;
+        worker->events++;
+        worker->errors += status;
+
+        // Whole result lines only, so workers never split each other's lines
+        size_t length = strlen(result);
+        if (outputLength + length > sizeof(output)) {
+            fwrite(output, 1, outputLength, stdout);
+            outputLength = 0;
+        }
+        memcpy(output + outputLength, result, length);
+        outputLength += length;
+    }
+
+    fwrite(output, 1, outputLength, stdout);
+    return NULL;
+}
+
+// line is shorter than BATCH_LINE_LENGTH (see skipLongLine)
+static void queueGateLine(GateWorker *worker, const char *line) {
+    pthread_mutex_lock(&worker->lock);
+    while (worker->count == GATE_QUEUE_LINES)
+        pthread_cond_wait(&worker->notFull, &worker->lock);
+    int tail = (worker->head + worker->count) % GATE_QUEUE_LINES;
+    memcpy(worker->lines[tail], line, strlen(line) + 1);
+    worker->count++;
+    pthread_cond_signal(&worker->notEmpty);
+    pthread_mutex_unlock(&worker->lock);
+}
+
+// Lets the workers finish their queues and joins them, adding up their
+// counts
+static void stopGateWorkers(GateWorker *workers, int started, long *events, long *errors) {
+    for (int i = 0; i < started; i++) {
+        pthread_mutex_lock(&workers[i].lock);
+        workers[i].done = 1;
+        pthread_cond_signal(&workers[i].notEmpty);
+        pthread_mutex_unlock(&workers[i].lock);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        *events += workers[i].events;
+        *errors += workers[i].errors;
+        pthread_mutex_destroy(&workers[i].lock);
+        pthread_cond_destroy(&workers[i].notEmpty);
+        pthread_cond_destroy(&workers[i].notFull);
+        free(workers[i].lines);
+    }
+}
+
+// An event line of BATCH_LINE_LENGTH or more is answered as the service
+// does, ERR PARSE - - TOO_LONG, on output (if not NULL) instead of being
+// cut; the rest of it is read and dropped. line must hold more than
+// BATCH_LINE_LENGTH bytes. Returns 1 if line was such a line.
+static int skipLongLine(char *line, int size, FILE *input, FILE *output) {
+    if (strlen(line) < BATCH_LINE_LENGTH)
+        return 0;
+    while (!strchr(line, '\n') && fgets(line, size, input))
+        ;
+    if (output)
+        fputs("ERR PARSE - - TOO_LONG\n", output);
+    return 1;
+}
+
+// Picks the worker for an event line by hashing its vehicle number, so
+// every spelling of one plate goes to the same worker
+static int gateForLine(const char *line, int gateWorkers) {
+    char vehicleNumber[PLATE_INPUT_LENGTH];
+    PlateKey plate;
+    if (sscanf(line, "%*s %*d %63s", vehicleNumber) != 1 ||
+        encodePlate(vehicleNumber, &plate) != 0)
+        return 0;
+    return (int)(hashPlate(plate) % (unsigned int)gateWorkers);
+}
+
+// Set by SIGUSR1; the batch reader dumps the operation timings to stderr
+// before its next line. SIGHUP likewise re-reads TARIFF_FILE.
+static volatile sig_atomic_t timingsRequested = 0;
+static volatile sig_atomic_t tariffReloadRequested = 0;
+
+static void requestTimings(int signalNumber) {
+    (void)signalNumber;
+    timingsRequested = 1;
+}
+
+static void requestTariffReload(int signalNumber) {
+    (void)signalNumber;
+    tariffReloadRequested = 1;
+}
+
+static void dumpRequestedTimings() {
+    if (!timingsRequested)
+        return;
+    timingsRequested = 0;
+    printOperationTimings(stderr);
+}
+
+static void reloadRequestedTariff() {
+    if (!tariffReloadRequested)
+        return;
+    tariffReloadRequested = 0;
+    if (loadTariff(TARIFF_FILE) == 0)
+        fprintf(stderr, "tariff: reloaded %s\n", TARIFF_FILE);
+    else
+        fprintf(stderr, "tariff: %s rejected, keeping the current tariff\n", TARIFF_FILE);
+}
+
+static void watchControlSignals() {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = requestTimings;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR1, &action, NULL);
+    action.sa_handler = requestTariffReload;
+    sigaction(SIGHUP, &action, NULL);
+}
+
+int runBatch(FILE *input, int gateWorkers) {
+    static char outputBuffer[1 << 16];
+    setvbuf(stdout, outputBuffer, _IOFBF, sizeof(outputBuffer));
+    watchControlSignals();
+
+    char line[256];
+    char result[sizeof(line) + 64];
+    long events = 0, errors = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (gateWorkers == 1) {
+        while (fgets(line, sizeof(line), input)) {
+            dumpRequestedTimings();
+            reloadRequestedTariff();
+            if (skipLongLine(line, sizeof(line), input, stdout)) {
+                events++;
+                errors++;
+                continue;
+            }
+            int status = processBatchLine(line, result, sizeof(result));
+            if (status < 0)
+                continue;
+            events++;
+            errors += status;
+            fputs(result, stdout);
+        }
+    } else {
+        GateWorker *workers = calloc(gateWorkers, sizeof(GateWorker));
+        if (!workers) return 1;
+
+        int started = 0;
+        while (started < gateWorkers) {
+            GateWorker *worker = &workers[started];
+            worker->lines = malloc(GATE_QUEUE_LINES * sizeof(*worker->lines));
+            if (!worker->lines)
+                break;
+            pthread_mutex_init(&worker->lock, NULL);
+            pthread_cond_init(&worker->notEmpty, NULL);
+            pthread_cond_init(&worker->notFull, NULL);
+            if (pthread_create(&worker->thread, NULL, runGateWorker, worker) != 0) {
+                pthread_mutex_destroy(&worker->lock);
+                pthread_cond_destroy(&worker->notEmpty);
+                pthread_cond_destroy(&worker->notFull);
+                free(worker->lines);
+                break;
+            }
+            started++;
+        }
+        if (started < gateWorkers) {
+            fprintf(stderr, "batch: cannot start %d gate workers\n", gateWorkers);
+            stopGateWorkers(workers, started, &events, &errors);
+            free(workers);
+            return 1;
+        }
+
+        while (fgets(line, sizeof(line), input)) {
+            dumpRequestedTimings();
+            reloadRequestedTariff();
+            if (skipLongLine(line, sizeof(line), input, stdout)) {
+                events++;
+                errors++;
+                continue;
+            }
+            queueGateLine(&workers[gateForLine(line, gateWorkers)], line);
+        }
+
+        stopGateWorkers(workers, gateWorkers, &events, &errors);
+        free(workers);
+    }
+
+    fflush(stdout);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "batch: %d gate(s), %ld events, %ld errors, %.3f s, %.0f events/s\n",
+            gateWorkers, events, errors, seconds, seconds > 0 ? events / seconds : 0.0);
+    return 0;
+}
+// ================================================
+
+void viewStatisticsSummary() {
+    struct timespec start;
+    startTiming(&start);
+    ParkingStatistics stats = getParkingStatistics(parking);
+
+    printf("\n+==================== Parking Summary ========================+\n");
+    printf("| %-30s : %-26d |\n", "Occupied", stats.occupied);
+    printf("| %-30s : %-26d |\n", "Capacity", parking->vehicleCapacity);
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        printf("|   %-28s : %-26d |\n", VehicleTypeNames[i], stats.occupiedByType[i]);
+    }
+    printf("+-------------------------------------------------------------+\n");
+    printf("| %-30s : %-26ld |\n", "Arrivals", stats.arrivals);
+    printf("| %-30s : %-26ld |\n", "Exits", stats.exits);
+    printf("| %-30s : %-26ld |\n", "Rejected", stats.rejections);
+    printf("| %-30s : %-26ld |\n", "Parked in another tier's bay", stats.borrowed);
+    printf("| %-30s : %-26ld |\n", "Overstay alerts", stats.overstays);
+    printf("| %-30s : Rs %-23.2f |\n", "Revenue", stats.revenueCents / 100.0);
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        printf("|   %-28s : Rs %-23.2f |\n", VehicleTypeNames[i],
+               stats.revenueByTypeCents[i] / 100.0);
+    }
+    long long averageDwell = stats.exits ? stats.totalDwellSeconds / stats.exits : 0;
+    printf("| %-30s : %3lld hours %2lld minutes      |\n", "Average Dwell Time",
+           averageDwell / 3600, averageDwell % 3600 / 60);
+    printf("+-------------------------------------------------------------+\n");
+
+    printf("| %-59s |\n", "Arrivals by hour of day");
+    for (int hour = 0; hour < 24; hour++) {
+        printf("|   %02d:00 %-51ld |\n", hour, stats.arrivalsByHour[hour]);
+    }
+    printf("+-------------------------------------------------------------+\n");
+
+    printf("| %-59s |\n", "Dwell time");
+    for (size_t i = 0; i < DWELL_BUCKET_COUNT; i++) {
+        char label[16];
+        if (i < ARRAY_COUNT(DWELL_BUCKET_HOURS))
+            snprintf(label, sizeof(label), "< %dh", DWELL_BUCKET_HOURS[i]);
+        else
+            snprintf(label, sizeof(label), ">= %dh", DWELL_BUCKET_HOURS[i - 1]);
+        printf("|   %-7s %-49ld |\n", label, stats.dwellHistogram[i]);
+    }
+    printf("+=============================================================+\n");
+    recordTiming(TIMED_RENDER, &start);
+}
+
+// ============== POLICY COMPARISON ===============
+// ./main --compare-policies [events file]
+// Replays the same batch-format trace once per allocation policy, each time
+// on freshly emptied lots, and reports how well the bays were used.
+int comparePolicies(FILE *input) {
+    size_t lineCount = 0, lineCapacity = 1024;
+    char (*lines)[BATCH_LINE_LENGTH] = malloc(lineCapacity * sizeof(*lines));
+    if (!lines) return 1;
+    char line[256];
+    while (fgets(line, sizeof(line), input)) {
+        // An over-long line stays one event, answered as runBatch answers
+        // it: "TOO_LONG" is an unknown op, so ERR PARSE - - TOO_LONG
+        if (skipLongLine(line, sizeof(line), input, NULL))
+            strcpy(line, "TOO_LONG\n");
+        memcpy(lines[lineCount], line, strlen(line) + 1);
+        if (++lineCount == lineCapacity) {
+            lineCapacity *= 2;
+            char (*grown)[BATCH_LINE_LENGTH] = realloc(lines, lineCapacity * sizeof(*lines));
+            if (!grown) {
+                free(lines);
+                return 1;
+            }
+            lines = grown;
+        }
+    }
+
+    long capacity = 0;
+    for (int i = 0; i < lotCount; i++)
+        capacity += lots[i].vehicleCapacity;
+
+    printf("\n+======================== Policy Comparison =========================+\n");
+    printf("| %-9s | %-9s | %-9s | %-8s | %-8s | %-9s |\n",
+           "Policy", "Arrivals", "Rejected", "Reject %", "Borrowed", "Avg use %");
+    printf("+--------------------------------------------------------------------+\n");
+
+    const AllocationPolicy *configured[MAX_LOTS];
+    for (int i = 0; i < lotCount; i++)
+        configured[i] = lots[i].policy;
+
+    for (size_t p = 0; p < ARRAY_COUNT(ALLOCATION_POLICIES); p++) {
+        for (int i = 0; i < lotCount; i++) {
+            lots[i].policy = &ALLOCATION_POLICIES[p];
+            resetParking(&lots[i]);
+        }
+
+        // Occupancy is sampled after every event for the utilisation average
+        long occupied = 0;
+        long events = 0;
+        double occupiedSum = 0;
+        char result[256];
+        for (size_t n = 0; n < lineCount; n++) {
+            if (processBatchLine(lines[n], result, sizeof(result)) < 0)
+                continue;
+            if (strncmp(result, "OK ENTER", 8) == 0) occupied++;
+            else if (strncmp(result, "OK EXIT", 7) == 0) occupied--;
+            occupiedSum += occupied;
+            events++;
+        }
+
+        long arrivals = 0, rejected = 0, borrowed = 0;
+        for (int i = 0; i < lotCount; i++) {
+            ParkingStatistics stats = getParkingStatistics(&lots[i]);
+            arrivals += stats.arrivals;
+            rejected += stats.rejections;
+            borrowed += stats.borrowed;
+        }
+        long attempts = arrivals + rejected;
+        printf("| %-9s | %-9ld | %-9ld | %-8.2f | %-8ld | %-9.2f |\n",
+               ALLOCATION_POLICIES[p].name, arrivals, rejected,
+               attempts ? 100.0 * rejected / attempts : 0.0, borrowed,
+               events && capacity ? 100.0 * occupiedSum / events / capacity : 0.0);
+    }
+    printf("+====================================================================+\n");
+
+    // Leave the lots empty, on the policy they were configured with
+    for (int i = 0; i < lotCount; i++) {
+        lots[i].policy = configured[i];
+        resetParking(&lots[i]);
+    }
+    free(lines);
+    return 0;
+}
+// ================================================
+
+// ================== BENCHMARKS ==================
+// ./main --bench billing|scan|tariff [rows]
+// ./main --bench render [frames]
+// ./main --bench bays [bays]
+// ./main --bench ops [bays]
+// ./main --bench reports [gates]
+// ./main --bench overstay [vehicles]
+// ./main --bench archive [days]
+static double secondsSince(const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Synthetic sessions: arrivals spread over a year, stays of up to three days
+static unsigned int benchRandom(unsigned int *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static int benchBilling(size_t rows) {
+    time_t *arrivalTimes = malloc(rows * sizeof(*arrivalTimes));
+    time_t *exitTimes = malloc(rows * sizeof(*exitTimes));
+    unsigned char *vehicleTypes = malloc(rows);
+    unsigned char *customerTypes = malloc(rows);
+    long long *payableCents = malloc(rows * sizeof(*payableCents));
+    if (!arrivalTimes || !exitTimes || !vehicleTypes || !customerTypes || !payableCents) {
+        fprintf(stderr, "bench: out of memory for %zu rows\n", rows);
+        free(arrivalTimes); free(exitTimes); free(vehicleTypes);
+        free(customerTypes); free(payableCents);
+        return 1;
+    }
+
+    unsigned int seed = 2463534242u;
+    for (size_t i = 0; i < rows; i++) {
+        arrivalTimes[i] = 1700000000 + benchRandom(&seed) % (365 * 86400);
+        exitTimes[i] = arrivalTimes[i] + benchRandom(&seed) % (72 * 3600);
+        vehicleTypes[i] = benchRandom(&seed) % VEHICLE_TYPE_COUNT;
+        customerTypes[i] = benchRandom(&seed) % CUSTOMER_TYPE_COUNT;
+    }
+
+    // Bulk path: one warmup pass, best of five
+    long long bulkTotal = calculateBills(rows, arrivalTimes, exitTimes,
+                                         vehicleTypes, customerTypes, payableCents);
+    double bulkSeconds = 0;
+    for (int pass = 0; pass < 5; pass++) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bulkTotal = calculateBills(rows, arrivalTimes, exitTimes,
+                                   vehicleTypes, customerTypes, payableCents);
+        double seconds = secondsSince(&start);
+        if (pass == 0 || seconds < bulkSeconds)
+            bulkSeconds = seconds;
+    }
+
+    // Single-bill path over the same rows, checking every amount
+    long long singleTotal = 0;
+    size_t mismatches = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < rows; i++) {
+        Vehicle vehicle = {
+            .vehicleType = vehicleTypes[i],
+            .customerType = customerTypes[i],
+            .arrivalTime = arrivalTimes[i]
+        };
+        Bill bill = calculateBill(&vehicle, exitTimes[i]);
+        singleTotal += bill.payableCents;
+        mismatches += bill.payableCents != payableCents[i];
+    }
+    double singleSeconds = secondsSince(&start);
+
+    // A type outside the tariff tables is refused, not read
+    unsigned char badType = VEHICLE_TYPE_COUNT;
+    mismatches += rows && calculateBills(1, arrivalTimes, exitTimes, &badType, customerTypes,
+                                         payableCents) != -1;
+
+    // The other bulk paths, checked the same way: the straight-line path
+    // with a grace period, then the per-row path under a daily cap
+    const CompiledTariff *builtin = currentTariff();
+    CompiledTariff *variant = malloc(sizeof(*variant));
+    for (int capped = 0; variant && capped < 2; capped++) {
+        Tariff tariff;
+        defaultTariff(&tariff);
+        tariff.graceMinutes = 10;
+        for (int i = 0; capped && i < VEHICLE_TYPE_COUNT; i++)
+            tariff.dailyCap[i] = ADDITIONAL_HOUR_FEE[i] * 10;
+        compileTariff(&tariff, variant);
+        installTariff(variant);
+        calculateBills(rows, arrivalTimes, exitTimes, vehicleTypes, customerTypes, payableCents);
+        for (size_t i = 0; i < rows; i++) {
+            Vehicle vehicle = {
+                .vehicleType = vehicleTypes[i],
+                .customerType = customerTypes[i],
+                .arrivalTime = arrivalTimes[i]
+            };
+            mismatches += calculateBill(&vehicle, exitTimes[i]).payableCents != payableCents[i];
+        }
+    }
+    installTariff(builtin);
+    free(variant);
+
+    printf("billing: %zu rows\n", rows);
+    printf("  bulk   %10.0f bills/s  total Rs %lld.%02lld\n",
+           bulkSeconds > 0 ? rows / bulkSeconds : 0.0, bulkTotal / 100, bulkTotal % 100);
+    printf("  single %10.0f bills/s  total Rs %lld.%02lld\n",
+           singleSeconds > 0 ? rows / singleSeconds : 0.0, singleTotal / 100, singleTotal % 100);
+    printf("  mismatched rows: %zu\n", mismatches);
+
+    free(arrivalTimes);
+    free(exitTimes);
+    free(vehicleTypes);
+    free(customerTypes);
+    free(payableCents);
+    return mismatches ? 1 : 0;
+}
+
+// The billing formula from before tariffs, kept here as the baseline for
+// the tariff benchmark
+static long long formulaPayableCents(long long durationSeconds, int vehicleType,
+                                     int customerType) {
+    long long hours = (durationSeconds + 3599) / 3600;
+    if (hours < 1)
+        hours = 1;
+    long long feeCents = FIRST_HOUR_FEE[vehicleType] * 100LL +
+                         (hours - 1) * ADDITIONAL_HOUR_FEE[vehicleType] * 100LL;
+    return feeCents - feeCents * DISCOUNT_PERCENT[customerType] / 100;
+}
+
+typedef struct {
+    size_t rows;
+    const time_t *arrivalTimes;
+    const time_t *exitTimes;
+    const unsigned char *vehicleTypes;
+    const unsigned char *customerTypes;
+    const long long *expectedA;   // bill under either tariff is correct,
+    const long long *expectedB;   // anything else is a torn read
+    _Atomic int *stop;
+    long bills;
+    long torn;
+} TariffSwapWorker;
+
+static void *runTariffSwapWorker(void *arg) {
+    TariffSwapWorker *worker = arg;
+    while (!atomic_load(worker->stop)) {
+        for (size_t i = 0; i < worker->rows; i++) {
+            Vehicle vehicle = {
+                .vehicleType = worker->vehicleTypes[i],
+                .customerType = worker->customerTypes[i],
+                .arrivalTime = worker->arrivalTimes[i]
+            };
+            long long payable = calculateBill(&vehicle, worker->exitTimes[i]).payableCents;
+            worker->torn += payable != worker->expectedA[i] && payable != worker->expectedB[i];
+        }
+        worker->bills += (long)worker->rows;
+    }
+    return NULL;
+}
+
+// Per-bill cost of the compiled built-in tariff against the formula it
+// replaced (amounts must agree), the same for a banded, capped tariff with
+// a grace period, and bills taken by gate threads while the tariff is
+// swapped underneath them. Every other swap installs a fresh copy of the
+// banded tariff, so retired copies must be freed as the threads move on.
+static int benchTariff(size_t rows) {
+    time_t *arrivalTimes = malloc(rows * sizeof(*arrivalTimes));
+    time_t *exitTimes = malloc(rows * sizeof(*exitTimes));
+    unsigned char *vehicleTypes = malloc(rows);
+    unsigned char *customerTypes = malloc(rows);
+    long long *expectedA = malloc(rows * sizeof(*expectedA));
+    long long *expectedB = malloc(rows * sizeof(*expectedB));
+    CompiledTariff *banded = malloc(sizeof(*banded));
+    if (!arrivalTimes || !exitTimes || !vehicleTypes || !customerTypes ||
+        !expectedA || !expectedB || !banded) {
+        fprintf(stderr, "bench: out of memory for %zu rows\n", rows);
+        free(arrivalTimes); free(exitTimes); free(vehicleTypes); free(customerTypes);
+        free(expectedA); free(expectedB); free(banded);
+        return 1;
+    }
+
+    unsigned int seed = 2463534242u;
+    for (size_t i = 0; i < rows; i++) {
+        arrivalTimes[i] = 1700000000 + benchRandom(&seed) % (365 * 86400);
+        exitTimes[i] = arrivalTimes[i] + benchRandom(&seed) % (72 * 3600);
+        vehicleTypes[i] = benchRandom(&seed) % VEHICLE_TYPE_COUNT;
+        customerTypes[i] = benchRandom(&seed) % CUSTOMER_TYPE_COUNT;
+    }
+
+    Tariff tariff;
+    defaultTariff(&tariff);
+    tariff.graceMinutes = 10;
+    tariff.bands[tariff.bandCount++] = (TariffBand){7, 10, 150};
+    tariff.bands[tariff.bandCount++] = (TariffBand){16, 19, 150};
+    tariff.bands[tariff.bandCount++] = (TariffBand){22, 24, 50};
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        tariff.dailyCap[i] = ADDITIONAL_HOUR_FEE[i] * 10;
+    compileTariff(&tariff, banded);
+    const CompiledTariff *builtin = currentTariff();
+
+    // Best of five passes over all rows for each path
+    long long formulaTotal = 0, tableTotal = 0, bandedTotal = 0;
+    double formulaSeconds = 0, tableSeconds = 0, bandedSeconds = 0;
+    size_t mismatches = 0;
+    for (int pass = 0; pass < 5; pass++) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        formulaTotal = 0;
+        for (size_t i = 0; i < rows; i++) {
+            expectedA[i] = formulaPayableCents((long long)exitTimes[i] - arrivalTimes[i],
+                                               vehicleTypes[i], customerTypes[i]);
+            formulaTotal += expectedA[i];
+        }
+        double seconds = secondsSince(&start);
+        if (pass == 0 || seconds < formulaSeconds)
+            formulaSeconds = seconds;
+
+        installTariff(builtin);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        tableTotal = 0;
+        const CompiledTariff *active = currentTariff();
+        for (size_t i = 0; i < rows; i++) {
+            long long hours, fee;
+            expectedB[i] = sessionPayableCents(active,
+                                               (long long)exitTimes[i] - arrivalTimes[i],
+                                               arrivalTimes[i], vehicleTypes[i],
+                                               customerTypes[i], &hours, &fee);
+            tableTotal += expectedB[i];
+        }
+        seconds = secondsSince(&start);
+        if (pass == 0 || seconds < tableSeconds)
+            tableSeconds = seconds;
+        mismatches = 0;
+        for (size_t i = 0; i < rows; i++)
+            mismatches += expectedB[i] != expectedA[i];
+
+        installTariff(banded);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bandedTotal = 0;
+        active = currentTariff();
+        for (size_t i = 0; i < rows; i++) {
+            long long hours, fee;
+            expectedB[i] = sessionPayableCents(active,
+                                               (long long)exitTimes[i] - arrivalTimes[i],
+                                               arrivalTimes[i], vehicleTypes[i],
+                                               customerTypes[i], &hours, &fee);
+            bandedTotal += expectedB[i];
+        }
+        seconds = secondsSince(&start);
+        if (pass == 0 || seconds < bandedSeconds)
+            bandedSeconds = seconds;
+    }
+
+    printf("tariff: %zu bills\n", rows);
+    printf("  formula  %6.1f ns/bill  total Rs %lld.%02lld\n",
+           formulaSeconds * 1e9 / rows, formulaTotal / 100, formulaTotal % 100);
+    printf("  built-in %6.1f ns/bill  total Rs %lld.%02lld  (built-in tariff)\n",
+           tableSeconds * 1e9 / rows, tableTotal / 100, tableTotal % 100);
+    printf("  banded   %6.1f ns/bill  total Rs %lld.%02lld  (3 bands, daily cap, 10 min grace)\n",
+           bandedSeconds * 1e9 / rows, bandedTotal / 100, bandedTotal % 100);
+    printf("  mismatched rows: %zu\n", mismatches);
+
+    // Hot swap: four gate threads bill the first rows over and over while
+    // the tariff flips between the two
+    _Atomic int stop = 0;
+    TariffSwapWorker workers[4];
+    pthread_t threads[4];
+    for (int w = 0; w < 4; w++) {
+        workers[w] = (TariffSwapWorker){
+            .rows = rows < 4096 ? rows : 4096,
+            .arrivalTimes = arrivalTimes, .exitTimes = exitTimes,
+            .vehicleTypes = vehicleTypes, .customerTypes = customerTypes,
+            .expectedA = expectedA, .expectedB = expectedB, .stop = &stop
+        };
+        pthread_create(&threads[w], NULL, runTariffSwapWorker, &workers[w]);
+    }
+    struct timespec pause = {0, 100000};
+    long copies = 0;
+    for (int swap = 0; swap < BENCH_TARIFF_SWAPS; swap++) {
+        CompiledTariff *copy = swap % 2 ? NULL : malloc(sizeof(*copy));
+        if (copy) {
+            memcpy(copy, banded, sizeof(*copy));
+            copy->allocated = 1;
+            copies++;
+        }
+        installTariff(copy ? copy : builtin);
+        nanosleep(&pause, NULL);
+    }
+    atomic_store(&stop, 1);
+    long bills = 0, torn = 0;
+    for (int w = 0; w < 4; w++) {
+        pthread_join(threads[w], NULL);
+        bills += workers[w].bills;
+        torn += workers[w].torn;
+    }
+    installTariff(builtin);
+    pthread_mutex_lock(&tariffInstallLock);
+    long freed = freedTariffCount;
+    pthread_mutex_unlock(&tariffInstallLock);
+    printf("  hot swap %d swaps under 4 billing threads: %ld bills, %ld torn, "
+           "%ld of %ld copies freed\n", BENCH_TARIFF_SWAPS, bills, torn, freed, copies);
+
+    // Banded start hours must follow the zone's offset at each arrival,
+    // not the offset when the tariff was compiled
+    long zoneErrors = 0;
+    for (size_t i = 0; i < rows; i++) {
+        long long local = ((long long)arrivalTimes[i] + utcOffsetAt(arrivalTimes[i])) % 86400;
+        zoneErrors += localStartHour(banded, arrivalTimes[i]) !=
+                      (int)((local < 0 ? local + 86400 : local) / 3600);
+    }
+    printf("  start hours off the zone's offset: %ld (%d offset spans)\n",
+           zoneErrors, banded->zoneSpans);
+
+    free(arrivalTimes);
+    free(exitTimes);
+    free(vehicleTypes);
+    free(customerTypes);
+    free(expectedA);
+    free(expectedB);
+    free(banded);
+    return mismatches || torn || zoneErrors || freed != copies ? 1 : 0;
+}
+
+// Row-wise layout the lots used before the vehicle columns, kept here as the
+// baseline for the scan benchmark.
+typedef struct {
+    size_t rows;
+    Vehicle *vehicles;
+    PlateKey *plateKeys;
+    time_t *arrivalTimes;
+    unsigned char *vehicleKinds;
+} ScanBenchData;
+
+#define SCAN_BENCH_LOOKUPS 16
+
+// Exit search without the plate index. Returns the sum of the rows found
+// (-1 for a miss).
+static long scanFindRows(const ScanBenchData *data, const PlateKey *plates) {
+    long sum = 0;
+    for (int k = 0; k < SCAN_BENCH_LOOKUPS; k++) {
+        long found = -1;
+        for (size_t i = 0; i < data->rows && found < 0; i++)
+            if (samePlate(data->vehicles[i].plate, plates[k]))
+                found = (long)i;
+        sum += found;
+    }
+    return sum;
+}
+
+static long scanFindColumns(const ScanBenchData *data, const PlateKey *plates) {
+    long sum = 0;
+    for (int k = 0; k < SCAN_BENCH_LOOKUPS; k++) {
+        long found = -1;
+        for (size_t i = 0; i < data->rows && found < 0; i++)
+            if (samePlate(data->plateKeys[i], plates[k]))
+                found = (long)i;
+        sum += found;
+    }
+    return sum;
+}
+
+// Occupancy rebuild: vehicles per [vehicleType][customerType]
+static long scanOccupancyRows(const ScanBenchData *data) {
+    long counts[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT] = {{0}};
+    for (size_t i = 0; i < data->rows; i++)
+        counts[data->vehicles[i].vehicleType][data->vehicles[i].customerType]++;
+    return counts[CAR][GUEST];
+}
+
+static long scanOccupancyColumns(const ScanBenchData *data) {
+    long counts[VEHICLE_TYPE_COUNT * 16] = {0};
+    for (size_t i = 0; i < data->rows; i++)
+        counts[data->vehicleKinds[i]]++;
+    return counts[VEHICLE_KIND(CAR, GUEST)];
+}
+
+// Overstay check: vehicles that arrived before a cutoff
+static long scanOverstayRows(const ScanBenchData *data, time_t cutoff) {
+    long count = 0;
+    for (size_t i = 0; i < data->rows; i++)
+        count += data->vehicles[i].arrivalTime < cutoff;
+    return count;
+}
+
+static long scanOverstayColumns(const ScanBenchData *data, time_t cutoff) {
+    long count = 0;
+    for (size_t i = 0; i < data->rows; i++)
+        count += data->arrivalTimes[i] < cutoff;
+    return count;
+}
+
+// Runs one scan kernel over both layouts (best of three each) and reports.
+#define BENCH_SCAN_PAIR(label, rowsCall, columnsCall)                           \
+    do {                                                                        \
+        double best[2] = {0, 0};                                                \
+        long results[2] = {0, 0};                                               \
+        for (int pass = 0; pass < 3; pass++) {                                  \
+            for (int layout = 0; layout < 2; layout++) {                        \
+                struct timespec start;                                          \
+                clock_gettime(CLOCK_MONOTONIC, &start);                         \
+                results[layout] = layout == 0 ? (rowsCall) : (columnsCall);     \
+                double seconds = secondsSince(&start);                          \
+                if (pass == 0 || seconds < best[layout])                        \
+                    best[layout] = seconds;                                     \
+            }                                                                   \
+        }                                                                       \
+        printf("  %-10s rows %8.2f ms  columns %8.2f ms  %5.2fx%s\n", label,    \
+               best[0] * 1e3, best[1] * 1e3, best[1] > 0 ? best[0] / best[1] : 0.0, \
+               results[0] == results[1] ? "" : "  MISMATCH");                   \
+        mismatches += results[0] != results[1];                                 \
+    } while (0)
+
+static int benchScan(size_t rows) {
+    ScanBenchData data = {
+        .rows = rows,
+        .vehicles = malloc(rows * sizeof(Vehicle)),
+        .plateKeys = malloc(rows * sizeof(PlateKey)),
+        .arrivalTimes = malloc(rows * sizeof(time_t)),
+        .vehicleKinds = malloc(rows)
+    };
+    if (!data.vehicles || !data.plateKeys || !data.arrivalTimes || !data.vehicleKinds) {
+        fprintf(stderr, "bench: out of memory for %zu rows\n", rows);
+        free(data.vehicles); free(data.plateKeys); free(data.arrivalTimes);
+        free(data.vehicleKinds);
+        return 1;
+    }
+
+    unsigned int seed = 2463534242u;
+    for (size_t i = 0; i < rows; i++) {
+        Vehicle *v = &data.vehicles[i];
+        char plateText[VEHICLE_NUMBER_LENGTH];
+        memset(v, 0, sizeof(*v));
+        snprintf(plateText, sizeof(plateText), "BN-%08u", (unsigned int)i);
+        encodePlate(plateText, &v->plate);
+        v->vehicleType = benchRandom(&seed) % VEHICLE_TYPE_COUNT;
+        v->customerType = benchRandom(&seed) % CUSTOMER_TYPE_COUNT;
+        v->arrivalTime = 1700000000 + benchRandom(&seed) % (72 * 3600);
+
+        data.plateKeys[i] = v->plate;
+        data.vehicleKinds[i] = VEHICLE_KIND(v->vehicleType, v->customerType);
+        data.arrivalTimes[i] = v->arrivalTime;
+    }
+
+    // Lookups for plates spread over the table, plus one that is absent
+    PlateKey plates[SCAN_BENCH_LOOKUPS];
+    for (int k = 0; k < SCAN_BENCH_LOOKUPS; k++) {
+        char plateText[VEHICLE_NUMBER_LENGTH];
+        if (k == SCAN_BENCH_LOOKUPS - 1)
+            snprintf(plateText, sizeof(plateText), "ABSENT");
+        else
+            snprintf(plateText, sizeof(plateText), "BN-%08u",
+                     (unsigned int)(rows * k / SCAN_BENCH_LOOKUPS));
+        encodePlate(plateText, &plates[k]);
+    }
+    time_t cutoff = 1700000000 + 48 * 3600;
+    int mismatches = 0;
+
+    printf("scan: %zu rows (rows: %zu bytes/vehicle, columns: %zu bytes/vehicle)\n", rows,
+           sizeof(Vehicle), sizeof(PlateKey) + sizeof(time_t) + 1);
+    BENCH_SCAN_PAIR("find", scanFindRows(&data, plates), scanFindColumns(&data, plates));
+    BENCH_SCAN_PAIR("occupancy", scanOccupancyRows(&data), scanOccupancyColumns(&data));
+    BENCH_SCAN_PAIR("overstay", scanOverstayRows(&data, cutoff),
+                    scanOverstayColumns(&data, cutoff));
+
+    free(data.vehicles);
+    free(data.plateKeys);
+    free(data.arrivalTimes);
+    free(data.vehicleKinds);
+    return mismatches ? 1 : 0;
+}
+
+// Text plates as vehicles stored them before PlateKey, kept as the
+// baseline for the plate benchmark
+typedef struct {
+    char vehicleNumber[VEHICLE_NUMBER_LENGTH];
+    unsigned int plateHash;  // FNV-1a of vehicleNumber
+    int bayId;
+    enum VehicleType vehicleType;
+    enum CustomerType customerType;
+    time_t arrivalTime;
+} TextPlateVehicle;
+
+static unsigned int hashPlateText(const char *text) {
+    unsigned int hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int comparePlateTexts(const void *a, const void *b) {
+    return strcmp(a, b);
+}
+
+static int comparePlateKeys(const void *a, const void *b) {
+    return comparePlates(*(const PlateKey *)a, *(const PlateKey *)b);
+}
+
+// One plate index probe, as findVehicleIndex() does it: hash the plate
+// looked for, then match it against the stored row. Half of the probes
+// hit; the others are the next plate, which mostly shares a long prefix.
+static long matchPlateTexts(const TextPlateVehicle *rows, char (*probes)[VEHICLE_NUMBER_LENGTH],
+                            size_t count) {
+    long matches = 0;
+    for (size_t i = 0; i < count; i++)
+        matches += rows[i].plateHash == hashPlateText(probes[i]) &&
+                   strcmp(rows[i].vehicleNumber, probes[i]) == 0;
+    return matches;
+}
+
+// The key index does not compare hashes, so the probe hashes are only
+// folded into a sink to keep them from being optimised away
+static volatile unsigned int plateBenchSink;
+
+static long matchPlateKeys(const PlateKey *rows, const PlateKey *probes, size_t count) {
+    long matches = 0;
+    unsigned int hashes = 0;
+    for (size_t i = 0; i < count; i++) {
+        hashes ^= hashPlate(probes[i]);
+        matches += samePlate(rows[i], probes[i]);
+    }
+    plateBenchSink = hashes;
+    return matches;
+}
+
+static long encodePlateRows(const TextPlateVehicle *rows, PlateKey *keys, size_t count) {
+    long encoded = 0;
+    for (size_t i = 0; i < count; i++)
+        encoded += encodePlate(rows[i].vehicleNumber, &keys[i]) == 0;
+    return encoded;
+}
+
+// Best of three runs of call, in nanoseconds per plate
+#define BENCH_PLATE_TIME(nanos, result, call)                                   \
+    do {                                                                        \
+        for (int pass = 0; pass < 3; pass++) {                                  \
+            struct timespec start;                                              \
+            clock_gettime(CLOCK_MONOTONIC, &start);                             \
+            result = (call);                                                    \
+            double perPlate = secondsSince(&start) * 1e9 / (double)rows;        \
+            if (pass == 0 || perPlate < nanos)                                  \
+                nanos = perPlate;                                               \
+        }                                                                       \
+    } while (0)
+
+// Text plates (strcmp + FNV, 20 byte strings) against PlateKey (two word
+// compare + multiply hash): encoding cost, index probes, sorting, and the
+// bytes each layout takes per vehicle. Sorted keys must come out in the
+// same order as the sorted text.
+static int benchPlates(size_t rows) {
+    TextPlateVehicle *textRows = calloc(rows, sizeof(*textRows));
+    char (*textProbes)[VEHICLE_NUMBER_LENGTH] = malloc(rows * VEHICLE_NUMBER_LENGTH);
+    char (*sortedTexts)[VEHICLE_NUMBER_LENGTH] = malloc(rows * VEHICLE_NUMBER_LENGTH);
+    PlateKey *keyRows = malloc(rows * sizeof(PlateKey));
+    PlateKey *keyProbes = malloc(rows * sizeof(PlateKey));
+    PlateKey *sortedKeys = malloc(rows * sizeof(PlateKey));
+    if (!textRows || !textProbes || !sortedTexts || !keyRows || !keyProbes || !sortedKeys) {
+        fprintf(stderr, "bench: out of memory for %zu rows\n", rows);
+        free(textRows); free(textProbes); free(sortedTexts);
+        free(keyRows); free(keyProbes); free(sortedKeys);
+        return 1;
+    }
+
+    // Plates like "WP-CAB-1234": a province, two or three letters, a number
+    static const char *provinces[] = {"WP", "CP", "SP", "NW", "SG", "UP"};
+    unsigned int seed = 2463534242u;
+    for (size_t i = 0; i < rows; i++) {
+        char letters[4];
+        int letterCount = 2 + (int)(benchRandom(&seed) % 2);
+        for (int k = 0; k < letterCount; k++)
+            letters[k] = (char)('A' + benchRandom(&seed) % 26);
+        letters[letterCount] = '\0';
+        snprintf(textRows[i].vehicleNumber, VEHICLE_NUMBER_LENGTH, "%s-%s-%04u",
+                 provinces[benchRandom(&seed) % ARRAY_COUNT(provinces)], letters,
+                 benchRandom(&seed) % 10000);
+        textRows[i].plateHash = hashPlateText(textRows[i].vehicleNumber);
+    }
+    for (size_t i = 0; i < rows; i++) {
+        const char *probe = textRows[i % 2 == 0 || rows == 1 ? i : (i + 1) % rows].vehicleNumber;
+        memcpy(textProbes[i], probe, VEHICLE_NUMBER_LENGTH);
+        memcpy(sortedTexts[i], textRows[i].vehicleNumber, VEHICLE_NUMBER_LENGTH);
+    }
+
+    double encodeNanos = 0;
+    long encoded = 0;
+    BENCH_PLATE_TIME(encodeNanos, encoded, encodePlateRows(textRows, keyRows, rows));
+    int errors = encoded != (long)rows;
+    for (size_t i = 0; i < rows; i++) {
+        encodePlate(textProbes[i], &keyProbes[i]);
+        sortedKeys[i] = keyRows[i];
+    }
+
+    double textNanos = 0, keyNanos = 0;
+    long textResult = 0, keyResult = 0;
+    printf("plates: %zu plates, encodePlate %.1f ns each\n", rows, encodeNanos);
+
+    BENCH_PLATE_TIME(textNanos, textResult, matchPlateTexts(textRows, textProbes, rows));
+    BENCH_PLATE_TIME(keyNanos, keyResult, matchPlateKeys(keyRows, keyProbes, rows));
+    printf("  %-7s text %7.2f ns  key %7.2f ns  %5.2fx%s\n", "probe", textNanos, keyNanos,
+           keyNanos > 0 ? textNanos / keyNanos : 0.0, textResult == keyResult ? "" : "  MISMATCH");
+    errors += textResult != keyResult;
+
+    // One pass each: sorting sorted input again would not measure much
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    qsort(sortedTexts, rows, VEHICLE_NUMBER_LENGTH, comparePlateTexts);
+    textNanos = secondsSince(&start) * 1e9 / (double)rows;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    qsort(sortedKeys, rows, sizeof(PlateKey), comparePlateKeys);
+    keyNanos = secondsSince(&start) * 1e9 / (double)rows;
+    long misordered = 0;
+    for (size_t i = 0; i < rows; i++) {
+        char plateText[VEHICLE_NUMBER_LENGTH];
+        misordered += strcmp(formatPlate(sortedKeys[i], plateText), sortedTexts[i]) != 0;
+    }
+    printf("  %-7s text %7.2f ns  key %7.2f ns  %5.2fx%s\n", "sort", textNanos, keyNanos,
+           keyNanos > 0 ? textNanos / keyNanos : 0.0, misordered ? "  MISORDERED" : "");
+    errors += misordered != 0;
+
+    printf("  memory  Vehicle %zu -> %zu bytes, lot plate columns %zu -> %zu bytes per bay\n",
+           sizeof(TextPlateVehicle), sizeof(Vehicle),
+           (size_t)VEHICLE_NUMBER_LENGTH + sizeof(unsigned int), sizeof(PlateKey));
+
+    free(textRows);
+    free(textProbes);
+    free(sortedTexts);
+    free(keyRows);
+    free(keyProbes);
+    free(sortedKeys);
+    return errors ? 1 : 0;
+}
+
+// The views as they were drawn before the render buffer (one stdio call
+// per symbol), kept as the baseline for the render benchmark.
+static void renderParkingSpaceStdio(FILE *out, ParkingManagement *lot) {
+    fprintf(out, "\n+======================================================= Parking Space ============================================================\n\n");
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        fprintf(out, "%-15s: { ", VehicleTypeNames[i]);
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+            int allocated = slotAllocated(&lot->slots[i][j]);
+            int free = slotFree(&lot->slots[i][j]);
+            for (int k = 0; k < allocated; k++) fprintf(out, "%s", CustomerTypeSymbols[j]);
+            for (int k = 0; k < free; k++) fprintf(out, "F");
+            if (j < CUSTOMER_TYPE_COUNT - 1) fprintf(out, " | ");
+        }
+        fprintf(out, " }\n");
+    }
+    fprintf(out, "\n+================================================================================================================================+\n\n");
+}
+
+static void renderStatisticsGraphStdio(FILE *out, ParkingManagement *lot) {
+    int vehicleColWidth = 15;
+    int customerColWidth = 25;
+    int barWidth = 20;
+
+    fprintf(out, "\n+==================================================================== Parking Graph ===================================================================+\n");
+    fprintf(out, "| %-*s|", vehicleColWidth, "Vehicle Type");
+    for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++)
+        fprintf(out, " %-*s ", customerColWidth, CustomerTypeNames[j]);
+    fprintf(out, "\n");
+    fprintf(out, "%.*s", vehicleColWidth + 2, "==============================");
+    for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++)
+        fprintf(out, "%.*s", customerColWidth + 2, "===============================");
+    fprintf(out, "\n");
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
+        fprintf(out, "|%-*s |", vehicleColWidth, VehicleTypeNames[i]);
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+            int allocated = slotAllocated(&lot->slots[i][j]);
+            int free = slotFree(&lot->slots[i][j]);
+            int totalSlots = allocated + free;
+            int scale = totalSlots > barWidth ? totalSlots / barWidth + 1 : 1;
+            int allocBars = allocated / scale;
+            int freeBars = free / scale;
+            for (int k = 0; k < allocBars; k++) fprintf(out, "#");
+            for (int k = 0; k < freeBars; k++) fprintf(out, "*");
+            for (int k = 0; k < customerColWidth - (allocBars + freeBars); k++) fprintf(out, " ");
+        }
+        fprintf(out, "\n");
+    }
+    fprintf(out, "+===================================================================================================================================================+\n");
+}
+
+// Frames of parking space + graph for the default lot while one bay
+// changes per frame, drawn to /dev/null.
+static int benchRender(long frames) {
+    int capacities[] = {MAX_MOTORCYCLES, MAX_THREE_WHEELERS, MAX_CARS, MAX_VANS, MAX_BUSES};
+    ParkingManagement lot;
+    if (initializeParking(&lot, DEFAULT_LOT_ID, capacities, DEFAULT_QUOTA_PERCENT) != 0)
+        return 1;
+    int fd = open("/dev/null", O_WRONLY);
+    FILE *out = fdopen(dup(fd), "w");
+    if (fd < 0 || !out) {
+        fprintf(stderr, "bench: cannot open /dev/null\n");
+        freeParking(&lot);
+        return 1;
+    }
+
+    static const char *modes[] = {"stdio", "buffer", "diff"};
+    RenderBuffer buffer = {0};
+    printf("render: %ld frames, parking space + graph, lot of %d slots\n",
+           frames, lot.vehicleCapacity);
+    for (int mode = 0; mode < 3; mode++) {
+        unsigned int seed = 2463534242u;
+        size_t bytes = 0;
+        buffer.hasPrevious = 0;
+        resetParking(&lot);
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (long frame = 0; frame < frames; frame++) {
+            // Flip one random bay
+            int type = benchRandom(&seed) % VEHICLE_TYPE_COUNT;
+            int tier = benchRandom(&seed) % CUSTOMER_TYPE_COUNT;
+            if (lot.bayCount[type][tier] > 0) {
+                int bayId = lot.bayStart[type][tier] + 1 + benchRandom(&seed) % lot.bayCount[type][tier];
+                if (bayOccupied(&lot, type, tier, bayId)) {
+                    freeBay(&lot, type, tier, bayId);
+                    releaseCell(&lot, type, tier);
+                    publishOccupancy(&lot, type, tier, -1);
+                } else if (reserveCell(&lot, type, tier, 1)) {
+                    takeBay(&lot, type, tier, bayId);
+                    publishOccupancy(&lot, type, tier, 1);
+                }
+            }
+
+            if (mode == 0) {
+                renderParkingSpaceStdio(out, &lot);
+                renderStatisticsGraphStdio(out, &lot);
+                fflush(out);
+                continue;
+            }
+            renderReset(&buffer);
+            renderParkingSpace(&buffer, &lot);
+            renderStatisticsGraph(&buffer, &lot);
+            long written = mode == 1 ? renderFlush(&buffer, fd) : renderFlushDiff(&buffer, fd);
+            if (written > 0)
+                bytes += (size_t)written;
+        }
+        double seconds = secondsSince(&start);
+        printf("  %-7s %10.0f frames/s", modes[mode], seconds > 0 ? frames / seconds : 0.0);
+        if (mode > 0)
+            printf("  %8zu bytes/frame", bytes / (size_t)frames);
+        printf("\n");
+    }
+
+    free(buffer.data);
+    free(buffer.previous);
+    fclose(out);
+    close(fd);
+    freeParking(&lot);
+    return 0;
+}
+
+static int compareLongs(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+static void printLatencies(const char *label, long *samples, long count) {
+    qsort(samples, (size_t)count, sizeof(*samples), compareLongs);
+    printf("  %-6s p50 %6ld ns  p99 %6ld ns  p99.9 %6ld ns  max %7ld ns\n", label,
+           samples[count / 2], samples[count * 99 / 100], samples[count * 999 / 1000],
+           samples[count - 1]);
+}
+
+static long nanosSince(const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1000000000L + (end.tv_nsec - start->tv_nsec);
+}
+
+// Bay take/free latency in one large cell held at 99% occupancy: each
+// operation frees a random occupied bay, then takes the lowest free one.
+static int benchBays(int bays) {
+    int capacities[VEHICLE_TYPE_COUNT] = {[CAR] = bays};
+    int quotaPercent[CUSTOMER_TYPE_COUNT] = {[GUEST] = 100};
+    ParkingManagement lot;
+    if (initializeParking(&lot, DEFAULT_LOT_ID, capacities, quotaPercent) != 0)
+        return 1;
+
+    long *takeSamples = malloc(BENCH_BAY_OPERATIONS * sizeof(long));
+    long *freeSamples = malloc(BENCH_BAY_OPERATIONS * sizeof(long));
+    if (!takeSamples || !freeSamples) {
+        free(takeSamples);
+        free(freeSamples);
+        freeParking(&lot);
+        return 1;
+    }
+
+    int start = lot.bayStart[CAR][GUEST];
+    int target = bays - bays / 100;
+    for (int i = 0; i < target; i++)
+        takeBay(&lot, CAR, GUEST, 0);
+    // Scatter the free 1% over the whole map
+    unsigned int seed = 2463534242u;
+    for (int i = 0; i < bays / 100; i++) {
+        int bayId = start + 1 + (int)(benchRandom(&seed) % (unsigned int)bays);
+        if (bayOccupied(&lot, CAR, GUEST, bayId)) {
+            freeBay(&lot, CAR, GUEST, bayId);
+            takeBay(&lot, CAR, GUEST, 0);
+        }
+    }
+
+    int errors = 0;
+    for (long n = 0; n < BENCH_BAY_OPERATIONS; n++) {
+        int bayId;
+        do {
+            bayId = start + 1 + (int)(benchRandom(&seed) % (unsigned int)bays);
+        } while (!bayOccupied(&lot, CAR, GUEST, bayId));
+
+        struct timespec begin;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        freeBay(&lot, CAR, GUEST, bayId);
+        freeSamples[n] = nanosSince(&begin);
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        errors += takeBay(&lot, CAR, GUEST, 0) == 0;
+        takeSamples[n] = nanosSince(&begin);
+    }
+
+    printf("bays: %d bays at 99%% occupancy, %d operations (timer overhead included)\n",
+           bays, BENCH_BAY_OPERATIONS);
+    printLatencies("take", takeSamples, BENCH_BAY_OPERATIONS);
+    printLatencies("free", freeSamples, BENCH_BAY_OPERATIONS);
+
+    free(takeSamples);
+    free(freeSamples);
+    freeParking(&lot);
+    return errors ? 1 : 0;
+}
+
+static void benchPlate(PlateKey *plate, unsigned int serial) {
+    char plateText[VEHICLE_NUMBER_LENGTH];
+    snprintf(plateText, sizeof(plateText), "OPS%08u", serial % 100000000u);
+    encodePlate(plateText, plate);
+}
+
+// A random parked vehicle's row; the lot must not be empty. Rows are bays,
+// so this probes from a random bay to the next occupied one.
+static int benchParkedRow(const ParkingManagement *lot, unsigned int *seed) {
+    int row = (int)(benchRandom(seed) % (unsigned int)lot->vehicleCapacity);
+    while (lot->vehicleKinds[row] == VEHICLE_KIND_EMPTY)
+        row = (row + 1) % lot->vehicleCapacity;
+    return row;
+}
+
+// Parks random vehicles until the lot holds target of them (or gives up
+// when the remaining cells refuse every request).
+static void benchFillLot(ParkingManagement *lot, int target, unsigned int *serial,
+                         unsigned int *seed, time_t now) {
+    long attempts = 0;
+    while (storedVehicles(lot) < target && attempts++ < 50L * lot->vehicleCapacity) {
+        Vehicle v;
+        benchPlate(&v.plate, *serial);
+        v.vehicleType = benchRandom(seed) % VEHICLE_TYPE_COUNT;
+        v.customerType = benchRandom(seed) % CUSTOMER_TYPE_COUNT;
+        if (parkVehicle(lot, &v, now - benchRandom(seed) % (3 * 24 * 3600)) == PARK_OK)
+            (*serial)++;
+    }
+}
+
+// End-to-end latency of the lot operations at several occupancy levels:
+// entry and exit (journaled to a scratch directory), printed bills, view
+// rendering (parking space, graph and summary views), snapshot save and
+// load. Every phase runs a warmup of a tenth
+// of its samples first.
+static int benchOperations(int bays) {
+    static const int levels[] = {25, 50, 90, 99};
+    int capacities[VEHICLE_TYPE_COUNT];
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        capacities[i] = bays / VEHICLE_TYPE_COUNT;
+    ParkingManagement lot;
+    if (initializeParking(&lot, 0, capacities, DEFAULT_QUOTA_PERCENT) != 0)
+        return 1;
+
+    char directory[] = "/tmp/parking-bench-XXXXXX";
+    long *samples = malloc(BENCH_OPS_PAIRS * sizeof(long));
+    long *exitSamples = malloc(BENCH_OPS_PAIRS * sizeof(long));
+    int devNull = open("/dev/null", O_WRONLY);
+    if (!samples || !exitSamples || devNull < 0 || !mkdtemp(directory)) {
+        fprintf(stderr, "bench: cannot set up the ops benchmark\n");
+        free(samples);
+        free(exitSamples);
+        if (devNull >= 0) close(devNull);
+        freeParking(&lot);
+        return 1;
+    }
+    snprintf(lot.snapshotFile, sizeof(lot.snapshotFile), "%s/%s", directory, SNAPSHOT_SUFFIX);
+    snprintf(lot.snapshotTempFile, sizeof(lot.snapshotTempFile), "%s/%s",
+             directory, SNAPSHOT_TEMP_SUFFIX);
+    snprintf(lot.journalFileName, sizeof(lot.journalFileName), "%s/%s", directory, JOURNAL_SUFFIX);
+
+    printf("ops: lot of %d bays, %d enter/exit pairs, %d bills, %d renders, "
+           "%d saves and loads per level\n", lot.vehicleCapacity, BENCH_OPS_PAIRS,
+           BENCH_OPS_BILLS, BENCH_OPS_RENDERS, BENCH_OPS_FILE_ROUNDS);
+
+    unsigned int seed = 2463534242u, serial = 0;
+    time_t now = time(NULL);
+    int errors = 0;
+    ParkingManagement *viewedLot = parking;
+    parking = &lot; // the views render the current lot
+    resetOperationTimings();
+    openJournal(&lot);
+    for (size_t level = 0; level < ARRAY_COUNT(levels); level++) {
+        benchFillLot(&lot, (int)((long)lot.vehicleCapacity * levels[level] / 100),
+                     &serial, &seed, now);
+        printf("  %d%% target, %d vehicles parked\n", levels[level], storedVehicles(&lot));
+        if (storedVehicles(&lot) == 0)
+            continue;
+
+        // Each pair exits a random vehicle, then parks a new one of the
+        // same kind, so occupancy holds steady
+        int warmup = BENCH_OPS_PAIRS / 10;
+        for (int n = -warmup; n < BENCH_OPS_PAIRS && storedVehicles(&lot) > 0; n++) {
+            int pick = benchParkedRow(&lot, &seed);
+            Vehicle v;
+            Bill bill;
+            PlateKey plate = lot.plateKeys[pick];
+            struct timespec begin;
+            clock_gettime(CLOCK_MONOTONIC, &begin);
+            errors += unparkVehicle(&lot, plate, now, &v, &bill) != 0;
+            long exitNanos = nanosSince(&begin);
+
+            benchPlate(&v.plate, serial);
+            clock_gettime(CLOCK_MONOTONIC, &begin);
+            enum ParkResult result = parkVehicle(&lot, &v, now - benchRandom(&seed) % (3 * 24 * 3600));
+            long enterNanos = nanosSince(&begin);
+            if (result == PARK_OK)
+                serial++;
+            if (n >= 0) {
+                samples[n] = enterNanos;
+                exitSamples[n] = exitNanos;
+            }
+        }
+        printLatencies("enter", samples, BENCH_OPS_PAIRS);
+        printLatencies("exit", exitSamples, BENCH_OPS_PAIRS);
+
+        // Bills and views go to /dev/null through the real output path
+        fflush(stdout);
+        int savedStdout = dup(STDOUT_FILENO);
+        dup2(devNull, STDOUT_FILENO);
+        for (int n = -BENCH_OPS_BILLS / 10; n < BENCH_OPS_BILLS; n++) {
+            Vehicle v;
+            getVehicleAt(&lot, benchParkedRow(&lot, &seed), &v);
+            struct timespec begin;
+            clock_gettime(CLOCK_MONOTONIC, &begin);
+            Bill bill = calculateBill(&v, now);
+            generateBill(&v, now, &bill);
+            fflush(stdout);
+            if (n >= 0)
+                samples[n] = nanosSince(&begin);
+        }
+        long *renderSamples = exitSamples;
+        for (int n = -BENCH_OPS_RENDERS / 10; n < BENCH_OPS_RENDERS; n++) {
+            struct timespec begin;
+            clock_gettime(CLOCK_MONOTONIC, &begin);
+            viewParkingSpace();
+            viewStatisticsGraph();
+            viewStatisticsSummary();
+            fflush(stdout);
+            if (n >= 0)
+                renderSamples[n] = nanosSince(&begin);
+        }
+        dup2(savedStdout, STDOUT_FILENO);
+        close(savedStdout);
+        printLatencies("bill", samples, BENCH_OPS_BILLS);
+        printLatencies("render", renderSamples, BENCH_OPS_RENDERS);
+
+        for (int n = -1; n < BENCH_OPS_FILE_ROUNDS; n++) {
+            struct timespec begin;
+            clock_gettime(CLOCK_MONOTONIC, &begin);
+            saveParkingData(&lot);
+            if (n >= 0)
+                samples[n] = nanosSince(&begin);
+        }
+        printLatencies("save", samples, BENCH_OPS_FILE_ROUNDS);
+
+        closeJournal(&lot);
+        int expected = storedVehicles(&lot);
+        for (int n = -1; n < BENCH_OPS_FILE_ROUNDS; n++) {
+            resetParking(&lot);
+            struct timespec begin;
+            clock_gettime(CLOCK_MONOTONIC, &begin);
+            loadParkingData(&lot);
+            if (n >= 0)
+                samples[n] = nanosSince(&begin);
+            errors += storedVehicles(&lot) != expected;
+            if (n + 1 < BENCH_OPS_FILE_ROUNDS)
+                closeJournal(&lot);
+        }
+        printLatencies("load", samples, BENCH_OPS_FILE_ROUNDS);
+    }
+    closeJournal(&lot);
+
+    // The same run as seen by the built-in counters
+    printOperationTimings(stdout);
+
+    remove(lot.snapshotFile);
+    remove(lot.snapshotTempFile);
+    remove(lot.journalFileName);
+    rmdir(directory);
+    parking = viewedLot;
+    free(samples);
+    free(exitSamples);
+    close(devNull);
+    freeParking(&lot);
+    return errors ? 1 : 0;
+}
+
+typedef struct {
+    ParkingManagement *lot;
+    int gate;
+    unsigned int seed;
+    unsigned int *serials;    // plates this gate has parked
+    int parked;
+    int capacity;
+    unsigned int nextSerial;
+    long *samples;            // one per enter and per exit
+    _Atomic int *go;
+} ReportBenchGate;
+
+typedef struct {
+    ParkingManagement *lot;
+    int locked;
+    int fd;
+    _Atomic int *stop;
+    long reports;
+    long inconsistent;
+} ReportBenchReader;
+
+static void reportBenchPlate(PlateKey *plate, int gate, unsigned int serial) {
+    char plateText[VEHICLE_NUMBER_LENGTH];
+    snprintf(plateText, sizeof(plateText), "RPT%02d-%07u", gate, serial % 10000000u);
+    encodePlate(plateText, plate);
+}
+
+// Parks one more vehicle of a random kind for this gate
+static void reportBenchEnter(ReportBenchGate *gate, time_t now) {
+    Vehicle v;
+    reportBenchPlate(&v.plate, gate->gate, gate->nextSerial);
+    v.vehicleType = benchRandom(&gate->seed) % VEHICLE_TYPE_COUNT;
+    v.customerType = benchRandom(&gate->seed) % CUSTOMER_TYPE_COUNT;
+    if (gate->parked < gate->capacity && parkVehicle(gate->lot, &v, now) == PARK_OK)
+        gate->serials[gate->parked++] = gate->nextSerial;
+    gate->nextSerial++;
+}
+
+static void *runReportBenchGate(void *arg) {
+    ReportBenchGate *gate = arg;
+    time_t now = time(NULL);
+    while (!atomic_load(gate->go))
+        ;
+    for (int n = 0; n < BENCH_REPORT_PAIRS; n++) {
+        struct timespec begin;
+        long exitNanos = 0;
+        if (gate->parked > 0) {
+            int pick = (int)(benchRandom(&gate->seed) % (unsigned int)gate->parked);
+            Vehicle v;
+            Bill bill;
+            PlateKey plate;
+            reportBenchPlate(&plate, gate->gate, gate->serials[pick]);
+            gate->serials[pick] = gate->serials[--gate->parked];
+            clock_gettime(CLOCK_MONOTONIC, &begin);
+            unparkVehicle(gate->lot, plate, now, &v, &bill);
+            exitNanos = nanosSince(&begin);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        reportBenchEnter(gate, now);
+        gate->samples[2 * n] = nanosSince(&begin);
+        gate->samples[2 * n + 1] = exitNanos;
+    }
+    return NULL;
+}
+
+// A report: the graph view plus the per-cell table, either from the
+// occupancy view or from the live slots with every statsLock held throughout
+static void *runReportBenchReader(void *arg) {
+    ReportBenchReader *reader = arg;
+    RenderBuffer buffer = {0};
+    while (!atomic_load(reader->stop)) {
+        renderReset(&buffer);
+        if (reader->locked) {
+            for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+                lockLotMutex(reader->lot, &reader->lot->stores[i].statsLock);
+            renderStatisticsGraph(&buffer, reader->lot);
+            for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+                for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++)
+                    renderFormat(&buffer, "| %-15s | %-15s | %-10d | %-10d |\n",
+                                 VehicleTypeNames[i], CustomerTypeNames[j],
+                                 slotAllocated(&reader->lot->slots[i][j]),
+                                 slotFree(&reader->lot->slots[i][j]));
+            renderFlush(&buffer, reader->fd);
+            for (int i = VEHICLE_TYPE_COUNT - 1; i >= 0; i--)
+                pthread_mutex_unlock(&reader->lot->stores[i].statsLock);
+        } else {
+            OccupancyView view;
+            readOccupancy(reader->lot, &view);
+            int allocated = 0;
+            for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+                for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
+                    allocated += view.allocated[i][j];
+                    renderFormat(&buffer, "| %-15s | %-15s | %-10d | %-10d |\n",
+                                 VehicleTypeNames[i], CustomerTypeNames[j],
+                                 view.allocated[i][j], view.free[i][j]);
+                }
+            reader->inconsistent += allocated != view.occupied;
+            renderStatisticsGraph(&buffer, reader->lot);
+            renderFlush(&buffer, reader->fd);
+        }
+        reader->reports++;
+    }
+    free(buffer.data);
+    free(buffer.previous);
+    return NULL;
+}
+
+// Gate latency (enter and exit) of gates threads on one lot held near 90%
+// occupancy: without reports, with report threads reading the occupancy
+// view, and with report threads that hold every statsLock while they render, as
+// a consistent report without the view would have to.
+static int benchReports(int gates) {
+    static const char *modes[] = {"idle", "view", "locked"};
+    int capacities[VEHICLE_TYPE_COUNT];
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        capacities[i] = BENCH_REPORT_BAYS / VEHICLE_TYPE_COUNT;
+    ParkingManagement lot;
+    if (initializeParking(&lot, 0, capacities, DEFAULT_QUOTA_PERCENT) != 0)
+        return 1;
+
+    ReportBenchGate *gateStates = calloc((size_t)gates, sizeof(*gateStates));
+    long *samples = malloc((size_t)gates * 2 * BENCH_REPORT_PAIRS * sizeof(long));
+    int devNull = open("/dev/null", O_WRONLY);
+    if (!gateStates || !samples || devNull < 0) {
+        fprintf(stderr, "bench: cannot set up the reports benchmark\n");
+        free(gateStates);
+        free(samples);
+        if (devNull >= 0) close(devNull);
+        freeParking(&lot);
+        return 1;
+    }
+
+    int ok = 1;
+    time_t now = time(NULL);
+    for (int g = 0; g < gates; g++) {
+        gateStates[g].lot = &lot;
+        gateStates[g].gate = g;
+        gateStates[g].seed = 2463534242u + (unsigned int)g * 7919u;
+        gateStates[g].capacity = lot.vehicleCapacity * 9 / 10 / gates;
+        gateStates[g].serials = malloc((size_t)(gateStates[g].capacity + 1) * sizeof(unsigned int));
+        gateStates[g].samples = samples + (size_t)g * 2 * BENCH_REPORT_PAIRS;
+        ok &= gateStates[g].serials != NULL;
+        for (int n = 0; ok && n < 4 * gateStates[g].capacity &&
+                        gateStates[g].parked < gateStates[g].capacity; n++)
+            reportBenchEnter(&gateStates[g], now);
+    }
+
+    printf("reports: lot of %d bays, %d vehicles parked, %d gate thread(s) x %d enter/exit "
+           "pairs, %d report thread(s)\n", lot.vehicleCapacity, storedVehicles(&lot), gates,
+           BENCH_REPORT_PAIRS, BENCH_REPORT_READERS);
+    long inconsistent = 0;
+    for (int mode = 0; ok && mode < 3; mode++) {
+        _Atomic int go = 0, stop = 0;
+        pthread_t gateThreads[MAX_GATE_WORKERS], readerThreads[BENCH_REPORT_READERS];
+        ReportBenchReader readers[BENCH_REPORT_READERS];
+        int readerCount = mode == 0 ? 0 : BENCH_REPORT_READERS;
+        for (int r = 0; r < readerCount; r++) {
+            readers[r] = (ReportBenchReader){&lot, mode == 2, devNull, &stop, 0, 0};
+            pthread_create(&readerThreads[r], NULL, runReportBenchReader, &readers[r]);
+        }
+        for (int g = 0; g < gates; g++) {
+            gateStates[g].go = &go;
+            pthread_create(&gateThreads[g], NULL, runReportBenchGate, &gateStates[g]);
+        }
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        atomic_store(&go, 1);
+        for (int g = 0; g < gates; g++)
+            pthread_join(gateThreads[g], NULL);
+        double seconds = secondsSince(&start);
+        atomic_store(&stop, 1);
+        long reports = 0;
+        for (int r = 0; r < readerCount; r++) {
+            pthread_join(readerThreads[r], NULL);
+            reports += readers[r].reports;
+            inconsistent += readers[r].inconsistent;
+        }
+
+        printf("  %-6s %8.0f reports/s\n", modes[mode], seconds > 0 ? reports / seconds : 0.0);
+        printLatencies("gate", samples, (long)gates * 2 * BENCH_REPORT_PAIRS);
+    }
+    printf("  inconsistent views: %ld\n", inconsistent);
+
+    for (int g = 0; g < gates; g++)
+        free(gateStates[g].serials);
+    free(gateStates);
+    free(samples);
+    close(devNull);
+    freeParking(&lot);
+    return ok && inconsistent == 0 ? 0 : 1;
+}
+
+// Overstay listing with the deadline heap against a scan of the arrival
+// column, then the cost of one advance per simulated minute over a day.
+static int benchOverstay(int vehicles) {
+    int capacities[VEHICLE_TYPE_COUNT];
+    int quotaPercent[CUSTOMER_TYPE_COUNT] = {[GUEST] = 100};
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        capacities[i] = (vehicles + VEHICLE_TYPE_COUNT - 1) / VEHICLE_TYPE_COUNT;
+    ParkingManagement lot;
+    if (initializeParking(&lot, DEFAULT_LOT_ID, capacities, quotaPercent) != 0)
+        return 1;
+
+    // Arrivals in time order over the last 36 hours
+    unsigned int seed = 2463534242u;
+    time_t now = 1700000000;
+    time_t span = 36 * 3600;
+    for (int i = 0; i < vehicles; i++) {
+        Vehicle v;
+        char plateText[VEHICLE_NUMBER_LENGTH];
+        snprintf(plateText, sizeof(plateText), "OV%07u", (unsigned int)i);
+        encodePlate(plateText, &v.plate);
+        v.vehicleType = i % VEHICLE_TYPE_COUNT;
+        v.customerType = GUEST;
+        v.arrivalTime = now - span + (time_t)((long long)span * i / vehicles) +
+                        (time_t)(benchRandom(&seed) % 60);
+        v.bayId = 0;
+        if (admitVehicle(&lot, &v) != 0) {
+            fprintf(stderr, "bench: could not park %s\n", plateText);
+            freeParking(&lot);
+            return 1;
+        }
+    }
+
+    struct timespec start;
+    long scanned = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < lot.vehicleCapacity; i++) {
+        if (lot.vehicleKinds[i] == VEHICLE_KIND_EMPTY)
+            continue;
+        int type = KIND_VEHICLE_TYPE(lot.vehicleKinds[i]);
+        scanned += lot.arrivalTimes[i] + (time_t)MAX_DWELL_HOURS[type] * 3600 < now;
+    }
+    double scanSeconds = secondsSince(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int firstListed = 0;
+    for (int t = 0; t < VEHICLE_TYPE_COUNT; t++)
+        firstListed += advanceOverstays(&lot, t, now);
+    double firstSeconds = secondsSince(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int listed = listOverstays(&lot, now, NULL, 0);
+    double listSeconds = secondsSince(&start);
+
+    printf("overstay: %d parked vehicles, %ld overstaying\n", storedVehicles(&lot), scanned);
+    printf("  %-26s %10.3f ms\n", "scan of arrival column", scanSeconds * 1e3);
+    printf("  %-26s %10.3f ms  (%d moved to the list)\n", "first advance",
+           firstSeconds * 1e3, firstListed);
+    printf("  %-26s %10.3f ms\n", "list when up to date", listSeconds * 1e3);
+
+    // One tick per minute for a day; each vehicle is listed exactly once
+    long *samples = malloc(24 * 60 * sizeof(long));
+    if (!samples) {
+        freeParking(&lot);
+        return 1;
+    }
+    long ticked = 0;
+    for (int tick = 0; tick < 24 * 60; tick++) {
+        struct timespec begin;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        for (int t = 0; t < VEHICLE_TYPE_COUNT; t++)
+            ticked += advanceOverstays(&lot, t, now + (tick + 1) * 60);
+        samples[tick] = nanosSince(&begin);
+    }
+    printf("  %ld listed over the next day (%.1f per minute tick)\n", ticked, ticked / 1440.0);
+    printLatencies("tick", samples, 24 * 60);
+
+    long overstaying = 0;
+    for (int t = 0; t < VEHICLE_TYPE_COUNT; t++)
+        overstaying += lot.stores[t].overstayListCount;
+    int errors = listed != scanned || overstaying != scanned + ticked;
+    if (errors)
+        fprintf(stderr, "bench: heap listed %d, scan found %ld\n", listed, scanned);
+    free(samples);
+    freeParking(&lot);
+    return errors;
+}
+
+static void removeArchiveFiles(const char *prefix, long *bytes) {
+    long *days;
+    int count = listArchiveDays(prefix, LONG_MIN, LONG_MAX, &days);
+    for (int d = 0; d < count; d++) {
+        char name[LOT_FILE_NAME_LENGTH + 16];
+        struct stat info;
+        archiveFileName(prefix, days[d], name, sizeof(name));
+        if (bytes && stat(name, &info) == 0)
+            *bytes += (long)info.st_size;
+        remove(name);
+    }
+    if (count >= 0)
+        free(days);
+}
+
+// Writes days of synthetic sessions through the archive (into a scratch
+// directory), then times revenue and occupancy queries over them with a
+// warm page cache.
+static int benchArchive(int days) {
+    int capacities[VEHICLE_TYPE_COUNT] = {100, 100, 100, 100, 100};
+    ParkingManagement lot;
+    if (initializeParking(&lot, DEFAULT_LOT_ID, capacities, DEFAULT_QUOTA_PERCENT) != 0)
+        return 1;
+    char directory[] = "/tmp/parking-bench-XXXXXX";
+    if (!mkdtemp(directory)) {
+        fprintf(stderr, "bench: cannot create a scratch directory\n");
+        freeParking(&lot);
+        return 1;
+    }
+    snprintf(lot.archivePrefix, sizeof(lot.archivePrefix), "%s/%s", directory, ARCHIVE_SUFFIX);
+    lot.archiving = 1;
+
+    // Exits spread evenly over each day; most stays are under 8 hours, one
+    // in fifty lasts up to three days
+    long firstDay = daysFromCivil(2024, 1, 1);
+    long sessions = (long)days * BENCH_ARCHIVE_SESSIONS_PER_DAY;
+    long long expectedCents = 0;
+    unsigned int seed = 2463534242u;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long n = 0; n < sessions; n++) {
+        time_t exitTime = (time_t)firstDay * 86400 + (time_t)(n * 86400 / BENCH_ARCHIVE_SESSIONS_PER_DAY);
+        unsigned int r = benchRandom(&seed);
+        time_t dwell = r % 50 == 0 ? 600 + benchRandom(&seed) % (3 * 86400)
+                                   : 600 + benchRandom(&seed) % (8 * 3600);
+        Vehicle v;
+        v.vehicleType = benchRandom(&seed) % VEHICLE_TYPE_COUNT;
+        v.customerType = benchRandom(&seed) % CUSTOMER_TYPE_COUNT;
+        v.arrivalTime = exitTime - dwell;
+        Bill bill = calculateBill(&v, exitTime);
+        archiveSession(&lot, &v, exitTime, &bill);
+        expectedCents += bill.payableCents;
+    }
+    flushArchive(&lot);
+    double writeSeconds = secondsSince(&start);
+
+    char last[16];
+    formatArchiveDay(firstDay + days - 1, last, sizeof(last));
+    printf("archive: %ld sessions over %d days (2024-01-01 .. %s)\n", sessions, days, last);
+    printf("  %-32s %9.3f s  %10.0f sessions/s\n", "write", writeSeconds,
+           writeSeconds > 0 ? sessions / writeSeconds : 0.0);
+
+    int errors = 0;
+    for (int q = 0; q < 4; q++) {
+        static const char *labels[] = {
+            "revenue by type, whole range", "revenue by type, first 30 days",
+            "hourly occupancy, first 30 days", "hourly occupancy, whole range"
+        };
+        long lastDay = q == 0 || q == 3 ? firstDay + days - 1 : firstDay + (days < 30 ? days : 30) - 1;
+        long hours = (lastDay - firstDay + 1) * 24;
+        ArchiveRevenue revenue;
+        memset(&revenue, 0, sizeof(revenue));
+        long *parkedByHour = calloc((size_t)hours, sizeof(long));
+        if (!parkedByHour) {
+            errors++;
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int result = q < 2 ? queryArchiveRevenue(lot.archivePrefix, firstDay, lastDay, &revenue)
+                           : queryArchiveOccupancy(lot.archivePrefix, firstDay, lastDay, parkedByHour);
+        double seconds = secondsSince(&start);
+        errors += result != 0;
+        printf("  %-32s %9.3f s", labels[q], seconds);
+        if (q < 2) {
+            long scanned = 0;
+            long long total = 0;
+            for (int t = 0; t < VEHICLE_TYPE_COUNT; t++) {
+                scanned += revenue.sessions[t];
+                total += revenue.revenueCents[t];
+            }
+            printf("  %10.0f sessions/s", seconds > 0 ? scanned / seconds : 0.0);
+            if (q == 0 && (scanned != sessions || total != expectedCents)) {
+                fprintf(stderr, "\nbench: archive returned %ld sessions, Rs %lld.%02lld\n",
+                        scanned, total / 100, total % 100);
+                errors++;
+            }
+        }
+        printf("\n");
+        free(parkedByHour);
+    }
+
+    long bytes = 0;
+    removeArchiveFiles(lot.archivePrefix, &bytes);
+    rmdir(directory);
+    printf("  %ld bytes on disk, %.1f bytes/session (snapshot records take %zu)\n",
+           bytes, (double)bytes / sessions, sizeof(SnapshotRecord));
+    freeParking(&lot);
+    return errors ? 1 : 0;
+}
+
+typedef struct {
+    ParkingManagement *lot;
+    int gate;
+    unsigned int seed;
+    long operations;
+    double seconds;
+    int errors;               // vehicles left behind
+} SharedBenchGate;
+
+static void sharedBenchPlate(PlateKey *plate, int gate, unsigned int serial) {
+    char plateText[VEHICLE_NUMBER_LENGTH];
+    snprintf(plateText, sizeof(plateText), "SHB%02d-%07u", gate, serial % 10000000u);
+    encodePlate(plateText, plate);
+}
+
+// Fills the gate's share of the lot to half, runs BENCH_SHARED_PAIRS
+// exit/enter pairs on random vehicles of its own, then empties its share
+static void *runSharedBenchGate(void *arg) {
+    SharedBenchGate *gate = arg;
+    int capacity = gate->lot->vehicleCapacity / (2 * BENCH_SHARED_GATES);
+    unsigned int *serials = malloc((size_t)capacity * sizeof(*serials));
+    unsigned int nextSerial = 0;
+    int parked = 0;
+    time_t now = time(NULL);
+    gate->operations = 0;
+    gate->errors = !serials;
+    for (int n = 0; serials && n < 4 * capacity && parked < capacity; n++) {
+        Vehicle v;
+        sharedBenchPlate(&v.plate, gate->gate, nextSerial);
+        v.vehicleType = benchRandom(&gate->seed) % VEHICLE_TYPE_COUNT;
+        v.customerType = benchRandom(&gate->seed) % CUSTOMER_TYPE_COUNT;
+        if (parkVehicle(gate->lot, &v, now) == PARK_OK)
+            serials[parked++] = nextSerial;
+        nextSerial++;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int n = 0; serials && parked > 0 && n < BENCH_SHARED_PAIRS; n++) {
+        int pick = (int)(benchRandom(&gate->seed) % (unsigned int)parked);
+        Vehicle v;
+        Bill bill;
+        PlateKey plate;
+        sharedBenchPlate(&plate, gate->gate, serials[pick]);
+        gate->errors += unparkVehicle(gate->lot, plate, now, &v, &bill) != 0;
+        sharedBenchPlate(&v.plate, gate->gate, nextSerial);
+        v.customerType = benchRandom(&gate->seed) % CUSTOMER_TYPE_COUNT;
+        if (parkVehicle(gate->lot, &v, now) == PARK_OK)
+            serials[pick] = nextSerial;
+        else
+            serials[pick] = serials[--parked];
+        nextSerial++;
+        gate->operations += 2;
+    }
+    gate->seconds = secondsSince(&start);
+
+    while (parked > 0) {
+        Vehicle v;
+        Bill bill;
+        PlateKey plate;
+        sharedBenchPlate(&plate, gate->gate, serials[--parked]);
+        gate->errors += unparkVehicle(gate->lot, plate, now, &v, &bill) != 0;
+    }
+    free(serials);
+    return NULL;
+}
+
+// Counts disagreements between a lot's rows, plate index, bays, slots,
+// statistics and occupancy view
+static int verifySharedBenchLot(ParkingManagement *lot) {
+    int mismatches = 0;
+    int rowsByCell[VEHICLE_TYPE_COUNT][CUSTOMER_TYPE_COUNT] = {{0}};
+    int rowsByType[VEHICLE_TYPE_COUNT] = {0};
+    int rows = 0;
+    for (int i = 0; i < lot->vehicleCapacity; i++) {
+        if (lot->vehicleKinds[i] == VEHICLE_KIND_EMPTY)
+            continue;
+        Vehicle v;
+        getVehicleAt(lot, i, &v);
+        rowsByType[v.vehicleType]++;
+        rows++;
+        mismatches += findVehicleIndex(lot, v.plate) != i;
+        mismatches += !bayOccupied(lot, v.vehicleType, v.customerType, v.bayId);
+        rowsByCell[v.vehicleType][v.customerType]++;
+    }
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++)
+            mismatches += slotAllocated(&lot->slots[i][j]) != rowsByCell[i][j];
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        mismatches += lot->stores[i].vehicleCount != rowsByType[i];
+    OccupancyView view;
+    readOccupancy(lot, &view);
+    mismatches += getParkingStatistics(lot).occupied != rows;
+    mismatches += view.occupied != rows;
+    return mismatches;
+}
+
+// Gate throughput of N threads on one lot against N processes on the same
+// lot in shared memory, then a process killed in the middle of an entry:
+// how long the next entry takes to rebuild the lot, and whether the lot
+// checks out afterwards.
+static int benchShared(int gates) {
+    int capacities[VEHICLE_TYPE_COUNT];
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        capacities[i] = BENCH_SHARED_BAYS / VEHICLE_TYPE_COUNT;
+    ParkingManagement local;
+    if (initializeParking(&local, 0, capacities, DEFAULT_QUOTA_PERCENT) != 0)
+        return 1;
+    lots = allocateLots(1);
+    if (!lots || initializeParking(&lots[0], 0, capacities, DEFAULT_QUOTA_PERCENT) != 0) {
+        free(lots);
+        lots = NULL;
+        freeParking(&local);
+        return 1;
+    }
+    lotCount = 1;
+    char name[SHARED_NAME_LENGTH + 1];
+    snprintf(name, sizeof(name), "parking-bench-%d", (int)getpid());
+    SharedBenchGate states[BENCH_SHARED_GATES];
+    int results[2]; // gate processes report back through a pipe
+    if (pipe(results) != 0 || attachSharedLots(name, 0) != 0) {
+        fprintf(stderr, "bench: cannot set up the shared lots benchmark\n");
+        discardLots();
+        freeParking(&local);
+        return 1;
+    }
+    ParkingManagement *shared = &lots[0];
+
+    printf("shared: lot of %d bays, gates keep it half full, %d exit/enter pairs per gate\n",
+           shared->vehicleCapacity, BENCH_SHARED_PAIRS);
+    int errors = 0;
+    for (int n = 1; n <= gates; n = n < gates && 2 * n > gates ? gates : 2 * n) {
+        double throughput[2] = {0, 0};
+        for (int mode = 0; mode < 2; mode++) {
+            for (int g = 0; g < n; g++)
+                states[g] = (SharedBenchGate){mode ? shared : &local, g,
+                                              2463534242u + (unsigned int)g * 7919u, 0, 0, 0};
+            if (mode == 0) {
+                pthread_t threads[MAX_GATE_WORKERS];
+                for (int g = 0; g < n; g++)
+                    pthread_create(&threads[g], NULL, runSharedBenchGate, &states[g]);
+                for (int g = 0; g < n; g++)
+                    pthread_join(threads[g], NULL);
+            } else {
+                for (int g = 0; g < n; g++) {
+                    pid_t child = fork();
+                    if (child == 0) {
+                        runSharedBenchGate(&states[g]);
+                        _exit(write(results[1], &states[g], sizeof(states[g])) !=
+                              (ssize_t)sizeof(states[g]));
+                    }
+                    states[g].errors += child < 0;
+                }
+                while (wait(NULL) > 0)
+                    ;
+                for (int g = 0; g < n; g++) {
+                    SharedBenchGate done;
+                    if (read(results[0], &done, sizeof(done)) != (ssize_t)sizeof(done)) {
+                        errors++;
+                        break;
+                    }
+                    states[done.gate] = done;
+                }
+            }
+            long operations = 0;
+            double seconds = 0;
+            for (int g = 0; g < n; g++) {
+                operations += states[g].operations;
+                if (states[g].seconds > seconds)
+                    seconds = states[g].seconds;
+                errors += states[g].errors;
+            }
+            throughput[mode] = seconds > 0 ? operations / seconds : 0;
+        }
+        printf("  %2d gate(s): threads %10.0f ops/s   processes %10.0f ops/s\n",
+               n, throughput[0], throughput[1]);
+        if (n == gates)
+            break;
+    }
+    int mismatches = verifySharedBenchLot(&local) + verifySharedBenchLot(shared);
+
+    // The child dies holding the store and the car stats lock with a row
+    // written into a free car bay but not indexed, slotted or given the bay,
+    // and the car row of the occupancy view mid-update
+    SharedBenchGate *filler = &states[0];
+    *filler = (SharedBenchGate){shared, 0, 88172645u, 0, 0, 0};
+    time_t now = time(NULL);
+    for (unsigned int serial = 0; storedVehicles(shared) < shared->vehicleCapacity / 2 &&
+                                  serial < (unsigned int)shared->vehicleCapacity; serial++) {
+        Vehicle v;
+        sharedBenchPlate(&v.plate, 0, serial);
+        v.vehicleType = benchRandom(&filler->seed) % VEHICLE_TYPE_COUNT;
+        v.customerType = benchRandom(&filler->seed) % CUSTOMER_TYPE_COUNT;
+        parkVehicle(shared, &v, now);
+    }
+    Vehicle crashed = {.vehicleType = CAR, .customerType = GUEST, .arrivalTime = now};
+    encodePlate("CRASH-1", &crashed.plate);
+    pid_t child = fork();
+    if (child == 0) {
+        VehicleStore *store = &shared->stores[CAR];
+        lockStore(shared, 1);
+        lockLotMutex(shared, &store->statsLock);
+        int row = shared->bayStart[CAR][GUEST];
+        while (shared->vehicleKinds[row] != VEHICLE_KIND_EMPTY)
+            row++;
+        setVehicleAt(shared, row, &crashed);
+        store->vehicleCount++;
+        atomic_fetch_add(&store->occupancySequence, 1);
+        _exit(0);
+    }
+    waitpid(child, NULL, 0);
+
+    Vehicle next = {.vehicleType = CAR, .customerType = GUEST};
+    encodePlate("CRASH-2", &next.plate);
+    int before = storedVehicles(shared);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    enum ParkResult result = parkVehicle(shared, &next, now);
+    double recovery = secondsSince(&start);
+    int crashMismatches = verifySharedBenchLot(shared);
+    int kept = findVehicleIndex(shared, crashed.plate) >= 0;
+    printf("  crash: %d vehicles + 1 half-written row; next entry %s in %.2f ms, "
+           "crashed row %s, %d mismatches\n", before - 1,
+           result == PARK_OK ? "parked" : "failed", recovery * 1e3,
+           kept ? "kept" : "dropped", crashMismatches);
+    printf("  mismatches after the throughput runs: %d, vehicles left behind: %d\n",
+           mismatches, errors);
+
+    close(results[0]);
+    close(results[1]);
+    detachSharedLots(0);
+    freeParking(&local);
+    return errors || mismatches || crashMismatches || result != PARK_OK || !kept ? 1 : 0;
+}
+
+// A random booking window between one lookahead and the horizon, 15 min
+// to 4 h long
+static void benchBookingWindow(unsigned int *seed, time_t now, time_t *start, time_t *end) {
+    long buckets = RESERVATION_HORIZON_DAYS * 86400L / RESERVATION_BUCKET_SECONDS -
+                   2 * RESERVATION_LOOKAHEAD_BUCKETS - 16;
+    *start = now + (RESERVATION_LOOKAHEAD_BUCKETS + 1 + (long)(benchRandom(seed) % buckets)) *
+                   RESERVATION_BUCKET_SECONDS + benchRandom(seed) % RESERVATION_BUCKET_SECONDS;
+    *end = *start + (1 + benchRandom(seed) % 16) * RESERVATION_BUCKET_SECONDS;
+}
+
+// The window's bookable bays counted the slow way, from every booking
+static int benchScanAvailability(ParkingManagement *lot, time_t start, time_t end) {
+    const ReservationBook *book = lot->reservations;
+    long first = (long)(start / RESERVATION_BUCKET_SECONDS);
+    long last = (long)((end - 1) / RESERVATION_BUCKET_SECONDS);
+    int holds[17] = {0}, most = 0;
+    for (int i = 0; i < book->count; i++) {
+        const Reservation *reservation = &book->reservations[i];
+        long from = (long)(reservation->start / RESERVATION_BUCKET_SECONDS);
+        long to = (long)((reservation->end - 1) / RESERVATION_BUCKET_SECONDS);
+        for (long bucket = from > first ? from : first; bucket <= to && bucket <= last; bucket++)
+            holds[bucket - first]++;
+    }
+    for (long bucket = first; bucket <= last; bucket++)
+        if (holds[bucket - first] > most) most = holds[bucket - first];
+    int bays = slotTotal(&lot->slots[CAR][GUEST]) * RESERVABLE_PERCENT / 100 - most;
+    return bays > 0 ? bays : 0;
+}
+
+// Booking, cancel and window query latency as the book grows to count
+// outstanding bookings in one cell, next to a scan over all bookings
+static int benchReservations(long count) {
+    static const long sizes[] = {10000, 100000, 1000000, 10000000};
+    int capacities[VEHICLE_TYPE_COUNT] = {[CAR] = BENCH_RESERVATION_BAYS};
+    int quotaPercent[CUSTOMER_TYPE_COUNT] = {[GUEST] = 100};
+    ParkingManagement lot;
+    if (initializeParking(&lot, DEFAULT_LOT_ID, capacities, quotaPercent) != 0)
+        return 1;
+
+    long *reserveSamples = malloc(BENCH_RESERVATION_QUERIES * sizeof(long));
+    long *querySamples = malloc(BENCH_RESERVATION_QUERIES * sizeof(long));
+    long *cancelSamples = malloc(BENCH_RESERVATION_QUERIES * sizeof(long));
+    if (!reserveSamples || !querySamples || !cancelSamples) {
+        free(reserveSamples);
+        free(querySamples);
+        free(cancelSamples);
+        freeParking(&lot);
+        return 1;
+    }
+
+    printf("reservations: one cell of %d bays, windows of 15 min to 4 h over %d days, "
+           "%d samples per size (timer overhead included)\n",
+           BENCH_RESERVATION_BAYS, RESERVATION_HORIZON_DAYS, BENCH_RESERVATION_QUERIES);
+    unsigned int seed = 2463534242u;
+    time_t now = time(NULL);
+    long booked = 0, errors = 0, mismatches = 0;
+    for (size_t size = 0; size < ARRAY_COUNT(sizes) && booked < count; size++) {
+        long target = sizes[size] < count ? sizes[size] : count;
+        long samples = 0;
+        for (; booked < target; booked++) {
+            Vehicle v;
+            time_t start, end;
+            benchPlate(&v.plate, (unsigned int)booked);
+            v.vehicleType = CAR;
+            v.customerType = GUEST;
+            benchBookingWindow(&seed, now, &start, &end);
+            struct timespec begin;
+            clock_gettime(CLOCK_MONOTONIC, &begin);
+            errors += reserveBay(&lot, &v, start, end, now) != PARK_OK;
+            long nanos = nanosSince(&begin);
+            // The last inserts before the size is reached are the sample
+            if (target - booked <= BENCH_RESERVATION_QUERIES)
+                reserveSamples[samples++] = nanos;
+        }
+
+        for (long n = 0; n < BENCH_RESERVATION_QUERIES; n++) {
+            time_t start, end;
+            benchBookingWindow(&seed, now, &start, &end);
+            struct timespec begin;
+            clock_gettime(CLOCK_MONOTONIC, &begin);
+            int bays = windowAvailability(&lot, CAR, GUEST, start, end, now);
+            querySamples[n] = nanosSince(&begin);
+            errors += bays < 0;
+        }
+
+        // Cancel a random booking and book it again, untimed
+        for (long n = 0; n < BENCH_RESERVATION_QUERIES; n++) {
+            Vehicle v;
+            time_t start, end;
+            benchPlate(&v.plate, benchRandom(&seed) % (unsigned int)booked);
+            v.vehicleType = CAR;
+            v.customerType = GUEST;
+            struct timespec begin;
+            clock_gettime(CLOCK_MONOTONIC, &begin);
+            errors += cancelReservation(&lot, v.plate, now) != 0;
+            cancelSamples[n] = nanosSince(&begin);
+            benchBookingWindow(&seed, now, &start, &end);
+            errors += reserveBay(&lot, &v, start, end, now) != PARK_OK;
+        }
+
+        // The scan gets a handful of queries, and must agree with the tree
+        int scans = 20;
+        struct timespec begin;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        for (int n = 0; n < scans; n++) {
+            time_t start, end;
+            benchBookingWindow(&seed, now, &start, &end);
+            mismatches += benchScanAvailability(&lot, start, end) !=
+                          windowAvailability(&lot, CAR, GUEST, start, end, now);
+        }
+        double scanNanos = (double)nanosSince(&begin) / scans;
+
+        printf("  %ld bookings outstanding\n", booked);
+        printLatencies("book", reserveSamples, samples);
+        printLatencies("query", querySamples, BENCH_RESERVATION_QUERIES);
+        printLatencies("cancel", cancelSamples, BENCH_RESERVATION_QUERIES);
+        printf("  %-6s mean %9.0f ns\n", "scan", scanNanos);
+    }
+    printf("  rejected operations: %ld, scan mismatches: %ld\n", errors, mismatches);
+
+    free(reserveSamples);
+    free(querySamples);
+    free(cancelSamples);
+    freeParking(&lot);
+    return errors || mismatches ? 1 : 0;
+}
+
+// What the follower of benchReplication sends back once it has taken over
+typedef struct {
+    FollowerReport report;
+    uint64_t checksum;
+    long lagCount;
+    long lag[TIMING_BUCKETS];
+} ReplicationBenchResult;
+
+static void benchLotFiles(ParkingManagement *lot, const char *directory, const char *role) {
+    snprintf(lot->snapshotFile, sizeof(lot->snapshotFile), "%s/%s-%s",
+             directory, role, SNAPSHOT_SUFFIX);
+    snprintf(lot->snapshotTempFile, sizeof(lot->snapshotTempFile), "%s/%s-%s",
+             directory, role, SNAPSHOT_TEMP_SUFFIX);
+    snprintf(lot->journalFileName, sizeof(lot->journalFileName), "%s/%s-%s",
+             directory, role, JOURNAL_SUFFIX);
+}
+
+static double runReplicationBenchGates(ParkingManagement *lot, int gates, int *errors) {
+    SharedBenchGate states[BENCH_REPLICATION_GATES];
+    pthread_t threads[BENCH_REPLICATION_GATES];
+    for (int g = 0; g < gates; g++) {
+        states[g] = (SharedBenchGate){lot, g, 2463534242u + (unsigned int)g * 7919u, 0, 0, 0};
+        pthread_create(&threads[g], NULL, runSharedBenchGate, &states[g]);
+    }
+    long operations = 0;
+    double seconds = 0;
+    for (int g = 0; g < gates; g++) {
+        pthread_join(threads[g], NULL);
+        operations += states[g].operations;
+        if (states[g].seconds > seconds)
+            seconds = states[g].seconds;
+        *errors += states[g].errors;
+    }
+    return seconds > 0 ? operations / seconds : 0;
+}
+
+// Journaled gate throughput on one lot with and without a follower process
+// replicating it, how far the follower lags, and how long it takes to
+// take over once the leader stops; the follower must end up with the
+// leader's checksum.
+// Forks a follower of socketPath on the bench's follower files. Once it has
+// taken over it writes a ReplicationBenchResult to resultFd and exits.
+static pid_t forkBenchFollower(ParkingManagement *lot, const char *directory,
+                               const char *socketPath, int resultFd) {
+    pid_t child = fork();
+    if (child != 0)
+        return child;
+    ReplicationBenchResult result;
+    memset(&result, 0, sizeof(result));
+    closeJournal(lot);
+    benchLotFiles(lot, directory, "follower");
+    openJournal(lot);
+    resetOperationTimings();
+    if (followLeader(socketPath, &result.report) == 0) {
+        lockLotState(lot);
+        result.checksum = lotStateChecksum(lot);
+        unlockLotState(lot);
+    }
+    OperationTimer *lag = &operationTimers[TIMED_REPLICATE];
+    result.lagCount = atomic_load(&lag->count);
+    for (int b = 0; b < TIMING_BUCKETS; b++)
+        result.lag[b] = atomic_load(&lag->buckets[b]);
+    closeJournal(lot);
+    _exit(write(resultFd, &result, sizeof(result)) != (ssize_t)sizeof(result));
+}
+
+// Waits up to REPLICATION_CONNECT_WAIT_MS for lot 0 to stream to a follower
+static int waitForFollower() {
+    for (int waited = 0; waited < REPLICATION_CONNECT_WAIT_MS; waited++) {
+        if (atomic_load(&replicationLeader->streaming[0]))
+            return 1;
+        struct timespec pause = {0, 1000000};
+        nanosleep(&pause, NULL);
+    }
+    return 0;
+}
+
+static int benchReplication(int gates) {
+    int capacities[VEHICLE_TYPE_COUNT];
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        capacities[i] = BENCH_SHARED_BAYS / VEHICLE_TYPE_COUNT;
+    char directory[] = "/tmp/parking-bench-XXXXXX";
+    int results[2] = {-1, -1}; // the follower reports back through a pipe
+    lots = allocateLots(1);
+    if (!lots || !mkdtemp(directory) || pipe(results) != 0 ||
+        initializeParking(&lots[0], DEFAULT_LOT_ID, capacities, DEFAULT_QUOTA_PERCENT) != 0) {
+        fprintf(stderr, "bench: cannot set up the replication benchmark\n");
+        free(lots);
+        lots = NULL;
+        return 1;
+    }
+    lotCount = 1;
+    ParkingManagement *lot = &lots[0];
+    char socketPath[64];
+    snprintf(socketPath, sizeof(socketPath), "%s/leader.sock", directory);
+    benchLotFiles(lot, directory, "leader");
+    openJournal(lot);
+
+    printf("replication: lot of %d bays, %d gate(s) keep it half full, %d exit/enter pairs "
+           "per gate\n", lot->vehicleCapacity, gates, BENCH_SHARED_PAIRS);
+    int errors = 0;
+    double alone = runReplicationBenchGates(lot, gates, &errors);
+
+    pid_t child = forkBenchFollower(lot, directory, socketPath, results[1]);
+    double replicated = 0;
+    int attached = 0;
+    if (child > 0 && startReplication(socketPath) == 0) {
+        attached = waitForFollower();
+        if (attached)
+            replicated = runReplicationBenchGates(lot, gates, &errors);
+        stopReplication();
+    }
+    lockLotState(lot);
+    uint64_t checksum = lotStateChecksum(lot);
+    unlockLotState(lot);
+
+    ReplicationBenchResult follower;
+    memset(&follower, 0, sizeof(follower));
+    if (child > 0 && attached &&
+        read(results[0], &follower, sizeof(follower)) != (ssize_t)sizeof(follower))
+        errors++;
+    if (child > 0) {
+        if (!attached)
+            kill(child, SIGKILL);
+        waitpid(child, NULL, 0);
+    }
+
+    char p50[16], p99[16];
+    formatNanos(p50, sizeof(p50), timingPercentile(follower.lag, follower.lagCount, 50));
+    formatNanos(p99, sizeof(p99), timingPercentile(follower.lag, follower.lagCount, 99));
+    printf("  alone      %10.0f ops/s\n", alone);
+    printf("  replicated %10.0f ops/s (%+.1f%%)\n", replicated,
+           alone > 0 ? (replicated / alone - 1) * 100 : 0.0);
+    printf("  follower: %ld records, lag p50 <= %s, p99 <= %s\n",
+           follower.report.records, p50, p99);
+    printf("  checksums: %ld matched, %ld differed, %ld records missing; final %s\n",
+           follower.report.checksumsMatched, follower.report.checksumsDiffered,
+           follower.report.gaps, follower.checksum == checksum ? "equal" : "DIFFERENT");
+    printf("  takeover after the stream ended: %.2f ms\n",
+           follower.report.takeoverSeconds * 1e3);
+    int failed = errors || !attached || follower.checksum != checksum ||
+                 follower.report.checksumsDiffered || follower.report.gaps;
+
+    // A follower that stops reading (SIGSTOP) must not hold up the gates:
+    // the leader detaches it, and once it reads again it rejoins from fresh
+    // images and still ends up equal. SIGALRM ends the bench if gates hang.
+    ReplicationBenchResult stalled;
+    memset(&stalled, 0, sizeof(stalled));
+    double stalledRate = 0;
+    int rejoined = 0;
+    child = forkBenchFollower(lot, directory, socketPath, results[1]);
+    if (child > 0 && startReplication(socketPath) == 0) {
+        if (waitForFollower()) {
+            kill(child, SIGSTOP);
+            alarm(BENCH_STALL_SECONDS);
+            stalledRate = runReplicationBenchGates(lot, gates, &errors);
+            alarm(0);
+            kill(child, SIGCONT);
+            rejoined = waitForFollower();
+        }
+        stopReplication();
+    }
+    lockLotState(lot);
+    checksum = lotStateChecksum(lot);
+    unlockLotState(lot);
+    if (child > 0 && rejoined &&
+        read(results[0], &stalled, sizeof(stalled)) != (ssize_t)sizeof(stalled))
+        errors++;
+    if (child > 0) {
+        if (!rejoined) {
+            kill(child, SIGCONT);
+            kill(child, SIGKILL);
+        }
+        waitpid(child, NULL, 0);
+    }
+    printf("  stopped follower: gates went on at %.0f ops/s; it rejoined %ld time(s), "
+           "final %s\n", stalledRate, stalled.report.rejoins,
+           stalled.checksum == checksum ? "equal" : "DIFFERENT");
+    failed |= errors || !rejoined || stalled.report.rejoins < 1 ||
+              stalled.checksum != checksum || stalled.report.checksumsDiffered;
+
+    closeJournal(lot);
+    for (int r = 0; r < 2; r++) {
+        benchLotFiles(lot, directory, r ? "follower" : "leader");
+        remove(lot->snapshotFile);
+        remove(lot->snapshotTempFile);
+        remove(lot->journalFileName);
+    }
+    rmdir(directory);
+    close(results[0]);
+    close(results[1]);
+    discardLots();
+    return failed ? 1 : 0;
+}
+
+// Packs a fresh lot of vehicles bays (guests only, every type alike) with
+// one vehicle per bay, arrived over the last three days. Returns 0 or -1.
+static int benchPackLot(ParkingManagement *lot, int vehicles, time_t now) {
+    int capacities[VEHICLE_TYPE_COUNT];
+    int quotaPercent[CUSTOMER_TYPE_COUNT] = {[GUEST] = 100};
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        capacities[i] = (vehicles + VEHICLE_TYPE_COUNT - 1) / VEHICLE_TYPE_COUNT;
+    if (initializeParking(lot, DEFAULT_LOT_ID, capacities, quotaPercent) != 0)
+        return -1;
+
+    unsigned int seed = 2463534242u;
+    for (int i = 0; i < vehicles; i++) {
+        Vehicle v;
+        benchPlate(&v.plate, (unsigned int)i);
+        v.vehicleType = i % VEHICLE_TYPE_COUNT;
+        v.customerType = GUEST;
+        v.arrivalTime = now - benchRandom(&seed) % (3 * 24 * 3600);
+        v.bayId = 0;
+        if (admitVehicle(lot, &v) != 0) {
+            freeParking(lot);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Reads one byte of every page of a lot's arena, so every chunk of a
+// mapped arena gets checked
+static void benchTouchArena(const ParkingManagement *lot) {
+    const volatile unsigned char *arena = lot->arena;
+    for (size_t i = 0; i < lot->arenaBytes; i += 4096)
+        (void)arena[i];
+}
+
+// Replaces a startup benchmark lot by a new empty one of the same layout,
+// as a process starts with. Returns 0 or -1.
+static int benchStartLot(ParkingManagement *lot, const char *directory) {
+    int capacities[VEHICLE_TYPE_COUNT], quotaPercent[CUSTOMER_TYPE_COUNT];
+    memcpy(capacities, lot->capacities, sizeof(capacities));
+    memcpy(quotaPercent, lot->quotaPercent, sizeof(quotaPercent));
+    freeParking(lot);
+    if (initializeParking(lot, DEFAULT_LOT_ID, capacities, quotaPercent) != 0)
+        return -1;
+    benchLotFiles(lot, directory, "startup");
+    return 0;
+}
+
+// Startup cost of a full lot of vehicles vehicles: loadSnapshot() of its
+// version 6 snapshot, best of BENCH_STARTUP_ROUNDS, against one load of the
+// same lot saved as version 5 records, which are admitted one by one. The
+// mapped load reads no rows, so it does not grow with the vehicle count;
+// the arena checks are deferred to first touch, not dropped, so the first
+// pass over the whole arena is timed as well. Last, a child process loads
+// the snapshot with one byte flipped in its arena and reads the arena: it
+// must stop and move the snapshot aside.
+static int benchStartup(int vehicles) {
+    ParkingManagement lot;
+    time_t now = time(NULL);
+    char directory[] = "/tmp/parking-bench-XXXXXX";
+    if (benchPackLot(&lot, vehicles, now) != 0 || !mkdtemp(directory)) {
+        fprintf(stderr, "bench: cannot set up the startup benchmark\n");
+        return 1;
+    }
+    benchLotFiles(&lot, directory, "startup");
+    int errors = 0;
+    struct timespec start;
+
+    size_t recordBytes = 0;
+    void *image = buildRecordImage(&lot, &recordBytes);
+    errors += !image || storeSnapshotImage(&lot, image, recordBytes) != 0;
+    free(image);
+    errors += benchStartLot(&lot, directory) != 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    errors += loadSnapshot(&lot) != 0;
+    double recordSeconds = secondsSince(&start);
+    errors += storedVehicles(&lot) != vehicles;
+
+    saveParkingData(&lot);
+    struct stat info;
+    long long bytes = stat(lot.snapshotFile, &info) == 0 ? (long long)info.st_size : -1;
+    double best = 0;
+    for (int round = 0; round < BENCH_STARTUP_ROUNDS; round++) {
+        errors += benchStartLot(&lot, directory) != 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        errors += loadSnapshot(&lot) != 0;
+        double seconds = secondsSince(&start);
+        if (round == 0 || seconds < best)
+            best = seconds;
+        errors += lot.arenaMap == NULL || storedVehicles(&lot) != vehicles;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    benchTouchArena(&lot);
+    double firstPass = secondsSince(&start);
+    for (int i = 0; i < vehicles; i += 1 + vehicles / 1000) {
+        PlateKey plate;
+        benchPlate(&plate, (unsigned int)i);
+        errors += findVehicleIndex(&lot, plate) < 0;
+    }
+
+    char corruptFile[sizeof(lot.snapshotFile) + sizeof(SNAPSHOT_CORRUPT_SUFFIX)];
+    snprintf(corruptFile, sizeof(corruptFile), "%s%s", lot.snapshotFile, SNAPSHOT_CORRUPT_SUFFIX);
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0)
+            dup2(null, STDERR_FILENO);
+        int fd = open(lot.snapshotFile, O_RDWR);
+        SnapshotArena layout;
+        unsigned char byte;
+        if (fd < 0 || pread(fd, &layout, sizeof(layout), sizeof(SnapshotHeader)) != sizeof(layout))
+            _exit(2);
+        off_t offset = (off_t)(layout.arenaOffset + layout.arenaBytes / 2);
+        if (pread(fd, &byte, 1, offset) != 1)
+            _exit(2);
+        byte ^= 0x5a;
+        if (pwrite(fd, &byte, 1, offset) != 1)
+            _exit(2);
+        close(fd);
+        if (loadSnapshot(&lot) != 0)
+            _exit(2);
+        benchTouchArena(&lot);
+        _exit(0);
+    }
+    int status = 0;
+    int caught = child > 0 && waitpid(child, &status, 0) == child && WIFEXITED(status) &&
+                 WEXITSTATUS(status) == EXIT_FAILURE && access(corruptFile, F_OK) == 0;
+    errors += !caught;
+
+    printf("  %8d vehicles  records %10zu bytes  load %9.2f ms  %6.0f ns/vehicle\n",
+           vehicles, recordBytes, recordSeconds * 1e3, recordSeconds * 1e9 / vehicles);
+    printf("  %8s           arena   %10lld bytes  load %9.3f ms  first pass %8.2f ms"
+           "  corrupt chunk %s%s\n", "", bytes, best * 1e3, firstPass * 1e3,
+           caught ? "stopped it" : "MISSED", errors ? "  FAILED" : "");
+
+    remove(lot.snapshotFile);
+    remove(lot.snapshotTempFile);
+    remove(lot.journalFileName);
+    remove(corruptFile);
+    rmdir(directory);
+    freeParking(&lot);
+    return errors ? 1 : 0;
+}
+
+// Exit latency as the lot grows to a million vehicles: random parked
+// vehicles leave a full lot through unparkVehicle() (plate index lookup,
+// row and bay freed in place, billing) and are parked again untimed. No journal
+// is open, so file writes do not hide the lookup cost.
+static int benchExit() {
+    static const int levels[] = {1000, 10000, 100000, 1000000};
+    long *samples = malloc(BENCH_EXIT_SAMPLES * sizeof(long));
+    if (!samples) {
+        fprintf(stderr, "bench: out of memory\n");
+        return 1;
+    }
+    printf("exit: %d exits from a full lot per size, vehicle re-parked after each\n",
+           BENCH_EXIT_SAMPLES);
+
+    unsigned int seed = 2463534242u;
+    time_t now = time(NULL);
+    int errors = 0;
+    for (size_t level = 0; level < ARRAY_COUNT(levels); level++) {
+        ParkingManagement lot;
+        if (benchPackLot(&lot, levels[level], now) != 0) {
+            fprintf(stderr, "bench: cannot park %d vehicles\n", levels[level]);
+            errors++;
+            continue;
+        }
+        for (int n = -BENCH_EXIT_SAMPLES / 10; n < BENCH_EXIT_SAMPLES; n++) {
+            PlateKey plate = lot.plateKeys[benchParkedRow(&lot, &seed)];
+            Vehicle v;
+            Bill bill;
+            struct timespec begin;
+            clock_gettime(CLOCK_MONOTONIC, &begin);
+            errors += unparkVehicle(&lot, plate, now, &v, &bill) != 0;
+            long nanos = nanosSince(&begin);
+            v.bayId = 0;
+            errors += admitVehicle(&lot, &v) != 0;
+            if (n >= 0)
+                samples[n] = nanos;
+        }
+        errors += storedVehicles(&lot) != levels[level];
+        printf("  %8d vehicles\n", levels[level]);
+        printLatencies("exit", samples, BENCH_EXIT_SAMPLES);
+        freeParking(&lot);
+    }
+    free(samples);
+    return errors ? 1 : 0;
+}
+
+// Crash recovery of entries journaled since an empty snapshot: time to
+// journal them through parkVehicle(), then loadParkingData() (snapshot plus
+// journal replay), the same after the journal is compacted into a
+// snapshot, and loadLegacyParkingData() on the same vehicles in the old
+// text format. Best of BENCH_STARTUP_ROUNDS loads each. Runs in a scratch
+// directory, as the text file's name is fixed.
+static int benchRecovery(int entries) {
+    int capacities[VEHICLE_TYPE_COUNT];
+    int quotaPercent[CUSTOMER_TYPE_COUNT] = {[GUEST] = 100};
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        capacities[i] = (entries + VEHICLE_TYPE_COUNT - 1) / VEHICLE_TYPE_COUNT;
+    ParkingManagement lot;
+    char directory[] = "/tmp/parking-bench-XXXXXX";
+    int home = open(".", O_RDONLY);
+    if (home < 0 || initializeParking(&lot, DEFAULT_LOT_ID, capacities, quotaPercent) != 0) {
+        fprintf(stderr, "bench: cannot set up the recovery benchmark\n");
+        if (home >= 0) close(home);
+        return 1;
+    }
+    if (!mkdtemp(directory) || chdir(directory) != 0) {
+        fprintf(stderr, "bench: cannot set up the recovery benchmark\n");
+        close(home);
+        freeParking(&lot);
+        return 1;
+    }
+    benchLotFiles(&lot, ".", "recovery");
+
+    saveParkingData(&lot);
+    openJournal(&lot);
+    unsigned int seed = 2463534242u;
+    time_t now = time(NULL);
+    int errors = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < entries; i++) {
+        Vehicle v;
+        benchPlate(&v.plate, (unsigned int)i);
+        v.vehicleType = i % VEHICLE_TYPE_COUNT;
+        v.customerType = GUEST;
+        errors += parkVehicle(&lot, &v, now - benchRandom(&seed) % (3 * 24 * 3600)) != PARK_OK;
+    }
+    double journalSeconds = secondsSince(&start);
+    closeJournal(&lot);
+
+    // 0: snapshot + journal, 1: compacted snapshot, 2: text file
+    double best[3] = {0, 0, 0};
+    for (int mode = 0; mode < 3; mode++) {
+        if (mode == 1) {
+            saveParkingData(&lot);
+        } else if (mode == 2) {
+            FILE *text = fopen(LEGACY_DATA_FILE, "w");
+            errors += !text;
+            if (!text)
+                break;
+            fprintf(text, "%d\n", storedVehicles(&lot));
+            for (int i = 0; i < lot.vehicleCapacity; i++) {
+                char plateText[VEHICLE_NUMBER_LENGTH];
+                if (lot.vehicleKinds[i] == VEHICLE_KIND_EMPTY)
+                    continue;
+                fprintf(text, "%s %d %d %ld\n", formatPlate(lot.plateKeys[i], plateText),
+                        KIND_VEHICLE_TYPE(lot.vehicleKinds[i]),
+                        KIND_CUSTOMER_TYPE(lot.vehicleKinds[i]), (long)lot.arrivalTimes[i]);
+            }
+            errors += fclose(text) != 0;
+        }
+        for (int round = 0; round < BENCH_STARTUP_ROUNDS; round++) {
+            resetParking(&lot);
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            if (mode < 2)
+                loadParkingData(&lot);
+            else
+                loadLegacyParkingData(&lot);
+            double seconds = secondsSince(&start);
+            if (mode < 2)
+                closeJournal(&lot);
+            if (round == 0 || seconds < best[mode])
+                best[mode] = seconds;
+            errors += storedVehicles(&lot) != entries;
+        }
+    }
+
+    printf("recovery: %d entries\n", entries);
+    printf("  journal entries      %10.0f entries/s\n",
+           journalSeconds > 0 ? entries / journalSeconds : 0.0);
+    printf("  snapshot + journal   %10.2f ms\n", best[0] * 1e3);
+    printf("  compacted snapshot   %10.2f ms\n", best[1] * 1e3);
+    printf("  text file (legacy)   %10.2f ms\n", best[2] * 1e3);
+    if (errors)
+        printf("  %d errors\n", errors);
+
+    remove(lot.snapshotFile);
+    remove(lot.snapshotTempFile);
+    remove(lot.journalFileName);
+    remove(LEGACY_DATA_FILE);
+    errors += fchdir(home) != 0;
+    close(home);
+    rmdir(directory);
+    freeParking(&lot);
+    return errors ? 1 : 0;
+}
+
+// Writes events ENTER/EXIT lines for lot lotId to file: fresh plates enter,
+// random parked ones leave, the clock advances 1-29 s per event
+static void writeReplayTrace(FILE *file, int lotId, long events) {
+    unsigned int parked[BENCH_REPLAY_PARKED];
+    int parkedCount = 0;
+    unsigned int nextPlate = 0, seed = 2463534242u;
+    long long now = 1700000000;
+    for (long n = 0; n < events; n++) {
+        if (parkedCount == BENCH_REPLAY_PARKED || (parkedCount > 0 && benchRandom(&seed) % 2)) {
+            int k = benchRandom(&seed) % parkedCount;
+            fprintf(file, "EXIT %d R-%u %lld\n", lotId, parked[k], now);
+            parked[k] = parked[--parkedCount];
+        } else {
+            parked[parkedCount++] = nextPlate;
+            fprintf(file, "ENTER %d R-%u %d %d %lld\n", lotId, nextPlate++,
+                    (int)(benchRandom(&seed) % VEHICLE_TYPE_COUNT),
+                    (int)(benchRandom(&seed) % CUSTOMER_TYPE_COUNT), now);
+        }
+        now += 1 + benchRandom(&seed) % 29;
+    }
+}
+
+// ./main --batch on a synthetic trace, as a gate controller would feed it:
+// the default lot with its journal, snapshot and archive, in a scratch
+// directory, result lines thrown away. Generating the trace is not timed.
+static int benchReplay(long events) {
+    char directory[] = "/tmp/parking-bench-XXXXXX";
+    int home = open(".", O_RDONLY);
+    if (home < 0 || !mkdtemp(directory) || chdir(directory) != 0) {
+        fprintf(stderr, "bench: cannot set up the replay benchmark\n");
+        if (home >= 0) close(home);
+        return 1;
+    }
+
+    int errors = 0;
+    FILE *trace = fopen("replay-events.txt", "w");
+    int quiet = open("/dev/null", O_WRONLY);
+    int output = dup(STDOUT_FILENO);
+    if (!trace || quiet < 0 || output < 0 || loadLotConfig() != 0) {
+        fprintf(stderr, "bench: cannot set up the replay benchmark\n");
+        errors++;
+    } else {
+        writeReplayTrace(trace, lots[0].lotId, events);
+        errors += fclose(trace) != 0;
+        trace = fopen("replay-events.txt", "r");
+        errors += !trace;
+        for (int i = 0; i < lotCount; i++) {
+            loadParkingData(&lots[i]);
+            lots[i].archiving = 1;
+        }
+        parking = &lots[0];
+
+        fflush(stdout);
+        dup2(quiet, STDOUT_FILENO);
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        errors += !trace || runBatch(trace, 1) != 0;
+        fflush(stdout);
+        double seconds = secondsSince(&start);
+        dup2(output, STDOUT_FILENO);
+        shutdownParking();
+
+        printf("replay: %ld events through --batch (journal and archive on)\n", events);
+        printf("  %.3f s, %.0f events/s\n", seconds, seconds > 0 ? events / seconds : 0.0);
+    }
+    if (trace) fclose(trace);
+    if (quiet >= 0) close(quiet);
+    if (output >= 0) close(output);
+
+    // Snapshot, journal, archive day files and the trace
+    DIR *files = opendir(".");
+    for (struct dirent *entry; files && (entry = readdir(files)); ) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+            remove(entry->d_name);
+    }
+    if (files) closedir(files);
+    errors += fchdir(home) != 0;
+    close(home);
+    rmdir(directory);
+    return errors ? 1 : 0;
+}
+
+typedef struct {
+    ParkingManagement *lot;
+    int gate;
+    int share;                // vehicles this gate keeps parked
+    int pairs;
+    unsigned int seed;
+    long operations;
+    double seconds;
+    int errors;
+} GateBenchWorker;
+
+// Parks the gate's share, then runs exit/enter pairs on random vehicles of
+// its own. The vehicles stay parked for the consistency check.
+static void *runGateBenchWorker(void *arg) {
+    GateBenchWorker *worker = arg;
+    unsigned int *serials = malloc((size_t)worker->share * sizeof(*serials));
+    unsigned int nextSerial = 0;
+    int parked = 0;
+    time_t now = time(NULL);
+    worker->errors = !serials;
+    for (int n = 0; serials && n < 4 * worker->share && parked < worker->share; n++) {
+        Vehicle v;
+        sharedBenchPlate(&v.plate, worker->gate, nextSerial);
+        v.vehicleType = benchRandom(&worker->seed) % VEHICLE_TYPE_COUNT;
+        v.customerType = benchRandom(&worker->seed) % CUSTOMER_TYPE_COUNT;
+        if (parkVehicle(worker->lot, &v, now) == PARK_OK)
+            serials[parked++] = nextSerial;
+        nextSerial++;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int n = 0; serials && parked > 0 && n < worker->pairs; n++) {
+        int pick = (int)(benchRandom(&worker->seed) % (unsigned int)parked);
+        Vehicle v;
+        Bill bill;
+        PlateKey plate;
+        sharedBenchPlate(&plate, worker->gate, serials[pick]);
+        worker->errors += unparkVehicle(worker->lot, plate, now, &v, &bill) != 0;
+        sharedBenchPlate(&v.plate, worker->gate, nextSerial);
+        v.customerType = benchRandom(&worker->seed) % CUSTOMER_TYPE_COUNT;
+        if (parkVehicle(worker->lot, &v, now) == PARK_OK)
+            serials[pick] = nextSerial;
+        else
+            serials[pick] = serials[--parked];
+        nextSerial++;
+        worker->operations += 2;
+    }
+    worker->seconds = secondsSince(&start);
+    free(serials);
+    return NULL;
+}
+
+typedef struct {
+    ParkingManagement *lot;
+    int attempts;
+    unsigned int seed;
+    int *balance;             // per plate: this thread's entries minus exits
+    int reader;               // also reads the statistics and reports
+    long entries;
+    long duplicates;
+    long exits;
+    long inconsistent;        // occupancy views that did not add up
+} GateStressWorker;
+
+static void gateStressPlate(PlateKey *plate, int serial) {
+    char plateText[VEHICLE_NUMBER_LENGTH];
+    snprintf(plateText, sizeof(plateText), "GST-%05d", serial);
+    encodePlate(plateText, plate);
+}
+
+// Enters and exits random plates of the one set every thread works on,
+// each entry as a random vehicle type, so gates race on the same plates
+// across types. The reader thread also takes statistics, occupancy views
+// and the overstay list while the gates run.
+static void *runGateStressWorker(void *arg) {
+    GateStressWorker *worker = arg;
+    time_t now = time(NULL);
+    for (int n = 0; n < worker->attempts; n++) {
+        int serial = (int)(benchRandom(&worker->seed) % BENCH_GATE_STRESS_PLATES);
+        Vehicle v;
+        Bill bill;
+        gateStressPlate(&v.plate, serial);
+        if (benchRandom(&worker->seed) % 2) {
+            v.vehicleType = benchRandom(&worker->seed) % VEHICLE_TYPE_COUNT;
+            v.customerType = benchRandom(&worker->seed) % CUSTOMER_TYPE_COUNT;
+            enum ParkResult result = parkVehicle(worker->lot, &v, now);
+            worker->balance[serial] += result == PARK_OK;
+            worker->entries += result == PARK_OK;
+            worker->duplicates += result == PARK_DUPLICATE;
+        } else if (unparkVehicle(worker->lot, v.plate, now, &v, &bill) == 0) {
+            worker->balance[serial]--;
+            worker->exits++;
+        }
+        if (worker->reader && n % 64 == 0) {
+            OccupancyView view;
+            readOccupancy(worker->lot, &view);
+            int allocated = 0;
+            for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+                for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++)
+                    allocated += view.allocated[i][j];
+            worker->inconsistent += allocated != view.occupied;
+            getParkingStatistics(worker->lot);
+            listOverstays(worker->lot, now, NULL, 0);
+        }
+    }
+    return NULL;
+}
+
+// The stress check: threadCount gates race on one small set of plates. Every
+// plate must be parked exactly when its entries outnumber its exits, no
+// plate may be parked twice, and rows, bays, slots, statistics and the
+// occupancy view must agree afterwards. Returns the number of failures.
+static int stressGates(int threadCount) {
+    int capacities[VEHICLE_TYPE_COUNT];
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        capacities[i] = BENCH_GATE_STRESS_BAYS / VEHICLE_TYPE_COUNT;
+    ParkingManagement lot;
+    GateStressWorker *workers = calloc((size_t)threadCount, sizeof(*workers));
+    pthread_t *threads = calloc((size_t)threadCount, sizeof(*threads));
+    int *balances = calloc((size_t)threadCount * BENCH_GATE_STRESS_PLATES, sizeof(int));
+    if (!workers || !threads || !balances ||
+        initializeParking(&lot, 0, capacities, DEFAULT_QUOTA_PERCENT) != 0) {
+        fprintf(stderr, "bench: cannot set up the gates stress check\n");
+        free(workers);
+        free(threads);
+        free(balances);
+        return 1;
+    }
+
+    int errors = 0, started = 0;
+    for (int t = 0; t < threadCount; t++) {
+        workers[t] = (GateStressWorker){&lot, BENCH_GATE_STRESS_OPS / threadCount,
+                                        88172645u + (unsigned int)t * 7919u,
+                                        balances + (size_t)t * BENCH_GATE_STRESS_PLATES,
+                                        t == 0, 0, 0, 0, 0};
+        if (pthread_create(&threads[t], NULL, runGateStressWorker, &workers[t]) != 0)
+            break;
+        started++;
+    }
+    long entries = 0, duplicates = 0, exits = 0, inconsistent = 0;
+    for (int t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+        entries += workers[t].entries;
+        duplicates += workers[t].duplicates;
+        exits += workers[t].exits;
+        inconsistent += workers[t].inconsistent;
+    }
+    errors += started != threadCount;
+
+    int unbalanced = 0;
+    for (int p = 0; p < BENCH_GATE_STRESS_PLATES; p++) {
+        int balance = 0;
+        for (int t = 0; t < started; t++)
+            balance += workers[t].balance[p];
+        PlateKey plate;
+        gateStressPlate(&plate, p);
+        unbalanced += balance != (findVehicleIndex(&lot, plate) >= 0);
+    }
+    ParkingStatistics stats = getParkingStatistics(&lot);
+    int mismatches = verifySharedBenchLot(&lot);
+    mismatches += stats.arrivals - stats.exits != storedVehicles(&lot);
+    printf("  stress: %d thread(s) on %d plates, %ld entries, %ld duplicates refused, "
+           "%ld exits, %d parked\n", started, BENCH_GATE_STRESS_PLATES, entries, duplicates,
+           exits, storedVehicles(&lot));
+    printf("          %d unbalanced plates, %d mismatches, %ld inconsistent views\n",
+           unbalanced, mismatches, inconsistent);
+    errors += unbalanced + mismatches + (int)inconsistent;
+
+    free(workers);
+    free(threads);
+    free(balances);
+    freeParking(&lot);
+    return errors;
+}
+
+// Gate scaling: 1, 2, 4, ... maxThreads gate threads share BENCH_GATE_PAIRS
+// exit/enter pairs on one lot kept half full. After each run the lot's
+// rows, plate index, bays, slot counts, stats.occupied and occupancy view
+// must agree, and again once it has been emptied. Then the stress check
+// (stressGates) with maxThreads threads.
+static int benchGates(int maxThreads) {
+    int capacities[VEHICLE_TYPE_COUNT];
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        capacities[i] = BENCH_GATE_BAYS / VEHICLE_TYPE_COUNT;
+    ParkingManagement lot;
+    GateBenchWorker *workers = calloc((size_t)maxThreads, sizeof(*workers));
+    pthread_t *threads = calloc((size_t)maxThreads, sizeof(*threads));
+    if (!workers || !threads || initializeParking(&lot, 0, capacities, DEFAULT_QUOTA_PERCENT) != 0) {
+        fprintf(stderr, "bench: cannot set up the gates benchmark\n");
+        free(workers);
+        free(threads);
+        return 1;
+    }
+
+    printf("gates: lot of %d bays kept half full, %d exit/enter pairs per run\n",
+           lot.vehicleCapacity, BENCH_GATE_PAIRS);
+    int errors = 0, mismatches = 0;
+    double single = 0;
+    for (int n = 1; n <= maxThreads; n = n < maxThreads && 2 * n > maxThreads ? maxThreads : 2 * n) {
+        int started = 0;
+        for (int g = 0; g < n; g++) {
+            workers[g] = (GateBenchWorker){&lot, g, lot.vehicleCapacity / (2 * n),
+                                           BENCH_GATE_PAIRS / n,
+                                           2463534242u + (unsigned int)g * 7919u, 0, 0, 0};
+            if (pthread_create(&threads[g], NULL, runGateBenchWorker, &workers[g]) != 0)
+                break;
+            started++;
+        }
+        long operations = 0;
+        double seconds = 0;
+        for (int g = 0; g < started; g++) {
+            pthread_join(threads[g], NULL);
+            operations += workers[g].operations;
+            if (workers[g].seconds > seconds)
+                seconds = workers[g].seconds;
+            errors += workers[g].errors;
+        }
+        errors += started != n;
+        int parked = storedVehicles(&lot);
+        int runMismatches = verifySharedBenchLot(&lot);
+        for (int i = 0; i < lot.vehicleCapacity; i++) {
+            Vehicle v;
+            Bill bill;
+            if (lot.vehicleKinds[i] != VEHICLE_KIND_EMPTY &&
+                unparkVehicle(&lot, lot.plateKeys[i], time(NULL), &v, &bill) != 0)
+                errors++;
+        }
+        runMismatches += verifySharedBenchLot(&lot);
+        mismatches += runMismatches;
+
+        double throughput = seconds > 0 ? operations / seconds : 0;
+        if (n == 1)
+            single = throughput;
+        printf("  %2d thread(s) %10.0f ops/s  %5.2fx  %6d parked  %d mismatches\n", n, throughput,
+               single > 0 ? throughput / single : 0.0, parked, runMismatches);
+        if (n == maxThreads)
+            break;
+    }
+    if (errors)
+        printf("  %d failed exits or threads\n", errors);
+    freeParking(&lot);
+    errors += stressGates(maxThreads);
+
+    free(workers);
+    free(threads);
+    return errors || mismatches ? 1 : 0;
+}
+
+// The same slot counts behind a mutex, as the baseline for reserveSlot()
+typedef struct {
+    pthread_mutex_t lock;
+    int allocated;
+    int free;
+} LockedBenchSlot;
+
+typedef struct {
+    ParkingSlot *slot;
+    LockedBenchSlot *locked;  // set: use it instead of slot
+    unsigned int seed;
+    long taken;
+    long refused;
+    long breaches;            // counts seen below the floor, or not adding up
+} SlotBenchWorker;
+
+// Random bursts of up to BENCH_SLOT_BURST reservations or releases on the
+// one cell, so the threads together want more than the floor leaves. Every
+// count seen after a reservation must keep the floor (a taker leaves at
+// least BENCH_SLOT_FLOOR - 1 free) and the total. All is given back at the end.
+static void *runSlotBenchWorker(void *arg) {
+    SlotBenchWorker *worker = arg;
+    int held = 0;
+    for (int round = 0; round <= BENCH_SLOT_ROUNDS; round++) {
+        unsigned int draw = benchRandom(&worker->seed);
+        int burst = 1 + (int)(draw % BENCH_SLOT_BURST);
+        if (round == BENCH_SLOT_ROUNDS || (held > 0 && draw / BENCH_SLOT_BURST % 2)) {
+            for (int n = round == BENCH_SLOT_ROUNDS ? held : burst; n > 0 && held > 0; n--, held--) {
+                if (worker->locked) {
+                    pthread_mutex_lock(&worker->locked->lock);
+                    worker->locked->allocated--;
+                    worker->locked->free++;
+                    pthread_mutex_unlock(&worker->locked->lock);
+                } else {
+                    releaseSlot(worker->slot);
+                }
+            }
+            continue;
+        }
+        for (int n = 0; n < burst; n++) {
+            int taken, allocated, free;
+            if (worker->locked) {
+                pthread_mutex_lock(&worker->locked->lock);
+                taken = worker->locked->free >= BENCH_SLOT_FLOOR;
+                if (taken) {
+                    worker->locked->allocated++;
+                    worker->locked->free--;
+                }
+                allocated = worker->locked->allocated;
+                free = worker->locked->free;
+                pthread_mutex_unlock(&worker->locked->lock);
+            } else {
+                taken = reserveSlot(worker->slot, BENCH_SLOT_FLOOR);
+                uint64_t counts = atomic_load(&worker->slot->counts);
+                allocated = SLOT_ALLOCATED(counts);
+                free = SLOT_FREE(counts);
+            }
+            worker->breaches += free < BENCH_SLOT_FLOOR - 1 || allocated + free != BENCH_SLOT_BAYS;
+            held += taken;
+            worker->taken += taken;
+            worker->refused += !taken;
+        }
+    }
+    return NULL;
+}
+
+// One call in a recorded history, timed on CLOCK_MONOTONIC around the call
+typedef struct {
+    int64_t start, end;
+    char release;             // releaseSlot(), else reserveSlot(BENCH_SLOT_FLOOR)
+    char taken;
+} SlotHistoryEntry;
+
+typedef struct {
+    ParkingSlot *slot;
+    pthread_barrier_t *barrier;
+    int checkThenAct;         // take with a separate check and update, for contrast
+    unsigned int seed;
+    SlotHistoryEntry history[BENCH_HISTORY_OPS];
+} SlotHistoryWorker;
+
+// The reservation as enterVehicle() once did it: check, then take. Each
+// step is atomic, the pair is not; the yield widens the gap between them
+// so that even one CPU interleaves the threads there.
+static int reserveSlotCheckThenAct(ParkingSlot *slot, int minFree) {
+    int free = SLOT_FREE(atomic_load(&slot->counts));
+    if (free <= 0 || free < minFree)
+        return 0;
+    sched_yield();
+    atomic_fetch_add(&slot->counts, ((uint64_t)1 << 32) - 1);
+    return 1;
+}
+
+// Per round: wait for the cell to be set, record BENCH_HISTORY_OPS calls
+// (a release only of a slot this thread took), wait for the check
+static void *runSlotHistoryWorker(void *arg) {
+    SlotHistoryWorker *worker = arg;
+    for (int round = 0; round < BENCH_HISTORY_ROUNDS; round++) {
+        int held = 0;
+        pthread_barrier_wait(worker->barrier);
+        for (int n = 0; n < BENCH_HISTORY_OPS; n++) {
+            SlotHistoryEntry *entry = &worker->history[n];
+            entry->release = held > 0 && benchRandom(&worker->seed) % 2;
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            if (entry->release)
+                releaseSlot(worker->slot);
+            else if (worker->checkThenAct)
+                entry->taken = (char)reserveSlotCheckThenAct(worker->slot, BENCH_SLOT_FLOOR);
+            else
+                entry->taken = (char)reserveSlot(worker->slot, BENCH_SLOT_FLOOR);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            entry->start = (int64_t)start.tv_sec * 1000000000LL + start.tv_nsec;
+            entry->end = (int64_t)end.tv_sec * 1000000000LL + end.tv_nsec;
+            held += entry->release ? -1 : entry->taken;
+        }
+        pthread_barrier_wait(worker->barrier);
+    }
+    return NULL;
+}
+
+// Searches for a sequential order of a round's calls, from next[] on with
+// free slots free: each thread's calls in program order, none placed
+// before a call that ended before it started, and each with the result the
+// sequential cell gives (a take succeeds exactly when at least
+// BENCH_SLOT_FLOOR, and one, are free). free follows from next[], so a
+// dead end is remembered by next[] alone.
+static int linearizeSlotHistory(const SlotHistoryWorker *workers, int *next, int free,
+                                unsigned char *dead) {
+    int index = 0, done = 1;
+    for (int t = 0; t < BENCH_HISTORY_THREADS; t++) {
+        index = index * (BENCH_HISTORY_OPS + 1) + next[t];
+        done &= next[t] == BENCH_HISTORY_OPS;
+    }
+    if (done)
+        return 1;
+    if (dead[index])
+        return 0;
+    for (int t = 0; t < BENCH_HISTORY_THREADS; t++) {
+        if (next[t] == BENCH_HISTORY_OPS)
+            continue;
+        const SlotHistoryEntry *call = &workers[t].history[next[t]];
+        int blocked = 0;
+        for (int u = 0; u < BENCH_HISTORY_THREADS; u++)
+            blocked |= u != t && next[u] < BENCH_HISTORY_OPS &&
+                       workers[u].history[next[u]].end < call->start;
+        int takes = free > 0 && free >= BENCH_SLOT_FLOOR;
+        if (blocked || (!call->release && call->taken != takes))
+            continue;
+        next[t]++;
+        int found = linearizeSlotHistory(workers, next, call->release ? free + 1 : free - takes,
+                                         dead);
+        next[t]--;
+        if (found)
+            return 1;
+    }
+    dead[index] = 1;
+    return 0;
+}
+
+// Linearizability of reserveSlot()/releaseSlot(): BENCH_HISTORY_ROUNDS
+// rounds in which BENCH_HISTORY_THREADS threads start together on a cell
+// a few slots either side of the floor, each recording its calls; every
+// round's history must have a sequential order (linearizeSlotHistory).
+// Returns the rounds that have none.
+static long checkSlotHistories(int checkThenAct, long *takes, long *refusals) {
+    size_t states = 1;
+    for (int t = 0; t < BENCH_HISTORY_THREADS; t++)
+        states *= BENCH_HISTORY_OPS + 1;
+    unsigned char *dead = malloc(states);
+    SlotHistoryWorker workers[BENCH_HISTORY_THREADS];
+    pthread_t ids[BENCH_HISTORY_THREADS];
+    pthread_barrier_t barrier;
+    ParkingSlot slot;
+    if (!dead || pthread_barrier_init(&barrier, NULL, BENCH_HISTORY_THREADS + 1) != 0) {
+        free(dead);
+        return -1;
+    }
+    int started = 0;
+    for (int t = 0; t < BENCH_HISTORY_THREADS; t++) {
+        workers[t] = (SlotHistoryWorker){.slot = &slot, .barrier = &barrier,
+                                         .checkThenAct = checkThenAct,
+                                         .seed = 2463534242u + (unsigned int)t * 7919u};
+        if (pthread_create(&ids[t], NULL, runSlotHistoryWorker, &workers[t]) != 0)
+            break;
+        started++;
+    }
+    if (started < BENCH_HISTORY_THREADS) {
+        // The barrier would never open: nothing to check
+        fprintf(stderr, "bench: cannot start the history threads\n");
+        exit(1);
+    }
+
+    long failed = 0;
+    unsigned int seed = 88172645u;
+    *takes = *refusals = 0;
+    for (int round = 0; round < BENCH_HISTORY_ROUNDS; round++) {
+        int free = BENCH_SLOT_FLOOR - 2 + (int)(benchRandom(&seed) % 9);
+        atomic_store(&slot.counts, SLOT_COUNTS(BENCH_SLOT_BAYS - free, free));
+        pthread_barrier_wait(&barrier);
+        pthread_barrier_wait(&barrier);
+
+        int next[BENCH_HISTORY_THREADS] = {0};
+        memset(dead, 0, states);
+        if (!linearizeSlotHistory(workers, next, free, dead) && failed++ == 0 && !checkThenAct) {
+            fprintf(stderr, "bench: round %d from %d free has no sequential order:\n",
+                    round, free);
+            for (int t = 0; t < BENCH_HISTORY_THREADS; t++) {
+                for (int n = 0; n < BENCH_HISTORY_OPS; n++) {
+                    const SlotHistoryEntry *call = &workers[t].history[n];
+                    fprintf(stderr, "  thread %d [%lld, %lld] %s\n", t, (long long)call->start,
+                            (long long)call->end,
+                            call->release ? "release" : call->taken ? "take" : "refused");
+                }
+            }
+        }
+        for (int t = 0; t < BENCH_HISTORY_THREADS; t++) {
+            for (int n = 0; n < BENCH_HISTORY_OPS; n++) {
+                const SlotHistoryEntry *call = &workers[t].history[n];
+                *takes += !call->release && call->taken;
+                *refusals += !call->release && !call->taken;
+            }
+        }
+    }
+    for (int t = 0; t < BENCH_HISTORY_THREADS; t++)
+        pthread_join(ids[t], NULL);
+    pthread_barrier_destroy(&barrier);
+    free(dead);
+    return failed;
+}
+
+// Contention on one cell: first the linearizability check, then threads
+// threads reserve and release slots of a BENCH_SLOT_BAYS cell in bursts
+// with reserveSlot()'s CAS loop, then the same workload on counts behind a
+// mutex. The floor must hold throughout and the cell must end with every
+// slot free.
+static int benchSlots(int threads) {
+    SlotBenchWorker *workers = calloc((size_t)threads, sizeof(*workers));
+    pthread_t *ids = calloc((size_t)threads, sizeof(*ids));
+    if (!workers || !ids) {
+        fprintf(stderr, "bench: out of memory\n");
+        free(workers);
+        free(ids);
+        return 1;
+    }
+    int errors = 0;
+    printf("slots: linearizability, %d rounds of %d threads x %d calls on a cell of %d bays "
+           "starting %d..%d free, floor %d\n", BENCH_HISTORY_ROUNDS, BENCH_HISTORY_THREADS,
+           BENCH_HISTORY_OPS, BENCH_SLOT_BAYS, BENCH_SLOT_FLOOR - 2, BENCH_SLOT_FLOOR + 6,
+           BENCH_SLOT_FLOOR);
+    for (int checkThenAct = 0; checkThenAct < 2; checkThenAct++) {
+        long takes, refusals;
+        long failed = checkSlotHistories(checkThenAct, &takes, &refusals);
+        printf("  %-14s %ld takes, %ld refusals; %ld rounds not linearizable%s\n",
+               checkThenAct ? "check-then-act" : "reserveSlot", takes, refusals, failed,
+               checkThenAct ? " (must be > 0, or the check proves nothing)" : "");
+        // The racy variant is there to show the check can fail
+        errors += checkThenAct ? failed <= 0 : failed != 0;
+    }
 
-    // Customer type input
-    printf("\n| %-40s: \n", "Customer Type");
-    for (int i = 0; i < CUSTOMER_TYPE_COUNT; i++) {
-        printf("|   (%d) %-33s |\n", i, CustomerTypeNames[i]);
+    printf("slots: %d threads, one cell of %d bays with a floor of %d free, "
+           "%d bursts of 1..%d reservations or releases each\n",
+           threads, BENCH_SLOT_BAYS, BENCH_SLOT_FLOOR, BENCH_SLOT_ROUNDS, BENCH_SLOT_BURST);
+
+    for (int mode = 0; mode < 2; mode++) {
+        ParkingSlot slot;
+        LockedBenchSlot locked = {.allocated = 0, .free = BENCH_SLOT_BAYS};
+        atomic_init(&slot.counts, SLOT_COUNTS(0, BENCH_SLOT_BAYS));
+        pthread_mutex_init(&locked.lock, NULL);
+        int started = 0;
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int t = 0; t < threads; t++) {
+            workers[t] = (SlotBenchWorker){&slot, mode ? &locked : NULL,
+                                           2463534242u + (unsigned int)t * 7919u, 0, 0, 0};
+            if (pthread_create(&ids[t], NULL, runSlotBenchWorker, &workers[t]) != 0)
+                break;
+            started++;
+        }
+        long taken = 0, refused = 0, breaches = 0;
+        for (int t = 0; t < started; t++) {
+            pthread_join(ids[t], NULL);
+            taken += workers[t].taken;
+            refused += workers[t].refused;
+            breaches += workers[t].breaches;
+        }
+        double seconds = secondsSince(&start);
+        int allocated = mode ? locked.allocated : slotAllocated(&slot);
+        int free = mode ? locked.free : slotFree(&slot);
+        int settled = allocated == 0 && free == BENCH_SLOT_BAYS;
+        errors += started != threads || breaches || !settled;
+        printf("  %-6s %10.0f attempts/s %10.0f taken/s  %ld taken, %ld refused at the floor, "
+               "%ld floor breaches, %s\n", mode ? "mutex" : "CAS",
+               seconds > 0 ? (taken + refused) / seconds : 0.0,
+               seconds > 0 ? taken / seconds : 0.0, taken, refused, breaches,
+               settled ? "all slots back" : "slots lost");
+        pthread_mutex_destroy(&locked.lock);
     }
-    printf("| %-40s: ", "Enter Choice");
-    scanf("%d", &vehicle.customerType);
+    free(workers);
+    free(ids);
+    return errors ? 1 : 0;
+}
 
-    ParkingSlot *allocatedSlot = NULL;
-    enum CustomerType allocatedCustomerType = vehicle.customerType;
+int runBench(int argc, char *argv[]) {
+    if (argc >= 1 && strcmp(argv[0], "billing") == 0) {
+        long rows = argc >= 2 ? atol(argv[1]) : BENCH_BILLING_ROWS;
+        if (rows < 1) {
+            fprintf(stderr, "bench: row count must be positive\n");
+            return 1;
+        }
+        return benchBilling((size_t)rows);
+    }
+    if (argc >= 1 && strcmp(argv[0], "tariff") == 0) {
+        long rows = argc >= 2 ? atol(argv[1]) : BENCH_TARIFF_ROWS;
+        if (rows < 1) {
+            fprintf(stderr, "bench: row count must be positive\n");
+            return 1;
+        }
+        return benchTariff((size_t)rows);
+    }
+    if (argc >= 1 && strcmp(argv[0], "plates") == 0) {
+        long rows = argc >= 2 ? atol(argv[1]) : BENCH_PLATE_ROWS;
+        if (rows < 1) {
+            fprintf(stderr, "bench: row count must be positive\n");
+            return 1;
+        }
+        return benchPlates((size_t)rows);
+    }
+    if (argc >= 1 && strcmp(argv[0], "scan") == 0) {
+        long rows = argc >= 2 ? atol(argv[1]) : BENCH_SCAN_ROWS;
+        if (rows < 1) {
+            fprintf(stderr, "bench: row count must be positive\n");
+            return 1;
+        }
+        return benchScan((size_t)rows);
+    }
 
-    ParkingSlot *ownSlot = &parking.slots[vehicle.vehicleType][vehicle.customerType];
-    if (ownSlot->free > 0) {
-        allocatedSlot = ownSlot;
-    } 
-    else {
-        for (enum CustomerType c = DISABLED; c < vehicle.customerType; c++) {
-            ParkingSlot *candidate = &parking.slots[vehicle.vehicleType][c];
+    if (argc >= 1 && strcmp(argv[0], "render") == 0) {
+        long frames = argc >= 2 ? atol(argv[1]) : BENCH_RENDER_FRAMES;
+        if (frames < 1) {
+            fprintf(stderr, "bench: frame count must be positive\n");
+            return 1;
+        }
+        return benchRender(frames);
+    }
 
-            if (candidate->free <= 0)
-                continue;
+    if (argc >= 1 && strcmp(argv[0], "bays") == 0) {
+        long bays = argc >= 2 ? atol(argv[1]) : BENCH_BAYS;
+        if (bays < 100 || bays > MAX_LOT_VEHICLES) {
+            fprintf(stderr, "bench: bay count must be between 100 and %d\n", MAX_LOT_VEHICLES);
+            return 1;
+        }
+        return benchBays((int)bays);
+    }
 
-            float freeRatio = (float)candidate->free / candidate->total;
+    if (argc >= 1 && strcmp(argv[0], "ops") == 0) {
+        static const int defaultSizes[] = {1000, 10000, 100000};
+        long bays = argc >= 2 ? atol(argv[1]) : 0;
+        if (argc >= 2 && (bays < 100 || bays > MAX_LOT_VEHICLES)) {
+            fprintf(stderr, "bench: bay count must be between 100 and %d\n", MAX_LOT_VEHICLES);
+            return 1;
+        }
+        if (bays)
+            return benchOperations((int)bays);
+        int status = 0;
+        for (size_t i = 0; i < ARRAY_COUNT(defaultSizes); i++)
+            status |= benchOperations(defaultSizes[i]);
+        return status;
+    }
 
-            // Disabled slots rule
-            if (c == DISABLED && freeRatio <= 0.60)
-                continue;
+    if (argc >= 1 && strcmp(argv[0], "reports") == 0) {
+        long gates = argc >= 2 ? atol(argv[1]) : BENCH_REPORT_GATES;
+        if (gates < 1 || gates > MAX_GATE_WORKERS) {
+            fprintf(stderr, "bench: gate count must be between 1 and %d\n", MAX_GATE_WORKERS);
+            return 1;
+        }
+        return benchReports((int)gates);
+    }
 
-            // VIP slots rule
-            if (c == VIP && freeRatio <= 0.50)
-                continue;
+    if (argc >= 1 && strcmp(argv[0], "overstay") == 0) {
+        long vehicles = argc >= 2 ? atol(argv[1]) : BENCH_OVERSTAY_VEHICLES;
+        if (vehicles < 1 || vehicles > MAX_LOT_VEHICLES) {
+            fprintf(stderr, "bench: vehicle count must be between 1 and %d\n", MAX_LOT_VEHICLES);
+            return 1;
+        }
+        return benchOverstay((int)vehicles);
+    }
 
-            allocatedSlot = candidate;
-            allocatedCustomerType = c;
-            break;
+    if (argc >= 1 && strcmp(argv[0], "archive") == 0) {
+        long days = argc >= 2 ? atol(argv[1]) : BENCH_ARCHIVE_DAYS;
+        if (days < 1 || days > 3660) {
+            fprintf(stderr, "bench: day count must be between 1 and 3660\n");
+            return 1;
         }
+        return benchArchive((int)days);
     }
 
-    // Final allocation decision
-    if (allocatedSlot) {
-        allocatedSlot->allocated++;
-        allocatedSlot->free--;
+    if (argc >= 1 && strcmp(argv[0], "shared") == 0) {
+        long gates = argc >= 2 ? atol(argv[1]) : BENCH_SHARED_GATES;
+        if (gates < 1 || gates > BENCH_SHARED_GATES) {
+            fprintf(stderr, "bench: gate count must be between 1 and %d\n", BENCH_SHARED_GATES);
+            return 1;
+        }
+        return benchShared((int)gates);
+    }
 
-        vehicle.customerType = allocatedCustomerType;
-        vehicle.arrivalTime = time(NULL);
-        parking.vehicles[parking.vehicleCount++] = vehicle;
+    if (argc >= 1 && strcmp(argv[0], "reservations") == 0) {
+        long count = argc >= 2 ? atol(argv[1]) : BENCH_RESERVATIONS;
+        if (count < 1 || count > 10000000) {
+            fprintf(stderr, "bench: booking count must be between 1 and 10000000\n");
+            return 1;
+        }
+        return benchReservations(count);
+    }
 
-        printf("\n+====================================================+\n");
-        printf("| Vehicle parked successfully under %-12s slot |\n",
-               CustomerTypeNames[allocatedCustomerType]);
-        printf("+====================================================+\n\n");
-    } else {
-        printf("\n+====================================================+\n");
-        printf("| No suitable slot available based on priority rules |\n");
-        printf("+====================================================+\n\n");
+    if (argc >= 1 && strcmp(argv[0], "replication") == 0) {
+        long gates = argc >= 2 ? atol(argv[1]) : BENCH_REPLICATION_GATES;
+        if (gates < 1 || gates > BENCH_REPLICATION_GATES) {
+            fprintf(stderr, "bench: gate count must be between 1 and %d\n",
+                    BENCH_REPLICATION_GATES);
+            return 1;
+        }
+        return benchReplication((int)gates);
     }
-}
 
-void checkAvailability() {
-    int backChoice;
+    if (argc >= 1 && strcmp(argv[0], "startup") == 0) {
+        static const int defaultSizes[] = {10000, 1000000, 10000000};
+        long vehicles = argc >= 2 ? atol(argv[1]) : 0;
+        if (argc >= 2 && (vehicles < 1 || vehicles > MAX_LOT_VEHICLES)) {
+            fprintf(stderr, "bench: vehicle count must be between 1 and %d\n", MAX_LOT_VEHICLES);
+            return 1;
+        }
+        printf("startup: loadSnapshot of one full lot as records (one load) and as its "
+               "mapped arena (best of %d)\n", BENCH_STARTUP_ROUNDS);
+        if (vehicles)
+            return benchStartup((int)vehicles);
+        int status = 0;
+        for (size_t i = 0; i < ARRAY_COUNT(defaultSizes); i++)
+            status |= benchStartup(defaultSizes[i]);
+        return status;
+    }
 
-    do {
-        printf("\n================ Availability ================\n");
+    if (argc >= 1 && strcmp(argv[0], "exit") == 0)
+        return benchExit();
 
-        printf("%-15s | %-15s | %5s\n", "Vehicle Type", "Customer Type", "Free");
-        printf("--------------------------------------------\n");
+    if (argc >= 1 && strcmp(argv[0], "slots") == 0) {
+        long threads = argc >= 2 ? atol(argv[1]) : BENCH_SLOT_THREADS;
+        if (threads < 1 || threads > MAX_GATE_WORKERS) {
+            fprintf(stderr, "bench: thread count must be between 1 and %d\n", MAX_GATE_WORKERS);
+            return 1;
+        }
+        return benchSlots((int)threads);
+    }
 
-        for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
-            for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
-                printf("%-15s | %-15s | %5d\n",
-                       VehicleTypeNames[i],        // Vehicle Type
-                       CustomerTypeNames[j],       // Customer Type
-                       parking.slots[i][j].free   // Free count
-                );
-            }
-            printf("\n");
+    if (argc >= 1 && strcmp(argv[0], "gates") == 0) {
+        long threads = argc >= 2 ? atol(argv[1]) : BENCH_GATE_THREADS;
+        if (threads < 1 || threads > MAX_GATE_WORKERS) {
+            fprintf(stderr, "bench: thread count must be between 1 and %d\n", MAX_GATE_WORKERS);
+            return 1;
         }
+        return benchGates((int)threads);
+    }
 
-        printf("============================================\n");
+    if (argc >= 1 && strcmp(argv[0], "recovery") == 0) {
+        long entries = argc >= 2 ? atol(argv[1]) : BENCH_RECOVERY_ENTRIES;
+        if (entries < 1 || entries > MAX_LOT_VEHICLES) {
+            fprintf(stderr, "bench: entry count must be between 1 and %d\n", MAX_LOT_VEHICLES);
+            return 1;
+        }
+        return benchRecovery((int)entries);
+    }
+    if (argc >= 1 && strcmp(argv[0], "replay") == 0) {
+        long events = argc >= 2 ? atol(argv[1]) : BENCH_REPLAY_EVENTS;
+        if (events < 1) {
+            fprintf(stderr, "bench: event count must be positive\n");
+            return 1;
+        }
+        return benchReplay(events);
+    }
 
-        printf("\nEnter 0 to go back to the Main Menu: ");
-        scanf("%d", &backChoice);
-        getchar();
-    } while (backChoice != 0);
+    fprintf(stderr, "usage: ./main --bench billing|scan|tariff|plates [rows] | render [frames] | bays [bays]"
+                    " | ops [bays] | reports [gates] | overstay [vehicles] | archive [days]"
+                    " | shared [gates] | reservations [bookings] | replication [gates]"
+                    " | startup [vehicles] | exit | recovery [entries] | gates [maxThreads]"
+                    " | slots [threads] | replay [events]\n");
+    return 1;
 }
+// ================================================
 
-void exitVehicle() {
-    char vehicleNumber[20];
+// ================== SIMULATION ==================
+// ./main --simulate [poisson|rush-hour|event-day] [--seed N] [--days N] [--rate N]
+// Discrete-event simulation: seeded arrivals (a non-homogeneous Poisson
+// process shaped by the traffic pattern) and their departures are kept in
+// a time-ordered event heap and fed straight into parkVehicle() and
+// unparkVehicle() on empty in-memory lots, with the simulated time as the
+// parking clock. The same seed always produces the same run.
+typedef struct {
+    const char *name;
+    double hourlyFactor[24]; // arrival rate multiplier by hour of day
+    double meanStayHours;
+} TrafficPattern;
 
-    printf("\n==================== Exit Vehicle ===================\n");
-    printf("| %-30s: ", "Enter vehicle number");
-    scanf("%s", vehicleNumber);
+static const TrafficPattern TRAFFIC_PATTERNS[] = {
+    {"poisson", {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1}, 2.0},
+    {"rush-hour", {0.2, 0.1, 0.1, 0.1, 0.2, 0.4, 0.8, 2.0, 3.0, 2.0, 1.0, 1.0,
+                   1.0, 1.0, 1.0, 1.2, 2.0, 3.0, 2.0, 1.0, 0.6, 0.4, 0.3, 0.2}, 2.0},
+    {"event-day", {0.1, 0.1, 0.1, 0.1, 0.1, 0.2, 0.4, 0.6, 0.8, 0.8, 0.8, 0.8,
+                   0.8, 0.8, 0.8, 1.0, 2.0, 4.0, 6.0, 5.0, 1.5, 0.5, 0.3, 0.2}, 3.5}
+};
 
-    for (int i = 0; i < parking.vehicleCount; i++) {
-        if (strcmp(parking.vehicles[i].vehicleNumber, vehicleNumber) == 0) {
-            Vehicle vehicle = parking.vehicles[i];
-            time_t exitTime = time(NULL);
+// Share of arrivals per vehicle and customer type, in percent
+static const int SIMULATION_VEHICLE_MIX[] = {
+    [MOTORCYCLE] = 25, [THREE_WHEELER] = 15, [CAR] = 40, [VAN] = 12, [BUS] = 8
+};
+static const int SIMULATION_CUSTOMER_MIX[] = {
+    [DISABLED] = 5, [VIP] = 8, [STAFF] = 15, [REGISTERED] = 27, [GUEST] = 45
+};
 
-            ParkingSlot *slot = &parking.slots[vehicle.vehicleType][vehicle.customerType];
-            slot->allocated--;
-            slot->free++;
+#define SIMULATION_START_TIME 1736121600 // a Monday, 00:00 UTC
+#define SIMULATION_MIN_STAY 300
 
-            generateBill(vehicle, exitTime);
+typedef struct {
+    time_t time;
+    long sequence;  // breaks ties in creation order
+    long vehicle;   // vehicle serial for a departure, -1 for an arrival
+    int lotIndex;
+} SimulationEvent;
 
-            for (int j = i; j < parking.vehicleCount - 1; j++) {
-                parking.vehicles[j] = parking.vehicles[j + 1]; 
-            }
-            parking.vehicleCount--;
+typedef struct {
+    SimulationEvent *events;
+    long count;
+    long capacity;
+} SimulationQueue;
 
-            printf("\n+--------------------------------------------+\n");
-            printf("| Vehicle successfully exited the parking!  |\n");
-            printf("+--------------------------------------------+\n\n");
+static int eventBefore(const SimulationEvent *a, const SimulationEvent *b) {
+    return a->time != b->time ? a->time < b->time : a->sequence < b->sequence;
+}
 
-            return;
-        }
+static int pushEvent(SimulationQueue *queue, SimulationEvent event) {
+    if (queue->count == queue->capacity) {
+        long capacity = queue->capacity ? queue->capacity * 2 : 1024;
+        SimulationEvent *events = realloc(queue->events, (size_t)capacity * sizeof(*events));
+        if (!events) return -1;
+        queue->events = events;
+        queue->capacity = capacity;
     }
 
-    printf("\n+--------------------------------------------+\n");
-    printf("| Vehicle not found in the parking system.   |\n");
-    printf("+--------------------------------------------+\n\n");
+    long i = queue->count++;
+    while (i > 0 && eventBefore(&event, &queue->events[(i - 1) / 2])) {
+        queue->events[i] = queue->events[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    queue->events[i] = event;
+    return 0;
 }
 
-// void generateBill(Vehicle vehicle, time_t exitTime) {
-//     // Calculate parking duration
-//     double duration = difftime(exitTime, vehicle.arrivalTime) / 3600.0; // in hours
-//     int hours = (int)duration;
-//     int minutes = (int)((duration - hours) * 60);
+static SimulationEvent popEvent(SimulationQueue *queue) {
+    SimulationEvent top = queue->events[0];
+    SimulationEvent last = queue->events[--queue->count];
+    long i = 0;
+    for (;;) {
+        long child = 2 * i + 1;
+        if (child >= queue->count) break;
+        if (child + 1 < queue->count && eventBefore(&queue->events[child + 1], &queue->events[child]))
+            child++;
+        if (!eventBefore(&queue->events[child], &last)) break;
+        queue->events[i] = queue->events[child];
+        i = child;
+    }
+    if (queue->count > 0)
+        queue->events[i] = last;
+    return top;
+}
 
-//     // Calculate fees
-//     int fee = FIRST_HOUR_FEE[vehicle.vehicleType];
-//     if (hours > 1) {
-//         fee += (hours - 1) * ADDITIONAL_HOUR_FEE[vehicle.vehicleType];
-//     }
+// Uniform in (0, 1)
+static double simulationUniform(unsigned int *seed) {
+    return (benchRandom(seed) + 0.5) / 4294967296.0;
+}
 
-//     float discount = fee * DISCOUNTS[vehicle.customerType];
-//     float totalPayable = fee - discount;
+static double simulationExponential(unsigned int *seed, double mean) {
+    return -log(simulationUniform(seed)) * mean;
+}
 
-//     // Print the parking bill
-//     printf("\n+=================== Parking Bill ===================+\n");
-//     printf("| %-20s : %s\n", "Vehicle Number", vehicle.vehicleNumber);
-//     printf("| %-20s : %s\n", "Vehicle Type", VehicleTypeNames[vehicle.vehicleType]);
-//     printf("| %-20s : %s\n", "Customer Type", CustomerTypeNames[vehicle.customerType]);
-//     printf("| %-20s : %s", "Entered Time", ctime(&vehicle.arrivalTime));
-//     printf("| %-20s : %s", "Exit Time", ctime(&exitTime));
-//     printf("| %-20s : %d hours %d minutes\n", "Parking Duration", hours, minutes);
-//     printf("| %-20s : Rs %d.00\n", "Total Charge", fee);
-//     printf("| %-20s : Rs %.2f\n", "Discount", discount);
-//     printf("| %-20s : Rs %.2f\n", "Total Payable", totalPayable);
-//     printf("+====================================================+\n\n");
-// }
+static int pickFromMix(unsigned int *seed, const int *percent, int count) {
+    int roll = (int)(benchRandom(seed) % 100);
+    for (int i = 0; i < count - 1; i++) {
+        if (roll < percent[i]) return i;
+        roll -= percent[i];
+    }
+    return count - 1;
+}
+
+static void simulationPlate(PlateKey *plate, long serial) {
+    char plateText[VEHICLE_NUMBER_LENGTH];
+    snprintf(plateText, sizeof(plateText), "SIM%u", (unsigned int)serial);
+    encodePlate(plateText, plate);
+}
 
-void generateBill(Vehicle vehicle, time_t exitTime) {
-    // Calculate exact duration in seconds
-    double durationSeconds = difftime(exitTime, vehicle.arrivalTime);
+static time_t simulationTime;
 
-    // Display duration
-    int totalMinutes = (int)(durationSeconds / 60);
-    int displayHours = totalMinutes / 60;
-    int displayMinutes = totalMinutes % 60;
+static time_t simulationClock() {
+    return simulationTime;
+}
 
-    // Billing hours (round UP)
-    double durationHours = durationSeconds / 3600.0;
-    int billableHours = (int)ceil(durationHours);
-    if (billableHours < 1)
-        billableHours = 1;
+// Samples grow as needed; a failed allocation just drops the sample
+typedef struct {
+    long *samples;
+    long count;
+    long capacity;
+} LatencySamples;
+
+static void addLatency(LatencySamples *latencies, long nanos) {
+    if (latencies->count == latencies->capacity) {
+        long capacity = latencies->capacity ? latencies->capacity * 2 : 4096;
+        long *samples = realloc(latencies->samples, (size_t)capacity * sizeof(*samples));
+        if (!samples) return;
+        latencies->samples = samples;
+        latencies->capacity = capacity;
+    }
+    latencies->samples[latencies->count++] = nanos;
+}
 
-    // Calculate fees
-    int fee = FIRST_HOUR_FEE[vehicle.vehicleType];
-    if (billableHours > 1) {
-        fee += (billableHours - 1) * ADDITIONAL_HOUR_FEE[vehicle.vehicleType];
+int runSimulation(int argc, char *argv[]) {
+    const TrafficPattern *pattern = &TRAFFIC_PATTERNS[0];
+    unsigned int seed = 1;
+    int days = 1;
+    double ratePerHour = 0;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--days") == 0 && i + 1 < argc) {
+            days = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            ratePerHour = atof(argv[++i]);
+        } else {
+            pattern = NULL;
+            for (size_t p = 0; p < ARRAY_COUNT(TRAFFIC_PATTERNS); p++) {
+                if (strcmp(argv[i], TRAFFIC_PATTERNS[p].name) == 0)
+                    pattern = &TRAFFIC_PATTERNS[p];
+            }
+            if (!pattern) {
+                fprintf(stderr, "usage: ./main --simulate [poisson|rush-hour|event-day] "
+                                "[--seed N] [--days N] [--rate arrivals/hour]\n");
+                return 1;
+            }
+        }
     }
+    if (seed == 0) seed = 1; // xorshift needs a non-zero state
+    unsigned int initialSeed = seed;
+    if (days < 1) days = 1;
 
-    // Apply discount
-    float discount = fee * DISCOUNTS[vehicle.customerType];
-    float totalPayable = fee - discount;
+    long capacity = 0;
+    for (int i = 0; i < lotCount; i++) {
+        resetParking(&lots[i]);
+        capacity += lots[i].vehicleCapacity;
+    }
+    // By default offer about as many vehicles as the lots hold at the mean stay
+    if (ratePerHour <= 0)
+        ratePerHour = capacity / pattern->meanStayHours;
 
-    // Print the parking bill
-    printf("\n+=================== Parking Bill ===================+\n");
-    printf("| %-20s : %s\n", "Vehicle Number", vehicle.vehicleNumber);
-    printf("| %-20s : %s\n", "Vehicle Type", VehicleTypeNames[vehicle.vehicleType]);
-    printf("| %-20s : %s\n", "Customer Type", CustomerTypeNames[vehicle.customerType]);
-    printf("| %-20s : %s", "Entered Time", ctime(&vehicle.arrivalTime));
-    printf("| %-20s : %s", "Exit Time", ctime(&exitTime));
-    printf("| %-20s : %d hours %d minutes\n",
-           "Parking Duration", displayHours, displayMinutes);
-    printf("| %-20s : Rs %d.00\n", "Total Charge", fee);
-    printf("| %-20s : Rs %.2f\n", "Discount", discount);
-    printf("| %-20s : Rs %.2f\n", "Total Payable", totalPayable);
-    printf("+====================================================+\n\n");
-}
+    double peakFactor = 0;
+    for (int h = 0; h < 24; h++)
+        if (pattern->hourlyFactor[h] > peakFactor) peakFactor = pattern->hourlyFactor[h];
+    double peakGap = 3600.0 / (ratePerHour * peakFactor);
 
-void viewParkingSpace() {
-    printf("\n+======================================================= Parking Space ============================================================\n\n");
+    time_t (*previousClock)() = parkingClock;
+    parkingClock = simulationClock;
 
-    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
-        printf("%-15s: { ", VehicleTypeNames[i]);
+    SimulationQueue queue = {0};
+    LatencySamples parkLatency = {0}, unparkLatency = {0};
+    long results[PARK_NO_SLOT + 1] = {0};
+    long rejectedByType[VEHICLE_TYPE_COUNT] = {0};
+    long rejectedByTier[CUSTOMER_TYPE_COUNT] = {0};
+    long arrivals = 0, departures = 0, events = 0, occupied = 0, peakOccupied = 0;
+    long long revenueCents = 0;
+    long sequence = 0;
+    time_t end = SIMULATION_START_TIME + (time_t)days * 86400;
+    double nextArrival = SIMULATION_START_TIME;
+    int status = 0;
 
-        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
-            int allocated = parking.slots[i][j].allocated;
-            int free = parking.slots[i][j].free;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
-            for (int k = 0; k < allocated; k++) {
-                printf("%s", CustomerTypeSymbols[j]);
+    // The next arrival is always queued; each one queues its successor
+    // (thinning: candidates at the peak rate, kept in proportion to the
+    // rate of their hour).
+    for (;;) {
+        if (queue.count == 0 || queue.events[0].vehicle >= 0) {
+            int queued = 0;
+            while (!queued && nextArrival < end) {
+                nextArrival += simulationExponential(&seed, peakGap);
+                int hour = (int)((long long)(nextArrival - SIMULATION_START_TIME) % 86400 / 3600);
+                if (simulationUniform(&seed) * peakFactor <= pattern->hourlyFactor[hour] &&
+                    nextArrival < end) {
+                    SimulationEvent arrival = {(time_t)nextArrival, sequence++, -1,
+                                               (int)(benchRandom(&seed) % (unsigned int)lotCount)};
+                    if (pushEvent(&queue, arrival) != 0) status = 1;
+                    queued = 1;
+                }
             }
+            if (!queued) nextArrival = end;
+        }
+        if (queue.count == 0 || status)
+            break;
+
+        SimulationEvent event = popEvent(&queue);
+        ParkingManagement *lot = &lots[event.lotIndex];
+        simulationTime = event.time;
+        events++;
 
-            for (int k = 0; k < free; k++) {
-                printf("F");
+        if (event.vehicle < 0) {
+            Vehicle vehicle;
+            long serial = arrivals++;
+            simulationPlate(&vehicle.plate, serial);
+            vehicle.vehicleType = pickFromMix(&seed, SIMULATION_VEHICLE_MIX, VEHICLE_TYPE_COUNT);
+            vehicle.customerType = pickFromMix(&seed, SIMULATION_CUSTOMER_MIX, CUSTOMER_TYPE_COUNT);
+            time_t stay = SIMULATION_MIN_STAY +
+                          (time_t)simulationExponential(&seed, pattern->meanStayHours * 3600);
+
+            struct timespec begin;
+            clock_gettime(CLOCK_MONOTONIC, &begin);
+            enum ParkResult result = parkVehicle(lot, &vehicle, parkingClock());
+            addLatency(&parkLatency, nanosSince(&begin));
+
+            results[result]++;
+            if (result != PARK_OK) {
+                rejectedByType[vehicle.vehicleType]++;
+                rejectedByTier[vehicle.customerType]++;
+                continue;
             }
+            if (++occupied > peakOccupied) peakOccupied = occupied;
+            SimulationEvent departure = {event.time + stay, sequence++, serial, event.lotIndex};
+            if (pushEvent(&queue, departure) != 0) status = 1;
+        } else {
+            PlateKey plate;
+            Vehicle vehicle;
+            Bill bill;
+            simulationPlate(&plate, event.vehicle);
 
-            if (j < CUSTOMER_TYPE_COUNT - 1) {
-                printf(" | ");
+            struct timespec begin;
+            clock_gettime(CLOCK_MONOTONIC, &begin);
+            int found = unparkVehicle(lot, plate, parkingClock(), &vehicle, &bill) == 0;
+            addLatency(&unparkLatency, nanosSince(&begin));
+
+            if (found) {
+                occupied--;
+                departures++;
+                revenueCents += bill.payableCents;
             }
         }
-
-        printf(" }\n");
     }
+    double seconds = secondsSince(&start);
+    parkingClock = previousClock;
 
-    printf("\n+================================================================================================================================+\n\n");
+    long rejected = arrivals - results[PARK_OK];
+    printf("simulation: %s, seed %u, %d day(s), base rate %.0f arrivals/hour, "
+           "%d lot(s), %ld bays, policy %s\n",
+           pattern->name, initialSeed, days, ratePerHour, lotCount, capacity, allocationPolicy->name);
+    printf("  events      %10ld  (%.0f events/s)\n", events, seconds > 0 ? events / seconds : 0.0);
+    printf("  arrivals    %10ld\n", arrivals);
+    printf("  parked      %10ld\n", results[PARK_OK]);
+    printf("  rejected    %10ld  (%.2f%%: full %ld, no slot %ld)\n", rejected,
+           arrivals ? 100.0 * rejected / arrivals : 0.0, results[PARK_FULL], results[PARK_NO_SLOT]);
+    printf("  departures  %10ld\n", departures);
+    printf("  peak        %10ld  (%.1f%% of bays)\n", peakOccupied,
+           capacity ? 100.0 * peakOccupied / capacity : 0.0);
+    printf("  revenue  Rs %10lld.%02lld\n", revenueCents / 100, revenueCents % 100);
+    printf("  rejected by vehicle type:");
+    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++)
+        printf(" %s %ld%s", VehicleTypeNames[i], rejectedByType[i],
+               i < VEHICLE_TYPE_COUNT - 1 ? "," : "\n");
+    printf("  rejected by customer type:");
+    for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++)
+        printf(" %s %ld%s", CustomerTypeNames[j], rejectedByTier[j],
+               j < CUSTOMER_TYPE_COUNT - 1 ? "," : "\n");
+    if (parkLatency.count)
+        printLatencies("park", parkLatency.samples, parkLatency.count);
+    if (unparkLatency.count)
+        printLatencies("exit", unparkLatency.samples, unparkLatency.count);
+
+    free(queue.events);
+    free(parkLatency.samples);
+    free(unparkLatency.samples);
+    if (status)
+        fprintf(stderr, "simulation: out of memory\n");
+    return status;
 }
+// ================================================
 
-void viewStatistics() {
-    int choice = 1; 
+// ================== SERVICE =====================
+// ./main --serve [socket path]: answers batch-mode request lines from many
+// gate clients over a Unix domain socket. One thread runs an event loop
+// (epoll on Linux, poll elsewhere) over non-blocking connections. Every
+// connection has fixed input and output buffers allocated at startup:
+// all complete request lines read in one go are answered into the output
+// buffer and sent with a single write. A client that does not read its
+// responses stops being read once its output buffer is full.
+// SIGINT/SIGTERM stop the loop; lots are saved on the way out.
+typedef struct {
+    int fd;                        // -1 when the slot is free
+    int closing;                   // peer closed; drop once output is sent
+    int discarding;                // inside an over-long line
+    size_t inLength;
+    size_t outLength;
+    size_t outSent;
+    char in[SERVE_INPUT_BUFFER];
+    char out[SERVE_OUTPUT_BUFFER];
+} ServeConnection;
 
-    do {
-        if (choice == 1) {
-            viewStatisticsTableView();
-        } else if (choice == 2) {
-            viewStatisticsGraph();
-        }
+#define SERVE_LISTENER MAX_SERVE_CLIENTS // event loop id of the listening socket
 
-        printf("\n| %-18s | %-18s | %-18s \n", "1: Table View", "2: Graph View", "0: Go Back");
-        printf("\n");
-        printf("+=============================================================+\n");
-        printf("Enter your choice: ");
-        scanf("%d", &choice);
-        getchar(); 
+static volatile sig_atomic_t serviceStopping = 0;
 
-        if (choice != 0 && choice != 1 && choice != 2) {
-            printf("Invalid choice. Please try again.\n");
-            choice = 1;
-        }
+static void stopService(int signalNumber) {
+    (void)signalNumber;
+    serviceStopping = 1;
+}
 
-    } while (choice != 0);
+static int setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
 }
 
-void viewStatisticsTableView() {
-    printf("\n+=================== Parking Statistics ======================+\n");
+// Event loop over the listener and the connection slots. Ids are slot
+// numbers (SERVE_LISTENER for the listener).
+typedef struct {
+#ifdef __linux__
+    int epollFd;
+    struct epoll_event events[MAX_SERVE_CLIENTS + 1];
+#else
+    struct pollfd fds[MAX_SERVE_CLIENTS + 1];
+    int ids[MAX_SERVE_CLIENTS + 1];
+    int fdCount;
+#endif
+    int fdOf[MAX_SERVE_CLIENTS + 1];
+    short wanted[MAX_SERVE_CLIENTS + 1]; // POLLIN / POLLOUT, 0 = not watched
+} EventLoop;
 
-    printf("| %-15s | %-15s | %-10s | %-10s |\n", 
-           "Vehicle Type", "Customer Type", "Allocated", "Free");
-    printf("+-------------------------------------------------------------+\n");
+static int eventLoopInit(EventLoop *loop) {
+    for (int id = 0; id <= MAX_SERVE_CLIENTS; id++) {
+        loop->fdOf[id] = -1;
+        loop->wanted[id] = 0;
+    }
+#ifdef __linux__
+    loop->epollFd = epoll_create1(0);
+    return loop->epollFd < 0 ? -1 : 0;
+#else
+    return 0;
+#endif
+}
 
-    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
-        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
-            printf("| %-15s | %-15s | %-10d | %-10d |\n",
-                   VehicleTypeNames[i],
-                   CustomerTypeNames[j],
-                   parking.slots[i][j].allocated,
-                   parking.slots[i][j].free);
+// Starts, changes or (events == 0) stops watching fd under id
+static void eventLoopWatch(EventLoop *loop, int id, int fd, short events) {
+#ifdef __linux__
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = (events & POLLIN ? EPOLLIN : 0) | (events & POLLOUT ? EPOLLOUT : 0);
+    event.data.u32 = (uint32_t)id;
+    if (loop->wanted[id] == 0 && events != 0)
+        epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, fd, &event);
+    else if (events == 0 && loop->wanted[id] != 0)
+        epoll_ctl(loop->epollFd, EPOLL_CTL_DEL, fd, &event);
+    else if (events != loop->wanted[id])
+        epoll_ctl(loop->epollFd, EPOLL_CTL_MOD, fd, &event);
+#endif
+    loop->fdOf[id] = events ? fd : -1;
+    loop->wanted[id] = events;
+}
+
+// Waits for readiness; fills ids[] and ready[] (POLLIN/POLLOUT/POLLHUP bits)
+static int eventLoopWait(EventLoop *loop, int *ids, short *ready, int timeoutMs) {
+#ifdef __linux__
+    int count = epoll_wait(loop->epollFd, loop->events, MAX_SERVE_CLIENTS + 1, timeoutMs);
+    for (int i = 0; i < count; i++) {
+        uint32_t events = loop->events[i].events;
+        ids[i] = (int)loop->events[i].data.u32;
+        ready[i] = (short)((events & EPOLLIN ? POLLIN : 0) | (events & EPOLLOUT ? POLLOUT : 0) |
+                           (events & (EPOLLHUP | EPOLLERR) ? POLLHUP : 0));
+    }
+    return count;
+#else
+    loop->fdCount = 0;
+    for (int id = 0; id <= MAX_SERVE_CLIENTS; id++) {
+        if (!loop->wanted[id]) continue;
+        loop->fds[loop->fdCount].fd = loop->fdOf[id];
+        loop->fds[loop->fdCount].events = loop->wanted[id];
+        loop->fds[loop->fdCount].revents = 0;
+        loop->ids[loop->fdCount++] = id;
+    }
+    int count = poll(loop->fds, (nfds_t)loop->fdCount, timeoutMs);
+    int found = 0;
+    for (int i = 0; count > 0 && i < loop->fdCount; i++) {
+        if (!loop->fds[i].revents) continue;
+        ids[found] = loop->ids[i];
+        ready[found++] = loop->fds[i].revents;
+    }
+    return count < 0 ? count : found;
+#endif
+}
+
+static void closeConnection(EventLoop *loop, ServeConnection *connection, int id) {
+    eventLoopWatch(loop, id, connection->fd, 0);
+    close(connection->fd);
+    connection->fd = -1;
+}
+
+// Answers every complete line in the input buffer while the output buffer
+// has room for another result. Returns the number of requests answered.
+static long answerRequests(ServeConnection *connection) {
+    long answered = 0;
+    size_t start = 0;
+    while (start < connection->inLength &&
+           SERVE_OUTPUT_BUFFER - connection->outLength >= BATCH_LINE_LENGTH + 64) {
+        char *newline = memchr(connection->in + start, '\n', connection->inLength - start);
+        size_t length = newline ? (size_t)(newline - connection->in) - start + 1
+                                : connection->inLength - start;
+        if (connection->discarding) {
+            // Rest of an over-long line that was already answered
+            connection->discarding = !newline;
+            start += length;
+            continue;
         }
-        printf("+-------------------------------------------------------------+\n"); 
+        if (length >= BATCH_LINE_LENGTH) {
+            connection->outLength += snprintf(connection->out + connection->outLength,
+                                              SERVE_OUTPUT_BUFFER - connection->outLength,
+                                              "ERR PARSE - - TOO_LONG\n");
+            connection->discarding = !newline;
+            start += length;
+            answered++;
+            continue;
+        }
+        if (!newline && !connection->closing)
+            break; // wait for the rest of the line
+
+        char line[BATCH_LINE_LENGTH];
+        memcpy(line, connection->in + start, length);
+        line[length] = '\0';
+        start += length;
+
+        int status = processBatchLine(line, connection->out + connection->outLength,
+                                      SERVE_OUTPUT_BUFFER - connection->outLength);
+        if (status < 0)
+            continue;
+        connection->outLength += strlen(connection->out + connection->outLength);
+        answered++;
     }
+    memmove(connection->in, connection->in + start, connection->inLength - start);
+    connection->inLength -= start;
+    return answered;
+}
 
-    printf("+=============================================================+\n");
+// Sends what it can of the pending output. Returns -1 if the peer is gone.
+static int sendResponses(ServeConnection *connection) {
+    while (connection->outSent < connection->outLength) {
+        ssize_t sent = write(connection->fd, connection->out + connection->outSent,
+                             connection->outLength - connection->outSent);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        connection->outSent += (size_t)sent;
+    }
+    connection->outLength = connection->outSent = 0;
+    return 0;
 }
 
-void viewStatisticsGraph() {
-    int vehicleColWidth = 15;  
-    int customerColWidth = 25;  
-    int barWidth = 20;
+int runService(const char *socketPath) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "serve: socket path too long\n");
+        return 1;
+    }
+    strcpy(address.sun_path, socketPath);
 
-    printf("\n+==================================================================== Parking Graph ===================================================================+\n");
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath);
+    if (listener < 0 || bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(listener, 128) != 0 || setNonBlocking(listener) != 0) {
+        fprintf(stderr, "serve: cannot listen on %s: %s\n", socketPath, strerror(errno));
+        if (listener >= 0) close(listener);
+        return 1;
+    }
 
-    printf("| %-*s|", vehicleColWidth, "Vehicle Type");
-    for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
-        printf(" %-*s ", customerColWidth, CustomerTypeNames[j]);
+    ServeConnection *connections = malloc(MAX_SERVE_CLIENTS * sizeof(ServeConnection));
+    EventLoop *loop = malloc(sizeof(EventLoop));
+    int *ids = malloc((MAX_SERVE_CLIENTS + 1) * sizeof(int));
+    short *ready = malloc((MAX_SERVE_CLIENTS + 1) * sizeof(short));
+    if (!connections || !loop || !ids || !ready || eventLoopInit(loop) != 0) {
+        fprintf(stderr, "serve: cannot set up the event loop\n");
+        free(connections);
+        free(loop);
+        free(ids);
+        free(ready);
+        close(listener);
+        unlink(socketPath);
+        return 1;
     }
-    printf("\n");
+    for (int id = 0; id < MAX_SERVE_CLIENTS; id++)
+        connections[id].fd = -1;
+    eventLoopWatch(loop, SERVE_LISTENER, listener, POLLIN);
 
-    printf("");
-    printf("%.*s", vehicleColWidth + 2, "==============================");
-    for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
-        printf("%.*s", customerColWidth + 2, "===============================");
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopService;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN); // a vanished client must not kill the daemon
+    watchControlSignals();
+    fprintf(stderr, "serve: listening on %s\n", socketPath);
+
+    long accepted = 0, requests = 0;
+    while (!serviceStopping) {
+        dumpRequestedTimings();
+        reloadRequestedTariff();
+        int count = eventLoopWait(loop, ids, ready, 1000);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "serve: event loop failed: %s\n", strerror(errno));
+            break;
+        }
+
+        for (int e = 0; e < count; e++) {
+            int id = ids[e];
+            if (id == SERVE_LISTENER) {
+                int fd;
+                while ((fd = accept(listener, NULL, NULL)) >= 0) {
+                    int slot = 0;
+                    while (slot < MAX_SERVE_CLIENTS && connections[slot].fd >= 0)
+                        slot++;
+                    if (slot == MAX_SERVE_CLIENTS || setNonBlocking(fd) != 0) {
+                        close(fd); // full: the client sees the connection drop
+                        continue;
+                    }
+                    ServeConnection *connection = &connections[slot];
+                    connection->fd = fd;
+                    connection->closing = connection->discarding = 0;
+                    connection->inLength = connection->outLength = connection->outSent = 0;
+                    eventLoopWatch(loop, slot, fd, POLLIN);
+                    accepted++;
+                }
+                continue;
+            }
+
+            ServeConnection *connection = &connections[id];
+            if (connection->fd < 0)
+                continue;
+            if ((ready[e] & (POLLIN | POLLHUP)) && !connection->closing &&
+                connection->inLength < SERVE_INPUT_BUFFER) {
+                ssize_t got = read(connection->fd, connection->in + connection->inLength,
+                                   SERVE_INPUT_BUFFER - connection->inLength);
+                if (got > 0)
+                    connection->inLength += (size_t)got;
+                else if (got == 0 || (errno != EAGAIN && errno != EINTR))
+                    connection->closing = 1;
+            }
+
+            // Keep answering buffered lines while the responses drain at once
+            long answered;
+            int lost = 0;
+            do {
+                answered = answerRequests(connection);
+                requests += answered;
+                lost = sendResponses(connection) != 0;
+            } while (!lost && answered > 0 && connection->outLength == 0 && connection->inLength > 0);
+            int pending = connection->outLength > 0;
+            if (lost || (connection->closing && !pending && connection->inLength == 0)) {
+                closeConnection(loop, connection, id);
+                continue;
+            }
+            // Read more only once the responses so far are out
+            eventLoopWatch(loop, id, connection->fd, pending ? POLLOUT : POLLIN);
+        }
     }
-    printf("\n");
 
-    for (int i = 0; i < VEHICLE_TYPE_COUNT; i++) {
-        printf("|%-*s |", vehicleColWidth, VehicleTypeNames[i]);
-        for (int j = 0; j < CUSTOMER_TYPE_COUNT; j++) {
-            int allocated = parking.slots[i][j].allocated;
-            int free = parking.slots[i][j].free;
-            int totalSlots = allocated + free;
+    for (int id = 0; id < MAX_SERVE_CLIENTS; id++) {
+        if (connections[id].fd >= 0)
+            closeConnection(loop, &connections[id], id);
+    }
+#ifdef __linux__
+    close(loop->epollFd);
+#endif
+    close(listener);
+    unlink(socketPath);
+    free(connections);
+    free(loop);
+    free(ids);
+    free(ready);
+    fprintf(stderr, "serve: %ld connection(s), %ld request(s)\n", accepted, requests);
+    return 0;
+}
 
-            int scale = totalSlots > barWidth ? totalSlots / barWidth + 1 : 1;
-            int allocBars = allocated / scale;
-            int freeBars = free / scale;
+// ./main --loadtest [--socket path] [--clients N] [--requests N per client]
+//                   [--pipeline N] [--lot id]
+// Each client keeps up to --pipeline requests in flight, cycling through
+// ENTER, AVAILABILITY, EXIT and STATS for its own vehicles. Latency is
+// measured per request from the write of its pipeline batch to the
+// arrival of its response line.
+typedef struct {
+    const char *socketPath;
+    int clientId;
+    int lotId;
+    long requests;
+    int pipeline;
+    long *latencies;   // one per request, filled in order
+    long rejected;     // ERR responses
+    int failed;
+    pthread_t thread;
+} LoadClient;
 
-            for (int k = 0; k < allocBars; k++) printf("#");
-            for (int k = 0; k < freeBars; k++) printf("*");
+static void *runLoadClient(void *arg) {
+    LoadClient *client = arg;
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", client->socketPath);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        if (fd >= 0) close(fd);
+        client->failed = 1;
+        return NULL;
+    }
 
-            int remaining = customerColWidth - (allocBars + freeBars);
-            for (int k = 0; k < remaining; k++) printf(" ");
+    char request[MAX_LOADTEST_PIPELINE * 64];
+    char response[SERVE_OUTPUT_BUFFER];
+    size_t responseLength = 0;
+    long sent = 0;
+    while (sent < client->requests && !client->failed) {
+        int batch = client->pipeline;
+        if (batch > client->requests - sent)
+            batch = (int)(client->requests - sent);
+        size_t length = 0;
+        for (int i = 0; i < batch; i++) {
+            long n = sent + i;
+            long vehicle = n / 4;
+            char plate[20];
+            snprintf(plate, sizeof(plate), "LT%02d%07ld", client->clientId % 100, vehicle % 10000000);
+            switch (n % 4) {
+                case 0:
+                    length += snprintf(request + length, sizeof(request) - length,
+                                       "ENTER %d %s %ld %ld\n", client->lotId, plate,
+                                       vehicle % VEHICLE_TYPE_COUNT, vehicle / 5 % CUSTOMER_TYPE_COUNT);
+                    break;
+                case 1:
+                    length += snprintf(request + length, sizeof(request) - length,
+                                       "AVAILABILITY %d\n", client->lotId);
+                    break;
+                case 2:
+                    length += snprintf(request + length, sizeof(request) - length,
+                                       "EXIT %d %s\n", client->lotId, plate);
+                    break;
+                default:
+                    length += snprintf(request + length, sizeof(request) - length,
+                                       "STATS %d\n", client->lotId);
+            }
         }
-        printf("\n");
+
+        struct timespec begin;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        for (size_t written = 0; written < length;) {
+            ssize_t n = write(fd, request + written, length - written);
+            if (n <= 0) {
+                client->failed = 1;
+                break;
+            }
+            written += (size_t)n;
+        }
+
+        int answered = 0;
+        while (answered < batch && !client->failed) {
+            ssize_t n = read(fd, response + responseLength, sizeof(response) - responseLength);
+            if (n <= 0) {
+                client->failed = 1;
+                break;
+            }
+            responseLength += (size_t)n;
+            long nanos = nanosSince(&begin);
+            size_t start = 0;
+            char *newline;
+            while ((newline = memchr(response + start, '\n', responseLength - start))) {
+                if (strncmp(response + start, "ERR", 3) == 0)
+                    client->rejected++;
+                client->latencies[sent + answered++] = nanos;
+                start = (size_t)(newline - response) + 1;
+            }
+            memmove(response, response + start, responseLength - start);
+            responseLength -= start;
+        }
+        sent += batch;
+    }
+    close(fd);
+    return NULL;
+}
+
+int runLoadTest(int argc, char *argv[]) {
+    const char *socketPath = SERVE_SOCKET_PATH;
+    int clients = LOADTEST_CLIENTS, pipeline = LOADTEST_PIPELINE, lotId = DEFAULT_LOT_ID;
+    long requests = LOADTEST_REQUESTS;
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--socket") == 0) socketPath = argv[i + 1];
+        else if (strcmp(argv[i], "--clients") == 0) clients = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--requests") == 0) requests = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--pipeline") == 0) pipeline = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--lot") == 0) lotId = atoi(argv[i + 1]);
+        else argc = -1;
+    }
+    if (argc < 0 || argc % 2 != 0 || clients < 1 || clients > MAX_SERVE_CLIENTS || requests < 1 ||
+        pipeline < 1 || pipeline > MAX_LOADTEST_PIPELINE) {
+        fprintf(stderr, "usage: ./main --loadtest [--socket path] [--clients 1-%d] "
+                        "[--requests N] [--pipeline 1-%d] [--lot id]\n",
+                MAX_SERVE_CLIENTS, MAX_LOADTEST_PIPELINE);
+        return 1;
     }
 
-    printf("+===================================================================================================================================================+\n");
+    LoadClient *loadClients = calloc((size_t)clients, sizeof(LoadClient));
+    long *latencies = malloc((size_t)clients * (size_t)requests * sizeof(long));
+    if (!loadClients || !latencies) {
+        fprintf(stderr, "loadtest: out of memory\n");
+        free(loadClients);
+        free(latencies);
+        return 1;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int c = 0; c < clients; c++) {
+        loadClients[c].socketPath = socketPath;
+        loadClients[c].clientId = c;
+        loadClients[c].lotId = lotId;
+        loadClients[c].requests = requests;
+        loadClients[c].pipeline = pipeline;
+        loadClients[c].latencies = latencies + (size_t)c * (size_t)requests;
+        pthread_create(&loadClients[c].thread, NULL, runLoadClient, &loadClients[c]);
+    }
+    long rejected = 0;
+    int failed = 0;
+    for (int c = 0; c < clients; c++) {
+        pthread_join(loadClients[c].thread, NULL);
+        rejected += loadClients[c].rejected;
+        failed += loadClients[c].failed;
+    }
+    double seconds = secondsSince(&start);
+
+    long total = (long)clients * requests;
+    if (failed) {
+        fprintf(stderr, "loadtest: %d client(s) lost the connection to %s\n", failed, socketPath);
+        free(loadClients);
+        free(latencies);
+        return 1;
+    }
+    printf("loadtest: %d client(s) x %ld requests, pipeline %d, %s\n",
+           clients, requests, pipeline, socketPath);
+    printf("  %.3f s, %.0f requests/s, %ld ERR responses\n",
+           seconds, seconds > 0 ? total / seconds : 0.0, rejected);
+    printLatencies("reply", latencies, total);
+    free(loadClients);
+    free(latencies);
+    return 0;
 }
+// ================================================